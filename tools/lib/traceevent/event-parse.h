@@ -924,10 +924,13 @@ struct filter_arg {
 	};
 };
 
+struct filter_prog;
+
 struct filter_type {
 	int			event_id;
 	struct event_format	*event;
 	struct filter_arg	*filter;
+	struct filter_prog	*prog;
 };
 
 #define PEVENT_FILTER_ERROR_BUFSZ  1024
@@ -958,6 +961,14 @@ enum pevent_errno pevent_filter_add_filter_str(struct event_filter *filter,
 
 enum pevent_errno pevent_filter_match(struct event_filter *filter,
 				      struct pevent_record *record);
+enum pevent_errno pevent_filter_match_tree(struct event_filter *filter,
+					   struct pevent_record *record);
+int pevent_filter_compiled(struct event_filter *filter, int event_id);
+
+enum pevent_errno pevent_filter_match_batch(struct event_filter *filter,
+					    struct pevent_record **records,
+					    int nr_records,
+					    enum pevent_errno *results);
 
 int pevent_filter_strerror(struct event_filter *filter, enum pevent_errno err,
 			   char *buf, size_t buflen);
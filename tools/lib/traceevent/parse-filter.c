@@ -169,6 +169,7 @@ add_filter_type(struct event_filter *filter, int id)
 	filter_type->event_id = id;
 	filter_type->event = pevent_find_event(filter->pevent, id);
 	filter_type->filter = NULL;
+	filter_type->prog = NULL;
 
 	filter->filters++;
 
@@ -1220,6 +1221,21 @@ process_event(struct event_format *event, const char *filter_str,
 	return 0;
 }
 
+static struct filter_prog *compile_filter(struct event_format *event,
+					  struct filter_arg *arg);
+static void free_filter_prog(struct filter_prog *prog);
+
+static void set_filter_type_arg(struct filter_type *filter_type,
+				struct filter_arg *arg)
+{
+	if (filter_type->filter)
+		free_arg(filter_type->filter);
+	free_filter_prog(filter_type->prog);
+
+	filter_type->filter = arg;
+	filter_type->prog = compile_filter(filter_type->event, arg);
+}
+
 static enum pevent_errno
 filter_event(struct event_filter *filter, struct event_format *event,
 	     const char *filter_str, char *error_str)
@@ -1247,9 +1263,7 @@ filter_event(struct event_filter *filter, struct event_format *event,
 	if (filter_type == NULL)
 		return PEVENT_ERRNO__MEM_ALLOC_FAILED;
 
-	if (filter_type->filter)
-		free_arg(filter_type->filter);
-	filter_type->filter = arg;
+	set_filter_type_arg(filter_type, arg);
 
 	return 0;
 }
@@ -1371,6 +1385,7 @@ enum pevent_errno pevent_filter_add_filter_str(struct event_filter *filter,
 static void free_filter_type(struct filter_type *filter_type)
 {
 	free_arg(filter_type->filter);
+	free_filter_prog(filter_type->prog);
 }
 
 /**
@@ -1505,7 +1520,7 @@ static int copy_filter_type(struct event_filter *filter,
 		if (filter_type == NULL)
 			return -1;
 
-		filter_type->filter = arg;
+		set_filter_type_arg(filter_type, arg);
 
 		free(str);
 		return 0;
@@ -2008,6 +2023,359 @@ static int test_filter(struct event_format *event, struct filter_arg *arg,
 	}
 }
 
+/*
+ * Filters are also compiled into a flat program for a small stack machine,
+ * so that matching a record doesn't recurse over the filter_arg tree and
+ * field offsets, sizes and signedness are resolved once.  Anything the
+ * compiler doesn't handle (e.g. the numeric value of COMM, or trees that
+ * would error out at match time) is left to test_filter().
+ */
+enum filter_insn_op {
+	FILTER_INSN_CONST,	/* push val */
+	FILTER_INSN_FIELD,	/* push the value of a numeric field */
+	FILTER_INSN_CPU,	/* push record->cpu */
+	FILTER_INSN_STR,	/* push test_str(arg) */
+	FILTER_INSN_EXP,	/* pop right, left, push left <exp> right */
+	FILTER_INSN_CMP,	/* pop right, left, push left <cmp> right */
+	FILTER_INSN_NOT,	/* top = !top */
+	FILTER_INSN_TRUTH,	/* top = !!top */
+	FILTER_INSN_JZ,		/* jump to target if top == 0, else pop */
+	FILTER_INSN_JNZ,	/* jump to target if top != 0, else pop */
+};
+
+struct filter_insn {
+	enum filter_insn_op	op;
+	int			type;
+	int			offset;
+	int			size;
+	int			is_signed;
+	union {
+		unsigned long long	val;
+		int			target;
+		struct filter_arg	*arg;
+	};
+};
+
+#define FILTER_PROG_STACK	32
+
+struct filter_prog {
+	int			nr_insns;
+	int			alloc_insns;
+	int			depth;
+	int			max_depth;
+	struct filter_insn	*insns;
+};
+
+static int prog_emit(struct filter_prog *prog, enum filter_insn_op op,
+		     int stack_delta)
+{
+	struct filter_insn *insns;
+
+	if (prog->nr_insns == prog->alloc_insns) {
+		int alloc = prog->alloc_insns ? prog->alloc_insns * 2 : 16;
+
+		insns = realloc(prog->insns, alloc * sizeof(*insns));
+		if (!insns)
+			return -1;
+		prog->insns = insns;
+		prog->alloc_insns = alloc;
+	}
+
+	prog->depth += stack_delta;
+	if (prog->depth > prog->max_depth)
+		prog->max_depth = prog->depth;
+	if (prog->max_depth > FILTER_PROG_STACK)
+		return -1;
+
+	memset(&prog->insns[prog->nr_insns], 0, sizeof(*prog->insns));
+	prog->insns[prog->nr_insns].op = op;
+	return prog->nr_insns++;
+}
+
+static int compile_value(struct filter_prog *prog, struct filter_arg *arg);
+
+static int compile_field(struct filter_prog *prog, struct format_field *field)
+{
+	struct filter_insn *insn;
+	int idx;
+
+	if (field == &cpu)
+		return prog_emit(prog, FILTER_INSN_CPU, 1) < 0 ? -1 : 0;
+
+	/* COMM as a number is the address of the comm string, keep it slow */
+	if (field == &comm)
+		return -1;
+
+	switch (field->size) {
+	case 1:
+	case 2:
+	case 4:
+	case 8:
+		break;
+	default:
+		return -1;
+	}
+
+	idx = prog_emit(prog, FILTER_INSN_FIELD, 1);
+	if (idx < 0)
+		return -1;
+
+	insn = &prog->insns[idx];
+	insn->offset	= field->offset;
+	insn->size	= field->size;
+	insn->is_signed	= !!(field->flags & FIELD_IS_SIGNED);
+	return 0;
+}
+
+static int compile_value(struct filter_prog *prog, struct filter_arg *arg)
+{
+	int idx;
+
+	switch (arg->type) {
+	case FILTER_ARG_FIELD:
+		return compile_field(prog, arg->field.field);
+
+	case FILTER_ARG_VALUE:
+		if (arg->value.type != FILTER_NUMBER)
+			return -1;
+		idx = prog_emit(prog, FILTER_INSN_CONST, 1);
+		if (idx < 0)
+			return -1;
+		prog->insns[idx].val = arg->value.val;
+		return 0;
+
+	case FILTER_ARG_EXP:
+		if (arg->exp.type <= FILTER_EXP_NONE ||
+		    arg->exp.type >= FILTER_EXP_NOT)
+			return -1;
+		if (compile_value(prog, arg->exp.left) ||
+		    compile_value(prog, arg->exp.right))
+			return -1;
+		idx = prog_emit(prog, FILTER_INSN_EXP, -1);
+		if (idx < 0)
+			return -1;
+		prog->insns[idx].type = arg->exp.type;
+		return 0;
+
+	default:
+		return -1;
+	}
+}
+
+static int compile_bool(struct filter_prog *prog, struct filter_arg *arg)
+{
+	int idx;
+
+	switch (arg->type) {
+	case FILTER_ARG_BOOLEAN:
+		idx = prog_emit(prog, FILTER_INSN_CONST, 1);
+		if (idx < 0)
+			return -1;
+		prog->insns[idx].val = !!arg->boolean.value;
+		return 0;
+
+	case FILTER_ARG_OP:
+		switch (arg->op.type) {
+		case FILTER_OP_AND:
+		case FILTER_OP_OR:
+			if (compile_bool(prog, arg->op.left))
+				return -1;
+			idx = prog_emit(prog, arg->op.type == FILTER_OP_AND ?
+					FILTER_INSN_JZ : FILTER_INSN_JNZ, -1);
+			if (idx < 0 || compile_bool(prog, arg->op.right))
+				return -1;
+			prog->insns[idx].target = prog->nr_insns;
+			return 0;
+		case FILTER_OP_NOT:
+			if (compile_bool(prog, arg->op.right))
+				return -1;
+			return prog_emit(prog, FILTER_INSN_NOT, 0) < 0 ? -1 : 0;
+		default:
+			return -1;
+		}
+
+	case FILTER_ARG_NUM:
+		if (arg->num.type < FILTER_CMP_EQ ||
+		    arg->num.type > FILTER_CMP_LE)
+			return -1;
+		if (compile_value(prog, arg->num.left) ||
+		    compile_value(prog, arg->num.right))
+			return -1;
+		idx = prog_emit(prog, FILTER_INSN_CMP, -1);
+		if (idx < 0)
+			return -1;
+		prog->insns[idx].type = arg->num.type;
+		return 0;
+
+	case FILTER_ARG_STR:
+		if (arg->str.type < FILTER_CMP_MATCH ||
+		    arg->str.type > FILTER_CMP_NOT_REGEX)
+			return -1;
+		idx = prog_emit(prog, FILTER_INSN_STR, 1);
+		if (idx < 0)
+			return -1;
+		prog->insns[idx].arg = arg;
+		return 0;
+
+	case FILTER_ARG_EXP:
+	case FILTER_ARG_VALUE:
+	case FILTER_ARG_FIELD:
+		if (compile_value(prog, arg))
+			return -1;
+		return prog_emit(prog, FILTER_INSN_TRUTH, 0) < 0 ? -1 : 0;
+
+	default:
+		return -1;
+	}
+}
+
+static void free_filter_prog(struct filter_prog *prog)
+{
+	if (!prog)
+		return;
+
+	free(prog->insns);
+	free(prog);
+}
+
+static struct filter_prog *compile_filter(struct event_format *event,
+					  struct filter_arg *arg)
+{
+	struct filter_prog *prog;
+
+	if (!event || !arg)
+		return NULL;
+
+	prog = calloc(1, sizeof(*prog));
+	if (!prog)
+		return NULL;
+
+	if (compile_bool(prog, arg)) {
+		free_filter_prog(prog);
+		return NULL;
+	}
+
+	return prog;
+}
+
+static inline unsigned long long
+prog_read_field(struct pevent *pevent, struct filter_insn *insn, void *data)
+{
+	void *ptr = data + insn->offset;
+	unsigned long long val;
+
+	switch (insn->size) {
+	case 1:
+		return insn->is_signed ? (unsigned long long)*(char *)ptr :
+					 *(unsigned char *)ptr;
+	case 2:
+		val = data2host2(pevent, ptr);
+		return insn->is_signed ? (unsigned long long)(short)val : val;
+	case 4:
+		val = data2host4(pevent, ptr);
+		return insn->is_signed ? (unsigned long long)(int)val : val;
+	default:
+		return data2host8(pevent, ptr);
+	}
+}
+
+static inline unsigned long long
+prog_exp(int type, unsigned long long lval, unsigned long long rval)
+{
+	switch (type) {
+	case FILTER_EXP_ADD:	return lval + rval;
+	case FILTER_EXP_SUB:	return lval - rval;
+	case FILTER_EXP_MUL:	return lval * rval;
+	case FILTER_EXP_DIV:	return rval ? lval / rval : 0;
+	case FILTER_EXP_MOD:	return rval ? lval % rval : 0;
+	case FILTER_EXP_RSHIFT:	return lval >> rval;
+	case FILTER_EXP_LSHIFT:	return lval << rval;
+	case FILTER_EXP_AND:	return lval & rval;
+	case FILTER_EXP_OR:	return lval | rval;
+	default:		return lval ^ rval;
+	}
+}
+
+static inline int
+prog_cmp(int type, unsigned long long lval, unsigned long long rval)
+{
+	switch (type) {
+	case FILTER_CMP_EQ:	return lval == rval;
+	case FILTER_CMP_NE:	return lval != rval;
+	case FILTER_CMP_GT:	return lval > rval;
+	case FILTER_CMP_LT:	return lval < rval;
+	case FILTER_CMP_GE:	return lval >= rval;
+	default:		return lval <= rval;
+	}
+}
+
+static int run_filter_prog(struct filter_prog *prog, struct event_format *event,
+			   struct pevent_record *record, enum pevent_errno *err)
+{
+	unsigned long long stack[FILTER_PROG_STACK];
+	struct pevent *pevent = event->pevent;
+	struct filter_insn *insn;
+	int sp = -1, pc = 0;
+
+	while (pc < prog->nr_insns) {
+		insn = &prog->insns[pc++];
+
+		switch (insn->op) {
+		case FILTER_INSN_CONST:
+			stack[++sp] = insn->val;
+			break;
+		case FILTER_INSN_FIELD:
+			stack[++sp] = prog_read_field(pevent, insn, record->data);
+			break;
+		case FILTER_INSN_CPU:
+			stack[++sp] = record->cpu;
+			break;
+		case FILTER_INSN_STR:
+			stack[++sp] = test_str(event, insn->arg, record, err);
+			break;
+		case FILTER_INSN_EXP:
+			sp--;
+			stack[sp] = prog_exp(insn->type, stack[sp], stack[sp + 1]);
+			break;
+		case FILTER_INSN_CMP:
+			sp--;
+			stack[sp] = prog_cmp(insn->type, stack[sp], stack[sp + 1]);
+			break;
+		case FILTER_INSN_NOT:
+			stack[sp] = !stack[sp];
+			break;
+		case FILTER_INSN_TRUTH:
+			stack[sp] = !!stack[sp];
+			break;
+		case FILTER_INSN_JZ:
+			if (!stack[sp])
+				pc = insn->target;
+			else
+				sp--;
+			break;
+		case FILTER_INSN_JNZ:
+			if (stack[sp])
+				pc = insn->target;
+			else
+				sp--;
+			break;
+		}
+	}
+
+	return stack[0];
+}
+
+static int filter_type_match(struct filter_type *filter_type,
+			     struct pevent_record *record,
+			     enum pevent_errno *err, bool compiled)
+{
+	if (filter_type->prog && compiled)
+		return run_filter_prog(filter_type->prog, filter_type->event,
+				       record, err);
+
+	return test_filter(filter_type->event, filter_type->filter, record, err);
+}
+
 /**
  * pevent_event_filtered - return true if event has filter
  * @filter: filter struct with filter information
@@ -2028,6 +2396,34 @@ int pevent_event_filtered(struct event_filter *filter, int event_id)
 	return filter_type ? 1 : 0;
 }
 
+static enum pevent_errno __pevent_filter_match(struct event_filter *filter,
+					       struct pevent_record *record,
+					       bool compiled)
+{
+	struct pevent *pevent = filter->pevent;
+	struct filter_type *filter_type;
+	int event_id;
+	int ret;
+	enum pevent_errno err = 0;
+
+	filter_init_error_buf(filter);
+
+	if (!filter->filters)
+		return PEVENT_ERRNO__NO_FILTER;
+
+	event_id = pevent_data_type(pevent, record);
+
+	filter_type = find_filter_type(filter, event_id);
+	if (!filter_type)
+		return PEVENT_ERRNO__FILTER_NOT_FOUND;
+
+	ret = filter_type_match(filter_type, record, &err, compiled);
+	if (err)
+		return err;
+
+	return ret ? PEVENT_ERRNO__FILTER_MATCH : PEVENT_ERRNO__FILTER_MISS;
+}
+
 /**
  * pevent_filter_match - test if a record matches a filter
  * @filter: filter struct with filter information
@@ -2043,28 +2439,99 @@ int pevent_event_filtered(struct event_filter *filter, int event_id)
 enum pevent_errno pevent_filter_match(struct event_filter *filter,
 				      struct pevent_record *record)
 {
-	struct pevent *pevent = filter->pevent;
+	return __pevent_filter_match(filter, record, true);
+}
+
+/**
+ * pevent_filter_match_tree - test a record without the compiled filter
+ * @filter: filter struct with filter information
+ * @record: the record to test against the filter
+ *
+ * Like pevent_filter_match(), but always interprets the filter tree, as
+ * a reference for the compiled filter programs.
+ */
+enum pevent_errno pevent_filter_match_tree(struct event_filter *filter,
+					   struct pevent_record *record)
+{
+	return __pevent_filter_match(filter, record, false);
+}
+
+/**
+ * pevent_filter_compiled - return true if the filter of an event is compiled
+ * @filter: filter struct with filter information
+ * @event_id: event id of the filter
+ *
+ * Returns 1 if the filter for @event_id is matched with a compiled
+ *   program, otherwise 0.
+ */
+int pevent_filter_compiled(struct event_filter *filter, int event_id)
+{
 	struct filter_type *filter_type;
-	int event_id;
-	int ret;
-	enum pevent_errno err = 0;
+
+	if (!filter->filters)
+		return 0;
+
+	filter_type = find_filter_type(filter, event_id);
+
+	return filter_type && filter_type->prog ? 1 : 0;
+}
+
+/**
+ * pevent_filter_match_batch - test several records against a filter
+ * @filter: filter struct with filter information
+ * @records: the records to test against the filter
+ * @nr_records: number of entries in @records
+ * @results: where to store the result for each record
+ *
+ * Like calling pevent_filter_match() on each record, but the filter for
+ * an event is only looked up once for a run of records of that event.
+ *
+ * Returns: 0, or the first error stored in @results for a record.
+ */
+enum pevent_errno pevent_filter_match_batch(struct event_filter *filter,
+					    struct pevent_record **records,
+					    int nr_records,
+					    enum pevent_errno *results)
+{
+	struct pevent *pevent = filter->pevent;
+	struct filter_type *filter_type = NULL;
+	enum pevent_errno ret = 0;
+	int i, event_id, last_id = -1;
 
 	filter_init_error_buf(filter);
 
-	if (!filter->filters)
-		return PEVENT_ERRNO__NO_FILTER;
+	for (i = 0; i < nr_records; i++) {
+		enum pevent_errno err = 0;
 
-	event_id = pevent_data_type(pevent, record);
+		if (!filter->filters) {
+			results[i] = PEVENT_ERRNO__NO_FILTER;
+			continue;
+		}
 
-	filter_type = find_filter_type(filter, event_id);
-	if (!filter_type)
-		return PEVENT_ERRNO__FILTER_NOT_FOUND;
+		event_id = pevent_data_type(pevent, records[i]);
+		if (event_id != last_id) {
+			filter_type = find_filter_type(filter, event_id);
+			last_id = event_id;
+		}
 
-	ret = test_filter(filter_type->event, filter_type->filter, record, &err);
-	if (err)
-		return err;
+		if (!filter_type) {
+			results[i] = PEVENT_ERRNO__FILTER_NOT_FOUND;
+			continue;
+		}
 
-	return ret ? PEVENT_ERRNO__FILTER_MATCH : PEVENT_ERRNO__FILTER_MISS;
+		if (filter_type_match(filter_type, records[i], &err, true))
+			results[i] = PEVENT_ERRNO__FILTER_MATCH;
+		else
+			results[i] = PEVENT_ERRNO__FILTER_MISS;
+
+		if (err) {
+			results[i] = err;
+			if (!ret)
+				ret = err;
+		}
+	}
+
+	return ret;
 }
 
 static char *op_to_str(struct event_filter *filter, struct filter_arg *arg)
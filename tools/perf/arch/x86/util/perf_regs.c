@@ -1,3 +1,8 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "../../perf.h"
 #include "../../util/perf_regs.h"
 
@@ -26,3 +31,138 @@ const struct sample_reg sample_reg_masks[] = {
 #endif
 	SMPL_REG_END
 };
+
+struct sdt_name_reg {
+	const char *sdt_name;
+	const char *uprobe_name;
+};
+#define SDT_NAME_REG(n, m) {.sdt_name = "%" #n, .uprobe_name = "%" #m}
+#define SDT_NAME_REG_END {.sdt_name = NULL, .uprobe_name = NULL}
+
+static const struct sdt_name_reg sdt_reg_tbl[] = {
+	SDT_NAME_REG(eax, ax),
+	SDT_NAME_REG(rax, ax),
+	SDT_NAME_REG(al,  ax),
+	SDT_NAME_REG(ax,  ax),
+	SDT_NAME_REG(ebx, bx),
+	SDT_NAME_REG(rbx, bx),
+	SDT_NAME_REG(bl,  bx),
+	SDT_NAME_REG(bx,  bx),
+	SDT_NAME_REG(ecx, cx),
+	SDT_NAME_REG(rcx, cx),
+	SDT_NAME_REG(cl,  cx),
+	SDT_NAME_REG(cx,  cx),
+	SDT_NAME_REG(edx, dx),
+	SDT_NAME_REG(rdx, dx),
+	SDT_NAME_REG(dl,  dx),
+	SDT_NAME_REG(dx,  dx),
+	SDT_NAME_REG(esi, si),
+	SDT_NAME_REG(rsi, si),
+	SDT_NAME_REG(sil, si),
+	SDT_NAME_REG(si,  si),
+	SDT_NAME_REG(edi, di),
+	SDT_NAME_REG(rdi, di),
+	SDT_NAME_REG(dil, di),
+	SDT_NAME_REG(di,  di),
+	SDT_NAME_REG(ebp, bp),
+	SDT_NAME_REG(rbp, bp),
+	SDT_NAME_REG(bpl, bp),
+	SDT_NAME_REG(bp,  bp),
+	SDT_NAME_REG(esp, sp),
+	SDT_NAME_REG(rsp, sp),
+	SDT_NAME_REG(spl, sp),
+	SDT_NAME_REG(sp,  sp),
+#ifdef HAVE_ARCH_X86_64_SUPPORT
+	SDT_NAME_REG(r8,   r8),
+	SDT_NAME_REG(r8d,  r8),
+	SDT_NAME_REG(r8w,  r8),
+	SDT_NAME_REG(r8b,  r8),
+	SDT_NAME_REG(r9,   r9),
+	SDT_NAME_REG(r9d,  r9),
+	SDT_NAME_REG(r9w,  r9),
+	SDT_NAME_REG(r9b,  r9),
+	SDT_NAME_REG(r10,  r10),
+	SDT_NAME_REG(r10d, r10),
+	SDT_NAME_REG(r10w, r10),
+	SDT_NAME_REG(r10b, r10),
+	SDT_NAME_REG(r11,  r11),
+	SDT_NAME_REG(r11d, r11),
+	SDT_NAME_REG(r11w, r11),
+	SDT_NAME_REG(r11b, r11),
+	SDT_NAME_REG(r12,  r12),
+	SDT_NAME_REG(r12d, r12),
+	SDT_NAME_REG(r12w, r12),
+	SDT_NAME_REG(r12b, r12),
+	SDT_NAME_REG(r13,  r13),
+	SDT_NAME_REG(r13d, r13),
+	SDT_NAME_REG(r13w, r13),
+	SDT_NAME_REG(r13b, r13),
+	SDT_NAME_REG(r14,  r14),
+	SDT_NAME_REG(r14d, r14),
+	SDT_NAME_REG(r14w, r14),
+	SDT_NAME_REG(r14b, r14),
+	SDT_NAME_REG(r15,  r15),
+	SDT_NAME_REG(r15d, r15),
+	SDT_NAME_REG(r15w, r15),
+	SDT_NAME_REG(r15b, r15),
+#endif
+	SDT_NAME_REG_END,
+};
+
+static const char *sdt_rename_register(const char *reg, size_t len)
+{
+	const struct sdt_name_reg *rnames;
+
+	for (rnames = sdt_reg_tbl; rnames->sdt_name; rnames++) {
+		if (strlen(rnames->sdt_name) == len &&
+		    !strncmp(rnames->sdt_name, reg, len))
+			return rnames->uprobe_name;
+	}
+
+	return NULL;
+}
+
+/*
+ * The SDT operands are in AT&T syntax: "%reg" and "[-]NUM(%reg)" can be
+ * fetched by uprobes once the registers are renamed, e.g. "-4(%rbp)" is
+ * "-4(%bp)".  Immediates, %rip relative and indexed operands can't.
+ */
+int arch_sdt_arg_parse_op(char *old_op, char **new_op)
+{
+	const char *reg, *uprobe_reg;
+	char *end, *paren;
+	long offs = 0;
+	int ret;
+
+	if (old_op[0] == '%') {
+		uprobe_reg = sdt_rename_register(old_op, strlen(old_op));
+		if (!uprobe_reg)
+			return SDT_ARG_SKIP;
+
+		*new_op = strdup(uprobe_reg);
+		return *new_op ? SDT_ARG_VALID : -ENOMEM;
+	}
+
+	paren = strchr(old_op, '(');
+	if (!paren || paren[1] != '%')
+		return SDT_ARG_SKIP;
+
+	if (paren != old_op) {
+		offs = strtol(old_op, &end, 0);
+		if (end != paren)
+			return SDT_ARG_SKIP;
+	}
+
+	reg = paren + 1;
+	end = strchr(reg, ')');
+	if (!end || end[1] != '\0')
+		return SDT_ARG_SKIP;
+
+	uprobe_reg = sdt_rename_register(reg, end - reg);
+	if (!uprobe_reg)
+		return SDT_ARG_SKIP;
+
+	/* uprobes need the sign of the offset */
+	ret = asprintf(new_op, "%+ld(%s)", offs, uprobe_reg);
+	return ret < 0 ? -ENOMEM : SDT_ARG_VALID;
+}
@@ -0,0 +1,138 @@
+/*
+ * trace-filter.c
+ *
+ * filter: Benchmark for libtraceevent filter matching, running typical
+ * sched_switch and syscall filters over synthesized records.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include <subcmd/parse-options.h>
+#include "../builtin.h"
+#include "../util/trace-filter-synth.h"
+#include "bench.h"
+
+#include <traceevent/event-parse.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+static const char *filters[] = {
+	"sched/sched_switch: prev_pid != 0 && next_pid != 0 && "
+	"(prev_prio < 120 || next_prio < 120 || prev_state & 2) && "
+	"prev_comm != \"swapper/0\"",
+	"raw_syscalls/sys_enter: id == 0 || id == 1 || id == 3 || id == 232 || "
+	"(id >= 257 && id <= 262)",
+};
+
+static unsigned int	nr_records = 4096;
+static unsigned int	loops = 1000;
+static bool		batch;
+
+static const struct option options[] = {
+	OPT_UINTEGER('n', "records", &nr_records, "Number of records to synthesize"),
+	OPT_UINTEGER('l', "loop", &loops, "Number of times to match all records"),
+	OPT_BOOLEAN('b', "batch", &batch, "Use pevent_filter_match_batch()"),
+	OPT_END()
+};
+
+static const char * const bench_trace_filter_usage[] = {
+	"perf bench trace filter <options>",
+	NULL
+};
+
+int bench_trace_filter(int argc, const char **argv,
+		       const char *prefix __maybe_unused)
+{
+	struct pevent_record *records, **record_ptrs;
+	enum pevent_errno *results;
+	struct event_filter *filter;
+	struct timeval start, stop, diff;
+	unsigned long long nr_matched = 0, nr_total;
+	struct pevent *pevent;
+	unsigned int i, l;
+	int err = -1;
+
+	argc = parse_options(argc, argv, options, bench_trace_filter_usage, 0);
+	if (argc || !nr_records)
+		usage_with_options(bench_trace_filter_usage, options);
+
+	pevent = trace_filter_synth__pevent();
+	if (pevent == NULL)
+		return -1;
+
+	filter = pevent_filter_alloc(pevent);
+	if (filter == NULL)
+		goto out_free_pevent;
+
+	for (i = 0; i < ARRAY_SIZE(filters); i++) {
+		if (pevent_filter_add_filter_str(filter, filters[i]) < 0) {
+			fprintf(stderr, "Failed to add filter '%s'\n", filters[i]);
+			goto out_free_filter;
+		}
+	}
+
+	records = trace_filter_synth__records(nr_records);
+	record_ptrs = calloc(nr_records, sizeof(*record_ptrs));
+	results = calloc(nr_records, sizeof(*results));
+	if (!records || !record_ptrs || !results)
+		goto out_free;
+
+	for (i = 0; i < nr_records; i++)
+		record_ptrs[i] = &records[i];
+
+	gettimeofday(&start, NULL);
+
+	for (l = 0; l < loops; l++) {
+		if (batch) {
+			pevent_filter_match_batch(filter, record_ptrs,
+						  nr_records, results);
+		} else {
+			for (i = 0; i < nr_records; i++)
+				results[i] = pevent_filter_match(filter, &records[i]);
+		}
+
+		for (i = 0; i < nr_records; i++)
+			nr_matched += results[i] == PEVENT_ERRNO__FILTER_MATCH;
+	}
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	nr_total = (unsigned long long)nr_records * loops;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Matched %llu sched_switch and sys_enter records%s, %.2f%% passed\n\n",
+		       nr_total, batch ? " in batches" : "",
+		       (double)nr_matched * 100 / nr_total);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec, (unsigned long)(diff.tv_usec / 1000));
+
+		printf(" %14.0lf records/sec\n",
+		       (double)nr_total * 1000000 /
+		       (double)(diff.tv_sec * 1000000 + diff.tv_usec ?: 1));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec, (unsigned long)(diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	err = 0;
+out_free:
+	free(results);
+	free(record_ptrs);
+	free(records);
+out_free_filter:
+	pevent_filter_free(filter);
+out_free_pevent:
+	pevent_free(pevent);
+	return err;
+}
@@ -0,0 +1,104 @@
+/*
+ * trace-replay.c
+ *
+ * replay: Benchmark for 'perf trace' syscall formatting, replaying a
+ * session recorded with 'perf trace record'.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include <subcmd/parse-options.h>
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+
+static const char	*input = "perf.data";
+static const char	*output = "/dev/null";
+static unsigned int	loops = 10;
+
+static const struct option options[] = {
+	OPT_STRING('i', "input", &input, "file",
+		   "Session recorded with 'perf trace record'"),
+	OPT_STRING('o', "output", &output, "file",
+		   "Where to write the formatted syscalls"),
+	OPT_UINTEGER('l', "loop", &loops, "Number of times to replay the session"),
+	OPT_END()
+};
+
+static const char * const bench_trace_replay_usage[] = {
+	"perf bench trace replay <options>",
+	NULL
+};
+
+int bench_trace_replay(int argc, const char **argv,
+		       const char *prefix __maybe_unused)
+{
+	struct timeval start, stop, diff;
+	unsigned long nr_events = 0;
+	unsigned long result_usec;
+	FILE *fp;
+	int err;
+
+	argc = parse_options(argc, argv, options, bench_trace_replay_usage, 0);
+	if (argc)
+		usage_with_options(bench_trace_replay_usage, options);
+
+	if (access(input, R_OK)) {
+		fprintf(stderr, "Can't read %s: %s, record one with 'perf trace record'\n",
+			input, strerror(errno));
+		return -1;
+	}
+
+	fp = fopen(output, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "Can't open %s: %s\n", output, strerror(errno));
+		return -1;
+	}
+
+	gettimeofday(&start, NULL);
+	err = trace__bench_replay(input, fp, loops, &nr_events);
+	gettimeofday(&stop, NULL);
+	fclose(fp);
+
+	if (err) {
+		fprintf(stderr, "Failed to replay %s\n", input);
+		return err;
+	}
+
+	timersub(&stop, &start, &diff);
+	result_usec = diff.tv_sec * 1000000 + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Replayed %s %u times, %lu events\n\n",
+		       input, loops, nr_events);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec, (unsigned long)(diff.tv_usec / 1000));
+
+		if (nr_events) {
+			printf(" %14lf usecs/event\n",
+			       (double)result_usec / (double)nr_events);
+			printf(" %14.0lf events/sec\n",
+			       (double)nr_events * 1000000 / (double)(result_usec ?: 1));
+		}
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec, (unsigned long)(diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
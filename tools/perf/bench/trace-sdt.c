@@ -0,0 +1,97 @@
+/*
+ * trace-sdt.c
+ *
+ * sdt: Benchmark for the cost of hitting an SDT probe, to be run with and
+ * without the probe enabled, e.g.:
+ *
+ *   perf probe -x `which perf` -a %sdt_perf_bench:hit
+ *   perf record -e sdt_perf_bench:hit -- perf bench trace sdt
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include <subcmd/parse-options.h>
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#ifdef HAVE_SDT_EVENT
+#include <sys/sdt.h>
+#else
+#define DTRACE_PROBE2(provider, name, arg1, arg2)	do { } while (0)
+#endif
+
+static unsigned int	loops = 10000000;
+
+static const struct option options[] = {
+	OPT_UINTEGER('l', "loop", &loops, "Number of probe hits"),
+	OPT_END()
+};
+
+static const char * const bench_trace_sdt_usage[] = {
+	"perf bench trace sdt <options>",
+	NULL
+};
+
+/* Not inlined, so that it is the same cost with or without SDT support */
+__attribute__ ((noinline))
+static unsigned long sdt_hit(unsigned long i, unsigned long sum)
+{
+	DTRACE_PROBE2(perf_bench, hit, i, sum);
+	return sum + i;
+}
+
+int bench_trace_sdt(int argc, const char **argv,
+		    const char *prefix __maybe_unused)
+{
+	struct timeval start, stop, diff;
+	unsigned long i, sum = 0;
+	double usecs;
+
+	argc = parse_options(argc, argv, options, bench_trace_sdt_usage, 0);
+	if (argc || !loops)
+		usage_with_options(bench_trace_sdt_usage, options);
+
+#ifndef HAVE_SDT_EVENT
+	fprintf(stderr, "perf was built without sys/sdt.h, there is no "
+		"sdt_perf_bench:hit probe to enable.\n");
+#endif
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < loops; i++)
+		sum = sdt_hit(i, sum);
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	usecs = (double)(diff.tv_sec * 1000000 + diff.tv_usec);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Hit sdt_perf_bench:hit %u times (sum %lu)\n\n",
+		       loops, sum);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec, (unsigned long)(diff.tv_usec / 1000));
+
+		printf(" %14lf usecs/hit\n", usecs / loops);
+		printf(" %14.0lf hits/sec\n",
+		       (double)loops * 1000000 / (usecs ?: 1));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec, (unsigned long)(diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -66,6 +66,16 @@ static struct bench futex_benchmarks[] = {
 	{ NULL,		NULL,						NULL			}
 };
 
+static struct bench trace_benchmarks[] = {
+	{ "filter",	"Benchmark for tracepoint filter matching",	bench_trace_filter	},
+	{ "sdt",	"Benchmark for SDT probe hits",			bench_trace_sdt		},
+#ifdef HAVE_LIBAUDIT_SUPPORT
+	{ "replay",	"Benchmark for 'perf trace' syscall formatting", bench_trace_replay	},
+#endif
+	{ "all",	"Run all trace benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
 struct collection {
 	const char	*name;
 	const char	*summary;
@@ -79,6 +89,7 @@ static struct collection collections[] = {
 	{ "numa",	"NUMA scheduling and MM benchmarks",		numa_benchmarks		},
 #endif
 	{"futex",       "Futex stressing benchmarks",                   futex_benchmarks        },
+	{ "trace",	"Tracing benchmarks",				trace_benchmarks	},
 	{ "all",	"All benchmarks",				NULL			},
 	{ NULL,		NULL,						NULL			}
 };
@@ -17,9 +17,11 @@
 #include "util/symbol.h"
 #include "util/util.h"
 #include "util/data.h"
+#include "util/machine.h"
 
 #include <stdlib.h>
 #include <math.h>
+#include <pthread.h>
 
 /* Diff command specific HPP columns. */
 enum {
@@ -47,6 +49,12 @@ struct data__file {
 	int			 idx;
 	struct hists		*hists;
 	struct diff_hpp_fmt	 fmt[PERF_HPP_DIFF__MAX_INDEX];
+	int			 ret;
+	/* accounted once processed, see data__account() */
+	u64			 nr_samples;
+	u64			 nr_entries;
+	u64			 nr_dsos;
+	u64			 mem_size;
 };
 
 static struct data__file *data__files;
@@ -63,6 +71,7 @@ static int data__files_cnt;
 static bool force;
 static bool show_period;
 static bool show_formula;
+static int diff_jobs;
 static bool show_baseline_only;
 static unsigned int sort_compute;
 
@@ -667,11 +676,20 @@ static void data__fprintf(void)
 
 	fprintf(stdout, "# Data files:\n");
 
-	data__for_each_file(i, d)
+	data__for_each_file(i, d) {
 		fprintf(stdout, "#  [%d] %s %s\n",
 			d->idx, d->file.path,
 			!d->idx ? "(Baseline)" : "");
 
+		if (verbose)
+			fprintf(stdout, "#       %" PRIu64 " samples, %" PRIu64
+				" entries, %u threads, %" PRIu64
+				" dsos, ~%" PRIu64 " KB\n",
+				d->nr_samples, d->nr_entries,
+				d->session->machines.host.nr_threads,
+				d->nr_dsos, d->mem_size / 1024);
+	}
+
 	fprintf(stdout, "#\n");
 }
 
@@ -730,26 +748,143 @@ static void data__free(struct data__file *d)
 	}
 }
 
-static int __cmd_diff(void)
+/*
+ * Approximate memory used by the hist entries and the symbols of a
+ * session, the bulk of it for large profiles.
+ */
+static void data__account(struct data__file *d)
+{
+	struct machine *machine = &d->session->machines.host;
+	struct perf_evsel *evsel;
+	struct rb_node *nd;
+	struct dso *dso;
+	int type;
+
+	evlist__for_each_entry(d->session->evlist, evsel) {
+		struct hists *hists = evsel__hists(evsel);
+		struct rb_root *root;
+
+		if (hists__has(hists, need_collapse))
+			root = &hists->entries_collapsed;
+		else
+			root = hists->entries_in;
+
+		d->nr_samples += hists->stats.nr_events[PERF_RECORD_SAMPLE];
+		for (nd = rb_first(root); nd; nd = rb_next(nd))
+			d->nr_entries++;
+	}
+
+	d->mem_size = d->nr_entries * sizeof(struct hist_entry) +
+		      machine->nr_threads * sizeof(struct thread);
+
+	list_for_each_entry(dso, &machine->dsos.head, node) {
+		d->nr_dsos++;
+		d->mem_size += sizeof(*dso);
+
+		for (type = 0; type < MAP__NR_TYPES; type++) {
+			for (nd = rb_first(&dso->symbols[type]); nd; nd = rb_next(nd)) {
+				struct symbol *sym = rb_entry(nd, struct symbol, rb_node);
+
+				d->mem_size += sizeof(*sym) + sym->namelen +
+					       symbol_conf.priv_size;
+			}
+		}
+	}
+}
+
+static int data__process_file(struct data__file *d)
+{
+	int ret;
+
+	ret = perf_session__process_events(d->session);
+	if (ret) {
+		pr_err("Failed to process %s\n", d->file.path);
+		return ret;
+	}
+
+	perf_evlist__collapse_resort(d->session->evlist);
+	data__account(d);
+	return 0;
+}
+
+static pthread_mutex_t data__next_lock = PTHREAD_MUTEX_INITIALIZER;
+static int data__next;
+
+/*
+ * The sessions are independent, each one is processed by a single thread.
+ * They are opened beforehand, as reading the headers (e.g. the tracing
+ * data) uses global state.
+ */
+static void *data__process_thread(void *arg __maybe_unused)
 {
 	struct data__file *d;
-	int ret = -EINVAL, i;
+
+	while (1) {
+		pthread_mutex_lock(&data__next_lock);
+		d = data__next < data__files_cnt ? &data__files[data__next++] : NULL;
+		pthread_mutex_unlock(&data__next_lock);
+
+		if (!d)
+			break;
+
+		d->ret = data__process_file(d);
+	}
+
+	return NULL;
+}
+
+static int data__process_files(void)
+{
+	int i, nr_threads = diff_jobs;
+	struct data__file *d;
+	pthread_t *threads;
 
 	data__for_each_file(i, d) {
 		d->session = perf_session__new(&d->file, false, &tool);
 		if (!d->session) {
 			pr_err("Failed to open %s\n", d->file.path);
-			ret = -1;
-			goto out_delete;
+			return -1;
 		}
+	}
 
-		ret = perf_session__process_events(d->session);
-		if (ret) {
-			pr_err("Failed to process %s\n", d->file.path);
-			goto out_delete;
-		}
+	if (nr_threads <= 0)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_threads > data__files_cnt)
+		nr_threads = data__files_cnt;
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		return -ENOMEM;
 
-		perf_evlist__collapse_resort(d->session->evlist);
+	/* this thread is one of the workers */
+	for (i = 1; i < nr_threads; i++) {
+		if (pthread_create(&threads[i], NULL, data__process_thread, NULL))
+			break;
+	}
+
+	nr_threads = i;
+	data__process_thread(NULL);
+
+	for (i = 1; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	return 0;
+}
+
+static int __cmd_diff(void)
+{
+	struct data__file *d;
+	int ret, i;
+
+	ret = data__process_files();
+	if (ret)
+		goto out_delete;
+
+	data__for_each_file(i, d) {
+		ret = d->ret;
+		if (ret)
+			goto out_delete;
 	}
 
 	data_process();
@@ -807,6 +942,8 @@ static const struct option options[] = {
 	OPT_UINTEGER('o', "order", &sort_compute, "Specify compute sorting."),
 	OPT_CALLBACK(0, "percentage", NULL, "relative|absolute",
 		     "How to display percentage of filtered entries", parse_filter_percentage),
+	OPT_INTEGER('j', "jobs", &diff_jobs,
+		    "number of data files processed in parallel, default: number of online CPUs"),
 	OPT_END()
 };
 
@@ -18,6 +18,7 @@
 #include "util/top.h"
 #include "util/data.h"
 #include "util/ordered-events.h"
+#include "util/log-hist.h"
 
 #include <sys/prctl.h>
 #ifdef HAVE_TIMERFD_SUPPORT
@@ -107,10 +108,24 @@ static bool register_kvm_events_ops(struct perf_kvm_stat *kvm)
 	return false;
 }
 
+struct vcpu_event_stats {
+	struct kvm_event_stats stats;
+	struct log_hist *hist;
+};
+
 struct vcpu_event_record {
 	int vcpu_id;
 	u64 start_time;
 	struct kvm_event *last_event;
+
+	/*
+	 * The events handled by this vcpu, indexed by kvm_event->idx: only
+	 * its own samples update them, they are folded into the kvm_events
+	 * by merge_vcpu_records() when the results are displayed.
+	 */
+	struct list_head list;
+	int nr_events;
+	struct vcpu_event_stats *events;
 };
 
 
@@ -120,28 +135,33 @@ static void init_kvm_event_record(struct perf_kvm_stat *kvm)
 
 	for (i = 0; i < EVENTS_CACHE_SIZE; i++)
 		INIT_LIST_HEAD(&kvm->kvm_events_cache[i]);
+
+	INIT_LIST_HEAD(&kvm->vcpu_records);
+}
+
+static void init_kvm_event_stats(struct kvm_event_stats *kvm_stats)
+{
+	kvm_stats->time = 0;
+	init_stats(&kvm_stats->stats);
 }
 
 #ifdef HAVE_TIMERFD_SUPPORT
-static void clear_events_cache_stats(struct list_head *kvm_events_cache)
+static void clear_events_cache_stats(struct perf_kvm_stat *kvm)
 {
-	struct list_head *head;
 	struct kvm_event *event;
-	unsigned int i;
-	int j;
-
-	for (i = 0; i < EVENTS_CACHE_SIZE; i++) {
-		head = &kvm_events_cache[i];
-		list_for_each_entry(event, head, hash_entry) {
-			/* reset stats for event */
-			event->total.time = 0;
-			init_stats(&event->total.stats);
-
-			for (j = 0; j < event->max_vcpu; ++j) {
-				event->vcpu[j].time = 0;
-				init_stats(&event->vcpu[j].stats);
-			}
-		}
+	int i, j;
+
+	for (i = 0; i < kvm->nr_events; i++) {
+		event = kvm->events[i];
+
+		/* reset stats for event */
+		init_kvm_event_stats(&event->total);
+
+		for (j = 0; j < event->max_vcpu; ++j)
+			init_kvm_event_stats(&event->vcpu[j]);
+
+		if (event->hist)
+			memset(event->hist, 0, sizeof(*event->hist));
 	}
 }
 #endif
@@ -153,7 +173,7 @@ static int kvm_events_hash_fn(u64 key)
 
 static bool kvm_event_expand(struct kvm_event *event, int vcpu_id)
 {
-	int old_max_vcpu = event->max_vcpu;
+	int i, old_max_vcpu = event->max_vcpu;
 	void *prev;
 
 	if (vcpu_id < event->max_vcpu)
@@ -171,8 +191,8 @@ static bool kvm_event_expand(struct kvm_event *event, int vcpu_id)
 		return false;
 	}
 
-	memset(event->vcpu + old_max_vcpu, 0,
-	       (event->max_vcpu - old_max_vcpu) * sizeof(*event->vcpu));
+	for (i = old_max_vcpu; i < event->max_vcpu; i++)
+		init_kvm_event_stats(&event->vcpu[i]);
 	return true;
 }
 
@@ -191,6 +211,8 @@ static struct kvm_event *kvm_alloc_init_event(struct event_key *key)
 	return event;
 }
 
+#define EVENTS_ALLOC_NR		64
+
 static struct kvm_event *find_create_kvm_event(struct perf_kvm_stat *kvm,
 					       struct event_key *key)
 {
@@ -205,10 +227,24 @@ static struct kvm_event *find_create_kvm_event(struct perf_kvm_stat *kvm,
 			return event;
 	}
 
+	if ((kvm->nr_events % EVENTS_ALLOC_NR) == 0) {
+		struct kvm_event **events;
+
+		events = realloc(kvm->events, (kvm->nr_events + EVENTS_ALLOC_NR) *
+					      sizeof(*events));
+		if (!events) {
+			pr_err("Not enough memory\n");
+			return NULL;
+		}
+		kvm->events = events;
+	}
+
 	event = kvm_alloc_init_event(key);
 	if (!event)
 		return NULL;
 
+	event->idx = kvm->nr_events++;
+	kvm->events[event->idx] = event;
 	list_add(&event->hash_entry, head);
 	return event;
 }
@@ -245,18 +281,97 @@ static double kvm_event_rel_stddev(int vcpu_id, struct kvm_event *event)
 				avg_stats(&kvm_stats->stats));
 }
 
-static bool update_kvm_event(struct kvm_event *event, int vcpu_id,
-			     u64 time_diff)
+static bool update_vcpu_event(struct perf_kvm_stat *kvm,
+			      struct vcpu_event_record *vcpu_record,
+			      struct kvm_event *event, u64 time_diff)
 {
-	if (vcpu_id == -1) {
-		kvm_update_event_stats(&event->total, time_diff);
-		return true;
+	struct vcpu_event_stats *vcpu_stats;
+	int i;
+
+	if (event->idx >= vcpu_record->nr_events) {
+		vcpu_stats = realloc(vcpu_record->events,
+				     kvm->nr_events * sizeof(*vcpu_stats));
+		if (!vcpu_stats) {
+			pr_err("Not enough memory\n");
+			return false;
+		}
+
+		for (i = vcpu_record->nr_events; i < kvm->nr_events; i++) {
+			init_kvm_event_stats(&vcpu_stats[i].stats);
+			vcpu_stats[i].hist = NULL;
+		}
+
+		vcpu_record->events = vcpu_stats;
+		vcpu_record->nr_events = kvm->nr_events;
 	}
 
-	if (!kvm_event_expand(event, vcpu_id))
-		return false;
+	vcpu_stats = &vcpu_record->events[event->idx];
+	if (!vcpu_stats->hist) {
+		vcpu_stats->hist = zalloc(sizeof(*vcpu_stats->hist));
+		if (!vcpu_stats->hist) {
+			pr_err("Not enough memory\n");
+			return false;
+		}
+	}
+
+	kvm_update_event_stats(&vcpu_stats->stats, time_diff);
+	log_hist__add(vcpu_stats->hist, time_diff);
+	return true;
+}
+
+static bool merge_kvm_event(struct kvm_event *event, int vcpu_id,
+			    struct vcpu_event_stats *vcpu_stats)
+{
+	struct kvm_event_stats *kvm_stats = &event->total;
+
+	if (vcpu_id != -1) {
+		if (!kvm_event_expand(event, vcpu_id))
+			return false;
+
+		kvm_stats = &event->vcpu[vcpu_id];
+	}
+
+	if (!event->hist) {
+		event->hist = zalloc(sizeof(*event->hist));
+		if (!event->hist) {
+			pr_err("Not enough memory\n");
+			return false;
+		}
+	}
+
+	kvm_stats->time += vcpu_stats->stats.time;
+	merge_stats(&kvm_stats->stats, &vcpu_stats->stats.stats);
+	log_hist__merge(event->hist, vcpu_stats->hist);
+	return true;
+}
+
+/*
+ * Fold the per vcpu tables into the kvm_events and reset them, the cost
+ * depends on the number of vcpus and of distinct events, not on the
+ * number of samples since the last call.
+ */
+static bool merge_vcpu_records(struct perf_kvm_stat *kvm)
+{
+	struct vcpu_event_record *vcpu_record;
+	struct vcpu_event_stats *vcpu_stats;
+	int i, vcpu;
+
+	list_for_each_entry(vcpu_record, &kvm->vcpu_records, list) {
+		vcpu = kvm->trace_vcpu == -1 ? -1 : vcpu_record->vcpu_id;
+
+		for (i = 0; i < vcpu_record->nr_events; i++) {
+			vcpu_stats = &vcpu_record->events[i];
+			if (!vcpu_stats->stats.stats.n)
+				continue;
+
+			if (!merge_kvm_event(kvm->events[i], vcpu, vcpu_stats))
+				return false;
+
+			init_kvm_event_stats(&vcpu_stats->stats);
+			memset(vcpu_stats->hist, 0, sizeof(*vcpu_stats->hist));
+		}
+	}
 
-	kvm_update_event_stats(&event->vcpu[vcpu_id], time_diff);
 	return true;
 }
 
@@ -315,12 +430,6 @@ static bool handle_end_event(struct perf_kvm_stat *kvm,
 {
 	struct kvm_event *event;
 	u64 time_begin, time_diff;
-	int vcpu;
-
-	if (kvm->trace_vcpu == -1)
-		vcpu = -1;
-	else
-		vcpu = vcpu_record->vcpu_id;
 
 	event = vcpu_record->last_event;
 	time_begin = vcpu_record->start_time;
@@ -366,11 +475,12 @@ static bool handle_end_event(struct perf_kvm_stat *kvm,
 		}
 	}
 
-	return update_kvm_event(event, vcpu, time_diff);
+	return update_vcpu_event(kvm, vcpu_record, event, time_diff);
 }
 
 static
-struct vcpu_event_record *per_vcpu_record(struct thread *thread,
+struct vcpu_event_record *per_vcpu_record(struct perf_kvm_stat *kvm,
+					  struct thread *thread,
 					  struct perf_evsel *evsel,
 					  struct perf_sample *sample)
 {
@@ -386,6 +496,7 @@ struct vcpu_event_record *per_vcpu_record(struct thread *thread,
 
 		vcpu_record->vcpu_id = perf_evsel__intval(evsel, sample,
 							  vcpu_id_str);
+		list_add_tail(&vcpu_record->list, &kvm->vcpu_records);
 		thread__set_priv(thread, vcpu_record);
 	}
 
@@ -401,7 +512,7 @@ static bool handle_kvm_event(struct perf_kvm_stat *kvm,
 	struct event_key key = { .key = INVALID_KEY,
 				 .exit_reasons = kvm->exit_reasons };
 
-	vcpu_record = per_vcpu_record(thread, evsel, sample);
+	vcpu_record = per_vcpu_record(kvm, thread, evsel, sample);
 	if (!vcpu_record)
 		return true;
 
@@ -508,21 +619,24 @@ static bool event_is_valid(struct kvm_event *event, int vcpu)
 	return !!get_event_count(event, vcpu);
 }
 
-static void sort_result(struct perf_kvm_stat *kvm)
+static bool sort_result(struct perf_kvm_stat *kvm)
 {
-	unsigned int i;
-	int vcpu = kvm->trace_vcpu;
+	int i, vcpu = kvm->trace_vcpu;
 	struct kvm_event *event;
 
-	for (i = 0; i < EVENTS_CACHE_SIZE; i++) {
-		list_for_each_entry(event, &kvm->kvm_events_cache[i], hash_entry) {
-			if (event_is_valid(event, vcpu)) {
-				update_total_count(kvm, event);
-				insert_to_result(&kvm->result, event,
-						 kvm->compare, vcpu);
-			}
+	if (!merge_vcpu_records(kvm))
+		return false;
+
+	for (i = 0; i < kvm->nr_events; i++) {
+		event = kvm->events[i];
+		if (event_is_valid(event, vcpu)) {
+			update_total_count(kvm, event);
+			insert_to_result(&kvm->result, event,
+					 kvm->compare, vcpu);
 		}
 	}
+
+	return true;
 }
 
 /* returns left most element of result, and erase it */
@@ -592,16 +706,19 @@ static void print_result(struct perf_kvm_stat *kvm)
 	pr_info("%9s ", "Time%");
 	pr_info("%11s ", "Min Time");
 	pr_info("%11s ", "Max Time");
+	pr_info("%11s ", "P99 Time");
 	pr_info("%16s ", "Avg time");
 	pr_info("\n\n");
 
 	while ((event = pop_from_result(&kvm->result))) {
-		u64 ecount, etime, max, min;
+		u64 ecount, etime, max, min, p99;
 
 		ecount = get_event_count(event, vcpu);
 		etime = get_event_time(event, vcpu);
 		max = get_event_max(event, vcpu);
 		min = get_event_min(event, vcpu);
+		/* a bucket upper bound, never report more than the max */
+		p99 = min(log_hist__percentile(event->hist, 99), max);
 
 		kvm->events_ops->decode_key(kvm, &event->key, decode);
 		pr_info("%*s ", decode_str_len, decode);
@@ -610,6 +727,7 @@ static void print_result(struct perf_kvm_stat *kvm)
 		pr_info("%8.2f%% ", (double)etime / kvm->total_time * 100);
 		pr_info("%9.2fus ", (double)min / 1e3);
 		pr_info("%9.2fus ", (double)max / 1e3);
+		pr_info("%9.2fus ", (double)p99 / 1e3);
 		pr_info("%9.2fus ( +-%7.2f%% )", (double)etime / ecount/1e3,
 			kvm_event_rel_stddev(vcpu, event));
 		pr_info("\n");
@@ -857,11 +975,12 @@ static int perf_kvm__handle_timerfd(struct perf_kvm_stat *kvm)
 		pr_debug("Missed timer beats: %" PRIu64 "\n", c-1);
 
 	/* update display */
-	sort_result(kvm);
+	if (!sort_result(kvm))
+		return -1;
 	print_result(kvm);
 
 	/* reset counts */
-	clear_events_cache_stats(kvm->kvm_events_cache);
+	clear_events_cache_stats(kvm);
 	kvm->total_count = 0;
 	kvm->total_time = 0;
 	kvm->lost_events = 0;
@@ -963,8 +1082,10 @@ static int kvm_events_live_report(struct perf_kvm_stat *kvm)
 	perf_evlist__disable(kvm->evlist);
 
 	if (err == 0) {
-		sort_result(kvm);
-		print_result(kvm);
+		if (!sort_result(kvm))
+			err = -1;
+		else
+			print_result(kvm);
 	}
 
 out:
@@ -1117,7 +1238,10 @@ static int kvm_events_report_vcpu(struct perf_kvm_stat *kvm)
 	if (ret)
 		goto exit;
 
-	sort_result(kvm);
+	if (!sort_result(kvm)) {
+		ret = -ENOMEM;
+		goto exit;
+	}
 	print_result(kvm);
 
 exit:
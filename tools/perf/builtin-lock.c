@@ -8,6 +8,8 @@
 #include "util/symbol.h"
 #include "util/thread.h"
 #include "util/header.h"
+#include "util/callchain.h"
+#include "util/log-hist.h"
 
 #include <subcmd/parse-options.h>
 #include "util/trace-event.h"
@@ -29,17 +31,94 @@
 
 static struct perf_session *session;
 
-/* based on kernel/lockdep.c */
+/*
+ * Open addressing hash tables with linear probing, for the lock instances
+ * and for the locks held by each thread.  How many there are is only
+ * known from the trace, so they start at 2^LOCKHASH_BITS slots and double
+ * when half full.
+ */
 #define LOCKHASH_BITS		12
-#define LOCKHASH_SIZE		(1UL << LOCKHASH_BITS)
 
-static struct list_head lockhash_table[LOCKHASH_SIZE];
+struct lock_hash {
+	void			**slots;
+	unsigned int		bits;
+	unsigned long		nr;
+	u32			(*hash)(void *entry, unsigned int bits);
+};
+
+#define lock_hash__mask(lh)	((1UL << (lh)->bits) - 1)
+
+#define lock_hash__for_each_entry(lh, entry, i)				\
+	for (i = 0; i <= lock_hash__mask(lh); i++)			\
+		if (((entry) = (lh)->slots[i]) != NULL)
+
+static int lock_hash__init(struct lock_hash *lh,
+			   u32 (*hash)(void *entry, unsigned int bits))
+{
+	lh->bits  = LOCKHASH_BITS;
+	lh->nr    = 0;
+	lh->hash  = hash;
+	lh->slots = calloc(1UL << lh->bits, sizeof(*lh->slots));
+	return lh->slots ? 0 : -ENOMEM;
+}
+
+static void lock_hash__add_slot(void **slots, unsigned long mask,
+				unsigned long slot, void *entry)
+{
+	while (slots[slot])
+		slot = (slot + 1) & mask;
+	slots[slot] = entry;
+}
+
+static int lock_hash__insert(struct lock_hash *lh, void *entry)
+{
+	if (lh->nr + 1 > (1UL << lh->bits) / 2) {
+		unsigned int bits = lh->bits + 1;
+		void **slots = calloc(1UL << bits, sizeof(*slots)), *old;
+		unsigned long i;
+
+		if (!slots)
+			return -ENOMEM;
 
-#define __lockhashfn(key)	hash_long((unsigned long)key, LOCKHASH_BITS)
-#define lockhashentry(key)	(lockhash_table + __lockhashfn((key)))
+		lock_hash__for_each_entry(lh, old, i)
+			lock_hash__add_slot(slots, (1UL << bits) - 1,
+					    lh->hash(old, bits), old);
+
+		free(lh->slots);
+		lh->slots = slots;
+		lh->bits  = bits;
+	}
+
+	lock_hash__add_slot(lh->slots, lock_hash__mask(lh),
+			    lh->hash(entry, lh->bits), entry);
+	lh->nr++;
+	return 0;
+}
+
+/* Backward shift deletion, so that lookups need no tombstones */
+static void lock_hash__remove(struct lock_hash *lh, void *entry)
+{
+	unsigned long mask = lock_hash__mask(lh), i, j, k;
+
+	for (i = lh->hash(entry, lh->bits); lh->slots[i] != entry; i = (i + 1) & mask)
+		BUG_ON(!lh->slots[i]);
+
+	lh->slots[i] = NULL;
+	for (j = (i + 1) & mask; lh->slots[j]; j = (j + 1) & mask) {
+		k = lh->hash(lh->slots[j], lh->bits);
+
+		/* leave it if its home slot is cyclically in (i, j] */
+		if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+
+		lh->slots[i] = lh->slots[j];
+		lh->slots[j] = NULL;
+		i = j;
+	}
+	lh->nr--;
+}
 
 struct lock_stat {
-	struct list_head	hash_entry;
 	struct rb_node		rb;		/* used for sorting */
 
 	/*
@@ -63,10 +142,22 @@ struct lock_stat {
 	u64			wait_time_total;
 	u64			wait_time_min;
 	u64			wait_time_max;
+	u64			wait_time_p50;
+	u64			wait_time_p99;
+	struct log_hist		*wait_hist;	/* allocated when contended */
 
 	int			discard; /* flag of blacklist */
 };
 
+static struct lock_hash		lock_stats;
+
+static u32 lock_stat__hash(void *entry, unsigned int bits)
+{
+	struct lock_stat *ls = entry;
+
+	return hash_ptr(ls->addr, bits);
+}
+
 /*
  * States of lock_seq_stat
  *
@@ -98,7 +189,7 @@ struct lock_stat {
  * 4) Are there other patterns?
  */
 struct lock_seq_stat {
-	struct list_head        list;
+	u32			tid;
 	int			state;
 	u64			prev_event_time;
 	void                    *addr;
@@ -106,11 +197,25 @@ struct lock_seq_stat {
 	int                     read_count;
 };
 
+/* the lock_seq_stats in progress, by tid and lock address */
+static struct lock_hash		lock_seqs;
+
+static u32 __lock_seq__hash(u32 tid, void *addr, unsigned int bits)
+{
+	return hash_64((unsigned long)addr ^ ((u64)tid << 32), bits);
+}
+
+static u32 lock_seq__hash(void *entry, unsigned int bits)
+{
+	struct lock_seq_stat *seq = entry;
+
+	return __lock_seq__hash(seq->tid, seq->addr, bits);
+}
+
 struct thread_stat {
 	struct rb_node		rb;
 
 	u32                     tid;
-	struct list_head        seq_list;
 };
 
 static struct rb_root		thread_stats;
@@ -171,7 +276,6 @@ static struct thread_stat *thread_stat_findnew_after_first(u32 tid)
 	}
 
 	st->tid = tid;
-	INIT_LIST_HEAD(&st->seq_list);
 
 	thread_stat_insert(st);
 
@@ -192,7 +296,6 @@ static struct thread_stat *thread_stat_findnew_first(u32 tid)
 		return NULL;
 	}
 	st->tid = tid;
-	INIT_LIST_HEAD(&st->seq_list);
 
 	rb_link_node(&st->rb, NULL, &thread_stats.rb_node);
 	rb_insert_color(&st->rb, &thread_stats);
@@ -214,6 +317,8 @@ SINGLE_KEY(nr_contended)
 SINGLE_KEY(avg_wait_time)
 SINGLE_KEY(wait_time_total)
 SINGLE_KEY(wait_time_max)
+SINGLE_KEY(wait_time_p50)
+SINGLE_KEY(wait_time_p99)
 
 static int lock_stat_key_wait_time_min(struct lock_stat *one,
 					struct lock_stat *two)
@@ -252,6 +357,8 @@ struct lock_key keys[] = {
 	DEF_KEY_LOCK(wait_total, wait_time_total),
 	DEF_KEY_LOCK(wait_min, wait_time_min),
 	DEF_KEY_LOCK(wait_max, wait_time_max),
+	DEF_KEY_LOCK(wait_p50, wait_time_p50),
+	DEF_KEY_LOCK(wait_p99, wait_time_p99),
 
 	/* extra comparisons much complicated should be here */
 
@@ -312,10 +419,10 @@ static struct lock_stat *pop_from_result(void)
 
 static struct lock_stat *lock_stat_findnew(void *addr, const char *name)
 {
-	struct list_head *entry = lockhashentry(addr);
+	unsigned long i = hash_ptr(addr, lock_stats.bits);
 	struct lock_stat *ret, *new;
 
-	list_for_each_entry(ret, entry, hash_entry) {
+	for (; (ret = lock_stats.slots[i]); i = (i + 1) & lock_hash__mask(&lock_stats)) {
 		if (ret->addr == addr)
 			return ret;
 	}
@@ -334,7 +441,11 @@ static struct lock_stat *lock_stat_findnew(void *addr, const char *name)
 	strcpy(new->name, name);
 	new->wait_time_min = ULLONG_MAX;
 
-	list_add(&new->hash_entry, entry);
+	if (lock_hash__insert(&lock_stats, new)) {
+		free(new->name);
+		free(new);
+		goto alloc_failed;
+	}
 	return new;
 
 alloc_failed:
@@ -342,6 +453,77 @@ alloc_failed:
 	return NULL;
 }
 
+static bool lock_callsites;
+
+/*
+ * With --callsite, the lock events are attributed to the first caller in
+ * their callchain that is not part of the locking code, known by the name
+ * prefixes below.
+ */
+static const char * const lock_function_prefixes[] = {
+	"lock_", "__lock", "_raw_", "__raw_", "do_raw_", "queued_",
+	"native_queued_", "mutex_", "__mutex_", "down_", "__down",
+	"up_", "__up", "rwsem_", "__rwsem_", "ww_mutex_",
+};
+
+static bool is_lock_function(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(lock_function_prefixes); i++) {
+		if (!strncmp(name, lock_function_prefixes[i],
+			     strlen(lock_function_prefixes[i])))
+			return true;
+	}
+	return false;
+}
+
+static struct symbol *lock_callsite(struct perf_evsel *evsel,
+				    struct perf_sample *sample)
+{
+	struct callchain_cursor_node *node;
+	struct symbol *sym = NULL;
+	struct thread *thread;
+
+	thread = machine__findnew_thread(&session->machines.host,
+					 sample->pid, sample->tid);
+	if (!thread)
+		return NULL;
+
+	if (!thread__resolve_callchain(thread, &callchain_cursor, evsel, sample,
+				       NULL, NULL, PERF_MAX_STACK_DEPTH)) {
+		callchain_cursor_commit(&callchain_cursor);
+
+		while ((node = callchain_cursor_current(&callchain_cursor))) {
+			if (node->sym && !is_lock_function(node->sym->name)) {
+				sym = node->sym;
+				break;
+			}
+			callchain_cursor_advance(&callchain_cursor);
+		}
+	}
+
+	thread__put(thread);
+	return sym;
+}
+
+/* The lock_stat of the lock instance, or of the callsite with --callsite */
+static struct lock_stat *lock_stat_findnew_event(void *addr, const char *name,
+						 struct perf_evsel *evsel,
+						 struct perf_sample *sample)
+{
+	struct symbol *sym;
+
+	if (!lock_callsites)
+		return lock_stat_findnew(addr, name);
+
+	sym = lock_callsite(evsel, sample);
+	if (!sym)
+		return lock_stat_findnew(NULL, "[unknown]");
+
+	return lock_stat_findnew(sym, sym->name);
+}
+
 struct trace_lock_handler {
 	int (*acquire_event)(struct perf_evsel *evsel,
 			     struct perf_sample *sample);
@@ -356,27 +538,43 @@ struct trace_lock_handler {
 			     struct perf_sample *sample);
 };
 
-static struct lock_seq_stat *get_seq(struct thread_stat *ts, void *addr)
+static struct lock_seq_stat *get_seq(u32 tid, void *addr)
 {
+	unsigned long i = __lock_seq__hash(tid, addr, lock_seqs.bits);
 	struct lock_seq_stat *seq;
 
-	list_for_each_entry(seq, &ts->seq_list, list) {
-		if (seq->addr == addr)
+	for (; (seq = lock_seqs.slots[i]); i = (i + 1) & lock_hash__mask(&lock_seqs)) {
+		if (seq->tid == tid && seq->addr == addr)
 			return seq;
 	}
 
+	/* for 'perf lock info -t' */
+	if (!thread_stat_findnew(tid))
+		return NULL;
+
 	seq = zalloc(sizeof(struct lock_seq_stat));
 	if (!seq) {
 		pr_err("memory allocation failed\n");
 		return NULL;
 	}
 	seq->state = SEQ_STATE_UNINITIALIZED;
+	seq->tid = tid;
 	seq->addr = addr;
 
-	list_add(&seq->list, &ts->seq_list);
+	if (lock_hash__insert(&lock_seqs, seq)) {
+		pr_err("memory allocation failed\n");
+		free(seq);
+		return NULL;
+	}
 	return seq;
 }
 
+static void put_seq(struct lock_seq_stat *seq)
+{
+	lock_hash__remove(&lock_seqs, seq);
+	free(seq);
+}
+
 enum broken_state {
 	BROKEN_ACQUIRE,
 	BROKEN_ACQUIRED,
@@ -397,25 +595,20 @@ static int report_lock_acquire_event(struct perf_evsel *evsel,
 {
 	void *addr;
 	struct lock_stat *ls;
-	struct thread_stat *ts;
 	struct lock_seq_stat *seq;
-	const char *name = perf_evsel__strval(evsel, sample, "name");
-	u64 tmp = perf_evsel__intval(evsel, sample, "lockdep_addr");
-	int flag = perf_evsel__intval(evsel, sample, "flag");
+	const char *name = perf_evsel__tp_strval(evsel, sample, "name");
+	u64 tmp = perf_evsel__tp_intval(evsel, sample, "lockdep_addr");
+	int flag = perf_evsel__tp_intval(evsel, sample, "flag");
 
 	memcpy(&addr, &tmp, sizeof(void *));
 
-	ls = lock_stat_findnew(addr, name);
+	ls = lock_stat_findnew_event(addr, name, evsel, sample);
 	if (!ls)
 		return -ENOMEM;
 	if (ls->discard)
 		return 0;
 
-	ts = thread_stat_findnew(sample->tid);
-	if (!ts)
-		return -ENOMEM;
-
-	seq = get_seq(ts, addr);
+	seq = get_seq(sample->tid, addr);
 	if (!seq)
 		return -ENOMEM;
 
@@ -448,10 +641,9 @@ static int report_lock_acquire_event(struct perf_evsel *evsel,
 	case SEQ_STATE_CONTENDED:
 broken:
 		/* broken lock sequence, discard it */
-		ls->discard = 1;
+		ls->discard = !lock_callsites;
 		bad_hist[BROKEN_ACQUIRE]++;
-		list_del(&seq->list);
-		free(seq);
+		put_seq(seq);
 		goto end;
 	default:
 		BUG_ON("Unknown state of lock sequence found!\n");
@@ -469,25 +661,20 @@ static int report_lock_acquired_event(struct perf_evsel *evsel,
 {
 	void *addr;
 	struct lock_stat *ls;
-	struct thread_stat *ts;
 	struct lock_seq_stat *seq;
 	u64 contended_term;
-	const char *name = perf_evsel__strval(evsel, sample, "name");
-	u64 tmp = perf_evsel__intval(evsel, sample, "lockdep_addr");
+	const char *name = perf_evsel__tp_strval(evsel, sample, "name");
+	u64 tmp = perf_evsel__tp_intval(evsel, sample, "lockdep_addr");
 
 	memcpy(&addr, &tmp, sizeof(void *));
 
-	ls = lock_stat_findnew(addr, name);
+	ls = lock_stat_findnew_event(addr, name, evsel, sample);
 	if (!ls)
 		return -ENOMEM;
 	if (ls->discard)
 		return 0;
 
-	ts = thread_stat_findnew(sample->tid);
-	if (!ts)
-		return -ENOMEM;
-
-	seq = get_seq(ts, addr);
+	seq = get_seq(sample->tid, addr);
 	if (!seq)
 		return -ENOMEM;
 
@@ -504,15 +691,21 @@ static int report_lock_acquired_event(struct perf_evsel *evsel,
 			ls->wait_time_min = contended_term;
 		if (ls->wait_time_max < contended_term)
 			ls->wait_time_max = contended_term;
+
+		if (!ls->wait_hist) {
+			ls->wait_hist = zalloc(sizeof(*ls->wait_hist));
+			if (!ls->wait_hist)
+				return -ENOMEM;
+		}
+		log_hist__add(ls->wait_hist, contended_term);
 		break;
 	case SEQ_STATE_RELEASED:
 	case SEQ_STATE_ACQUIRED:
 	case SEQ_STATE_READ_ACQUIRED:
 		/* broken lock sequence, discard it */
-		ls->discard = 1;
+		ls->discard = !lock_callsites;
 		bad_hist[BROKEN_ACQUIRED]++;
-		list_del(&seq->list);
-		free(seq);
+		put_seq(seq);
 		goto end;
 	default:
 		BUG_ON("Unknown state of lock sequence found!\n");
@@ -532,24 +725,19 @@ static int report_lock_contended_event(struct perf_evsel *evsel,
 {
 	void *addr;
 	struct lock_stat *ls;
-	struct thread_stat *ts;
 	struct lock_seq_stat *seq;
-	const char *name = perf_evsel__strval(evsel, sample, "name");
-	u64 tmp = perf_evsel__intval(evsel, sample, "lockdep_addr");
+	const char *name = perf_evsel__tp_strval(evsel, sample, "name");
+	u64 tmp = perf_evsel__tp_intval(evsel, sample, "lockdep_addr");
 
 	memcpy(&addr, &tmp, sizeof(void *));
 
-	ls = lock_stat_findnew(addr, name);
+	ls = lock_stat_findnew_event(addr, name, evsel, sample);
 	if (!ls)
 		return -ENOMEM;
 	if (ls->discard)
 		return 0;
 
-	ts = thread_stat_findnew(sample->tid);
-	if (!ts)
-		return -ENOMEM;
-
-	seq = get_seq(ts, addr);
+	seq = get_seq(sample->tid, addr);
 	if (!seq)
 		return -ENOMEM;
 
@@ -564,10 +752,9 @@ static int report_lock_contended_event(struct perf_evsel *evsel,
 	case SEQ_STATE_READ_ACQUIRED:
 	case SEQ_STATE_CONTENDED:
 		/* broken lock sequence, discard it */
-		ls->discard = 1;
+		ls->discard = !lock_callsites;
 		bad_hist[BROKEN_CONTENDED]++;
-		list_del(&seq->list);
-		free(seq);
+		put_seq(seq);
 		goto end;
 	default:
 		BUG_ON("Unknown state of lock sequence found!\n");
@@ -587,24 +774,19 @@ static int report_lock_release_event(struct perf_evsel *evsel,
 {
 	void *addr;
 	struct lock_stat *ls;
-	struct thread_stat *ts;
 	struct lock_seq_stat *seq;
-	const char *name = perf_evsel__strval(evsel, sample, "name");
-	u64 tmp = perf_evsel__intval(evsel, sample, "lockdep_addr");
+	const char *name = perf_evsel__tp_strval(evsel, sample, "name");
+	u64 tmp = perf_evsel__tp_intval(evsel, sample, "lockdep_addr");
 
 	memcpy(&addr, &tmp, sizeof(void *));
 
-	ls = lock_stat_findnew(addr, name);
+	ls = lock_stat_findnew_event(addr, name, evsel, sample);
 	if (!ls)
 		return -ENOMEM;
 	if (ls->discard)
 		return 0;
 
-	ts = thread_stat_findnew(sample->tid);
-	if (!ts)
-		return -ENOMEM;
-
-	seq = get_seq(ts, addr);
+	seq = get_seq(sample->tid, addr);
 	if (!seq)
 		return -ENOMEM;
 
@@ -625,7 +807,7 @@ static int report_lock_release_event(struct perf_evsel *evsel,
 	case SEQ_STATE_CONTENDED:
 	case SEQ_STATE_RELEASED:
 		/* broken lock sequence, discard it */
-		ls->discard = 1;
+		ls->discard = !lock_callsites;
 		bad_hist[BROKEN_RELEASE]++;
 		goto free_seq;
 	default:
@@ -635,8 +817,7 @@ static int report_lock_release_event(struct perf_evsel *evsel,
 
 	ls->nr_release++;
 free_seq:
-	list_del(&seq->list);
-	free(seq);
+	put_seq(seq);
 end:
 	return 0;
 }
@@ -714,6 +895,8 @@ static void print_result(void)
 	pr_info("%15s ", "total wait (ns)");
 	pr_info("%15s ", "max wait (ns)");
 	pr_info("%15s ", "min wait (ns)");
+	pr_info("%15s ", "p50 wait (ns)");
+	pr_info("%15s ", "p99 wait (ns)");
 
 	pr_info("\n\n");
 
@@ -747,6 +930,8 @@ static void print_result(void)
 		pr_info("%15" PRIu64 " ", st->wait_time_max);
 		pr_info("%15" PRIu64 " ", st->wait_time_min == ULLONG_MAX ?
 		       0 : st->wait_time_min);
+		pr_info("%15" PRIu64 " ", st->wait_time_p50);
+		pr_info("%15" PRIu64 " ", st->wait_time_p99);
 		pr_info("\n");
 	}
 
@@ -775,15 +960,12 @@ static void dump_threads(void)
 
 static void dump_map(void)
 {
-	unsigned int i;
+	unsigned long i;
 	struct lock_stat *st;
 
 	pr_info("Address of instance: name of class\n");
-	for (i = 0; i < LOCKHASH_SIZE; i++) {
-		list_for_each_entry(st, &lockhash_table[i], hash_entry) {
-			pr_info(" %p: %s\n", st->addr, st->name);
-		}
-	}
+	lock_hash__for_each_entry(&lock_stats, st, i)
+		pr_info(" %p: %s\n", st->addr, st->name);
 }
 
 static int dump_info(void)
@@ -833,13 +1015,18 @@ static int process_sample_event(struct perf_tool *tool __maybe_unused,
 
 static void sort_result(void)
 {
-	unsigned int i;
+	unsigned long i;
 	struct lock_stat *st;
 
-	for (i = 0; i < LOCKHASH_SIZE; i++) {
-		list_for_each_entry(st, &lockhash_table[i], hash_entry) {
-			insert_to_result(st, compare);
+	lock_hash__for_each_entry(&lock_stats, st, i) {
+		/* percentiles are bucket upper bounds, never more than the max */
+		if (st->wait_hist) {
+			st->wait_time_p50 = min(log_hist__percentile(st->wait_hist, 50),
+						st->wait_time_max);
+			st->wait_time_p99 = min(log_hist__percentile(st->wait_hist, 99),
+						st->wait_time_max);
 		}
+		insert_to_result(st, compare);
 	}
 }
 
@@ -885,6 +1072,12 @@ static int __cmd_report(bool display_info)
 	if (select_key())
 		goto out_delete;
 
+	if (lock_callsites &&
+	    !(perf_evlist__combined_sample_type(session->evlist) & PERF_SAMPLE_CALLCHAIN)) {
+		pr_err("--callsite needs callchains, use 'perf lock record -g'\n");
+		goto out_delete;
+	}
+
 	err = perf_session__process_events(session);
 	if (err)
 		goto out_delete;
@@ -963,7 +1156,9 @@ int cmd_lock(int argc, const char **argv, const char *prefix __maybe_unused)
 	};
 	const struct option report_options[] = {
 	OPT_STRING('k', "key", &sort_key, "acquired",
-		    "key for sorting (acquired / contended / avg_wait / wait_total / wait_max / wait_min)"),
+		    "key for sorting (acquired / contended / avg_wait / wait_total / wait_max / wait_min / wait_p50 / wait_p99)"),
+	OPT_BOOLEAN('c', "callsite", &lock_callsites,
+		    "aggregate by callsite instead of lock instance"),
 	OPT_BOOLEAN('f', "force", &force, "don't complain, do it"),
 	/* TODO: type */
 	OPT_END()
@@ -982,11 +1177,11 @@ int cmd_lock(int argc, const char **argv, const char *prefix __maybe_unused)
 		"perf lock report [<options>]",
 		NULL
 	};
-	unsigned int i;
 	int rc = 0;
 
-	for (i = 0; i < LOCKHASH_SIZE; i++)
-		INIT_LIST_HEAD(lockhash_table + i);
+	if (lock_hash__init(&lock_stats, lock_stat__hash) ||
+	    lock_hash__init(&lock_seqs, lock_seq__hash))
+		return -ENOMEM;
 
 	argc = parse_options_subcommand(argc, argv, lock_options, lock_subcommands,
 					lock_usage, PARSE_OPT_STOP_AT_NON_OPTION);
@@ -8,6 +8,12 @@
 #include "util/data.h"
 #include "util/mem-events.h"
 #include "util/debug.h"
+#include "util/symbol.h"
+#include "util/sort.h"
+#include "util/intlist.h"
+#include "util/evlist.h"
+#include "util/mem-cachelines.h"
+#include <linux/bitmap.h>
 
 #define MEM_OPERATION_LOAD	0x1
 #define MEM_OPERATION_STORE	0x2
@@ -21,8 +27,16 @@ struct perf_mem {
 	int			operation;
 	const char		*cpu_list;
 	DECLARE_BITMAP(cpu_bitmap, MAX_NR_CPUS);
+
+	/* --cacheline */
+	bool			cacheline;
+	unsigned int		nr_lines;
+	struct mem_cachelines	lines;
+	struct c2c_stats	stats;
 };
 
+#define MEM_CACHELINE_NR_LINES	10
+
 static int parse_record_events(const struct option *opt,
 			       const char *str, int unset __maybe_unused)
 {
@@ -185,12 +199,73 @@ out_put:
 	return 0;
 }
 
+static int process_cacheline_sample(struct perf_mem *mem,
+				    struct perf_sample *sample,
+				    struct machine *machine)
+{
+	struct mem_info mi = {
+		.daddr.addr	= sample->addr,
+		.data_src.val	= sample->data_src,
+	};
+	struct c2c_stats stats = { .nr_entries = 0, };
+	struct mem_cacheline *cl;
+	struct mem_cl_entry *entry;
+	struct addr_location al;
+	int ret = 0;
+
+	if (mem->cpu_list && !test_bit(sample->cpu, mem->cpu_bitmap))
+		return 0;
+
+	if (machine__resolve(machine, &al, sample) < 0) {
+		pr_err("problem processing sample, skipping it.\n");
+		return -1;
+	}
+
+	if (al.filtered || (mem->hide_unresolved && al.sym == NULL))
+		goto out_put;
+
+	/* no data address or not a load or a store */
+	if (c2c_decode_stats(&stats, &mi)) {
+		c2c_add_stats(&mem->stats, &stats);
+		goto out_put;
+	}
+
+	ret = -ENOMEM;
+	cl = mem_cachelines__findnew(&mem->lines, sample->addr);
+	if (!cl)
+		goto out_put;
+
+	entry = mem_cacheline__findnew_entry(cl, &mem->lines, sample->addr,
+					     &al);
+	if (!entry)
+		goto out_put;
+
+	if (mem_cl_users__add(&cl->users, &mem->lines, sample->cpu,
+			      sample->tid) ||
+	    mem_cl_users__add(&entry->users, &mem->lines, sample->cpu,
+			      sample->tid))
+		goto out_put;
+
+	c2c_add_stats(&mem->stats, &stats);
+	c2c_add_stats(&cl->stats, &stats);
+	c2c_add_stats(&entry->stats, &stats);
+	ret = 0;
+out_put:
+	addr_location__put(&al);
+	return ret;
+}
+
 static int process_sample_event(struct perf_tool *tool,
 				union perf_event *event,
 				struct perf_sample *sample,
 				struct perf_evsel *evsel __maybe_unused,
 				struct machine *machine)
 {
+	struct perf_mem *mem = container_of(tool, struct perf_mem, tool);
+
+	if (mem->cacheline)
+		return process_cacheline_sample(mem, sample, machine);
+
 	return dump_raw_samples(tool, event, sample, machine);
 }
 
@@ -228,6 +303,200 @@ out_delete:
 	return ret;
 }
 
+static int mem_cachelines__setup(struct perf_mem *mem, struct perf_env *env)
+{
+	struct mem_cachelines *cls = &mem->lines;
+	int node, i, ret;
+
+	ret = mem_cachelines__init(cls, cacheline_size,
+				   env->nr_cpus_avail ?: MAX_NR_CPUS,
+				   env->nr_numa_nodes ?: 1);
+	if (ret < 0)
+		return ret;
+
+	for (node = 0; node < env->nr_numa_nodes; node++) {
+		struct cpu_map *map = env->numa_nodes[node].map;
+
+		for (i = 0; map && i < map->nr; i++) {
+			if (map->map[i] >= 0 && map->map[i] < cls->nr_cpus)
+				cls->cpu2node[map->map[i]] = node;
+		}
+	}
+
+	return 0;
+}
+
+/* HITMs first: loads that found the line modified in another cache */
+static int mem_cacheline__cmp(const void *a, const void *b)
+{
+	const struct mem_cacheline *l = *(const struct mem_cacheline **)a;
+	const struct mem_cacheline *r = *(const struct mem_cacheline **)b;
+
+	if (l->stats.tot_hitm != r->stats.tot_hitm)
+		return l->stats.tot_hitm > r->stats.tot_hitm ? -1 : 1;
+	if (l->stats.store != r->stats.store)
+		return l->stats.store > r->stats.store ? -1 : 1;
+	if (l->stats.nr_entries != r->stats.nr_entries)
+		return l->stats.nr_entries > r->stats.nr_entries ? -1 : 1;
+	return 0;
+}
+
+static int mem_cl_entry__cmp(const void *a, const void *b)
+{
+	const struct mem_cl_entry *l = *(const struct mem_cl_entry **)a;
+	const struct mem_cl_entry *r = *(const struct mem_cl_entry **)b;
+
+	if (l->offset != r->offset)
+		return l->offset < r->offset ? -1 : 1;
+	if (l->stats.tot_hitm != r->stats.tot_hitm)
+		return l->stats.tot_hitm > r->stats.tot_hitm ? -1 : 1;
+	if (l->stats.nr_entries != r->stats.nr_entries)
+		return l->stats.nr_entries > r->stats.nr_entries ? -1 : 1;
+	return 0;
+}
+
+static void mem_cl_print_stats(struct c2c_stats *stats,
+			       struct mem_cl_users *users, struct perf_mem *mem)
+{
+	printf("%8u %8u %8u %8u %8u %8u %6u %5d %5d %7u",
+	       stats->nr_entries, stats->tot_hitm, stats->lcl_hitm,
+	       stats->rmt_hitm, stats->load, stats->store, stats->locks,
+	       bitmap_weight(users->cpus, mem->lines.nr_cpus),
+	       bitmap_weight(users->nodes, mem->lines.nr_nodes),
+	       intlist__nr_entries(users->tids));
+}
+
+static int mem_cacheline__print(struct mem_cacheline *cl, unsigned int idx,
+				struct perf_mem *mem)
+{
+	struct mem_cl_entry **entries, *entry;
+	unsigned int i = 0;
+
+	entries = calloc(cl->nr_entries, sizeof(*entries));
+	if (!entries)
+		return -ENOMEM;
+
+	for (entry = cl->entries; entry; entry = entry->next)
+		entries[i++] = entry;
+	qsort(entries, cl->nr_entries, sizeof(*entries), mem_cl_entry__cmp);
+
+	printf("%6u  %#18" PRIx64 " ", idx, cl->addr);
+	mem_cl_print_stats(&cl->stats, &cl->users, mem);
+	printf("\n");
+
+	for (i = 0; i < cl->nr_entries; i++) {
+		entry = entries[i];
+
+		printf("        %#6x  %#10" PRIx64 " ", entry->offset, entry->ip);
+		mem_cl_print_stats(&entry->stats, &entry->users, mem);
+		printf("  %s  %s\n",
+		       entry->sym ? entry->sym->name : "[unknown]",
+		       entry->map ? entry->map->dso->short_name : "[unknown]");
+	}
+	printf("\n");
+
+	free(entries);
+	return 0;
+}
+
+static int mem_cachelines__print(struct perf_mem *mem)
+{
+	struct mem_cacheline **lines, *cl;
+	unsigned int i, nr = 0;
+	int ret = 0;
+
+	printf("# Total records       : %u\n", mem->stats.nr_entries);
+	printf("# Loads / Stores      : %u / %u\n",
+	       mem->stats.load, mem->stats.store);
+	printf("# Local / Remote HITM : %u / %u\n",
+	       mem->stats.lcl_hitm, mem->stats.rmt_hitm);
+	printf("# Locked accesses     : %u\n", mem->stats.locks);
+	printf("# No address / parse  : %u / %u\n",
+	       mem->stats.ld_noadrs + mem->stats.st_noadrs,
+	       mem->stats.noparse);
+	printf("# Cachelines          : %u (%u bytes)\n",
+	       mem->lines.nr, mem->lines.size);
+	printf("#\n");
+	printf("# %6s  %18s %8s %8s %8s %8s %8s %8s %6s %5s %5s %7s\n",
+	       "Index", "Cacheline", "Records", "Tot Hitm", "Lcl Hitm",
+	       "Rmt Hitm", "Loads", "Stores", "Locks", "Cpus", "Nodes",
+	       "Threads");
+	printf("# %6s  %6s  %10s\n", "", "Offset", "Code addr");
+	printf("#\n");
+
+	if (!mem->lines.nr)
+		return 0;
+
+	lines = calloc(mem->lines.nr, sizeof(*lines));
+	if (!lines)
+		return -ENOMEM;
+
+	for (i = 0; i < (1U << mem->lines.bits); i++) {
+		hlist_for_each_entry(cl, &mem->lines.lines[i], node)
+			lines[nr++] = cl;
+	}
+
+	qsort(lines, nr, sizeof(*lines), mem_cacheline__cmp);
+
+	for (i = 0; i < nr && i < mem->nr_lines && !ret; i++)
+		ret = mem_cacheline__print(lines[i], i, mem);
+
+	free(lines);
+	return ret;
+}
+
+static int report_cacheline_events(struct perf_mem *mem)
+{
+	struct perf_data_file file = {
+		.path = input_name,
+		.mode = PERF_DATA_MODE_READ,
+		.force = mem->force,
+	};
+	u64 sample_type;
+	int ret;
+	struct perf_session *session = perf_session__new(&file, false,
+							 &mem->tool);
+
+	if (session == NULL)
+		return -1;
+
+	ret = -EINVAL;
+	sample_type = perf_evlist__combined_sample_type(session->evlist);
+	if (!(sample_type & PERF_SAMPLE_ADDR) ||
+	    !(sample_type & PERF_SAMPLE_DATA_SRC)) {
+		pr_err("The cacheline analysis needs the data address and source of the samples,\n"
+		       "please use 'perf mem record'.\n");
+		goto out_delete;
+	}
+
+	if (mem->cpu_list) {
+		ret = perf_session__cpu_bitmap(session, mem->cpu_list,
+					       mem->cpu_bitmap);
+		if (ret < 0)
+			goto out_delete;
+	}
+
+	ret = mem_cachelines__setup(mem, &session->header.env);
+	if (ret < 0)
+		goto out_delete;
+
+	ret = symbol__init(&session->header.env);
+	if (ret < 0)
+		goto out_delete;
+
+	ret = perf_session__process_events(session);
+	if (ret < 0)
+		goto out_delete;
+
+	setup_pager();
+	ret = mem_cachelines__print(mem);
+
+out_delete:
+	mem_cachelines__exit(&mem->lines);
+	perf_session__delete(session);
+	return ret;
+}
+
 static int report_events(int argc, const char **argv, struct perf_mem *mem)
 {
 	const char **rep_argv;
@@ -236,6 +505,9 @@ static int report_events(int argc, const char **argv, struct perf_mem *mem)
 	if (mem->dump_raw)
 		return report_raw_events(mem);
 
+	if (mem->cacheline)
+		return report_cacheline_events(mem);
+
 	rep_argc = argc + 3;
 	rep_argv = calloc(rep_argc + 1, sizeof(char *));
 	if (!rep_argv)
@@ -349,6 +621,7 @@ int cmd_mem(int argc, const char **argv, const char *prefix __maybe_unused)
 		 * default to both load an store sampling
 		 */
 		.operation		 = MEM_OPERATION_LOAD | MEM_OPERATION_STORE,
+		.nr_lines		 = MEM_CACHELINE_NR_LINES,
 	};
 	const struct option mem_options[] = {
 	OPT_CALLBACK('t', "type", &mem.operation,
@@ -367,6 +640,10 @@ int cmd_mem(int argc, const char **argv, const char *prefix __maybe_unused)
 		   "separator for columns, no spaces will be added"
 		   " between columns '.' is reserved."),
 	OPT_BOOLEAN('f', "force", &mem.force, "don't complain, do it"),
+	OPT_BOOLEAN(0, "cacheline", &mem.cacheline,
+		    "report the cachelines with the most contention (HITM)"),
+	OPT_UINTEGER(0, "lines", &mem.nr_lines,
+		     "number of cachelines to report, default 10"),
 	OPT_END()
 	};
 	const char *const mem_subcommands[] = { "record", "report", NULL };
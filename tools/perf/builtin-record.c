@@ -35,15 +35,34 @@
 #include "util/parse-regs-options.h"
 #include "util/llvm-utils.h"
 #include "util/bpf-loader.h"
+#include "util/bpf-record-stacks.h"
 #include "util/trigger.h"
 #include "asm/bug.h"
 
 #include <unistd.h>
 #include <sched.h>
+#include <dirent.h>
+#include <libgen.h>
+#include <pthread.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <asm/bug.h>
 
 
+struct switch_output {
+	bool		 enabled;
+	unsigned long	 size;
+	unsigned long	 time;
+};
+
+/* A sample whose DSO gets marked hit once the round after it is drained */
+struct buildid_hit {
+	u64	ip;
+	pid_t	pid;
+	pid_t	tid;
+	u8	cpumode;
+};
+
 struct record {
 	struct perf_tool	tool;
 	struct record_opts	opts;
@@ -60,10 +79,32 @@ struct record {
 	bool			no_buildid_cache_set;
 	bool			buildid_all;
 	bool			timestamp_filename;
-	bool			switch_output;
+	struct switch_output	switch_output;
+	u64			flight_window;
+	u64			flight_cutoff;
+	int			sample_time_offset;
+	const char		*trigger_file;
+	unsigned long		switch_output_budget;
+	bool			buildid_track;
+	struct buildid_hit	*hits;
+	size_t			nr_hits;
+	size_t			nr_hits_round;
+	size_t			hits_alloc;
+	u64			nr_track_samples;
+	bool			bpf_stacks;
+	struct perf_evsel	*bpf_stacks_evsel;
 	unsigned long long	samples;
 };
 
+static DEFINE_TRIGGER(switch_output_trigger);
+
+static bool switch_output_size(struct record *rec)
+{
+	return rec->switch_output.size &&
+	       trigger_is_ready(&switch_output_trigger) &&
+	       (rec->bytes_written >= rec->switch_output.size);
+}
+
 static int record__write(struct record *rec, void *bf, size_t size)
 {
 	if (perf_data_file__write(rec->session->file, bf, size) < 0) {
@@ -72,15 +113,133 @@ static int record__write(struct record *rec, void *bf, size_t size)
 	}
 
 	rec->bytes_written += size;
+
+	if (switch_output_size(rec))
+		trigger_hit(&switch_output_trigger);
+
 	return 0;
 }
 
+/*
+ * Mark the DSOs hit while the events are drained, instead of reading the
+ * whole perf.data again at the end: the task events are applied to the
+ * host machine right away and the sample hits are resolved one round
+ * later, so that the mmaps drained from the other CPUs in the meantime
+ * are known.
+ */
+static void record__track_event(struct record *rec, union perf_event *event)
+{
+	struct machine *machine = &rec->session->machines.host;
+	struct perf_sample sample;
+	struct buildid_hit *hit;
+
+	switch (event->header.type) {
+	case PERF_RECORD_SAMPLE:
+	case PERF_RECORD_MMAP:
+	case PERF_RECORD_MMAP2:
+	case PERF_RECORD_COMM:
+	case PERF_RECORD_FORK:
+	case PERF_RECORD_EXIT:
+		break;
+	default:
+		return;
+	}
+
+	if (perf_evlist__parse_sample(rec->evlist, event, &sample))
+		goto out_fallback;
+
+	if (event->header.type != PERF_RECORD_SAMPLE) {
+		machine__process_event(machine, event, &sample);
+		return;
+	}
+
+	rec->nr_track_samples++;
+
+	/* guests have their own machines, left to process_buildids() */
+	if (sample.cpumode == PERF_RECORD_MISC_GUEST_KERNEL ||
+	    sample.cpumode == PERF_RECORD_MISC_GUEST_USER)
+		goto out_fallback;
+
+	if (rec->nr_hits == rec->hits_alloc) {
+		size_t alloc = rec->hits_alloc ? rec->hits_alloc * 2 : 1024;
+
+		hit = realloc(rec->hits, alloc * sizeof(*hit));
+		if (hit == NULL)
+			goto out_fallback;
+		rec->hits = hit;
+		rec->hits_alloc = alloc;
+	}
+
+	hit = &rec->hits[rec->nr_hits++];
+	hit->ip	     = sample.ip;
+	hit->pid     = sample.pid;
+	hit->tid     = sample.tid;
+	hit->cpumode = sample.cpumode;
+	return;
+
+out_fallback:
+	pr_debug("marking the DSO hits at the end of the recording\n");
+	rec->buildid_track = false;
+	zfree(&rec->hits);
+	rec->nr_hits = rec->nr_hits_round = rec->hits_alloc = 0;
+}
+
+static void record__track_range(struct record *rec, struct perf_mmap *md,
+				unsigned char *data, u64 start, u64 end)
+{
+	while (start < end && rec->buildid_track) {
+		union perf_event *event = (void *)&data[start & md->mask];
+		size_t size = event->header.size;
+
+		if (size < sizeof(event->header) || start + size > end)
+			break;
+
+		if ((start & md->mask) + size > (u64)md->mask + 1) {
+			unsigned int len = md->mask + 1 - (start & md->mask);
+
+			if (size > sizeof(md->event_copy)) {
+				start += size;
+				continue;
+			}
+
+			memcpy(md->event_copy, event, len);
+			memcpy(md->event_copy + len, data, size - len);
+			event = (union perf_event *)md->event_copy;
+		}
+
+		record__track_event(rec, event);
+		start += size;
+	}
+}
+
+/* Resolve the hits of the previous round, keep this round's for the next */
+static void record__mark_hits(struct record *rec, size_t nr)
+{
+	struct machine *machine = &rec->session->machines.host;
+	size_t i;
+
+	for (i = 0; i < nr; i++) {
+		struct buildid_hit *hit = &rec->hits[i];
+
+		build_id__mark_dso_hit_ip(machine, hit->pid, hit->tid,
+					  hit->cpumode, hit->ip);
+	}
+
+	rec->nr_hits -= nr;
+	memmove(rec->hits, rec->hits + nr, rec->nr_hits * sizeof(*rec->hits));
+	rec->nr_hits_round = rec->nr_hits;
+}
+
 static int process_synthesized_event(struct perf_tool *tool,
 				     union perf_event *event,
 				     struct perf_sample *sample __maybe_unused,
 				     struct machine *machine __maybe_unused)
 {
 	struct record *rec = container_of(tool, struct record, tool);
+
+	if (rec->buildid_track)
+		record__track_event(rec, event);
+
 	return record__write(rec, event, event->header.size);
 }
 
@@ -118,6 +277,95 @@ backward_rb_find_range(void *buf, int mask, u64 head, u64 *start, u64 *end)
 	return -1;
 }
 
+/*
+ * Offset of the time of PERF_RECORD_SAMPLE events from the start of the
+ * event, or -1 if it is not at the same place for all the events.
+ */
+static int perf_evlist__sample_time_offset(struct perf_evlist *evlist)
+{
+	struct perf_evsel *evsel;
+	int offset = -1;
+
+	evlist__for_each_entry(evlist, evsel) {
+		u64 type = evsel->attr.sample_type;
+		int pos = sizeof(struct perf_event_header);
+
+		if (!(type & PERF_SAMPLE_TIME))
+			return -1;
+		if (type & PERF_SAMPLE_IDENTIFIER)
+			pos += sizeof(u64);
+		if (type & PERF_SAMPLE_IP)
+			pos += sizeof(u64);
+		if (type & PERF_SAMPLE_TID)
+			pos += sizeof(u64);
+
+		if (offset != -1 && offset != pos)
+			return -1;
+		offset = pos;
+	}
+
+	return offset;
+}
+
+/*
+ * Events are 8 bytes aligned and the ring buffer size is a multiple of the
+ * page size, so neither the header nor the sample time can wrap around.
+ * Positions are compared with != as the backward head grows down from 0.
+ */
+static bool
+backward_rb_sample_time(void *buf, int mask, u64 pos, int time_offset,
+			u64 *time)
+{
+	struct perf_event_header *pheader = buf + (pos & mask);
+
+	if (pheader->type != PERF_RECORD_SAMPLE ||
+	    pheader->size < time_offset + sizeof(u64))
+		return false;
+
+	*time = *(u64 *)(buf + ((pos + time_offset) & mask));
+	return true;
+}
+
+/* The backward ring buffer has the newest events first */
+static u64
+backward_rb_newest_time(void *buf, int mask, u64 start, u64 end,
+			int time_offset)
+{
+	struct perf_event_header *pheader;
+	u64 time;
+
+	while (start != end) {
+		if (backward_rb_sample_time(buf, mask, start, time_offset, &time))
+			return time;
+
+		pheader = buf + (start & mask);
+		start += pheader->size;
+	}
+
+	return 0;
+}
+
+/* Drop the events from the first sample older than cutoff on */
+static void
+backward_rb_trim_range(void *buf, int mask, u64 start, u64 *end,
+		       int time_offset, u64 cutoff)
+{
+	struct perf_event_header *pheader;
+	u64 pos = start, time;
+
+	while (pos != *end) {
+		if (backward_rb_sample_time(buf, mask, pos, time_offset, &time) &&
+		    time < cutoff) {
+			pr_debug3("trim backward ring buffer at %"PRIx64"\n", pos);
+			*end = pos;
+			return;
+		}
+
+		pheader = buf + (pos & mask);
+		pos += pheader->size;
+	}
+}
+
 static int
 rb_find_range(void *data, int mask, u64 head, u64 old,
 	      u64 *start, u64 *end, bool backward)
@@ -147,6 +395,11 @@ record__mmap_read(struct record *rec, struct perf_mmap *md,
 			  old, &start, &end, backward))
 		return -1;
 
+	if (backward && rec->flight_cutoff)
+		backward_rb_trim_range(data, md->mask, start, &end,
+				       rec->sample_time_offset,
+				       rec->flight_cutoff);
+
 	if (start == end)
 		return 0;
 
@@ -161,6 +414,9 @@ record__mmap_read(struct record *rec, struct perf_mmap *md,
 		return 0;
 	}
 
+	if (rec->buildid_track && !backward)
+		record__track_range(rec, md, data, start, end);
+
 	if ((start & md->mask) + size != (end & md->mask)) {
 		buf = &data[start & md->mask];
 		size = md->mask + 1 - (start & md->mask);
@@ -193,7 +449,6 @@ static volatile int child_finished;
 
 static volatile int auxtrace_record__snapshot_started;
 static DEFINE_TRIGGER(auxtrace_snapshot_trigger);
-static DEFINE_TRIGGER(switch_output_trigger);
 
 static void sig_handler(int sig)
 {
@@ -376,6 +631,19 @@ static int record__mmap(struct record *rec)
 	return record__mmap_evlist(rec, rec->evlist);
 }
 
+/*
+ * The BPF program of --bpf-stacks never outputs samples, its event only
+ * carries the samples synthesized by record__write_bpf_stacks().
+ */
+static void record__config_bpf_stacks(struct perf_evsel *evsel)
+{
+	perf_evsel__set_sample_bit(evsel, IP);
+	perf_evsel__set_sample_bit(evsel, TID);
+	perf_evsel__set_sample_bit(evsel, PERIOD);
+	perf_evsel__set_sample_bit(evsel, CALLCHAIN);
+	perf_evsel__reset_sample_bit(evsel, RAW);
+}
+
 static int record__open(struct record *rec)
 {
 	char msg[512];
@@ -387,6 +655,9 @@ static int record__open(struct record *rec)
 
 	perf_evlist__config(evlist, opts, &callchain_param);
 
+	if (rec->bpf_stacks_evsel)
+		record__config_bpf_stacks(rec->bpf_stacks_evsel);
+
 	evlist__for_each_entry(evlist, pos) {
 		perf_evsel__set_sample_bit(pos, REGS_USER);
 		pos->attr.sample_regs_user = PERF_REGS_MASK;
@@ -501,6 +772,42 @@ static struct perf_event_header finished_round_event = {
 	.type = PERF_RECORD_FINISHED_ROUND,
 };
 
+/*
+ * With --flight-recorder=<time> only the last <time> of the overwritable
+ * ring buffers is dumped: the newest sample of all the buffers sets the
+ * end of the window.
+ */
+static void record__flight_cutoff(struct record *rec, struct perf_evlist *evlist)
+{
+	struct perf_mmap *maps = evlist->backward_mmap;
+	u64 newest = 0;
+	int i;
+
+	rec->flight_cutoff = 0;
+	if (!rec->flight_window || rec->sample_time_offset < 0)
+		return;
+
+	for (i = 0; i < evlist->nr_mmaps; i++) {
+		unsigned char *data = maps[i].base + page_size;
+		u64 head, start, end, time;
+
+		if (!maps[i].base)
+			continue;
+
+		head = perf_mmap__read_head(&maps[i]);
+		if (backward_rb_find_range(data, maps[i].mask, head, &start, &end))
+			continue;
+
+		time = backward_rb_newest_time(data, maps[i].mask, start, end,
+					       rec->sample_time_offset);
+		if (time > newest)
+			newest = time;
+	}
+
+	if (newest > rec->flight_window)
+		rec->flight_cutoff = newest - rec->flight_window;
+}
+
 static int record__mmap_read_evlist(struct record *rec, struct perf_evlist *evlist,
 				    bool backward)
 {
@@ -519,6 +826,9 @@ static int record__mmap_read_evlist(struct record *rec, struct perf_evlist *evli
 	if (backward && evlist->bkw_mmap_state != BKW_MMAP_DATA_PENDING)
 		return 0;
 
+	if (backward)
+		record__flight_cutoff(rec, evlist);
+
 	for (i = 0; i < evlist->nr_mmaps; i++) {
 		struct auxtrace_mmap *mm = &maps[i].auxtrace_mmap;
 
@@ -546,6 +856,8 @@ static int record__mmap_read_evlist(struct record *rec, struct perf_evlist *evli
 
 	if (backward)
 		perf_evlist__toggle_bkw_mmap(evlist, BKW_MMAP_EMPTY);
+	else if (rec->buildid_track)
+		record__mark_hits(rec, rec->nr_hits_round);
 out:
 	return rc;
 }
@@ -596,7 +908,11 @@ record__finish_output(struct record *rec)
 	rec->session->header.data_size += rec->bytes_written;
 	file->size = lseek(perf_data_file__fd(file), 0, SEEK_CUR);
 
-	if (!rec->no_buildid) {
+	if (rec->buildid_track) {
+		record__mark_hits(rec, rec->nr_hits);
+		rec->samples = rec->nr_track_samples;
+		rec->nr_track_samples = 0;
+	} else if (!rec->no_buildid) {
 		process_buildids(rec);
 
 		if (rec->buildid_all)
@@ -607,6 +923,135 @@ record__finish_output(struct record *rec)
 	return;
 }
 
+struct bpf_stacks_args {
+	struct record		*rec;
+	union perf_event	*event;
+	struct ip_callchain	*chain;
+	u64			time;
+	u64			nr_dropped;
+};
+
+static int record__write_bpf_stacks_cb(struct bpf_stacks_entry *entry,
+				       void *arg)
+{
+	struct bpf_stacks_args *args = arg;
+	struct perf_evsel *evsel = args->rec->bpf_stacks_evsel;
+	struct ip_callchain *chain = args->chain;
+	union perf_event *event = args->event;
+	struct perf_sample sample = {
+		.pid	   = entry->key.pid,
+		.tid	   = entry->key.tid,
+		.time	   = args->time,
+		.period	   = entry->count,
+		.callchain = chain,
+	};
+	u64 type = evsel->attr.sample_type;
+	u64 read_format = evsel->attr.read_format;
+	u64 nr = 0;
+	size_t size;
+
+	/* Don't blame the tick handling for the kernel time */
+	if (entry->nr_kstack &&
+	    !bpf_record_stacks__skip_tick(entry, &args->rec->session->machines.host)) {
+		args->nr_dropped += entry->count;
+		return 0;
+	}
+
+	/* The leaf frame is the sample ip, the kernel one when in kernel */
+	if (entry->nr_ustack) {
+		sample.ip = entry->ustack[0];
+		sample.cpumode = PERF_RECORD_MISC_USER;
+	}
+
+	if (entry->nr_kstack) {
+		chain->ips[nr++] = PERF_CONTEXT_KERNEL;
+		memcpy(&chain->ips[nr], entry->kstack,
+		       entry->nr_kstack * sizeof(u64));
+		nr += entry->nr_kstack;
+
+		sample.ip = entry->kstack[0];
+		sample.cpumode = PERF_RECORD_MISC_KERNEL;
+	}
+
+	if (entry->nr_ustack) {
+		chain->ips[nr++] = PERF_CONTEXT_USER;
+		memcpy(&chain->ips[nr], entry->ustack,
+		       entry->nr_ustack * sizeof(u64));
+		nr += entry->nr_ustack;
+	}
+	chain->nr = nr;
+
+	if (evsel->ids)
+		sample.id = sample.stream_id = evsel->id[0];
+
+	size = perf_event__sample_event_size(&sample, type, read_format);
+	event->header.type = PERF_RECORD_SAMPLE;
+	event->header.misc = sample.cpumode ?: PERF_RECORD_MISC_USER;
+	event->header.size = size;
+
+	if (perf_event__synthesize_sample(event, type, read_format,
+					  &sample, false))
+		return -EINVAL;
+
+	return record__write(args->rec, event, size);
+}
+
+/*
+ * Write the callchains aggregated in kernel by --bpf-stacks as samples
+ * weighted by their count.  They are timed now, after all the events
+ * recorded so far, cmd_record() making the events use the same clock.
+ */
+static int record__write_bpf_stacks(struct record *rec, bool clear)
+{
+	struct bpf_stacks_args args = { .rec = rec, };
+	struct timespec ts;
+	int err = -ENOMEM;
+
+	if (!rec->bpf_stacks_evsel)
+		return 0;
+
+	if (clock_gettime(rec->opts.clockid, &ts))
+		return -errno;
+	args.time = ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+
+	args.event = malloc(PERF_SAMPLE_MAX_SIZE);
+	args.chain = malloc(sizeof(*args.chain) +
+			    (2 + 2 * PERF_MAX_STACK_DEPTH) * sizeof(u64));
+	if (args.event && args.chain)
+		err = bpf_record_stacks__for_each(record__write_bpf_stacks_cb,
+						  &args, clear);
+	if (err)
+		pr_err("Failed to write the BPF aggregated stacks: %s\n",
+		       strerror(-err));
+	if (args.nr_dropped)
+		pr_warning("Dropped %" PRIu64 " ticks whose kernel stack doesn't reach the interrupted code\n",
+			   args.nr_dropped);
+
+	free(args.event);
+	free(args.chain);
+	return err;
+}
+
+/*
+ * The BPF program sees every task: leave perf out, and unless recording
+ * system wide only count the target tasks and their children, by tid for
+ * a --tid target, by tgid otherwise.
+ */
+static int record__set_bpf_stacks_filter(struct record *rec)
+{
+	struct thread_map *threads = rec->evlist->threads;
+	int err, thread;
+
+	err = bpf_record_stacks__filter_pid(getpid(), false);
+	if (err || thread_map__pid(threads, 0) == -1)
+		return err;
+
+	for (thread = 0; !err && thread < thread_map__nr(threads); thread++)
+		err = bpf_record_stacks__filter_pid(thread_map__pid(threads, thread), true);
+
+	return err ?: bpf_record_stacks__filter_only(true, rec->opts.target.tid);
+}
+
 static int record__synthesize_workload(struct record *rec, bool tail)
 {
 	struct {
@@ -629,6 +1074,200 @@ static int record__synthesize_workload(struct record *rec, bool tail)
 
 static int record__synthesize(struct record *rec, bool tail);
 
+static int rotate_filter_len;
+static const char *rotate_filter_name;
+
+/* <output>.<timestamp>, as written by record__switch_output() */
+static int rotate_filter(const struct dirent *d)
+{
+	const char *p = d->d_name;
+	int i;
+
+	if (strncmp(p, rotate_filter_name, rotate_filter_len) ||
+	    p[rotate_filter_len] != '.')
+		return 0;
+
+	p += rotate_filter_len + 1;
+	for (i = 0; i < 16; i++) {
+		if (!isdigit(p[i]))
+			return 0;
+	}
+	return p[i] == '\0';
+}
+
+/*
+ * Remove the oldest dumps until they all fit in --switch-output-budget,
+ * keeping at least the one just written.
+ */
+static void record__rotate_output(struct record *rec)
+{
+	struct dirent **namelist;
+	unsigned long total = 0;
+	char *dir, *copy, path[PATH_MAX];
+	struct stat st;
+	int i, n;
+
+	if (!rec->switch_output_budget)
+		return;
+
+	copy = strdup(rec->file.path);
+	if (copy == NULL)
+		return;
+
+	dir = dirname(copy);
+	rotate_filter_name = strrchr(rec->file.path, '/');
+	rotate_filter_name = rotate_filter_name ? rotate_filter_name + 1 :
+						  rec->file.path;
+	rotate_filter_len = strlen(rotate_filter_name);
+
+	/* the timestamps have a fixed width, so the oldest sort first */
+	n = scandir(dir, &namelist, rotate_filter, alphasort);
+	if (n < 0) {
+		pr_debug("failed to scan %s: %m\n", dir);
+		goto out;
+	}
+
+	for (i = 0; i < n; i++) {
+		scnprintf(path, sizeof(path), "%s/%s", dir, namelist[i]->d_name);
+		if (!stat(path, &st))
+			total += st.st_size;
+	}
+
+	for (i = 0; i < n - 1 && total > rec->switch_output_budget; i++) {
+		scnprintf(path, sizeof(path), "%s/%s", dir, namelist[i]->d_name);
+		if (stat(path, &st) || unlink(path))
+			continue;
+
+		total -= st.st_size;
+		if (!quiet)
+			fprintf(stderr, "[ perf record: Removed %s ]\n", path);
+	}
+
+	for (i = 0; i < n; i++)
+		free(namelist[i]);
+	free(namelist);
+out:
+	free(copy);
+}
+
+/*
+ * The header of a switched output is written by a thread while recording
+ * goes on in the next file, it is renamed from <output>.<timestamp>.part
+ * to <output>.<timestamp> once complete.  Only one at a time, as they
+ * share the evlist.
+ */
+struct record_finalize {
+	pthread_t		thread;
+	bool			running;
+	int			fd;
+	struct record		*rec;
+	struct perf_session	session;
+	char			*part;
+	char			*path;
+};
+
+static struct record_finalize record_finalize;
+
+static void *record__finalize_thread(void *arg)
+{
+	struct record_finalize *f = arg;
+
+	if (perf_session__write_header(&f->session, f->rec->evlist, f->fd, true))
+		pr_err("failed to write the header of %s\n", f->path);
+	close(f->fd);
+
+	if (rename(f->part, f->path))
+		pr_warning("Failed to rename %s to %s\n", f->part, f->path);
+	else if (!quiet)
+		fprintf(stderr, "[ perf record: Dump %s ]\n", f->path);
+
+	record__rotate_output(f->rec);
+	return NULL;
+}
+
+static void record__finalize_wait(void)
+{
+	struct record_finalize *f = &record_finalize;
+
+	if (!f->running)
+		return;
+
+	pthread_join(f->thread, NULL);
+	zfree(&f->part);
+	zfree(&f->path);
+	f->running = false;
+}
+
+/*
+ * Without build-ids and AUX area index to collect, the header of the
+ * switched output only depends on the evlist and on its data size.
+ */
+static bool record__can_finalize_async(struct record *rec)
+{
+	return rec->no_buildid && !rec->opts.full_auxtrace;
+}
+
+static int record__finalize_async(struct record *rec, const char *timestamp)
+{
+	struct record_finalize *f = &record_finalize;
+	struct perf_data_file *file = &rec->file;
+	char postfix[32];
+	int fd, old_fd;
+
+	record__finalize_wait();
+
+	scnprintf(postfix, sizeof(postfix), "%s.part", timestamp);
+	if (asprintf(&f->path, "%s.%s", file->path, timestamp) < 0) {
+		f->path = NULL;
+		return -ENOMEM;
+	}
+	if (asprintf(&f->part, "%s.%s", file->path, postfix) < 0) {
+		f->part = NULL;
+		fd = -ENOMEM;
+		goto out_free;
+	}
+
+	/* keeps the switched output open for the thread */
+	old_fd = dup(perf_data_file__fd(file));
+	if (old_fd < 0) {
+		fd = -errno;
+		goto out_free;
+	}
+
+	/*
+	 * A shallow copy: the machines, the evlist and the auxtrace index are
+	 * still shared with the main thread, which keeps updating them.  The
+	 * header features only walk them for the build-ids (the DSOs) and the
+	 * auxtrace index, which are not written with --no-buildid and without
+	 * full auxtrace, as required by record__can_finalize_async().  The
+	 * other features only read what doesn't change while recording.
+	 */
+	f->session = *rec->session;
+	f->session.header.data_size += rec->bytes_written;
+
+	fd = perf_data_file__switch(file, postfix,
+				    rec->session->header.data_offset, false);
+	if (fd < 0) {
+		close(old_fd);
+		goto out_free;
+	}
+
+	f->fd = old_fd;
+	f->rec = rec;
+	if (pthread_create(&f->thread, NULL, record__finalize_thread, f)) {
+		record__finalize_thread(f);
+		goto out_free;
+	}
+
+	f->running = true;
+	return fd;
+
+out_free:
+	zfree(&f->part);
+	zfree(&f->path);
+	return fd;
+}
+
 static int
 record__switch_output(struct record *rec, bool at_exit)
 {
@@ -638,30 +1277,43 @@ record__switch_output(struct record *rec, bool at_exit)
 	/* Same Size:      "2015122520103046"*/
 	char timestamp[] = "InvalidTimestamp";
 
+	/* Each output gets the stacks counted since the previous one */
+	if (!at_exit)
+		record__write_bpf_stacks(rec, true);
+
 	record__synthesize(rec, true);
 	if (target__none(&rec->opts.target))
 		record__synthesize_workload(rec, true);
 
 	rec->samples = 0;
-	record__finish_output(rec);
 	err = fetch_current_timestamp(timestamp, sizeof(timestamp));
 	if (err) {
 		pr_err("Failed to get current timestamp\n");
 		return -EINVAL;
 	}
 
-	fd = perf_data_file__switch(file, timestamp,
-				    rec->session->header.data_offset,
-				    at_exit);
+	if (!at_exit && record__can_finalize_async(rec)) {
+		fd = record__finalize_async(rec, timestamp);
+	} else {
+		record__finalize_wait();
+		record__finish_output(rec);
+
+		fd = perf_data_file__switch(file, timestamp,
+					    rec->session->header.data_offset,
+					    at_exit);
+		if (!quiet)
+			fprintf(stderr, "[ perf record: Dump %s.%s ]\n",
+				file->path, timestamp);
+
+		if (fd >= 0)
+			record__rotate_output(rec);
+	}
+
 	if (fd >= 0 && !at_exit) {
 		rec->bytes_written = 0;
 		rec->session->header.data_size = 0;
 	}
 
-	if (!quiet)
-		fprintf(stderr, "[ perf record: Dump %s.%s ]\n",
-			file->path, timestamp);
-
 	/* Output tracking events */
 	if (!at_exit) {
 		record__synthesize(rec, false);
@@ -698,6 +1350,22 @@ static void workload_exec_failed_signal(int signo __maybe_unused,
 }
 
 static void snapshot_sig_handler(int sig);
+static void alarm_sig_handler(int sig);
+
+/* How often to look for the --trigger-file, in milliseconds */
+#define TRIGGER_FILE_POLL_MS	100
+
+static void record__check_trigger_file(struct record *rec)
+{
+	if (!rec->trigger_file || access(rec->trigger_file, F_OK))
+		return;
+
+	if (unlink(rec->trigger_file))
+		pr_warning("Failed to remove %s: %m\n", rec->trigger_file);
+
+	if (trigger_is_ready(&switch_output_trigger))
+		trigger_hit(&switch_output_trigger);
+}
 
 int __weak
 perf_event__synth_time_conv(const struct perf_event_mmap_page *pc __maybe_unused,
@@ -827,16 +1495,19 @@ static int __cmd_record(struct record *rec, int argc, const char **argv)
 	signal(SIGINT, sig_handler);
 	signal(SIGTERM, sig_handler);
 
-	if (rec->opts.auxtrace_snapshot_mode || rec->switch_output) {
+	if (rec->opts.auxtrace_snapshot_mode || rec->switch_output.enabled) {
 		signal(SIGUSR2, snapshot_sig_handler);
 		if (rec->opts.auxtrace_snapshot_mode)
 			trigger_on(&auxtrace_snapshot_trigger);
-		if (rec->switch_output)
+		if (rec->switch_output.enabled)
 			trigger_on(&switch_output_trigger);
 	} else {
 		signal(SIGUSR2, SIG_IGN);
 	}
 
+	if (rec->switch_output.time)
+		signal(SIGALRM, alarm_sig_handler);
+
 	session = perf_session__new(file, false, tool);
 	if (session == NULL) {
 		pr_err("Perf session creation failed.\n");
@@ -859,11 +1530,32 @@ static int __cmd_record(struct record *rec, int argc, const char **argv)
 		}
 	}
 
+	if (rec->bpf_stacks_evsel) {
+		err = record__set_bpf_stacks_filter(rec);
+		if (err) {
+			pr_err("Failed to set the BPF stacks filter: %s\n",
+			       strerror(-err));
+			goto out_child;
+		}
+	}
+
 	if (record__open(rec) != 0) {
 		err = -1;
 		goto out_child;
 	}
 
+	/*
+	 * The backward ring buffers have the newest events first, mark
+	 * their hits from perf.data at the end.
+	 */
+	rec->buildid_track = !rec->no_buildid && !rec->buildid_all &&
+			     !file->is_pipe && !rec->evlist->backward_mmap;
+
+	rec->sample_time_offset = perf_evlist__sample_time_offset(rec->evlist);
+	if (rec->flight_window && rec->sample_time_offset < 0)
+		pr_warning("WARNING: samples without a common time layout, "
+			   "dumping the whole overwrite ring buffers\n");
+
 	err = bpf__apply_obj_config();
 	if (err) {
 		char errbuf[BUFSIZ];
@@ -963,6 +1655,8 @@ static int __cmd_record(struct record *rec, int argc, const char **argv)
 
 	trigger_ready(&auxtrace_snapshot_trigger);
 	trigger_ready(&switch_output_trigger);
+	if (rec->switch_output.time)
+		alarm(rec->switch_output.time);
 	for (;;) {
 		unsigned long long hits = rec->samples;
 
@@ -1027,24 +1721,33 @@ static int __cmd_record(struct record *rec, int argc, const char **argv)
 				err = fd;
 				goto out_child;
 			}
+
+			/* the time threshold counts from the switch */
+			if (rec->switch_output.time)
+				alarm(rec->switch_output.time);
 		}
 
 		if (hits == rec->samples) {
 			if (done || draining)
 				break;
-			err = perf_evlist__poll(rec->evlist, -1);
+			err = perf_evlist__poll(rec->evlist, rec->trigger_file ?
+						TRIGGER_FILE_POLL_MS : -1);
+			/* a timeout to look for the trigger file isn't a wakeup */
+			if (err || !rec->trigger_file)
+				waking++;
 			/*
 			 * Propagate error, only if there's any. Ignore positive
 			 * number of returned events and interrupt error.
 			 */
 			if (err > 0 || (err < 0 && errno == EINTR))
 				err = 0;
-			waking++;
 
 			if (perf_evlist__filter_pollfd(rec->evlist, POLLERR | POLLHUP) == 0)
 				draining = true;
 		}
 
+		record__check_trigger_file(rec);
+
 		/*
 		 * When perf is starting the traced process, at the end events
 		 * die with the process and we wait for that. Thus no need to
@@ -1091,6 +1794,9 @@ out_child:
 	} else
 		status = err;
 
+	if (!err)
+		record__write_bpf_stacks(rec, false);
+
 	record__synthesize(rec, true);
 	/* this will be recalculated during process_buildids() */
 	rec->samples = 0;
@@ -1124,6 +1830,8 @@ out_child:
 	}
 
 out_delete_session:
+	record__finalize_wait();
+	zfree(&rec->hits);
 	perf_session__delete(session);
 	return status;
 }
@@ -1334,6 +2042,113 @@ out_free:
 	return ret;
 }
 
+static int record__parse_flight_recorder(const struct option *opt,
+					 const char *str, int unset)
+{
+	struct record *rec = opt->value;
+	char *end;
+	double val;
+
+	if (unset)
+		return 0;
+
+	rec->opts.overwrite = true;
+	rec->switch_output.enabled = true;
+	if (!str)
+		return 0;
+
+	val = strtod(str, &end);
+	if (end == str || val <= 0)
+		return -EINVAL;
+
+	if (!strcmp(end, "ms"))
+		val *= NSEC_PER_MSEC;
+	else if (!strcmp(end, "s") || *end == '\0')
+		val *= NSEC_PER_SEC;
+	else if (!strcmp(end, "m"))
+		val *= 60 * NSEC_PER_SEC;
+	else
+		return -EINVAL;
+
+	rec->flight_window = val;
+	/* the window needs the sample times, even with --no-inherit */
+	rec->opts.sample_time = true;
+	rec->opts.sample_time_set = true;
+	return 0;
+}
+
+static struct parse_tag switch_output_size_tags[] = {
+	{ .tag  = 'B', .mult = 1       },
+	{ .tag  = 'K', .mult = 1 << 10 },
+	{ .tag  = 'M', .mult = 1 << 20 },
+	{ .tag  = 'G', .mult = 1 << 30 },
+	{ .tag  = 0 },
+};
+
+static struct parse_tag switch_output_time_tags[] = {
+	{ .tag  = 's', .mult = 1        },
+	{ .tag  = 'm', .mult = 60       },
+	{ .tag  = 'h', .mult = 60*60    },
+	{ .tag  = 'd', .mult = 60*60*24 },
+	{ .tag  = 0 },
+};
+
+static int record__parse_switch_output(const struct option *opt,
+				       const char *str, int unset)
+{
+	struct switch_output *s = opt->value;
+	unsigned long val;
+
+	if (unset) {
+		memset(s, 0, sizeof(*s));
+		return 0;
+	}
+
+	if (!str || !strcmp(str, "signal")) {
+		pr_debug("switch-output with SIGUSR2 signal\n");
+		goto enabled;
+	}
+
+	val = parse_tag_value(str, switch_output_size_tags);
+	if (val != (unsigned long) -1 && val) {
+		s->size = val;
+		pr_debug("switch-output with %s size threshold\n", str);
+		goto enabled;
+	}
+
+	val = parse_tag_value(str, switch_output_time_tags);
+	if (val != (unsigned long) -1 && val) {
+		s->time = val;
+		pr_debug("switch-output with %s time threshold (%lu seconds)\n",
+			 str, s->time);
+		goto enabled;
+	}
+
+	return -EINVAL;
+
+enabled:
+	s->enabled = true;
+	return 0;
+}
+
+static int record__parse_switch_output_budget(const struct option *opt,
+					      const char *str,
+					      int unset __maybe_unused)
+{
+	unsigned long *budget = opt->value;
+	unsigned long val;
+
+	if (!str)
+		return -EINVAL;
+
+	val = parse_tag_value(str, switch_output_size_tags);
+	if (val == (unsigned long) -1 || val == 0)
+		return -EINVAL;
+
+	*budget = val;
+	return 0;
+}
+
 static const char * const __record_usage[] = {
 	"perf record [<options>] [<command>]",
 	"perf record [<options>] -- <command> [<options>]",
@@ -1501,8 +2316,20 @@ struct option __record_options[] = {
 		    "Record build-id of all DSOs regardless of hits"),
 	OPT_BOOLEAN(0, "timestamp-filename", &record.timestamp_filename,
 		    "append timestamp to output filename"),
-	OPT_BOOLEAN(0, "switch-output", &record.switch_output,
-		    "Switch output when receive SIGUSR2"),
+	OPT_CALLBACK_OPTARG(0, "switch-output", &record.switch_output, NULL,
+			    "signal,size,time",
+			    "Switch output when receive SIGUSR2 or cross size,time threshold",
+			    record__parse_switch_output),
+	OPT_CALLBACK(0, "switch-output-budget", &record.switch_output_budget,
+		     "size", "Remove the oldest switched outputs beyond size (B/K/M/G)",
+		     record__parse_switch_output_budget),
+	OPT_CALLBACK_OPTARG(0, "flight-recorder", &record, NULL, "time",
+			    "Keep events in overwritable ring buffers, dump the last <time> (s/ms/m) on SIGUSR2",
+			    record__parse_flight_recorder),
+	OPT_STRING(0, "trigger-file", &record.trigger_file, "file",
+		   "Switch output when file is created, removing it"),
+	OPT_BOOLEAN(0, "bpf-stacks", &record.bpf_stacks,
+		    "Count the callchains of the ticks in kernel with BPF, write the counts"),
 	OPT_BOOLEAN(0, "dry-run", &dry_run,
 		    "Parse options then exit"),
 	OPT_END()
@@ -1520,6 +2347,7 @@ int cmd_record(int argc, const char **argv, const char *prefix __maybe_unused)
 # define set_nobuild(s, l, c) set_option_nobuild(record_options, s, l, "NO_LIBBPF=1", c)
 	set_nobuild('\0', "clang-path", true);
 	set_nobuild('\0', "clang-opt", true);
+	set_nobuild('\0', "bpf-stacks", true);
 # undef set_nobuild
 #endif
 
@@ -1560,7 +2388,13 @@ int cmd_record(int argc, const char **argv, const char *prefix __maybe_unused)
 		return -EINVAL;
 	}
 
-	if (rec->switch_output)
+	if ((rec->trigger_file || rec->switch_output_budget) &&
+	    !rec->switch_output.enabled) {
+		ui__error("--trigger-file and --switch-output-budget need --switch-output\n");
+		return -EINVAL;
+	}
+
+	if (rec->switch_output.enabled)
 		rec->timestamp_filename = true;
 
 	if (!rec->itr) {
@@ -1601,7 +2435,7 @@ int cmd_record(int argc, const char **argv, const char *prefix __maybe_unused)
 
 	if (rec->no_buildid_cache || rec->no_buildid) {
 		disable_buildid_cache();
-	} else if (rec->switch_output) {
+	} else if (rec->switch_output.enabled) {
 		/*
 		 * In 'perf record --switch-output', disable buildid
 		 * generation by default to reduce data file switching
@@ -1633,6 +2467,23 @@ int cmd_record(int argc, const char **argv, const char *prefix __maybe_unused)
 	if (record.opts.overwrite)
 		record.opts.tail_synthesize = true;
 
+	if (rec->bpf_stacks) {
+		err = bpf_record_stacks__add_events(rec->evlist,
+						    &rec->bpf_stacks_evsel);
+		if (err)
+			goto out_symbol_exit;
+		err = -EINVAL;
+		if (!rec->bpf_stacks_evsel)
+			goto out_symbol_exit;
+
+		/* See record__write_bpf_stacks() */
+		if (!rec->opts.use_clockid) {
+			rec->opts.use_clockid = true;
+			rec->opts.clockid = CLOCK_MONOTONIC;
+		}
+		err = -ENOMEM;
+	}
+
 	if (rec->evlist->nr_entries == 0 &&
 	    perf_evlist__add_default(rec->evlist) < 0) {
 		pr_err("Not enough memory for event selector list\n");
@@ -1688,6 +2539,12 @@ out_symbol_exit:
 	return err;
 }
 
+static void alarm_sig_handler(int sig __maybe_unused)
+{
+	if (trigger_is_ready(&switch_output_trigger))
+		trigger_hit(&switch_output_trigger);
+}
+
 static void snapshot_sig_handler(int sig __maybe_unused)
 {
 	if (trigger_is_ready(&auxtrace_snapshot_trigger)) {
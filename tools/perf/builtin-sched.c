@@ -13,6 +13,8 @@
 #include "util/cloexec.h"
 #include "util/thread_map.h"
 #include "util/color.h"
+#include "util/log-hist.h"
+#include "util/sched-timehist.h"
 
 #include <subcmd/parse-options.h>
 #include "util/trace-event.h"
@@ -88,6 +90,12 @@ struct work_atom {
 	u64			runtime;
 };
 
+/*
+ * Only the last atom of a thread is ever looked at while processing
+ * events, so unless --keep-atoms is used work_list holds just that one
+ * and the latencies are accounted in lat_hist, keeping the memory used
+ * per thread constant however long the trace is.
+ */
 struct work_atoms {
 	struct list_head	work_list;
 	struct thread		*thread;
@@ -98,6 +106,7 @@ struct work_atoms {
 	u64			nb_atoms;
 	u64			total_runtime;
 	int			num_merged;
+	struct log_hist		*lat_hist;
 };
 
 typedef int (*sort_fn_t)(struct work_atoms *, struct work_atoms *);
@@ -139,6 +148,20 @@ struct perf_sched_map {
 	const char		*cpus_str;
 };
 
+struct timehist_cpu;
+
+struct perf_sched_timehist {
+	struct timehist_cpu	*cpus;
+	struct list_head	 threads;
+	bool			 summary_only;
+	bool			 summary;
+	bool			 wakeups;
+	bool			 migrations;
+	u64			 first_time;
+	u64			 last_time;
+	unsigned long		 nr_threads;
+};
+
 struct perf_sched {
 	struct perf_tool tool;
 	const char	 *sort_order;
@@ -190,7 +213,9 @@ struct perf_sched {
 	struct list_head sort_list, cmp_pid;
 	bool force;
 	bool skip_merge;
+	bool keep_atoms;
 	struct perf_sched_map map;
+	struct perf_sched_timehist timehist;
 };
 
 static u64 get_nsecs(void)
@@ -713,8 +738,8 @@ replay_wakeup_event(struct perf_sched *sched,
 		    struct perf_evsel *evsel, struct perf_sample *sample,
 		    struct machine *machine __maybe_unused)
 {
-	const char *comm = perf_evsel__strval(evsel, sample, "comm");
-	const u32 pid	 = perf_evsel__intval(evsel, sample, "pid");
+	const char *comm = perf_evsel__tp_strval(evsel, sample, "comm");
+	const u32 pid	 = perf_evsel__tp_intval(evsel, sample, "pid");
 	struct task_desc *waker, *wakee;
 
 	if (verbose) {
@@ -735,11 +760,11 @@ static int replay_switch_event(struct perf_sched *sched,
 			       struct perf_sample *sample,
 			       struct machine *machine __maybe_unused)
 {
-	const char *prev_comm  = perf_evsel__strval(evsel, sample, "prev_comm"),
-		   *next_comm  = perf_evsel__strval(evsel, sample, "next_comm");
-	const u32 prev_pid = perf_evsel__intval(evsel, sample, "prev_pid"),
-		  next_pid = perf_evsel__intval(evsel, sample, "next_pid");
-	const u64 prev_state = perf_evsel__intval(evsel, sample, "prev_state");
+	const char *prev_comm  = perf_evsel__tp_strval(evsel, sample, "prev_comm"),
+		   *next_comm  = perf_evsel__tp_strval(evsel, sample, "next_comm");
+	const u32 prev_pid = perf_evsel__tp_intval(evsel, sample, "prev_pid"),
+		  next_pid = perf_evsel__tp_intval(evsel, sample, "next_pid");
+	const u64 prev_state = perf_evsel__tp_intval(evsel, sample, "prev_state");
 	struct task_desc *prev, __maybe_unused *next;
 	u64 timestamp0, timestamp = sample->time;
 	int cpu = sample->cpu;
@@ -889,6 +914,13 @@ static int thread_atoms_insert(struct perf_sched *sched, struct thread *thread)
 		return -1;
 	}
 
+	atoms->lat_hist = zalloc(sizeof(*atoms->lat_hist));
+	if (!atoms->lat_hist) {
+		pr_err("No memory at %s\n", __func__);
+		free(atoms);
+		return -1;
+	}
+
 	atoms->thread = thread__get(thread);
 	INIT_LIST_HEAD(&atoms->work_list);
 	__thread_latency_insert(&sched->atom_root, atoms, &sched->cmp_pid);
@@ -903,14 +935,24 @@ static char sched_out_state(u64 prev_state)
 }
 
 static int
-add_sched_out_event(struct work_atoms *atoms,
+add_sched_out_event(struct perf_sched *sched,
+		    struct work_atoms *atoms,
 		    char run_state,
 		    u64 timestamp)
 {
-	struct work_atom *atom = zalloc(sizeof(*atom));
-	if (!atom) {
-		pr_err("Non memory at %s", __func__);
-		return -1;
+	struct work_atom *atom;
+
+	if (!sched->keep_atoms && !list_empty(&atoms->work_list)) {
+		/* recycle the previous atom, it was already accounted */
+		atom = list_entry(atoms->work_list.prev, struct work_atom, list);
+		list_del(&atom->list);
+		memset(atom, 0, sizeof(*atom));
+	} else {
+		atom = zalloc(sizeof(*atom));
+		if (!atom) {
+			pr_err("Non memory at %s", __func__);
+			return -1;
+		}
 	}
 
 	atom->sched_out_time = timestamp;
@@ -961,6 +1003,7 @@ add_sched_in_event(struct work_atoms *atoms, u64 timestamp)
 	atom->sched_in_time = timestamp;
 
 	delta = atom->sched_in_time - atom->wake_up_time;
+	log_hist__add(atoms->lat_hist, delta);
 	atoms->total_lat += delta;
 	if (delta > atoms->max_lat) {
 		atoms->max_lat = delta;
@@ -974,9 +1017,9 @@ static int latency_switch_event(struct perf_sched *sched,
 				struct perf_sample *sample,
 				struct machine *machine)
 {
-	const u32 prev_pid = perf_evsel__intval(evsel, sample, "prev_pid"),
-		  next_pid = perf_evsel__intval(evsel, sample, "next_pid");
-	const u64 prev_state = perf_evsel__intval(evsel, sample, "prev_state");
+	const u32 prev_pid = perf_evsel__tp_intval(evsel, sample, "prev_pid"),
+		  next_pid = perf_evsel__tp_intval(evsel, sample, "next_pid");
+	const u64 prev_state = perf_evsel__tp_intval(evsel, sample, "prev_state");
 	struct work_atoms *out_events, *in_events;
 	struct thread *sched_out, *sched_in;
 	u64 timestamp0, timestamp = sample->time;
@@ -1012,7 +1055,7 @@ static int latency_switch_event(struct perf_sched *sched,
 			goto out_put;
 		}
 	}
-	if (add_sched_out_event(out_events, sched_out_state(prev_state), timestamp))
+	if (add_sched_out_event(sched, out_events, sched_out_state(prev_state), timestamp))
 		return -1;
 
 	in_events = thread_atoms_search(&sched->atom_root, sched_in, &sched->cmp_pid);
@@ -1028,7 +1071,7 @@ static int latency_switch_event(struct perf_sched *sched,
 		 * Take came in we have not heard about yet,
 		 * add in an initial atom in runnable state:
 		 */
-		if (add_sched_out_event(in_events, 'R', timestamp))
+		if (add_sched_out_event(sched, in_events, 'R', timestamp))
 			goto out_put;
 	}
 	add_sched_in_event(in_events, timestamp);
@@ -1044,8 +1087,8 @@ static int latency_runtime_event(struct perf_sched *sched,
 				 struct perf_sample *sample,
 				 struct machine *machine)
 {
-	const u32 pid	   = perf_evsel__intval(evsel, sample, "pid");
-	const u64 runtime  = perf_evsel__intval(evsel, sample, "runtime");
+	const u32 pid	   = perf_evsel__tp_intval(evsel, sample, "pid");
+	const u64 runtime  = perf_evsel__tp_intval(evsel, sample, "runtime");
 	struct thread *thread = machine__findnew_thread(machine, -1, pid);
 	struct work_atoms *atoms = thread_atoms_search(&sched->atom_root, thread, &sched->cmp_pid);
 	u64 timestamp = sample->time;
@@ -1063,7 +1106,7 @@ static int latency_runtime_event(struct perf_sched *sched,
 			pr_err("in-event: Internal tree error");
 			goto out_put;
 		}
-		if (add_sched_out_event(atoms, 'R', timestamp))
+		if (add_sched_out_event(sched, atoms, 'R', timestamp))
 			goto out_put;
 	}
 
@@ -1079,7 +1122,7 @@ static int latency_wakeup_event(struct perf_sched *sched,
 				struct perf_sample *sample,
 				struct machine *machine)
 {
-	const u32 pid	  = perf_evsel__intval(evsel, sample, "pid");
+	const u32 pid	  = perf_evsel__tp_intval(evsel, sample, "pid");
 	struct work_atoms *atoms;
 	struct work_atom *atom;
 	struct thread *wakee;
@@ -1098,7 +1141,7 @@ static int latency_wakeup_event(struct perf_sched *sched,
 			pr_err("wakeup-event: Internal tree error");
 			goto out_put;
 		}
-		if (add_sched_out_event(atoms, 'S', timestamp))
+		if (add_sched_out_event(sched, atoms, 'S', timestamp))
 			goto out_put;
 	}
 
@@ -1140,7 +1183,7 @@ static int latency_migrate_task_event(struct perf_sched *sched,
 				      struct perf_sample *sample,
 				      struct machine *machine)
 {
-	const u32 pid = perf_evsel__intval(evsel, sample, "pid");
+	const u32 pid = perf_evsel__tp_intval(evsel, sample, "pid");
 	u64 timestamp = sample->time;
 	struct work_atoms *atoms;
 	struct work_atom *atom;
@@ -1166,7 +1209,7 @@ static int latency_migrate_task_event(struct perf_sched *sched,
 			pr_err("migration-event: Internal tree error");
 			goto out_put;
 		}
-		if (add_sched_out_event(atoms, 'R', timestamp))
+		if (add_sched_out_event(sched, atoms, 'R', timestamp))
 			goto out_put;
 	}
 
@@ -1185,6 +1228,14 @@ out_put:
 	return err;
 }
 
+/* percentiles are bucket upper bounds, never report more than the max */
+static double work_atoms__lat_pct_ms(struct work_atoms *atoms, double pct)
+{
+	u64 lat = log_hist__percentile(atoms->lat_hist, pct);
+
+	return (double)min(lat, atoms->max_lat) / 1e6;
+}
+
 static void output_lat_thread(struct perf_sched *sched, struct work_atoms *work_list)
 {
 	int i;
@@ -1212,9 +1263,12 @@ static void output_lat_thread(struct perf_sched *sched, struct work_atoms *work_
 
 	avg = work_list->total_lat / work_list->nb_atoms;
 
-	printf("|%11.3f ms |%9" PRIu64 " | avg:%9.3f ms | max:%9.3f ms | max at: %13.6f s\n",
+	printf("|%11.3f ms |%9" PRIu64 " | avg:%9.3f ms | p50:%9.3f ms | p99:%9.3f ms | p99.9:%9.3f ms | max:%9.3f ms | max at: %13.6f s\n",
 	      (double)work_list->total_runtime / 1e6,
 		 work_list->nb_atoms, (double)avg / 1e6,
+		 work_atoms__lat_pct_ms(work_list, 50),
+		 work_atoms__lat_pct_ms(work_list, 99),
+		 work_atoms__lat_pct_ms(work_list, 99.9),
 		 (double)work_list->max_lat / 1e6,
 		 (double)work_list->max_lat_at / 1e9);
 }
@@ -1261,6 +1315,19 @@ static int max_cmp(struct work_atoms *l, struct work_atoms *r)
 	return 0;
 }
 
+static int p99_cmp(struct work_atoms *l, struct work_atoms *r)
+{
+	u64 p99l = log_hist__percentile(l->lat_hist, 99),
+	    p99r = log_hist__percentile(r->lat_hist, 99);
+
+	if (p99l < p99r)
+		return -1;
+	if (p99l > p99r)
+		return 1;
+
+	return 0;
+}
+
 static int switch_cmp(struct work_atoms *l, struct work_atoms *r)
 {
 	if (l->nb_atoms < r->nb_atoms)
@@ -1292,6 +1359,10 @@ static int sort_dimension__add(const char *tok, struct list_head *list)
 		.name = "max",
 		.cmp  = max_cmp,
 	};
+	static struct sort_dimension p99_sort_dimension = {
+		.name = "p99",
+		.cmp  = p99_cmp,
+	};
 	static struct sort_dimension pid_sort_dimension = {
 		.name = "pid",
 		.cmp  = pid_cmp,
@@ -1308,6 +1379,7 @@ static int sort_dimension__add(const char *tok, struct list_head *list)
 		&pid_sort_dimension,
 		&avg_sort_dimension,
 		&max_sort_dimension,
+		&p99_sort_dimension,
 		&switch_sort_dimension,
 		&runtime_sort_dimension,
 	};
@@ -1392,7 +1464,7 @@ map__findnew_thread(struct perf_sched *sched, struct machine *machine, pid_t pid
 static int map_switch_event(struct perf_sched *sched, struct perf_evsel *evsel,
 			    struct perf_sample *sample, struct machine *machine)
 {
-	const u32 next_pid = perf_evsel__intval(evsel, sample, "next_pid");
+	const u32 next_pid = perf_evsel__tp_intval(evsel, sample, "next_pid");
 	struct thread *sched_in;
 	int new_shortname;
 	u64 timestamp0, timestamp = sample->time;
@@ -1513,6 +1585,261 @@ out:
 	return 0;
 }
 
+/*
+ * 'perf sched timehist': wait time, scheduling delay and run time of every
+ * scheduling slice.  Only the current state of each CPU and of each thread
+ * is kept, so memory use does not depend on the length of the trace.
+ */
+#define TASK_STATE_MAX		2048
+
+struct timehist_cpu {
+	u64		last_switch;
+	u64		idle_time;
+	u64		nr_switches;
+	bool		idle;
+};
+
+static struct timehist_thread *
+timehist__thread(struct perf_sched *sched, struct thread *thread)
+{
+	struct timehist_thread *tr = thread__priv(thread);
+
+	if (tr)
+		return tr;
+
+	tr = zalloc(sizeof(*tr));
+	if (tr == NULL) {
+		pr_err("No memory for the timehist thread state\n");
+		return NULL;
+	}
+
+	tr->thread = thread__get(thread);
+	list_add_tail(&tr->list, &sched->timehist.threads);
+	sched->timehist.nr_threads++;
+	thread__set_priv(thread, tr);
+	return tr;
+}
+
+static char timehist__state(u64 prev_state)
+{
+	const char *str = TASK_STATE_TO_CHAR_STR;
+	int bit = ffs(prev_state & (TASK_STATE_MAX - 1));
+
+	return bit < (int)strlen(str) ? str[bit] : '?';
+}
+
+static bool timehist__show_rows(struct perf_sched *sched, int cpu)
+{
+	return !sched->timehist.summary_only &&
+	       (sched->profile_cpu == -1 || sched->profile_cpu == cpu);
+}
+
+static void timehist__time_str(u64 timestamp, char *buf, size_t size)
+{
+	unsigned long secs = timestamp / NSEC_PER_SEC;
+	unsigned long usecs = (timestamp % NSEC_PER_SEC) / NSEC_PER_USEC;
+
+	scnprintf(buf, size, "%lu.%06lu", secs, usecs);
+}
+
+static void timehist__print_start(u64 timestamp, int cpu)
+{
+	char buf[32];
+
+	timehist__time_str(timestamp, buf, sizeof(buf));
+	printf("%15s [%04d]", buf, cpu);
+}
+
+static void timehist__comm_name(struct thread *thread, char *buf, size_t size)
+{
+	if (thread->pid_ > 0 && thread->pid_ != thread->tid)
+		scnprintf(buf, size, "%s[%d/%d]", thread__comm_str(thread),
+			  thread->tid, thread->pid_);
+	else
+		scnprintf(buf, size, "%s[%d]", thread__comm_str(thread),
+			  thread->tid);
+}
+
+static void timehist__print_comm(struct thread *thread)
+{
+	char buf[64] = "<idle>";
+
+	if (thread)
+		timehist__comm_name(thread, buf, sizeof(buf));
+	printf("  %-30.30s", buf);
+}
+
+static void timehist__print_header(void)
+{
+	printf("%15s %6s  %-30s  %9s  %9s  %9s  %s\n",
+	       "time", "cpu", "task name", "wait time", "sch delay", "run time", "state");
+	printf("%15s %6s  %-30s  %9s  %9s  %9s\n",
+	       "", "", "[tid/pid]", "(msec)", "(msec)", "(msec)");
+	printf("--------------- ------  ------------------------------  ---------  ---------  ---------  -----\n");
+}
+
+static void timehist__print_slice(u64 timestamp, int cpu, struct thread *thread,
+				  u64 dt_wait, u64 dt_delay, u64 dt_run, char state)
+{
+	timehist__print_start(timestamp, cpu);
+	timehist__print_comm(thread);
+	printf("  %9.3f  %9.3f  %9.3f  %5c\n",
+	       (double)dt_wait / NSEC_PER_MSEC, (double)dt_delay / NSEC_PER_MSEC,
+	       (double)dt_run / NSEC_PER_MSEC, state);
+}
+
+static void timehist__sched_out(struct perf_sched *sched, struct timehist_thread *tr,
+				u64 timestamp, int cpu, u64 prev_state)
+{
+	bool seen = tr->last_in != 0;
+	u64 dt_run = timehist_thread__sched_out(tr, timestamp,
+						!(prev_state & (TASK_STATE_MAX - 1)));
+
+	if (seen && timehist__show_rows(sched, cpu))
+		timehist__print_slice(timestamp, cpu, tr->thread, tr->dt_wait,
+				      tr->dt_delay, dt_run,
+				      timehist__state(prev_state));
+}
+
+static struct timehist_thread *
+timehist__findnew(struct perf_sched *sched, struct machine *machine,
+		  pid_t tid, struct thread **threadp)
+{
+	struct thread *thread = machine__findnew_thread(machine, -1, tid);
+	struct timehist_thread *tr;
+
+	if (thread == NULL) {
+		pr_err("problem processing %d event, skipping it.\n", tid);
+		return NULL;
+	}
+
+	tr = timehist__thread(sched, thread);
+	if (threadp)
+		*threadp = thread;
+	else
+		thread__put(thread);
+	return tr;
+}
+
+static void timehist__update_time(struct perf_sched *sched, u64 timestamp)
+{
+	if (!sched->timehist.first_time)
+		sched->timehist.first_time = timestamp;
+	sched->timehist.last_time = timestamp;
+}
+
+static int timehist_switch_event(struct perf_sched *sched,
+				 struct perf_evsel *evsel,
+				 struct perf_sample *sample,
+				 struct machine *machine)
+{
+	const u32 prev_pid = perf_evsel__tp_intval(evsel, sample, "prev_pid"),
+		  next_pid = perf_evsel__tp_intval(evsel, sample, "next_pid");
+	const u64 prev_state = perf_evsel__tp_intval(evsel, sample, "prev_state");
+	u64 timestamp = sample->time;
+	int this_cpu = sample->cpu;
+	struct timehist_thread *tr;
+	struct timehist_cpu *cpu;
+
+	BUG_ON(this_cpu >= MAX_CPUS || this_cpu < 0);
+
+	cpu = &sched->timehist.cpus[this_cpu];
+	timehist__update_time(sched, timestamp);
+
+	/* the idle task has one pid 0 per CPU, account it in the CPU state */
+	if (prev_pid == 0) {
+		if (cpu->idle && cpu->last_switch) {
+			cpu->idle_time += timestamp - cpu->last_switch;
+
+			if (timehist__show_rows(sched, this_cpu))
+				timehist__print_slice(timestamp, this_cpu, NULL, 0, 0,
+						      timestamp - cpu->last_switch, 'I');
+		}
+	} else {
+		tr = timehist__findnew(sched, machine, prev_pid, NULL);
+		if (tr == NULL)
+			return -1;
+		timehist__sched_out(sched, tr, timestamp, this_cpu, prev_state);
+	}
+
+	cpu->idle = next_pid == 0;
+	if (!cpu->idle) {
+		tr = timehist__findnew(sched, machine, next_pid, NULL);
+		if (tr == NULL)
+			return -1;
+		timehist_thread__sched_in(tr, timestamp);
+	}
+
+	cpu->last_switch = timestamp;
+	cpu->nr_switches++;
+	return 0;
+}
+
+static int timehist_wakeup_event(struct perf_sched *sched,
+				 struct perf_evsel *evsel,
+				 struct perf_sample *sample,
+				 struct machine *machine)
+{
+	const u32 pid = perf_evsel__tp_intval(evsel, sample, "pid");
+	struct timehist_thread *tr;
+	struct thread *thread;
+
+	if (pid == 0)
+		return 0;
+
+	timehist__update_time(sched, sample->time);
+
+	tr = timehist__findnew(sched, machine, pid, &thread);
+	if (tr == NULL)
+		return -1;
+
+	timehist_thread__wakeup(tr, sample->time);
+
+	if (sched->timehist.wakeups && timehist__show_rows(sched, sample->cpu)) {
+		struct thread *waker = machine__find_thread(machine, -1, sample->tid);
+
+		timehist__print_start(sample->time, sample->cpu);
+		timehist__print_comm(sample->tid ? waker : NULL);
+		printf("  awakened: %s[%d]\n", thread__comm_str(thread), pid);
+		thread__put(waker);
+	}
+
+	thread__put(thread);
+	return 0;
+}
+
+static int timehist_migrate_task_event(struct perf_sched *sched,
+				       struct perf_evsel *evsel,
+				       struct perf_sample *sample,
+				       struct machine *machine)
+{
+	const u32 pid = perf_evsel__tp_intval(evsel, sample, "pid");
+	const u32 orig_cpu = perf_evsel__tp_intval(evsel, sample, "orig_cpu"),
+		  dest_cpu = perf_evsel__tp_intval(evsel, sample, "dest_cpu");
+	struct timehist_thread *tr;
+	struct thread *thread;
+
+	if (pid == 0)
+		return 0;
+
+	timehist__update_time(sched, sample->time);
+
+	tr = timehist__findnew(sched, machine, pid, &thread);
+	if (tr == NULL)
+		return -1;
+
+	tr->nr_migrations++;
+
+	if (sched->timehist.migrations && timehist__show_rows(sched, sample->cpu)) {
+		timehist__print_start(sample->time, sample->cpu);
+		timehist__print_comm(thread);
+		printf("  migrated: cpu %u => %u\n", orig_cpu, dest_cpu);
+	}
+
+	thread__put(thread);
+	return 0;
+}
+
 static int process_sched_switch_event(struct perf_tool *tool,
 				      struct perf_evsel *evsel,
 				      struct perf_sample *sample,
@@ -1520,8 +1847,8 @@ static int process_sched_switch_event(struct perf_tool *tool,
 {
 	struct perf_sched *sched = container_of(tool, struct perf_sched, tool);
 	int this_cpu = sample->cpu, err = 0;
-	u32 prev_pid = perf_evsel__intval(evsel, sample, "prev_pid"),
-	    next_pid = perf_evsel__intval(evsel, sample, "next_pid");
+	u32 prev_pid = perf_evsel__tp_intval(evsel, sample, "prev_pid"),
+	    next_pid = perf_evsel__tp_intval(evsel, sample, "next_pid");
 
 	if (sched->curr_pid[this_cpu] != (u32)-1) {
 		/*
@@ -1694,6 +2021,8 @@ static void __merge_work_atoms(struct rb_root *root, struct work_atoms *data)
 			this->total_runtime += data->total_runtime;
 			this->nb_atoms += data->nb_atoms;
 			this->total_lat += data->total_lat;
+			log_hist__merge(this->lat_hist, data->lat_hist);
+			zfree(&data->lat_hist);
 			list_splice(&data->work_list, &this->work_list);
 			if (this->max_lat < data->max_lat) {
 				this->max_lat = data->max_lat;
@@ -1736,9 +2065,9 @@ static int perf_sched__lat(struct perf_sched *sched)
 	perf_sched__merge_lat(sched);
 	perf_sched__sort_lat(sched);
 
-	printf("\n -----------------------------------------------------------------------------------------------------------------\n");
-	printf("  Task                  |   Runtime ms  | Switches | Average delay ms | Maximum delay ms | Maximum delay at       |\n");
-	printf(" -----------------------------------------------------------------------------------------------------------------\n");
+	printf("\n -----------------------------------------------------------------------------------------------------------------------------------------------------------------------\n");
+	printf("  Task                  |   Runtime ms  | Switches | Average delay ms | p50 delay ms     | p99 delay ms     | p99.9 delay ms     | Maximum delay ms | Maximum delay at       |\n");
+	printf(" -----------------------------------------------------------------------------------------------------------------------------------------------------------------------\n");
 
 	next = rb_first(&sched->sorted_atom_root);
 
@@ -1751,7 +2080,7 @@ static int perf_sched__lat(struct perf_sched *sched)
 		thread__zput(work_list->thread);
 	}
 
-	printf(" -----------------------------------------------------------------------------------------------------------------\n");
+	printf(" -----------------------------------------------------------------------------------------------------------------------------------------------------------------------\n");
 	printf("  TOTAL:                |%11.3f ms |%9" PRIu64 " |\n",
 		(double)sched->all_runtime / 1e6, sched->all_count);
 
@@ -1875,6 +2204,107 @@ static int perf_sched__replay(struct perf_sched *sched)
 	return 0;
 }
 
+static void timehist__print_summary(struct perf_sched *sched)
+{
+	struct timehist_thread *tr;
+	u64 span = sched->timehist.last_time - sched->timehist.first_time;
+	u64 nr_slices = 0, run_time = 0, nr_switches = 0;
+	int cpu;
+
+	printf("\n Runtime summary\n");
+	printf(" ---------------------------------------------------------------------------------------------------------------------------------------------\n");
+	printf("  %-30s | Slices | Preempted | Run time ms | Wait time ms | Avg delay ms | p99 delay ms | Max delay ms | Max delay at    | Migrations |\n",
+	       "Task [tid/pid]");
+	printf(" ---------------------------------------------------------------------------------------------------------------------------------------------\n");
+
+	list_for_each_entry(tr, &sched->timehist.threads, list) {
+		char buf[64], at[32];
+		u64 p99;
+
+		if (!tr->nr_slices && !tr->delay_hist.count)
+			continue;
+
+		timehist__comm_name(tr->thread, buf, sizeof(buf));
+		timehist__time_str(tr->max_delay_at, at, sizeof(at));
+		p99 = min(log_hist__percentile(&tr->delay_hist, 99), tr->max_delay);
+
+		printf("  %-30.30s |%7" PRIu64 " |%10" PRIu64 " |%12.3f |%13.3f |%13.3f |%13.3f |%13.3f | %15s |%11" PRIu64 " |\n",
+		       buf, tr->nr_slices, tr->nr_preempted,
+		       (double)tr->run_time / NSEC_PER_MSEC,
+		       (double)tr->wait_time / NSEC_PER_MSEC,
+		       tr->delay_hist.count ?
+		       (double)tr->delay_time / tr->delay_hist.count / NSEC_PER_MSEC : 0,
+		       (double)p99 / NSEC_PER_MSEC,
+		       (double)tr->max_delay / NSEC_PER_MSEC,
+		       at,
+		       tr->nr_migrations);
+
+		nr_slices += tr->nr_slices;
+		run_time += tr->run_time;
+	}
+
+	printf(" ---------------------------------------------------------------------------------------------------------------------------------------------\n");
+	printf("  %-30s |%7" PRIu64 " |%10s |%12.3f |\n", "TOTAL:", nr_slices, "",
+	       (double)run_time / NSEC_PER_MSEC);
+
+	printf("\n Idle stats\n");
+	printf(" ---------------------------------------------\n");
+	printf("   CPU | Switches | Idle time ms |    Idle %% |\n");
+	printf(" ---------------------------------------------\n");
+
+	for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+		struct timehist_cpu *c = &sched->timehist.cpus[cpu];
+
+		if (!c->nr_switches)
+			continue;
+
+		printf("  %4d |%9" PRIu64 " |%13.3f |%10.2f |\n", cpu, c->nr_switches,
+		       (double)c->idle_time / NSEC_PER_MSEC,
+		       span ? (double)c->idle_time * 100 / span : 0);
+		nr_switches += c->nr_switches;
+	}
+
+	printf(" ---------------------------------------------\n");
+	printf("\n  Total number of unique tasks: %lu\n", sched->timehist.nr_threads);
+	printf("  Total number of context switches: %" PRIu64 "\n", nr_switches);
+	printf("  Total run time (msec): %.3f\n", (double)run_time / NSEC_PER_MSEC);
+	printf("  Trace duration (msec): %.3f\n", (double)span / NSEC_PER_MSEC);
+}
+
+static int perf_sched__timehist(struct perf_sched *sched)
+{
+	struct timehist_thread *tr, *n;
+	int err = -1;
+
+	sched->timehist.cpus = zalloc(MAX_CPUS * sizeof(*sched->timehist.cpus));
+	if (sched->timehist.cpus == NULL)
+		return -1;
+
+	setup_pager();
+
+	if (!sched->timehist.summary_only)
+		timehist__print_header();
+
+	if (perf_sched__read_events(sched))
+		goto out_free;
+
+	if (sched->timehist.summary || sched->timehist.summary_only)
+		timehist__print_summary(sched);
+
+	print_bad_events(sched);
+	printf("\n");
+	err = 0;
+out_free:
+	list_for_each_entry_safe(tr, n, &sched->timehist.threads, list) {
+		list_del(&tr->list);
+		thread__set_priv(tr->thread, NULL);
+		thread__put(tr->thread);
+		free(tr);
+	}
+	zfree(&sched->timehist.cpus);
+	return err;
+}
+
 static void setup_sorting(struct perf_sched *sched, const struct option *options,
 			  const char * const usage_msg[])
 {
@@ -1955,7 +2385,7 @@ int cmd_sched(int argc, const char **argv, const char *prefix __maybe_unused)
 	};
 	const struct option latency_options[] = {
 	OPT_STRING('s', "sort", &sched.sort_order, "key[,key2...]",
-		   "sort by key(s): runtime, switch, avg, max"),
+		   "sort by key(s): runtime, switch, avg, p99, max"),
 	OPT_INCR('v', "verbose", &verbose,
 		    "be more verbose (show symbol address, etc)"),
 	OPT_INTEGER('C', "CPU", &sched.profile_cpu,
@@ -1964,6 +2394,8 @@ int cmd_sched(int argc, const char **argv, const char *prefix __maybe_unused)
 		    "dump raw trace in ASCII"),
 	OPT_BOOLEAN('p', "pids", &sched.skip_merge,
 		    "latency stats per pid instead of per comm"),
+	OPT_BOOLEAN(0, "keep-atoms", &sched.keep_atoms,
+		    "keep every scheduling atom in memory instead of just the latency histograms"),
 	OPT_END()
 	};
 	const struct option replay_options[] = {
@@ -2004,12 +2436,31 @@ int cmd_sched(int argc, const char **argv, const char *prefix __maybe_unused)
 		"perf sched replay [<options>]",
 		NULL
 	};
+	const struct option timehist_options[] = {
+	OPT_BOOLEAN('s', "summary", &sched.timehist.summary_only,
+		    "Show only the summary tables, no per slice rows"),
+	OPT_BOOLEAN('S', "with-summary", &sched.timehist.summary,
+		    "Show the summary tables after the per slice rows"),
+	OPT_BOOLEAN('w', "wakeups", &sched.timehist.wakeups,
+		    "Show wakeup events"),
+	OPT_BOOLEAN('M', "migrations", &sched.timehist.migrations,
+		    "Show migration events"),
+	OPT_INTEGER('C', "CPU", &sched.profile_cpu,
+		    "Only show the rows of this CPU"),
+	OPT_BOOLEAN('f', "force", &sched.force, "don't complain, do it"),
+	OPT_END()
+	};
 	const char * const map_usage[] = {
 		"perf sched map [<options>]",
 		NULL
 	};
+	const char * const timehist_usage[] = {
+		"perf sched timehist [<options>]",
+		NULL
+	};
 	const char *const sched_subcommands[] = { "record", "latency", "map",
-						  "replay", "script", NULL };
+						  "replay", "script", "timehist",
+						  NULL };
 	const char *sched_usage[] = {
 		NULL,
 		NULL
@@ -2028,6 +2479,11 @@ int cmd_sched(int argc, const char **argv, const char *prefix __maybe_unused)
 		.switch_event	    = replay_switch_event,
 		.fork_event	    = replay_fork_event,
 	};
+	struct trace_sched_handler timehist_ops  = {
+		.wakeup_event	    = timehist_wakeup_event,
+		.switch_event	    = timehist_switch_event,
+		.migrate_task_event = timehist_migrate_task_event,
+	};
 	unsigned int i;
 
 	for (i = 0; i < ARRAY_SIZE(sched.curr_pid); i++)
@@ -2072,6 +2528,16 @@ int cmd_sched(int argc, const char **argv, const char *prefix __maybe_unused)
 				usage_with_options(replay_usage, replay_options);
 		}
 		return perf_sched__replay(&sched);
+	} else if (!strcmp(argv[0], "timehist")) {
+		if (argc) {
+			argc = parse_options(argc, argv, timehist_options,
+					     timehist_usage, 0);
+			if (argc)
+				usage_with_options(timehist_usage, timehist_options);
+		}
+		sched.tp_handler = &timehist_ops;
+		INIT_LIST_HEAD(&sched.timehist.threads);
+		return perf_sched__timehist(&sched);
 	} else {
 		usage_with_options(sched_usage, sched_options);
 	}
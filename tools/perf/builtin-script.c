@@ -26,6 +26,7 @@
 #include <linux/stringify.h>
 #include "asm/bug.h"
 #include "util/mem-events.h"
+#include "util/folded-stacks.h"
 
 static char const		*script_name;
 static char const		*generate_script_lang;
@@ -40,6 +41,9 @@ static bool			nanosecs;
 static const char		*cpu_list;
 static DECLARE_BITMAP(cpu_bitmap, MAX_NR_CPUS);
 static struct perf_stat_config	stat_config;
+static bool			folded;
+static const char		*flamegraph_file;
+static struct folded_stacks	*folded_stacks;
 
 unsigned int scripting_max_stack = PERF_MAX_STACK_DEPTH;
 
@@ -1014,6 +1018,16 @@ static int process_sample_event(struct perf_tool *tool,
 	if (cpu_list && !test_bit(sample->cpu, cpu_bitmap))
 		goto out_put;
 
+	if (folded_stacks) {
+		if (folded_stacks__add_sample(folded_stacks, evsel, sample, &al,
+					      scripting_max_stack)) {
+			pr_err("Not enough memory to fold the callchains\n");
+			addr_location__put(&al);
+			return -ENOMEM;
+		}
+		goto out_put;
+	}
+
 	if (scripting_ops)
 		scripting_ops->process_event(event, sample, evsel, &al);
 	else
@@ -1273,6 +1287,34 @@ static int __cmd_script(struct perf_script *script)
 	return ret;
 }
 
+static int folded_stacks__output(struct perf_script *script)
+{
+	char title[PATH_MAX + 32];
+	FILE *fp;
+	int ret;
+
+	if (!flamegraph_file)
+		return folded_stacks__fprintf(folded_stacks, stdout);
+
+	fp = fopen(flamegraph_file, "w");
+	if (fp == NULL) {
+		pr_err("Failed to open %s: %s\n", flamegraph_file,
+		       strerror(errno));
+		return -errno;
+	}
+
+	scnprintf(title, sizeof(title), "Flame Graph of %s",
+		  perf_data_file__is_pipe(script->session->file) ?
+		  "standard input" : script->session->file->path);
+	ret = folded_stacks__fprintf_svg(folded_stacks, fp, title);
+	if (fclose(fp) && !ret)
+		ret = -errno;
+	if (ret)
+		pr_err("Failed to write %s\n", flamegraph_file);
+
+	return ret;
+}
+
 struct script_spec {
 	struct list_head	node;
 	struct scripting_ops	*ops;
@@ -2139,6 +2181,10 @@ int cmd_script(int argc, const char **argv, const char *prefix __maybe_unused)
 		     "Set the maximum stack depth when parsing the callchain, "
 		     "anything beyond the specified depth will be ignored. "
 		     "Default: kernel.perf_event_max_stack or " __stringify(PERF_MAX_STACK_DEPTH)),
+	OPT_BOOLEAN(0, "folded", &folded,
+		    "print the callchains folded and aggregated, one stack per line, for flame graphs"),
+	OPT_STRING(0, "flamegraph", &flamegraph_file, "file",
+		   "write a flame graph of the callchains to an SVG file"),
 	OPT_BOOLEAN('I', "show-info", &show_full_info,
 		    "display extended information from perf.data file"),
 	OPT_BOOLEAN('\0', "show-kernel-path", &symbol_conf.show_kernel_path,
@@ -2179,6 +2225,10 @@ int cmd_script(int argc, const char **argv, const char *prefix __maybe_unused)
 	argc = parse_options_subcommand(argc, argv, options, script_subcommands, script_usage,
 			     PARSE_OPT_STOP_AT_NON_OPTION);
 
+	if (folded && flamegraph_file)
+		usage_with_options_msg(script_usage, options,
+			"--folded and --flamegraph are mutually exclusive.\n");
+
 	file.path = input_name;
 
 	if (argc > 1 && !strncmp(argv[0], "rec", strlen("rec"))) {
@@ -2440,8 +2490,29 @@ int cmd_script(int argc, const char **argv, const char *prefix __maybe_unused)
 	if (err < 0)
 		goto out_delete;
 
+	if (folded || flamegraph_file) {
+		if (script_name) {
+			pr_err("--folded and --flamegraph can't be used with scripts\n");
+			err = -EINVAL;
+			goto out_delete;
+		}
+
+		folded_stacks = folded_stacks__new();
+		if (!folded_stacks) {
+			err = -ENOMEM;
+			goto out_delete;
+		}
+	}
+
 	err = __cmd_script(&script);
 
+	if (folded_stacks) {
+		if (!err)
+			err = folded_stacks__output(&script);
+		folded_stacks__delete(folded_stacks);
+		folded_stacks = NULL;
+	}
+
 	flush_scripting();
 
 out_delete:
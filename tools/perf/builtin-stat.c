@@ -54,6 +54,7 @@
 #include "util/debug.h"
 #include "util/color.h"
 #include "util/stat.h"
+#include "util/stat-stream.h"
 #include "util/header.h"
 #include "util/cpumap.h"
 #include "util/thread.h"
@@ -144,6 +145,9 @@ static aggr_get_id_t		aggr_get_id;
 static bool			append_file;
 static const char		*output_name;
 static int			output_fd;
+static const char		*stream_name;
+static unsigned int		stream_ring;
+static struct stat_stream	*stat_stream;
 
 struct perf_stat {
 	bool			 record;
@@ -318,6 +322,15 @@ static int read_counter(struct perf_evsel *counter)
 				}
 			}
 
+			if (stat_stream &&
+			    stat_stream__write(stat_stream, counter->idx,
+					       target__has_cpu(&target) ?
+					       perf_evsel__cpus(counter)->map[cpu] : -1,
+					       counter->system_wide ?
+					       -1 : thread_map__pid(counter->threads, thread),
+					       count))
+				return -1;
+
 			if (verbose > 1) {
 				fprintf(stat_config.output,
 					"%s: %d: %" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
@@ -335,6 +348,14 @@ static void read_counters(void)
 {
 	struct perf_evsel *counter;
 
+	if (stat_stream) {
+		struct timespec ts, rs;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		diff_timespec(&rs, &ts, &ref_time);
+		stat_stream__begin(stat_stream, rs.tv_sec * NSECS_PER_SEC + rs.tv_nsec);
+	}
+
 	evlist__for_each_entry(evsel_list, counter) {
 		if (read_counter(counter))
 			pr_debug("failed to read counter %s\n", counter->name);
@@ -342,6 +363,9 @@ static void read_counters(void)
 		if (perf_stat_process_counter(&stat_config, counter))
 			pr_warning("failed to process counter %s\n", counter->name);
 	}
+
+	if (stat_stream && stat_stream__end(stat_stream))
+		pr_err("failed to write stat stream\n");
 }
 
 static void process_interval(void)
@@ -1629,6 +1653,10 @@ static const struct option stat_options[] = {
 		     "monitor event in cgroup name only", parse_cgroups),
 	OPT_STRING('o', "output", &output_name, "file", "output file name"),
 	OPT_BOOLEAN(0, "append", &append_file, "append to the output file"),
+	OPT_STRING(0, "stream", &stream_name, "file",
+		   "stream raw counter values in binary form to file ('-' for stdout)"),
+	OPT_UINTEGER(0, "stream-ring", &stream_ring,
+		     "write the --stream output to a mmapable ring file of N records"),
 	OPT_INTEGER(0, "log-fd", &output_fd,
 		    "log output to fd, instead of stderr"),
 	OPT_STRING(0, "pre", &pre_cmd, "command",
@@ -2392,6 +2420,12 @@ int cmd_stat(int argc, const char **argv, const char *prefix __maybe_unused)
 		goto out;
 	}
 
+	if (stream_ring && (!stream_name || !strcmp(stream_name, "-"))) {
+		fprintf(stderr, "--stream-ring needs a --stream file to map\n");
+		parse_options_usage(stat_usage, stat_options, "stream-ring", 0);
+		goto out;
+	}
+
 	if (output_fd < 0) {
 		fprintf(stderr, "argument to --log-fd must be a > 0\n");
 		parse_options_usage(stat_usage, stat_options, "log-fd", 0);
@@ -2510,6 +2544,12 @@ int cmd_stat(int argc, const char **argv, const char *prefix __maybe_unused)
 	if (perf_evlist__alloc_stats(evsel_list, interval))
 		goto out;
 
+	if (stream_name) {
+		stat_stream = stat_stream__new(stream_name, stream_ring, evsel_list);
+		if (stat_stream == NULL)
+			goto out;
+	}
+
 	if (perf_stat_init_aggr_mode())
 		goto out;
 
@@ -2580,6 +2620,7 @@ int cmd_stat(int argc, const char **argv, const char *prefix __maybe_unused)
 	perf_stat__exit_aggr_mode();
 	perf_evlist__free_stats(evsel_list);
 out:
+	stat_stream__delete(stat_stream);
 	perf_evlist__delete(evsel_list);
 	return status;
 }
@@ -35,6 +35,7 @@
 #include "util/event.h"
 #include "util/session.h"
 #include "util/svghelper.h"
+#include "util/time-bins.h"
 #include "util/tool.h"
 #include "util/data.h"
 #include "util/debug.h"
@@ -68,12 +69,19 @@ struct timechart {
 	u64			io_events;
 	u64			min_time,
 				merge_dist;
+	/* merge scheduling samples, C states and wakeups closer than this */
+	u64			resolution;
 };
 
 struct per_pidcomm;
 struct cpu_sample;
 struct io_sample;
 
+#define TYPE_NONE	0
+#define TYPE_RUNNING	1
+#define TYPE_WAITING	2
+#define TYPE_BLOCKED	3
+
 /*
  * Datastructure layout:
  * We keep an list of "pid"s, matching the kernels notion of a task struct.
@@ -98,6 +106,8 @@ struct per_pid {
 
 	struct per_pidcomm *all;
 	struct per_pidcomm *current;
+
+	struct time_bin	wake_bin;	/* for --resolution */
 };
 
 
@@ -119,6 +129,7 @@ struct per_pidcomm {
 	char		*comm;
 
 	struct cpu_sample *samples;
+	struct time_bin	bin;	/* for --resolution */
 	struct io_sample  *io_samples;
 };
 
@@ -129,19 +140,16 @@ struct sample_wrapper {
 	unsigned char	data[0];
 };
 
-#define TYPE_NONE	0
-#define TYPE_RUNNING	1
-#define TYPE_WAITING	2
-#define TYPE_BLOCKED	3
-
 struct cpu_sample {
 	struct cpu_sample *next;
 
 	u64 start_time;
 	u64 end_time;
+	u64 busy;	/* < end_time - start_time when merged */
 	int type;
 	int cpu;
 	const char *backtrace;
+	struct time_bin_entry bin_entry;
 };
 
 enum {
@@ -174,7 +182,9 @@ struct power_event {
 	int state;
 	u64 start_time;
 	u64 end_time;
+	u64 busy;	/* C states, < end_time - start_time when merged */
 	int cpu;
+	struct time_bin_entry bin_entry;
 };
 
 struct wake_event {
@@ -183,6 +193,7 @@ struct wake_event {
 	int wakee;
 	u64 time;
 	const char *backtrace;
+	struct time_bin_entry bin_entry;
 };
 
 struct process_filter {
@@ -269,6 +280,8 @@ static void pid_put_sample(struct timechart *tchart, int pid, int type,
 	struct per_pid *p;
 	struct per_pidcomm *c;
 	struct cpu_sample *sample;
+	struct time_bin_entry *entry;
+	int key = cpu * (TYPE_BLOCKED + 1) + type;
 
 	p = find_create_pid(tchart, pid);
 	c = p->current;
@@ -280,15 +293,29 @@ static void pid_put_sample(struct timechart *tchart, int pid, int type,
 		p->all = c;
 	}
 
-	sample = zalloc(sizeof(*sample));
-	assert(sample != NULL);
-	sample->start_time = start;
-	sample->end_time = end;
-	sample->type = type;
-	sample->next = c->samples;
-	sample->cpu = cpu;
-	sample->backtrace = backtrace;
-	c->samples = sample;
+	/* with --resolution, one sample per state, CPU and time bin */
+	entry = time_bin__find(&c->bin, key, end, tchart->resolution);
+	if (entry) {
+		sample = container_of(entry, struct cpu_sample, bin_entry);
+		if (start < sample->start_time)
+			sample->start_time = start;
+		if (end > sample->end_time)
+			sample->end_time = end;
+		sample->busy += end - start;
+	} else {
+		sample = zalloc(sizeof(*sample));
+		assert(sample != NULL);
+		sample->start_time = start;
+		sample->end_time = end;
+		sample->busy = end - start;
+		sample->type = type;
+		sample->next = c->samples;
+		sample->cpu = cpu;
+		sample->backtrace = backtrace;
+		c->samples = sample;
+		time_bin__add(&c->bin, &sample->bin_entry, key, end,
+			      tchart->resolution);
+	}
 
 	if (sample->type == TYPE_RUNNING && end > start && start > 0) {
 		c->total_time += (end-start);
@@ -348,21 +375,42 @@ static void c_state_start(int cpu, u64 timestamp, int state)
 	cpus_cstate_state[cpu] = state;
 }
 
+static struct time_bin cpus_cstate_bin[MAX_CPUS];
+
 static void c_state_end(struct timechart *tchart, int cpu, u64 timestamp)
 {
-	struct power_event *pwr = zalloc(sizeof(*pwr));
+	u64 start = cpus_cstate_start_times[cpu];
+	struct time_bin_entry *entry;
+	struct power_event *pwr;
+
+	/* with --resolution, one C state period per CPU and time bin */
+	entry = time_bin__find(&cpus_cstate_bin[cpu], 0, timestamp,
+			       tchart->resolution);
+	if (entry) {
+		pwr = container_of(entry, struct power_event, bin_entry);
+		/* show the deepest state of the bin */
+		if (cpus_cstate_state[cpu] > pwr->state)
+			pwr->state = cpus_cstate_state[cpu];
+		pwr->end_time = timestamp;
+		pwr->busy += timestamp - start;
+		return;
+	}
 
+	pwr = zalloc(sizeof(*pwr));
 	if (!pwr)
 		return;
 
 	pwr->state = cpus_cstate_state[cpu];
-	pwr->start_time = cpus_cstate_start_times[cpu];
+	pwr->start_time = start;
 	pwr->end_time = timestamp;
+	pwr->busy = timestamp - start;
 	pwr->cpu = cpu;
 	pwr->type = CSTATE;
 	pwr->next = tchart->power_events;
 
 	tchart->power_events = pwr;
+	time_bin__add(&cpus_cstate_bin[cpu], &pwr->bin_entry, 0, timestamp,
+		      tchart->resolution);
 }
 
 static void p_state_change(struct timechart *tchart, int cpu, u64 timestamp, u64 new_freq)
@@ -405,22 +453,30 @@ static void sched_wakeup(struct timechart *tchart, int cpu, u64 timestamp,
 			 int waker, int wakee, u8 flags, const char *backtrace)
 {
 	struct per_pid *p;
-	struct wake_event *we = zalloc(sizeof(*we));
+	struct wake_event *we;
 
+	if ((flags & TRACE_FLAG_HARDIRQ) || (flags & TRACE_FLAG_SOFTIRQ))
+		waker = -1;
+
+	p = find_create_pid(tchart, wakee);
+
+	/* with --resolution, one wakeline per waker, wakee and time bin */
+	if (time_bin__find(&p->wake_bin, waker, timestamp, tchart->resolution))
+		goto out_state;
+
+	we = zalloc(sizeof(*we));
 	if (!we)
 		return;
 
 	we->time = timestamp;
 	we->waker = waker;
 	we->backtrace = backtrace;
-
-	if ((flags & TRACE_FLAG_HARDIRQ) || (flags & TRACE_FLAG_SOFTIRQ))
-		we->waker = -1;
-
 	we->wakee = wakee;
 	we->next = tchart->wake_events;
 	tchart->wake_events = we;
-	p = find_create_pid(tchart, we->wakee);
+	time_bin__add(&p->wake_bin, &we->bin_entry, waker, timestamp,
+		      tchart->resolution);
+out_state:
 
 	if (p && p->current && p->current->state == TYPE_NONE) {
 		p->current->state_since = timestamp;
@@ -581,8 +637,8 @@ process_sample_cpu_idle(struct timechart *tchart __maybe_unused,
 			struct perf_sample *sample,
 			const char *backtrace __maybe_unused)
 {
-	u32 state = perf_evsel__intval(evsel, sample, "state");
-	u32 cpu_id = perf_evsel__intval(evsel, sample, "cpu_id");
+	u32 state = perf_evsel__tp_intval(evsel, sample, "state");
+	u32 cpu_id = perf_evsel__tp_intval(evsel, sample, "cpu_id");
 
 	if (state == (u32)PWR_EVENT_EXIT)
 		c_state_end(tchart, cpu_id, sample->time);
@@ -597,8 +653,8 @@ process_sample_cpu_frequency(struct timechart *tchart,
 			     struct perf_sample *sample,
 			     const char *backtrace __maybe_unused)
 {
-	u32 state = perf_evsel__intval(evsel, sample, "state");
-	u32 cpu_id = perf_evsel__intval(evsel, sample, "cpu_id");
+	u32 state = perf_evsel__tp_intval(evsel, sample, "state");
+	u32 cpu_id = perf_evsel__tp_intval(evsel, sample, "cpu_id");
 
 	p_state_change(tchart, cpu_id, sample->time, state);
 	return 0;
@@ -610,9 +666,9 @@ process_sample_sched_wakeup(struct timechart *tchart,
 			    struct perf_sample *sample,
 			    const char *backtrace)
 {
-	u8 flags = perf_evsel__intval(evsel, sample, "common_flags");
-	int waker = perf_evsel__intval(evsel, sample, "common_pid");
-	int wakee = perf_evsel__intval(evsel, sample, "pid");
+	u8 flags = perf_evsel__tp_intval(evsel, sample, "common_flags");
+	int waker = perf_evsel__tp_intval(evsel, sample, "common_pid");
+	int wakee = perf_evsel__tp_intval(evsel, sample, "pid");
 
 	sched_wakeup(tchart, sample->cpu, sample->time, waker, wakee, flags, backtrace);
 	return 0;
@@ -624,9 +680,9 @@ process_sample_sched_switch(struct timechart *tchart,
 			    struct perf_sample *sample,
 			    const char *backtrace)
 {
-	int prev_pid = perf_evsel__intval(evsel, sample, "prev_pid");
-	int next_pid = perf_evsel__intval(evsel, sample, "next_pid");
-	u64 prev_state = perf_evsel__intval(evsel, sample, "prev_state");
+	int prev_pid = perf_evsel__tp_intval(evsel, sample, "prev_pid");
+	int next_pid = perf_evsel__tp_intval(evsel, sample, "next_pid");
+	u64 prev_state = perf_evsel__tp_intval(evsel, sample, "prev_state");
 
 	sched_switch(tchart, sample->cpu, sample->time, prev_pid, next_pid,
 		     prev_state, backtrace);
@@ -640,8 +696,8 @@ process_sample_power_start(struct timechart *tchart __maybe_unused,
 			   struct perf_sample *sample,
 			   const char *backtrace __maybe_unused)
 {
-	u64 cpu_id = perf_evsel__intval(evsel, sample, "cpu_id");
-	u64 value = perf_evsel__intval(evsel, sample, "value");
+	u64 cpu_id = perf_evsel__tp_intval(evsel, sample, "cpu_id");
+	u64 value = perf_evsel__tp_intval(evsel, sample, "value");
 
 	c_state_start(cpu_id, sample->time, value);
 	return 0;
@@ -663,8 +719,8 @@ process_sample_power_frequency(struct timechart *tchart,
 			       struct perf_sample *sample,
 			       const char *backtrace __maybe_unused)
 {
-	u64 cpu_id = perf_evsel__intval(evsel, sample, "cpu_id");
-	u64 value = perf_evsel__intval(evsel, sample, "value");
+	u64 cpu_id = perf_evsel__tp_intval(evsel, sample, "cpu_id");
+	u64 value = perf_evsel__tp_intval(evsel, sample, "value");
 
 	p_state_change(tchart, cpu_id, sample->time, value);
 	return 0;
@@ -845,7 +901,7 @@ process_enter_read(struct timechart *tchart,
 		   struct perf_evsel *evsel,
 		   struct perf_sample *sample)
 {
-	long fd = perf_evsel__intval(evsel, sample, "fd");
+	long fd = perf_evsel__tp_intval(evsel, sample, "fd");
 	return pid_begin_io_sample(tchart, sample->tid, IOTYPE_READ,
 				   sample->time, fd);
 }
@@ -855,7 +911,7 @@ process_exit_read(struct timechart *tchart,
 		  struct perf_evsel *evsel,
 		  struct perf_sample *sample)
 {
-	long ret = perf_evsel__intval(evsel, sample, "ret");
+	long ret = perf_evsel__tp_intval(evsel, sample, "ret");
 	return pid_end_io_sample(tchart, sample->tid, IOTYPE_READ,
 				 sample->time, ret);
 }
@@ -865,7 +921,7 @@ process_enter_write(struct timechart *tchart,
 		    struct perf_evsel *evsel,
 		    struct perf_sample *sample)
 {
-	long fd = perf_evsel__intval(evsel, sample, "fd");
+	long fd = perf_evsel__tp_intval(evsel, sample, "fd");
 	return pid_begin_io_sample(tchart, sample->tid, IOTYPE_WRITE,
 				   sample->time, fd);
 }
@@ -875,7 +931,7 @@ process_exit_write(struct timechart *tchart,
 		   struct perf_evsel *evsel,
 		   struct perf_sample *sample)
 {
-	long ret = perf_evsel__intval(evsel, sample, "ret");
+	long ret = perf_evsel__tp_intval(evsel, sample, "ret");
 	return pid_end_io_sample(tchart, sample->tid, IOTYPE_WRITE,
 				 sample->time, ret);
 }
@@ -885,7 +941,7 @@ process_enter_sync(struct timechart *tchart,
 		   struct perf_evsel *evsel,
 		   struct perf_sample *sample)
 {
-	long fd = perf_evsel__intval(evsel, sample, "fd");
+	long fd = perf_evsel__tp_intval(evsel, sample, "fd");
 	return pid_begin_io_sample(tchart, sample->tid, IOTYPE_SYNC,
 				   sample->time, fd);
 }
@@ -895,7 +951,7 @@ process_exit_sync(struct timechart *tchart,
 		  struct perf_evsel *evsel,
 		  struct perf_sample *sample)
 {
-	long ret = perf_evsel__intval(evsel, sample, "ret");
+	long ret = perf_evsel__tp_intval(evsel, sample, "ret");
 	return pid_end_io_sample(tchart, sample->tid, IOTYPE_SYNC,
 				 sample->time, ret);
 }
@@ -905,7 +961,7 @@ process_enter_tx(struct timechart *tchart,
 		 struct perf_evsel *evsel,
 		 struct perf_sample *sample)
 {
-	long fd = perf_evsel__intval(evsel, sample, "fd");
+	long fd = perf_evsel__tp_intval(evsel, sample, "fd");
 	return pid_begin_io_sample(tchart, sample->tid, IOTYPE_TX,
 				   sample->time, fd);
 }
@@ -915,7 +971,7 @@ process_exit_tx(struct timechart *tchart,
 		struct perf_evsel *evsel,
 		struct perf_sample *sample)
 {
-	long ret = perf_evsel__intval(evsel, sample, "ret");
+	long ret = perf_evsel__tp_intval(evsel, sample, "ret");
 	return pid_end_io_sample(tchart, sample->tid, IOTYPE_TX,
 				 sample->time, ret);
 }
@@ -925,7 +981,7 @@ process_enter_rx(struct timechart *tchart,
 		 struct perf_evsel *evsel,
 		 struct perf_sample *sample)
 {
-	long fd = perf_evsel__intval(evsel, sample, "fd");
+	long fd = perf_evsel__tp_intval(evsel, sample, "fd");
 	return pid_begin_io_sample(tchart, sample->tid, IOTYPE_RX,
 				   sample->time, fd);
 }
@@ -935,7 +991,7 @@ process_exit_rx(struct timechart *tchart,
 		struct perf_evsel *evsel,
 		struct perf_sample *sample)
 {
-	long ret = perf_evsel__intval(evsel, sample, "ret");
+	long ret = perf_evsel__tp_intval(evsel, sample, "ret");
 	return pid_end_io_sample(tchart, sample->tid, IOTYPE_RX,
 				 sample->time, ret);
 }
@@ -945,7 +1001,7 @@ process_enter_poll(struct timechart *tchart,
 		   struct perf_evsel *evsel,
 		   struct perf_sample *sample)
 {
-	long fd = perf_evsel__intval(evsel, sample, "fd");
+	long fd = perf_evsel__tp_intval(evsel, sample, "fd");
 	return pid_begin_io_sample(tchart, sample->tid, IOTYPE_POLL,
 				   sample->time, fd);
 }
@@ -955,7 +1011,7 @@ process_exit_poll(struct timechart *tchart,
 		  struct perf_evsel *evsel,
 		  struct perf_sample *sample)
 {
-	long ret = perf_evsel__intval(evsel, sample, "ret");
+	long ret = perf_evsel__tp_intval(evsel, sample, "ret");
 	return pid_end_io_sample(tchart, sample->tid, IOTYPE_POLL,
 				 sample->time, ret);
 }
@@ -1019,7 +1075,8 @@ static void draw_c_p_states(struct timechart *tchart)
 	 */
 	while (pwr) {
 		if (pwr->type == CSTATE)
-			svg_cstate(pwr->cpu, pwr->start_time, pwr->end_time, pwr->state);
+			svg_cstate(pwr->cpu, pwr->start_time, pwr->end_time,
+				   pwr->busy, pwr->state);
 		pwr = pwr->next;
 	}
 
@@ -1117,6 +1174,7 @@ static void draw_cpu_usage(struct timechart *tchart)
 					svg_process(sample->cpu,
 						    sample->start_time,
 						    sample->end_time,
+						    sample->busy,
 						    p->pid,
 						    c->comm,
 						    sample->backtrace);
@@ -1271,16 +1329,19 @@ static void draw_process_bars(struct timechart *tchart)
 					svg_running(Y, sample->cpu,
 						    sample->start_time,
 						    sample->end_time,
+						    sample->busy,
 						    sample->backtrace);
 				if (sample->type == TYPE_BLOCKED)
 					svg_blocked(Y, sample->cpu,
 						    sample->start_time,
 						    sample->end_time,
+						    sample->busy,
 						    sample->backtrace);
 				if (sample->type == TYPE_WAITING)
 					svg_waiting(Y, sample->cpu,
 						    sample->start_time,
 						    sample->end_time,
+						    sample->busy,
 						    sample->backtrace);
 				sample = sample->next;
 			}
@@ -1960,6 +2021,9 @@ int cmd_timechart(int argc, const char **argv,
 	OPT_CALLBACK(0, "io-merge-dist", &tchart.merge_dist, "time",
 		     "merge events that are merge-dist us apart",
 		     parse_time),
+	OPT_CALLBACK(0, "resolution", &tchart.resolution, "time",
+		     "merge scheduling samples, C states and wakeups closer than this",
+		     parse_time),
 	OPT_BOOLEAN('f', "force", &tchart.force, "don't complain, do it"),
 	OPT_END()
 	};
@@ -34,6 +34,7 @@
 #include "trace-event.h"
 #include "util/parse-events.h"
 #include "util/bpf-loader.h"
+#include "util/bpf-trace-summary.h"
 #include "callchain.h"
 #include "syscalltbl.h"
 #include "rb_resort.h"
@@ -87,6 +88,7 @@ struct trace {
 	} stats;
 	unsigned int		max_stack;
 	unsigned int		min_stack;
+	unsigned int		bpf_summary_interval;
 	bool			not_ev_qualifier;
 	bool			live;
 	bool			full_time;
@@ -94,6 +96,7 @@ struct trace {
 	bool			multiple_threads;
 	bool			summary;
 	bool			summary_only;
+	bool			bpf_summary;
 	bool			show_comm;
 	bool			show_tool_stats;
 	bool			trace_syscalls;
@@ -808,15 +811,25 @@ static struct syscall_fmt *syscall_fmt__find(const char *name)
 	return bsearch(name, syscall_fmts, nmemb, sizeof(struct syscall_fmt), syscall_fmt__cmp);
 }
 
+/*
+ * Per argument formatting, resolved once from the tracepoint format fields
+ * and syscall_fmts[] so that formatting a syscall just walks an array.
+ */
+struct syscall_arg_fmt {
+	size_t	   (*scnprintf)(char *bf, size_t size, struct syscall_arg *arg);
+	void	   *parm;
+	const char *name;
+	bool	   show_zero;
+};
+
 struct syscall {
-	struct event_format *tp_format;
-	int		    nr_args;
-	struct format_field *args;
-	const char	    *name;
-	bool		    is_exit;
-	struct syscall_fmt  *fmt;
-	size_t		    (**arg_scnprintf)(char *bf, size_t size, struct syscall_arg *arg);
-	void		    **arg_parm;
+	struct event_format    *tp_format;
+	int		       nr_args;
+	struct format_field    *args;
+	const char	       *name;
+	bool		       is_exit;
+	struct syscall_fmt     *fmt;
+	struct syscall_arg_fmt *arg_fmt;
 };
 
 static size_t fprintf_duration(unsigned long t, FILE *fp)
@@ -1130,29 +1143,32 @@ static int trace__symbols_init(struct trace *trace, struct perf_evlist *evlist)
 static int syscall__set_arg_fmts(struct syscall *sc)
 {
 	struct format_field *field;
+	struct syscall_arg_fmt *arg_fmt;
 	int idx = 0, len;
 
-	sc->arg_scnprintf = calloc(sc->nr_args, sizeof(void *));
-	if (sc->arg_scnprintf == NULL)
+	sc->arg_fmt = calloc(sc->nr_args, sizeof(*sc->arg_fmt));
+	if (sc->arg_fmt == NULL)
 		return -1;
 
-	if (sc->fmt)
-		sc->arg_parm = sc->fmt->arg_parm;
+	for (field = sc->args; field; field = field->next, ++idx) {
+		arg_fmt = &sc->arg_fmt[idx];
+		arg_fmt->name = field->name;
 
-	for (field = sc->args; field; field = field->next) {
-		if (sc->fmt && sc->fmt->arg_scnprintf[idx])
-			sc->arg_scnprintf[idx] = sc->fmt->arg_scnprintf[idx];
-		else if (strcmp(field->type, "const char *") == 0 &&
+		if (sc->fmt && idx < (int)ARRAY_SIZE(sc->fmt->arg_scnprintf) &&
+		    sc->fmt->arg_scnprintf[idx]) {
+			arg_fmt->scnprintf = sc->fmt->arg_scnprintf[idx];
+			arg_fmt->parm	   = sc->fmt->arg_parm[idx];
+		} else if (strcmp(field->type, "const char *") == 0 &&
 			 (strcmp(field->name, "filename") == 0 ||
 			  strcmp(field->name, "path") == 0 ||
 			  strcmp(field->name, "pathname") == 0))
-			sc->arg_scnprintf[idx] = SCA_FILENAME;
+			arg_fmt->scnprintf = SCA_FILENAME;
 		else if (field->flags & FIELD_IS_POINTER)
-			sc->arg_scnprintf[idx] = syscall_arg__scnprintf_hex;
+			arg_fmt->scnprintf = syscall_arg__scnprintf_hex;
 		else if (strcmp(field->type, "pid_t") == 0)
-			sc->arg_scnprintf[idx] = SCA_PID;
+			arg_fmt->scnprintf = SCA_PID;
 		else if (strcmp(field->type, "umode_t") == 0)
-			sc->arg_scnprintf[idx] = SCA_MODE_T;
+			arg_fmt->scnprintf = SCA_MODE_T;
 		else if ((strcmp(field->type, "int") == 0 ||
 			  strcmp(field->type, "unsigned int") == 0 ||
 			  strcmp(field->type, "long") == 0) &&
@@ -1165,9 +1181,15 @@ static int syscall__set_arg_fmts(struct syscall *sc)
 			 * 23 unsigned int
 			 * 7 unsigned long
 			 */
-			sc->arg_scnprintf[idx] = SCA_FD;
+			arg_fmt->scnprintf = SCA_FD;
 		}
-		++idx;
+
+		/*
+		 * Zero values are suppressed unless there is a string
+		 * associated to it in a strarray.
+		 */
+		arg_fmt->show_zero = arg_fmt->scnprintf == SCA_STRARRAY &&
+				     arg_fmt->parm != NULL;
 	}
 
 	return 0;
@@ -1295,8 +1317,8 @@ static size_t syscall__scnprintf_args(struct syscall *sc, char *bf, size_t size,
 	unsigned char *p;
 	unsigned long val;
 
-	if (sc->args != NULL) {
-		struct format_field *field;
+	if (sc->arg_fmt != NULL) {
+		struct syscall_arg_fmt *arg_fmt = sc->arg_fmt;
 		u8 bit = 1;
 		struct syscall_arg arg = {
 			.idx	= 0,
@@ -1305,8 +1327,7 @@ static size_t syscall__scnprintf_args(struct syscall *sc, char *bf, size_t size,
 			.thread = thread,
 		};
 
-		for (field = sc->args; field;
-		     field = field->next, ++arg.idx, bit <<= 1) {
+		for (; arg.idx < sc->nr_args; ++arg.idx, ++arg_fmt, bit <<= 1) {
 			if (arg.mask & bit)
 				continue;
 
@@ -1314,25 +1335,16 @@ static size_t syscall__scnprintf_args(struct syscall *sc, char *bf, size_t size,
 			p = args + sizeof(unsigned long) * arg.idx;
 			memcpy(&val, p, sizeof(val));
 
-			/*
- 			 * Suppress this argument if its value is zero and
- 			 * and we don't have a string associated in an
- 			 * strarray for it.
- 			 */
-			if (val == 0 &&
-			    !(sc->arg_scnprintf &&
-			      sc->arg_scnprintf[arg.idx] == SCA_STRARRAY &&
-			      sc->arg_parm[arg.idx]))
+			if (val == 0 && !arg_fmt->show_zero)
 				continue;
 
 			printed += scnprintf(bf + printed, size - printed,
-					     "%s%s: ", printed ? ", " : "", field->name);
-			if (sc->arg_scnprintf && sc->arg_scnprintf[arg.idx]) {
-				arg.val = val;
-				if (sc->arg_parm)
-					arg.parm = sc->arg_parm[arg.idx];
-				printed += sc->arg_scnprintf[arg.idx](bf + printed,
-								      size - printed, &arg);
+					     "%s%s: ", printed ? ", " : "", arg_fmt->name);
+			if (arg_fmt->scnprintf) {
+				arg.val	 = val;
+				arg.parm = arg_fmt->parm;
+				printed += arg_fmt->scnprintf(bf + printed,
+							      size - printed, &arg);
 			} else {
 				printed += scnprintf(bf + printed, size - printed,
 						     "%ld", val);
@@ -2024,6 +2036,7 @@ static int trace__record(struct trace *trace, int argc, const char **argv)
 }
 
 static size_t trace__fprintf_thread_summary(struct trace *trace, FILE *fp);
+static size_t trace__fprintf_bpf_summary(struct trace *trace, FILE *fp);
 
 static bool perf_evlist__add_vfs_getname(struct perf_evlist *evlist)
 {
@@ -2158,6 +2171,32 @@ out_enomem:
 	goto out;
 }
 
+/*
+ * The BPF programs see every task, so the target is applied with a filter
+ * in the BPF maps: perf itself and --filter-pids are always left out, and
+ * unless tracing system wide only the target tasks and their children are
+ * counted.  The filter is by tid for a --tid target, by tgid otherwise.
+ */
+static int trace__set_bpf_summary_filter(struct trace *trace)
+{
+	struct thread_map *threads = trace->evlist->threads;
+	size_t i;
+	int err, thread;
+
+	err = bpf_trace_summary__filter_pid(getpid(), false);
+
+	for (i = 0; !err && i < trace->filter_pids.nr; i++)
+		err = bpf_trace_summary__filter_pid(trace->filter_pids.entries[i], false);
+
+	if (err || thread_map__pid(threads, 0) == -1)
+		return err;
+
+	for (thread = 0; !err && thread < thread_map__nr(threads); thread++)
+		err = bpf_trace_summary__filter_pid(thread_map__pid(threads, thread), true);
+
+	return err ?: bpf_trace_summary__filter_only(true, trace->opts.target.tid);
+}
+
 static int trace__run(struct trace *trace, int argc, const char **argv)
 {
 	struct perf_evlist *evlist = trace->evlist;
@@ -2166,14 +2205,24 @@ static int trace__run(struct trace *trace, int argc, const char **argv)
 	unsigned long before;
 	const bool forks = argc > 0;
 	bool draining = false;
+	u64 next_summary;
 
 	trace->live = true;
 
-	if (trace->trace_syscalls && trace__add_syscall_newtp(trace))
-		goto out_error_raw_syscalls;
+	if (trace->bpf_summary) {
+		if (bpf_trace_summary__add_events(evlist))
+			goto out_delete_evlist;
+
+		evlist__for_each_entry(evlist, evsel) {
+			if (evsel->handler == NULL)
+				evsel->handler = trace__event_handler;
+		}
+	} else if (trace->trace_syscalls) {
+		if (trace__add_syscall_newtp(trace))
+			goto out_error_raw_syscalls;
 
-	if (trace->trace_syscalls)
 		trace->vfs_getname = perf_evlist__add_vfs_getname(evlist);
+	}
 
 	if ((trace->trace_pgfaults & TRACE_PFMAJ)) {
 		pgfault_maj = perf_evsel__new_pgfault(PERF_COUNT_SW_PAGE_FAULTS_MAJ);
@@ -2286,7 +2335,13 @@ static int trace__run(struct trace *trace, int argc, const char **argv)
 	if (err < 0)
 		goto out_error_mem;
 
-	if (trace->ev_qualifier_ids.nr > 0) {
+	if (trace->bpf_summary) {
+		err = trace__set_bpf_summary_filter(trace);
+		if (err < 0)
+			goto out_error_bpf_summary;
+	}
+
+	if (trace->ev_qualifier_ids.nr > 0 && !trace->bpf_summary) {
 		err = trace__set_ev_qualifier_filter(trace);
 		if (err < 0)
 			goto out_errno;
@@ -2312,6 +2367,7 @@ static int trace__run(struct trace *trace, int argc, const char **argv)
 	trace->multiple_threads = thread_map__pid(evlist->threads, 0) == -1 ||
 				  evlist->threads->nr > 1 ||
 				  perf_evlist__first(evlist)->attr.inherit;
+	next_summary = rdclock() + trace->bpf_summary_interval * NSEC_PER_MSEC;
 again:
 	before = trace->nr_events;
 
@@ -2346,12 +2402,25 @@ next_event:
 	if (trace->nr_events == before) {
 		int timeout = done ? 100 : -1;
 
+		if (trace->bpf_summary_interval && !done) {
+			u64 now = rdclock();
+
+			if (now >= next_summary) {
+				trace__fprintf_bpf_summary(trace, trace->output);
+				next_summary = now + trace->bpf_summary_interval * NSEC_PER_MSEC;
+			}
+			timeout = (next_summary - now) / NSEC_PER_MSEC + 1;
+		}
+
 		if (!draining && perf_evlist__poll(evlist, timeout) > 0) {
 			if (perf_evlist__filter_pollfd(evlist, POLLERR | POLLHUP) == 0)
 				draining = true;
 
 			goto again;
 		}
+
+		if (trace->bpf_summary_interval && !done && !draining)
+			goto again;
 	} else {
 		goto again;
 	}
@@ -2362,7 +2431,9 @@ out_disable:
 	perf_evlist__disable(evlist);
 
 	if (!err) {
-		if (trace->summary)
+		if (trace->bpf_summary)
+			trace__fprintf_bpf_summary(trace, trace->output);
+		else if (trace->summary)
 			trace__fprintf_thread_summary(trace, trace->output);
 
 		if (trace->show_tool_stats) {
@@ -2380,7 +2451,7 @@ out_delete_evlist:
 	trace->live = false;
 	return err;
 {
-	char errbuf[BUFSIZ];
+	char errbuf[BUFSIZ], sbuf[STRERR_BUFSIZE];
 
 out_error_sched_stat_runtime:
 	tracing_path__strerror_open_tp(errno, errbuf, sizeof(errbuf), "sched", "sched_stat_runtime");
@@ -2396,6 +2467,12 @@ out_error_mmap:
 
 out_error_open:
 	perf_evlist__strerror_open(evlist, errno, errbuf, sizeof(errbuf));
+	goto out_error;
+
+out_error_bpf_summary:
+	scnprintf(errbuf, sizeof(errbuf), "Failed to set up the BPF summary pid filter: %s",
+		  str_error_r(-err, sbuf, sizeof(sbuf)));
+	goto out_error;
 
 out_error:
 	fprintf(trace->output, "%s\n", errbuf);
@@ -2498,8 +2575,6 @@ static int trace__replay(struct trace *trace)
 	if (err != 0)
 		goto out;
 
-	setup_pager();
-
 	err = perf_session__process_events(session);
 	if (err)
 		pr_err("Failed to process events, error %d", err);
@@ -2513,6 +2588,55 @@ out:
 	return err;
 }
 
+/*
+ * 'perf bench trace replay': format the syscalls recorded in 'input' to
+ * 'output' 'loops' times.  The syscall table and its argument formatters
+ * are only set up on the first pass, like in a long running session.
+ */
+int trace__bench_replay(const char *input, FILE *output, unsigned int loops,
+			unsigned long *nr_events)
+{
+	struct trace trace = {
+		.syscalls = {
+			. max = -1,
+		},
+		.opts = {
+			.target = {
+				.uid	   = UINT_MAX,
+				.uses_mmap = true,
+			},
+		},
+		.output = output,
+		.show_comm = true,
+		.trace_syscalls = true,
+		.max_stack = PERF_MAX_STACK_DEPTH,
+	};
+	const char *saved_input_name = input_name;
+	int err = -ENOMEM;
+
+	trace.sctbl = syscalltbl__new();
+	if (trace.sctbl == NULL)
+		return -ENOMEM;
+
+	trace.open_id = syscalltbl__id(trace.sctbl, "open");
+	input_name = input;
+
+	while (loops--) {
+		err = trace__replay(&trace);
+		if (err)
+			break;
+	}
+
+	input_name = saved_input_name;
+	*nr_events = trace.nr_events;
+
+	for (; trace.syscalls.max >= 0; --trace.syscalls.max)
+		free(trace.syscalls.table[trace.syscalls.max].arg_fmt);
+	free(trace.syscalls.table);
+	syscalltbl__delete(trace.sctbl);
+	return err;
+}
+
 static size_t trace__fprintf_threads_header(FILE *fp)
 {
 	size_t printed;
@@ -2638,6 +2762,182 @@ static size_t trace__fprintf_thread_summary(struct trace *trace, FILE *fp)
 	return printed;
 }
 
+struct syscall_summaries {
+	struct trace		*trace;
+	struct syscall_summary	*entries;
+	size_t			nr, alloc;
+	u64			nr_calls;
+};
+
+static bool trace__ev_qualifier_has(struct trace *trace, int id)
+{
+	size_t i;
+
+	for (i = 0; i < trace->ev_qualifier_ids.nr; i++) {
+		if (trace->ev_qualifier_ids.entries[i] == id)
+			return true;
+	}
+
+	return false;
+}
+
+static int syscall_summaries__add(struct syscall_summary *summary, void *arg)
+{
+	struct syscall_summaries *summaries = arg;
+	struct trace *trace = summaries->trace;
+
+	if (trace->ev_qualifier_ids.nr &&
+	    trace__ev_qualifier_has(trace, summary->key.id) == trace->not_ev_qualifier)
+		return 0;
+
+	if (summaries->nr == summaries->alloc) {
+		size_t alloc = summaries->alloc ? summaries->alloc * 2 : 256;
+		struct syscall_summary *entries;
+
+		entries = realloc(summaries->entries, alloc * sizeof(*entries));
+		if (entries == NULL)
+			return -ENOMEM;
+
+		summaries->entries = entries;
+		summaries->alloc   = alloc;
+	}
+
+	summaries->entries[summaries->nr++] = *summary;
+	summaries->nr_calls += summary->stats.count;
+	return 0;
+}
+
+/* Upper bound of the log2 bucket holding the pct percentile, in msecs */
+static double syscall_summary__percentile(struct syscall_summary *summary, double pct)
+{
+	u64 target = summary->stats.count * pct / 100.0, seen = 0, upper;
+	int slot;
+
+	for (slot = 0; slot < SYSCALL_SUMMARY_HIST_SLOTS - 1; slot++) {
+		seen += summary->hist[slot];
+		if (seen > target)
+			break;
+	}
+
+	upper = 2ULL << slot;
+	if (slot == SYSCALL_SUMMARY_HIST_SLOTS - 1 || upper > summary->stats.max)
+		upper = summary->stats.max;
+
+	return (double)upper / NSEC_PER_MSEC;
+}
+
+/* Threads with the most calls first, the costliest syscalls first in each */
+static int syscall_summary__cmp(const void *a, const void *b)
+{
+	const struct syscall_summary *sa = a, *sb = b;
+
+	if (sa->key.tid != sb->key.tid)
+		return sa->key.tid < sb->key.tid ? -1 : 1;
+	if (sa->stats.total != sb->stats.total)
+		return sa->stats.total > sb->stats.total ? -1 : 1;
+	return 0;
+}
+
+struct syscall_summary_thread {
+	struct syscall_summary	*entries;
+	size_t			nr;
+	u64			nr_calls;
+};
+
+static int syscall_summary_thread__cmp(const void *a, const void *b)
+{
+	const struct syscall_summary_thread *ta = a, *tb = b;
+
+	if (ta->nr_calls != tb->nr_calls)
+		return ta->nr_calls > tb->nr_calls ? -1 : 1;
+	return 0;
+}
+
+static size_t syscall_summary_thread__fprintf(struct syscall_summary_thread *st,
+					      struct trace *trace, u64 nr_calls,
+					      FILE *fp)
+{
+	pid_t tid = st->entries[0].key.tid;
+	struct thread *thread = machine__find_thread(trace->host, -1, tid);
+	size_t printed = 0, i;
+
+	printed += fprintf(fp, " %s (%d), ",
+			   thread ? thread__comm_str(thread) : ":", tid);
+	printed += fprintf(fp, "%" PRIu64 " syscalls, ", st->nr_calls);
+	printed += fprintf(fp, "%.1f%%\n\n", (double)st->nr_calls / nr_calls * 100.0);
+	thread__put(thread);
+
+	printed += fprintf(fp, "   syscall            calls    total       min       avg       max       p50       p99\n");
+	printed += fprintf(fp, "                               (msec)    (msec)    (msec)    (msec)    (msec)    (msec)\n");
+	printed += fprintf(fp, "   --------------- -------- --------- --------- --------- --------- --------- ---------\n");
+
+	for (i = 0; i < st->nr; i++) {
+		struct syscall_summary *summary = &st->entries[i];
+		struct syscall_summary_stats *stats = &summary->stats;
+		const char *name = syscalltbl__name(trace->sctbl, summary->key.id);
+		double total = (double)stats->total / NSEC_PER_MSEC;
+
+		if (name)
+			printed += fprintf(fp, "   %-15s", name);
+		else
+			printed += fprintf(fp, "   %-15d", summary->key.id);
+		printed += fprintf(fp, " %8" PRIu64 " %9.3f %9.3f %9.3f",
+				   stats->count, total,
+				   (double)stats->min / NSEC_PER_MSEC,
+				   stats->count ? total / stats->count : 0.0);
+		printed += fprintf(fp, " %9.3f %9.3f %9.3f\n",
+				   (double)stats->max / NSEC_PER_MSEC,
+				   syscall_summary__percentile(summary, 50),
+				   syscall_summary__percentile(summary, 99));
+	}
+
+	printed += fprintf(fp, "\n\n");
+	return printed;
+}
+
+static size_t trace__fprintf_bpf_summary(struct trace *trace, FILE *fp)
+{
+	struct syscall_summaries summaries = { .trace = trace, };
+	struct syscall_summary_thread *threads = NULL;
+	size_t printed = trace__fprintf_threads_header(fp);
+	size_t i, nr_threads = 0;
+
+	if (bpf_trace_summary__for_each(syscall_summaries__add, &summaries)) {
+		fprintf(fp, "%s", "Error reading the BPF summary maps!\n");
+		goto out;
+	}
+
+	qsort(summaries.entries, summaries.nr, sizeof(*summaries.entries),
+	      syscall_summary__cmp);
+
+	threads = calloc(summaries.nr, sizeof(*threads));
+	if (summaries.nr && threads == NULL) {
+		fprintf(fp, "%s", "Not enough memory to sort the summary!\n");
+		goto out;
+	}
+
+	for (i = 0; i < summaries.nr; i++) {
+		struct syscall_summary *summary = &summaries.entries[i];
+
+		if (i == 0 || summary->key.tid != summary[-1].key.tid)
+			threads[nr_threads++].entries = summary;
+
+		threads[nr_threads - 1].nr++;
+		threads[nr_threads - 1].nr_calls += summary->stats.count;
+	}
+
+	qsort(threads, nr_threads, sizeof(*threads), syscall_summary_thread__cmp);
+
+	for (i = 0; i < nr_threads; i++)
+		printed += syscall_summary_thread__fprintf(&threads[i], trace,
+							   summaries.nr_calls, fp);
+out:
+	free(threads);
+	free(summaries.entries);
+	fflush(fp);
+	return printed;
+}
+
 static int trace__set_duration(const struct option *opt, const char *str,
 			       int unset __maybe_unused)
 {
@@ -2791,6 +3091,10 @@ int cmd_trace(int argc, const char **argv, const char *prefix __maybe_unused)
 		    "Show only syscall summary with statistics"),
 	OPT_BOOLEAN('S', "with-summary", &trace.summary,
 		    "Show all syscalls and summary with statistics"),
+	OPT_BOOLEAN(0, "bpf-summary", &trace.bpf_summary,
+		    "Aggregate the syscall summary in kernel BPF maps (implies -s)"),
+	OPT_UINTEGER(0, "bpf-summary-interval", &trace.bpf_summary_interval,
+		     "Print the BPF syscall summary every N ms"),
 	OPT_CALLBACK_DEFAULT('F', "pf", &trace.trace_pgfaults, "all|maj|min",
 		     "Trace pagefaults", parse_pagefaults, "maj"),
 	OPT_BOOLEAN(0, "syscalls", &trace.trace_syscalls, "Trace syscalls"),
@@ -2872,6 +3176,25 @@ int cmd_trace(int argc, const char **argv, const char *prefix __maybe_unused)
 	if ((argc >= 1) && (strcmp(argv[0], "record") == 0))
 		return trace__record(&trace, argc-1, &argv[1]);
 
+	if (trace.bpf_summary_interval)
+		trace.bpf_summary = true;
+
+	if (trace.bpf_summary) {
+		if (input_name) {
+			pr_err("--bpf-summary only works live, not with -i.\n");
+			goto out;
+		}
+		if (trace.summary) {
+			pr_err("--bpf-summary can't be used with -S/--with-summary, it only shows the summary.\n");
+			goto out;
+		}
+		if (!trace.trace_syscalls) {
+			pr_err("--bpf-summary can't be used with --no-syscalls.\n");
+			goto out;
+		}
+		trace.summary_only = true;
+	}
+
 	/* summary_only implies summary option, but don't overwrite summary if set */
 	if (trace.summary_only)
 		trace.summary = trace.summary_only;
@@ -2936,9 +3259,10 @@ int cmd_trace(int argc, const char **argv, const char *prefix __maybe_unused)
 	if (!argc && target__none(&trace.opts.target))
 		trace.opts.target.system_wide = true;
 
-	if (input_name)
+	if (input_name) {
+		setup_pager();
 		err = trace__replay(&trace);
-	else
+	} else
 		err = trace__run(&trace, argc, argv);
 
 out_close:
@@ -36,6 +36,8 @@ int cmd_lock(int argc, const char **argv, const char *prefix);
 int cmd_kvm(int argc, const char **argv, const char *prefix);
 int cmd_test(int argc, const char **argv, const char *prefix);
 int cmd_trace(int argc, const char **argv, const char *prefix);
+int trace__bench_replay(const char *input, FILE *output, unsigned int loops,
+			unsigned long *nr_events);
 int cmd_inject(int argc, const char **argv, const char *prefix);
 int cmd_mem(int argc, const char **argv, const char *prefix);
 int cmd_data(int argc, const char **argv, const char *prefix);
@@ -225,6 +225,10 @@ perf_db_export_mode = True
 perf_db_export_calls = False
 perf_db_export_callchains = False
 
+# perf writes the intermediate files itself, instead of calling the
+# *_table() functions below for every row.  Set to False to debug them.
+native_export = True
+
 
 def usage():
 	print >> sys.stderr, "Usage is: export-to-postgresql.py <database name> [<columns>] [<calls>] [<callchains>]"
@@ -259,6 +263,10 @@ for i in range(3,len(sys.argv)):
 output_dir_name = os.getcwd() + "/" + dbname + "-perf-data"
 os.mkdir(output_dir_name)
 
+if native_export:
+	perf_db_export_pgcopy = output_dir_name
+	perf_db_export_pgcopy_branches = branches
+
 def do_query(q, s):
 	if (q.exec_(s)):
 		return
@@ -503,6 +511,10 @@ def open_output_file(file_name):
 	file.write(file_header)
 	return file
 
+# The files written by perf already have their trailer
+def reopen_output_file(file_name):
+	return open(output_dir_name + "/" + file_name, "r")
+
 def close_output_file(file):
 	file.write(file_trailer)
 	file.close()
@@ -517,7 +529,8 @@ def copy_output_file(file, table_name):
 	conn = PQconnectdb("dbname = " + dbname)
 	if (PQstatus(conn)):
 		raise Exception("COPY FROM STDIN PQconnectdb failed")
-	file.write(file_trailer)
+	if not native_export:
+		file.write(file_trailer)
 	file.seek(0)
 	sql = "COPY " + table_name + " FROM STDIN (FORMAT 'binary')"
 	res = PQexec(conn, sql)
@@ -539,22 +552,31 @@ def remove_output_file(file):
 	file.close()
 	os.unlink(name)
 
-evsel_file		= open_output_file("evsel_table.bin")
-machine_file		= open_output_file("machine_table.bin")
-thread_file		= open_output_file("thread_table.bin")
-comm_file		= open_output_file("comm_table.bin")
-comm_thread_file	= open_output_file("comm_thread_table.bin")
-dso_file		= open_output_file("dso_table.bin")
-symbol_file		= open_output_file("symbol_table.bin")
-branch_type_file	= open_output_file("branch_type_table.bin")
-sample_file		= open_output_file("sample_table.bin")
-if perf_db_export_calls or perf_db_export_callchains:
-	call_path_file		= open_output_file("call_path_table.bin")
-if perf_db_export_calls:
-	call_file		= open_output_file("call_table.bin")
+def open_output_files(open_file):
+	global evsel_file, machine_file, thread_file, comm_file, comm_thread_file
+	global dso_file, symbol_file, branch_type_file, sample_file
+	global call_path_file, call_file
+	evsel_file		= open_file("evsel_table.bin")
+	machine_file		= open_file("machine_table.bin")
+	thread_file		= open_file("thread_table.bin")
+	comm_file		= open_file("comm_table.bin")
+	comm_thread_file	= open_file("comm_thread_table.bin")
+	dso_file		= open_file("dso_table.bin")
+	symbol_file		= open_file("symbol_table.bin")
+	branch_type_file	= open_file("branch_type_table.bin")
+	sample_file		= open_file("sample_table.bin")
+	if perf_db_export_calls or perf_db_export_callchains:
+		call_path_file		= open_file("call_path_table.bin")
+	if perf_db_export_calls:
+		call_file		= open_file("call_table.bin")
+
+if not native_export:
+	open_output_files(open_output_file)
 
 def trace_begin():
 	print datetime.datetime.today(), "Writing to intermediate files..."
+	if native_export:
+		return
 	# id == 0 means unknown.  It is easier to create records for them than replace the zeroes with NULLs
 	evsel_table(0, "unknown")
 	machine_table(0, 0, "unknown")
@@ -569,6 +591,8 @@ def trace_begin():
 unhandled_count = 0
 
 def trace_end():
+	if native_export:
+		open_output_files(reopen_output_file)
 	print datetime.datetime.today(), "Copying to database..."
 	copy_output_file(evsel_file,		"selected_events")
 	copy_output_file(machine_file,		"machines")
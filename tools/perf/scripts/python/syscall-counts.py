@@ -7,6 +7,7 @@
 
 import os
 import sys
+import struct
 
 sys.path.append(os.environ['PERF_EXEC_PATH'] + \
 	'/scripts/python/Perf-Trace-Util/lib/Perf/Trace')
@@ -27,6 +28,9 @@ if len(sys.argv) > 1:
 
 syscalls = autodict()
 
+# Get raw_syscalls:sys_enter in batches, see raw_syscalls__sys_enter__batch()
+perf_script_batch_size = 4096
+
 def trace_begin():
 	print "Press control+C to stop and show the summary"
 
@@ -44,6 +48,17 @@ def raw_syscalls__sys_enter(event_name, context, common_cpu,
 	except TypeError:
 		syscalls[id] = 1
 
+def raw_syscalls__sys_enter__batch(event_name, nr, columns, types):
+	ids = struct.unpack("=%d%s" % (nr, types['id']), columns['id'].tobytes())
+	if for_comm is not None:
+		ids = [id for id, comm in zip(ids, columns['common_comm'])
+		       if comm == for_comm]
+	for id in ids:
+		try:
+			syscalls[id] += 1
+		except TypeError:
+			syscalls[id] = 1
+
 def syscalls__sys_enter(event_name, context, common_cpu,
 	common_secs, common_nsecs, common_pid, common_comm,
 	id, args):
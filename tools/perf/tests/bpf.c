@@ -6,6 +6,8 @@
 #include <linux/bpf.h>
 #include <linux/filter.h>
 #include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <util/bpf-trace-summary.h>
 #include "tests.h"
 #include "llvm.h"
 #include "debug.h"
@@ -23,6 +25,49 @@ static int epoll_wait_loop(void)
 	return 0;
 }
 
+static int getppid_loop(void)
+{
+	int i;
+
+	for (i = 0; i < NR_ITERS; i++)
+		getppid();
+	return 0;
+}
+
+/*
+ * Nothing reaches the ring buffer, everything is aggregated in maps:
+ * look for an entry of this thread that saw all the getppid() calls.
+ */
+static int check_trace_summary(struct bpf_object *obj)
+{
+	struct syscall_summary_key key, next;
+	struct syscall_summary_stats stats;
+	u32 tid = syscall(__NR_gettid);
+	struct bpf_map *map;
+	int fd;
+
+	map = bpf_object__find_map_by_name(obj, "syscall_summary_stats");
+	if (IS_ERR(map) || map == NULL) {
+		pr_debug("syscall_summary_stats map not found\n");
+		return TEST_FAIL;
+	}
+	fd = bpf_map__fd(map);
+
+	memset(&key, 0xff, sizeof(key));
+	while (bpf_map_get_next_key(fd, &key, &next) == 0) {
+		key = next;
+		if (key.tid != tid || bpf_map_lookup_elem(fd, &key, &stats))
+			continue;
+
+		if (stats.count == NR_ITERS && stats.min <= stats.max &&
+		    stats.total >= stats.max)
+			return TEST_OK;
+	}
+
+	pr_debug("BPF syscall summary incorrect\n");
+	return TEST_FAIL;
+}
+
 #ifdef HAVE_BPF_PROLOGUE
 
 static int llseek_loop(void)
@@ -54,6 +99,7 @@ static struct {
 	const char *msg_load_fail;
 	int (*target_func)(void);
 	int expect_result;
+	int (*check_func)(struct bpf_object *obj);
 } bpf_testcase_table[] = {
 	{
 		LLVM_TESTCASE_BASE,
@@ -63,6 +109,7 @@ static struct {
 		"load bpf object failed",
 		&epoll_wait_loop,
 		(NR_ITERS + 1) / 2,
+		NULL,
 	},
 #ifdef HAVE_BPF_PROLOGUE
 	{
@@ -73,6 +120,7 @@ static struct {
 		"check your vmlinux setting?",
 		&llseek_loop,
 		(NR_ITERS + 1) / 4,
+		NULL,
 	},
 #endif
 	{
@@ -83,6 +131,17 @@ static struct {
 		"libbpf error when dealing with relocation",
 		NULL,
 		0,
+		NULL,
+	},
+	{
+		LLVM_TESTCASE_BPF_TRACE_SUMMARY,
+		"Test BPF syscall summary",
+		"[bpf_trace_summary_test]",
+		"fix 'perf test LLVM' first",
+		"load bpf object failed",
+		&getppid_loop,
+		0,
+		&check_trace_summary,
 	},
 };
 
@@ -230,6 +289,8 @@ static int __test__bpf(int idx)
 		ret = do_test(obj,
 			      bpf_testcase_table[idx].target_func,
 			      bpf_testcase_table[idx].expect_result);
+	if (ret == TEST_OK && bpf_testcase_table[idx].check_func)
+		ret = bpf_testcase_table[idx].check_func(obj);
 out:
 	bpf__clear();
 	return ret;
@@ -201,6 +201,10 @@ static struct test generic_tests[] = {
 		.desc = "Test stat round synthesize",
 		.func = test__synthesize_stat_round,
 	},
+	{
+		.desc = "Test stat stream ring file",
+		.func = test__stat_stream_ring,
+	},
 	{
 		.desc = "Test attr update synthesize",
 		.func = test__event_update,
@@ -229,6 +233,34 @@ static struct test generic_tests[] = {
 		.desc = "Test bitmap print",
 		.func = test__bitmap_print,
 	},
+	{
+		.desc = "Test log-linear histogram",
+		.func = test__log_hist,
+	},
+	{
+		.desc = "Test columnar data file writer",
+		.func = test__data_convert_col,
+	},
+	{
+		.desc = "Test folded stacks aggregation",
+		.func = test__folded_stacks,
+	},
+	{
+		.desc = "Test sched timehist slice accounting",
+		.func = test__sched_timehist,
+	},
+	{
+		.desc = "Test time bins merging",
+		.func = test__time_bins,
+	},
+	{
+		.desc = "Test compiled trace event filters",
+		.func = test__trace_filter,
+	},
+	{
+		.desc = "Test cacheline contention table",
+		.func = test__mem_cachelines,
+	},
 	{
 		.func = NULL,
 	},
@@ -0,0 +1,199 @@
+#include <linux/compiler.h>
+#include <endian.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "tests.h"
+#include "data-convert-col.h"
+#include "util.h"
+#include "debug.h"
+
+#define NR_ROWS		10
+#define CHUNK_ROWS	4
+
+static const char *comms[] = { "perf", "bash", "swapper" };
+
+static u64 get_u64(const u8 *p)
+{
+	u64 val;
+
+	memcpy(&val, p, sizeof(val));
+	return le64toh(val);
+}
+
+static u32 get_u32(const u8 *p)
+{
+	u32 val;
+
+	memcpy(&val, p, sizeof(val));
+	return le32toh(val);
+}
+
+static s64 get_delta(const u8 **p)
+{
+	u64 val = 0;
+	int shift = 0;
+
+	do {
+		val |= (u64)(**p & 0x7f) << shift;
+		shift += 7;
+	} while (*(*p)++ & 0x80);
+
+	return (s64)(val >> 1) ^ -(s64)(val & 1);
+}
+
+static int write_file(const char *path)
+{
+	struct col_writer *w = col_writer__new(path, CHUNK_ROWS);
+	u64 i;
+
+	TEST_ASSERT_VAL("failed to create the writer", w != NULL);
+
+	/* a timestamp going backwards needs a negative delta */
+	for (i = 0; i < NR_ROWS; i++) {
+		struct col_sample sample = {
+			.time	= i == 5 ? 1000 : 1000000 + i * 1000,
+			.cpu	= i % 2,
+			.pid	= 100 + i,
+			.tid	= 100 + i,
+			.ip	= 0xffffffff81000000ULL + i,
+			.period	= 1,
+			.event	= "cycles",
+			.comm	= comms[i % ARRAY_SIZE(comms)],
+			.symbol	= i % 2 ? "main" : NULL,
+		};
+
+		if (col_writer__add(w, &sample)) {
+			pr_debug("failed to add row %" PRIu64 "\n", i);
+			col_writer__close(w);
+			return TEST_FAIL;
+		}
+	}
+
+	TEST_ASSERT_VAL("failed to close the writer", col_writer__close(w) == 0);
+	return TEST_OK;
+}
+
+static int check_file(const u8 *buf, size_t size)
+{
+	const u8 *p, *chunk, *dict = NULL;
+	u64 i, time, nr_chunks, sizes[COL__MAX];
+	int c;
+
+	TEST_ASSERT_VAL("wrong header magic",
+			!memcmp(buf, COL_FILE_MAGIC, sizeof(COL_FILE_MAGIC)));
+	TEST_ASSERT_VAL("wrong trailer magic",
+			!memcmp(buf + size - 8, COL_FILE_MAGIC, sizeof(COL_FILE_MAGIC)));
+
+	p = buf + get_u64(buf + size - 16);
+	TEST_ASSERT_VAL("wrong version", get_u32(p) == COL_FILE_VERSION);
+	TEST_ASSERT_VAL("wrong nr of columns", get_u32(p + 4) == COL__MAX);
+	p += 8;
+
+	for (c = 0; c < COL__MAX; c++) {
+		u8 encoding = p[1];
+		u16 len = p[2] | p[3] << 8;
+		u32 nr;
+
+		if (c == COL__TIME)
+			TEST_ASSERT_VAL("wrong time column name",
+					len == 4 && !memcmp(p + 4, "time", 4));
+		p += 4 + len;
+
+		if (encoding != COL_ENC__DICT)
+			continue;
+
+		if (c == COL__COMM)
+			dict = p;
+
+		nr = get_u32(p);
+		p += 4;
+		for (i = 0; i < nr; i++)
+			p += 4 + get_u32(p);
+	}
+
+	/* the empty string, then the comms in order of appearance */
+	TEST_ASSERT_VAL("wrong comm dictionary size",
+			dict != NULL && get_u32(dict) == 1 + ARRAY_SIZE(comms));
+	TEST_ASSERT_VAL("no empty string first", get_u32(dict + 4) == 0);
+	TEST_ASSERT_VAL("wrong first comm",
+			get_u32(dict + 8) == 4 && !memcmp(dict + 12, "perf", 4));
+
+	nr_chunks = get_u64(p);
+	TEST_ASSERT_VAL("wrong nr of chunks",
+			nr_chunks == (NR_ROWS + CHUNK_ROWS - 1) / CHUNK_ROWS);
+	p += 8;
+
+	/* second chunk: rows 4..7 */
+	p += 4 * 8 + COL__MAX * 8;
+	chunk = buf + get_u64(p);
+	TEST_ASSERT_VAL("wrong chunk rows", get_u64(p + 8) == CHUNK_ROWS);
+	TEST_ASSERT_VAL("wrong chunk min time", get_u64(p + 16) == 1000);
+	TEST_ASSERT_VAL("wrong chunk max time",
+			get_u64(p + 24) == 1000000 + 7 * 1000);
+	for (c = 0; c < COL__MAX; c++)
+		sizes[c] = get_u64(p + 32 + c * 8);
+
+	TEST_ASSERT_VAL("wrong cpu column size", sizes[COL__CPU] == CHUNK_ROWS * 4);
+	TEST_ASSERT_VAL("wrong ip column size", sizes[COL__IP] == CHUNK_ROWS * 8);
+
+	time = 0;
+	for (p = chunk, i = 4; i < 8; i++) {
+		time += get_delta(&p);
+		TEST_ASSERT_VAL("wrong time",
+				time == (i == 5 ? 1000 : 1000000 + i * 1000));
+	}
+	TEST_ASSERT_VAL("wrong time column end", p == chunk + sizes[COL__TIME]);
+
+	for (c = 0; c < COL__COMM; c++)
+		chunk += sizes[c];
+	for (i = 4; i < 8; i++)
+		TEST_ASSERT_VAL("wrong comm index",
+				get_u32(chunk + (i - 4) * 4) == 1 + i % ARRAY_SIZE(comms));
+
+	chunk += sizes[COL__COMM] + sizes[COL__DSO];
+	/* row 4 has no symbol, row 5 is "main" */
+	TEST_ASSERT_VAL("wrong symbol index", get_u32(chunk) == 0);
+	TEST_ASSERT_VAL("wrong symbol index", get_u32(chunk + 4) == 1);
+
+	return TEST_OK;
+}
+
+int test__data_convert_col(int subtest __maybe_unused)
+{
+	char path[] = "/tmp/perf-test-col-XXXXXX";
+	int fd, ret;
+	u8 *buf = NULL;
+	struct stat st;
+	FILE *fp;
+
+	fd = mkstemp(path);
+	if (fd < 0)
+		return TEST_FAIL;
+	close(fd);
+
+	ret = write_file(path);
+	if (ret)
+		goto out;
+
+	ret = TEST_FAIL;
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		goto out;
+
+	if (!fstat(fileno(fp), &st))
+		buf = malloc(st.st_size);
+	if (buf && fread(buf, st.st_size, 1, fp) == 1)
+		ret = check_file(buf, st.st_size);
+	else
+		pr_debug("failed to read %s\n", path);
+
+	fclose(fp);
+	free(buf);
+out:
+	unlink(path);
+	return ret;
+}
@@ -0,0 +1,105 @@
+#include <linux/compiler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "folded-stacks.h"
+#include "util.h"
+#include "debug.h"
+
+static const char *folded_output =
+	"perf;main;foo 3\n"
+	"perf;main;bar;foo 1\n"
+	"bash;main 1\n";
+
+static int add_stacks(struct folded_stacks *fs)
+{
+	int perf, bash, main_, foo, bar, foo2;
+
+	perf = folded_stacks__frame(fs, NULL, "perf");
+	bash = folded_stacks__frame(fs, NULL, "bash");
+	main_ = folded_stacks__frame(fs, &main_, "main");
+	foo = folded_stacks__frame(fs, &foo, "foo");
+	bar = folded_stacks__frame(fs, NULL, "bar");
+	TEST_ASSERT_VAL("failed to add the frames",
+			perf >= 0 && bash >= 0 && main_ >= 0 && foo >= 0 && bar >= 0);
+
+	/* same name through another key, or none: same frame */
+	foo2 = folded_stacks__frame(fs, &foo2, "foo");
+	TEST_ASSERT_VAL("same name, other key", foo2 == foo);
+	TEST_ASSERT_VAL("same name, no key",
+			folded_stacks__frame(fs, NULL, "foo") == foo);
+	TEST_ASSERT_VAL("same key, other name",
+			folded_stacks__frame(fs, &main_, "ignored") == main_);
+
+	{
+		u32 s1[] = { perf, main_, foo };
+		u32 s2[] = { perf, main_, bar, foo };
+		u32 s3[] = { bash, main_ };
+
+		TEST_ASSERT_VAL("failed to add a stack",
+				!folded_stacks__add(fs, s1, ARRAY_SIZE(s1), 1) &&
+				!folded_stacks__add(fs, s2, ARRAY_SIZE(s2), 1) &&
+				!folded_stacks__add(fs, s1, ARRAY_SIZE(s1), 2) &&
+				!folded_stacks__add(fs, s3, ARRAY_SIZE(s3), 1));
+	}
+
+	return TEST_OK;
+}
+
+static int check_svg(const char *svg)
+{
+	TEST_ASSERT_VAL("title not escaped", strstr(svg, "&lt;test&gt;") != NULL);
+	TEST_ASSERT_VAL("wrong root",
+			strstr(svg, "<title>all (5 samples, 100.00%)</title>") != NULL);
+	/* the two perf stacks are merged under one main */
+	TEST_ASSERT_VAL("wrong perf frame",
+			strstr(svg, "<title>perf (4 samples, 80.00%)</title>") != NULL);
+	TEST_ASSERT_VAL("wrong main frame",
+			strstr(svg, "<title>main (4 samples, 80.00%)</title>") != NULL);
+	TEST_ASSERT_VAL("wrong main;foo frame",
+			strstr(svg, "<title>foo (3 samples, 60.00%)</title>") != NULL);
+	TEST_ASSERT_VAL("wrong bar;foo frame",
+			strstr(svg, "<title>foo (1 samples, 20.00%)</title>") != NULL);
+	TEST_ASSERT_VAL("svg not closed", strstr(svg, "</svg>\n") != NULL);
+
+	return TEST_OK;
+}
+
+int test__folded_stacks(int subtest __maybe_unused)
+{
+	struct folded_stacks *fs = folded_stacks__new();
+	char *buf = NULL, *svg = NULL;
+	int err, ret = TEST_FAIL;
+	size_t size;
+	FILE *fp;
+
+	if (fs == NULL)
+		return TEST_FAIL;
+
+	if (add_stacks(fs))
+		goto out;
+
+	fp = open_memstream(&buf, &size);
+	if (fp == NULL)
+		goto out;
+	err = folded_stacks__fprintf(fs, fp);
+	fclose(fp);
+	if (err || strcmp(buf, folded_output)) {
+		pr_debug("wrong folded stacks:\n%s", buf);
+		goto out;
+	}
+
+	fp = open_memstream(&svg, &size);
+	if (fp == NULL)
+		goto out;
+	err = folded_stacks__fprintf_svg(fs, fp, "<test>");
+	fclose(fp);
+	if (!err)
+		ret = check_svg(svg);
+out:
+	free(buf);
+	free(svg);
+	folded_stacks__delete(fs);
+	return ret;
+}
@@ -49,6 +49,14 @@ static struct {
 		.desc = "Compile source for BPF relocation test",
 		.should_load_fail = true,
 	},
+	[LLVM_TESTCASE_BPF_TRACE_SUMMARY] = {
+		.source = test_llvm__bpf_trace_summary_prog,
+		.desc = "Compile source for BPF trace summary",
+	},
+	[LLVM_TESTCASE_BPF_RECORD_STACKS] = {
+		.source = test_llvm__bpf_record_stacks_prog,
+		.desc = "Compile source for BPF record stacks",
+	},
 };
 
 int
@@ -0,0 +1,52 @@
+#include <linux/compiler.h>
+#include "tests.h"
+#include "log-hist.h"
+#include "util.h"
+#include "debug.h"
+
+int test__log_hist(int subtest __maybe_unused)
+{
+	struct log_hist hist = { .count = 0, }, other = { .count = 0, };
+	unsigned int b;
+	u64 i, val;
+
+	/* buckets are contiguous and cover all of u64 */
+	TEST_ASSERT_VAL("wrong first bucket", log_hist__bucket(0) == 0);
+	TEST_ASSERT_VAL("wrong last bucket",
+			log_hist__bucket(~0ULL) == LOG_HIST_NR_BUCKETS - 1);
+	TEST_ASSERT_VAL("wrong last bucket max",
+			log_hist__bucket_max(LOG_HIST_NR_BUCKETS - 1) == ~0ULL);
+	for (b = 0; b < LOG_HIST_NR_BUCKETS - 1; b++) {
+		val = log_hist__bucket_max(b);
+		TEST_ASSERT_VAL("bucket max not in bucket",
+				log_hist__bucket(val) == b);
+		TEST_ASSERT_VAL("bucket max + 1 not in next bucket",
+				log_hist__bucket(val + 1) == b + 1);
+	}
+
+	/* 1..10000: percentiles within the bucket resolution */
+	for (i = 1; i <= 10000; i++)
+		log_hist__add(&hist, i);
+
+	TEST_ASSERT_VAL("wrong count", hist.count == 10000);
+	val = log_hist__percentile(&hist, 50);
+	TEST_ASSERT_VAL("wrong p50",
+			val >= 5000 && val <= 5000 + 5000 / LOG_HIST_SUB_BUCKETS);
+	val = log_hist__percentile(&hist, 99);
+	TEST_ASSERT_VAL("wrong p99",
+			val >= 9900 && val <= 9900 + 9900 / LOG_HIST_SUB_BUCKETS);
+	val = log_hist__percentile(&hist, 100);
+	TEST_ASSERT_VAL("wrong p100",
+			val >= 10000 && val <= 10000 + 10000 / LOG_HIST_SUB_BUCKETS);
+
+	/* merging 10000 big values moves the median up */
+	for (i = 1; i <= 10000; i++)
+		log_hist__add(&other, 1000000);
+	log_hist__merge(&hist, &other);
+	TEST_ASSERT_VAL("wrong merged count", hist.count == 20000);
+	val = log_hist__percentile(&hist, 75);
+	TEST_ASSERT_VAL("wrong merged p75",
+			val >= 1000000 && val <= 1000000 + 1000000 / LOG_HIST_SUB_BUCKETS);
+
+	return TEST_OK;
+}
@@ -0,0 +1,91 @@
+#include <linux/compiler.h>
+#include <linux/bitmap.h>
+#include "tests.h"
+#include "mem-cachelines.h"
+#include "intlist.h"
+#include "symbol.h"
+#include "util.h"
+#include "debug.h"
+
+#define NR_CACHELINES	3000
+
+static int check_cachelines(struct mem_cachelines *cls)
+{
+	struct addr_location al = { .addr = 0x1000, };
+	struct mem_cacheline *cl, *first = NULL;
+	struct mem_cl_entry *entry;
+	u64 i;
+
+	/* more lines than the initial buckets, so the table gets resized */
+	for (i = 0; i < NR_CACHELINES; i++) {
+		cl = mem_cachelines__findnew(cls, 0x10000 + i * 64 + i % 64);
+		TEST_ASSERT_VAL("failed to add a cacheline", cl != NULL);
+		TEST_ASSERT_VAL("wrong cacheline address",
+				cl->addr == 0x10000 + i * 64);
+		if (!first)
+			first = cl;
+	}
+	TEST_ASSERT_EQUAL("wrong number of cachelines", (int)cls->nr,
+			  NR_CACHELINES);
+
+	/* found again after the resizes, from any offset of the line */
+	for (i = 0; i < NR_CACHELINES; i++) {
+		cl = mem_cachelines__findnew(cls, 0x10000 + i * 64 + 63);
+		TEST_ASSERT_VAL("cacheline not found",
+				cl && cl->addr == 0x10000 + i * 64);
+	}
+	TEST_ASSERT_EQUAL("cachelines added twice", (int)cls->nr,
+			  NR_CACHELINES);
+
+	/* one entry per offset and code address */
+	entry = mem_cacheline__findnew_entry(first, cls, 0x10008, &al);
+	TEST_ASSERT_VAL("wrong entry offset", entry && entry->offset == 8);
+	TEST_ASSERT_VAL("entry added twice",
+			mem_cacheline__findnew_entry(first, cls, 0x10008, &al) == entry);
+	mem_cacheline__findnew_entry(first, cls, 0x10010, &al);
+	al.addr = 0x2000;
+	mem_cacheline__findnew_entry(first, cls, 0x10008, &al);
+	TEST_ASSERT_EQUAL("wrong number of entries", (int)first->nr_entries, 3);
+
+	/* CPUs 2 and 3 are on node 1, CPUs past the topology are skipped */
+	TEST_ASSERT_VAL("failed to add users",
+			!mem_cl_users__add(&first->users, cls, 0, 10) &&
+			!mem_cl_users__add(&first->users, cls, 3, 10) &&
+			!mem_cl_users__add(&first->users, cls, 3, 11) &&
+			!mem_cl_users__add(&first->users, cls, 100, 12));
+	TEST_ASSERT_EQUAL("wrong number of CPUs",
+			  bitmap_weight(first->users.cpus, cls->nr_cpus), 2);
+	TEST_ASSERT_EQUAL("wrong number of nodes",
+			  bitmap_weight(first->users.nodes, cls->nr_nodes), 2);
+	TEST_ASSERT_EQUAL("wrong number of threads",
+			  (int)intlist__nr_entries(first->users.tids), 3);
+	return 0;
+}
+
+int test__mem_cachelines(int subtest __maybe_unused)
+{
+	struct mem_cachelines cls;
+	int ret;
+
+	/* unknown or bogus cacheline sizes */
+	TEST_ASSERT_VAL("failed to init cachelines",
+			!mem_cachelines__init(&cls, 0, 4, 2));
+	TEST_ASSERT_EQUAL("wrong default size", (int)cls.size,
+			  MEM_CACHELINE_DEFAULT_SIZE);
+	mem_cachelines__exit(&cls);
+
+	TEST_ASSERT_VAL("failed to init cachelines",
+			!mem_cachelines__init(&cls, 48, 4, 2));
+	TEST_ASSERT_EQUAL("wrong default size", (int)cls.size,
+			  MEM_CACHELINE_DEFAULT_SIZE);
+	mem_cachelines__exit(&cls);
+
+	TEST_ASSERT_VAL("failed to init cachelines",
+			!mem_cachelines__init(&cls, 64, 4, 2));
+	cls.cpu2node[2] = cls.cpu2node[3] = 1;
+
+	/* the lines and their entries are freed whatever the result */
+	ret = check_cachelines(&cls);
+	mem_cachelines__exit(&cls);
+	return ret;
+}
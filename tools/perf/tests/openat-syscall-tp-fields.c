@@ -108,6 +108,14 @@ int test__syscall_openat_tp_fields(int subtest __maybe_unused)
 					goto out_delete_evlist;
 				}
 
+				tp_flags = perf_evsel__tp_intval(evsel, &sample, "flags");
+
+				if (flags != tp_flags) {
+					pr_debug("%s: Expected cached flags=%#x, got %#x\n",
+						 __func__, flags, tp_flags);
+					goto out_delete_evlist;
+				}
+
 				goto out_ok;
 			}
 		}
@@ -0,0 +1,64 @@
+#include <linux/compiler.h>
+#include <string.h>
+#include "tests.h"
+#include "sched-timehist.h"
+#include "util.h"
+#include "debug.h"
+
+int test__sched_timehist(int subtest __maybe_unused)
+{
+	struct timehist_thread thread, *tr = &thread;
+
+	memset(tr, 0, sizeof(*tr));
+
+	/* first seen switching in: nothing to account before */
+	timehist_thread__sched_in(tr, 100);
+	TEST_ASSERT_VAL("wait or delay on first sched in",
+			tr->dt_wait == 0 && tr->dt_delay == 0);
+
+	/* runs 100, sleeps 300, woken up, waits 50 for a CPU */
+	TEST_ASSERT_VAL("wrong run time",
+			timehist_thread__sched_out(tr, 200, false) == 100);
+	timehist_thread__wakeup(tr, 500);
+	timehist_thread__wakeup(tr, 520);	/* not the first wakeup */
+	timehist_thread__sched_in(tr, 550);
+	TEST_ASSERT_VAL("wrong wait time after wakeup", tr->dt_wait == 300);
+	TEST_ASSERT_VAL("wrong delay after wakeup", tr->dt_delay == 50);
+
+	/* preempted: runnable right away, so no wait, only delay */
+	TEST_ASSERT_VAL("wrong run time before preemption",
+			timehist_thread__sched_out(tr, 600, true) == 50);
+	timehist_thread__sched_in(tr, 630);
+	TEST_ASSERT_VAL("wait time after preemption", tr->dt_wait == 0);
+	TEST_ASSERT_VAL("wrong delay after preemption", tr->dt_delay == 30);
+
+	/* no wakeup seen: all the time off CPU is wait */
+	TEST_ASSERT_VAL("wrong run time before sleep",
+			timehist_thread__sched_out(tr, 700, false) == 70);
+	timehist_thread__sched_in(tr, 1000);
+	TEST_ASSERT_VAL("wrong wait time without wakeup", tr->dt_wait == 300);
+	TEST_ASSERT_VAL("delay without wakeup", tr->dt_delay == 0);
+
+	/* woken up while still running: not a delay */
+	timehist_thread__wakeup(tr, 1010);
+	TEST_ASSERT_VAL("wrong run time after wakeup while running",
+			timehist_thread__sched_out(tr, 1100, false) == 100);
+	TEST_ASSERT_VAL("runnable after sleeping", tr->ready_to_run == 0);
+
+	/* the totals are the sums of the slices, wait and delay disjoint */
+	TEST_ASSERT_VAL("wrong nr_slices", tr->nr_slices == 4);
+	TEST_ASSERT_VAL("wrong nr_preempted", tr->nr_preempted == 1);
+	TEST_ASSERT_VAL("wrong total run time",
+			tr->run_time == 100 + 50 + 70 + 100);
+	TEST_ASSERT_VAL("wrong total wait time",
+			tr->wait_time == 300 + 0 + 300);
+	TEST_ASSERT_VAL("wrong total delay", tr->delay_time == 50 + 30);
+	TEST_ASSERT_VAL("wrong max delay",
+			tr->max_delay == 50 && tr->max_delay_at == 550);
+	TEST_ASSERT_VAL("wrong delay histogram count",
+			tr->delay_hist.count == 2);
+	TEST_ASSERT_VAL("slices don't add up",
+			tr->delay_time + tr->wait_time + tr->run_time == 1100 - 100);
+
+	return TEST_OK;
+}
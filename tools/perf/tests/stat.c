@@ -1,7 +1,14 @@
 #include <linux/compiler.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include "event.h"
+#include "evlist.h"
 #include "tests.h"
 #include "stat.h"
+#include "stat-stream.h"
 #include "counts.h"
 #include "debug.h"
 
@@ -109,3 +116,80 @@ int test__synthesize_stat_round(int subtest __maybe_unused)
 
 	return 0;
 }
+
+int test__stat_stream_ring(int subtest __maybe_unused)
+{
+	char path[] = "/tmp/perf-stat-stream-XXXXXX";
+	struct perf_counts_values count = { .val = 0 };
+	struct stat_stream_header *header;
+	struct stat_stream_record *ring;
+	struct perf_evlist *evlist;
+	struct stat_stream *stream;
+	struct stat st;
+	void *base;
+	int fd, i, err = -1;
+
+	fd = mkstemp(path);
+	TEST_ASSERT_VAL("failed to create file", fd >= 0);
+	close(fd);
+
+	evlist = perf_evlist__new();
+	if (evlist == NULL || perf_evlist__add_default(evlist))
+		goto out_unlink;
+
+	stream = stat_stream__new(path, 4, evlist);
+	if (stream == NULL)
+		goto out_delete;
+
+	/* 6 records into 4 slots: the first two get overwritten */
+	stat_stream__begin(stream, 1000);
+	for (i = 0; i < 6; i++) {
+		count.val = i;
+		count.ena = 2 * i;
+		count.run = 3 * i;
+		stat_stream__write(stream, 0, i, -1, &count);
+	}
+	stat_stream__end(stream);
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0)
+		goto out_stream;
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		goto out_stream;
+
+	header = base;
+	ring = base + header->data_offset;
+
+	if (header->magic != STAT_STREAM_MAGIC ||
+	    header->record_size != sizeof(*ring) ||
+	    header->nr_evsels != 1 || header->ring_size != 4 ||
+	    header->head != 6) {
+		pr_debug("wrong stat stream header\n");
+		goto out_munmap;
+	}
+
+	for (i = 2; i < 6; i++) {
+		struct stat_stream_record *rec = &ring[i % 4];
+
+		if (rec->time != 1000 || rec->cpu != i || rec->thread != -1 ||
+		    rec->val != (u64)i || rec->ena != (u64)2 * i ||
+		    rec->run != (u64)3 * i) {
+			pr_debug("wrong stat stream record %d\n", i);
+			goto out_munmap;
+		}
+	}
+
+	err = 0;
+out_munmap:
+	munmap(base, st.st_size);
+out_stream:
+	stat_stream__delete(stream);
+out_delete:
+	perf_evlist__delete(evlist);
+out_unlink:
+	unlink(path);
+	return err;
+}
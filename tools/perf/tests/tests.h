@@ -84,6 +84,7 @@ int test__cpu_map_synthesize(int subtest);
 int test__synthesize_stat_config(int subtest);
 int test__synthesize_stat(int subtest);
 int test__synthesize_stat_round(int subtest);
+int test__stat_stream_ring(int subtest);
 int test__event_update(int subtest);
 int test__event_times(int subtest);
 int test__backward_ring_buffer(int subtest);
@@ -91,6 +92,13 @@ int test__cpu_map_print(int subtest);
 int test__sdt_event(int subtest);
 int test__is_printable_array(int subtest);
 int test__bitmap_print(int subtest);
+int test__log_hist(int subtest);
+int test__data_convert_col(int subtest);
+int test__folded_stacks(int subtest);
+int test__sched_timehist(int subtest);
+int test__time_bins(int subtest);
+int test__trace_filter(int subtest);
+int test__mem_cachelines(int subtest);
 
 #if defined(__arm__) || defined(__aarch64__)
 #ifdef HAVE_DWARF_UNWIND_SUPPORT
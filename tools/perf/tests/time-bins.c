@@ -0,0 +1,104 @@
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include "tests.h"
+#include "time-bins.h"
+#include "util.h"
+#include "debug.h"
+
+#define RESOLUTION	1000
+#define NR_SPANS	64
+
+struct span {
+	u64			start;
+	u64			end;
+	u64			busy;
+	struct time_bin_entry	entry;
+};
+
+static struct span spans[NR_SPANS];
+static unsigned int nr_spans;
+
+/* what 'perf timechart --resolution' does for a task state period */
+static struct span *put_period(struct time_bin *bin, int key, u64 start,
+			       u64 end, u64 resolution)
+{
+	struct time_bin_entry *entry;
+	struct span *span;
+
+	entry = time_bin__find(bin, key, end, resolution);
+	if (entry) {
+		span = container_of(entry, struct span, entry);
+		if (start < span->start)
+			span->start = start;
+		if (end > span->end)
+			span->end = end;
+		span->busy += end - start;
+		return span;
+	}
+
+	if (nr_spans == NR_SPANS)
+		return NULL;
+
+	span = &spans[nr_spans++];
+	span->start = start;
+	span->end = end;
+	span->busy = end - start;
+	time_bin__add(bin, &span->entry, key, end, resolution);
+	return span;
+}
+
+int test__time_bins(int subtest __maybe_unused)
+{
+	struct time_bin bin = { .entries = NULL, };
+	struct span *span;
+	u64 t, busy = 0;
+	unsigned int i;
+
+	/* no resolution: nothing merged */
+	nr_spans = 0;
+	put_period(&bin, 0, 0, 10, 0);
+	put_period(&bin, 0, 20, 30, 0);
+	TEST_ASSERT_VAL("merged without a resolution", nr_spans == 2);
+
+	/*
+	 * A task migrating between two CPUs every 10ns, running 5ns of each
+	 * period, for 10 bins: one span per CPU and bin.
+	 */
+	nr_spans = 0;
+	memset(&bin, 0, sizeof(bin));
+	for (t = 0; t < 10 * RESOLUTION; t += 10) {
+		span = put_period(&bin, (t / 10) % 2, t, t + 5, RESOLUTION);
+		TEST_ASSERT_VAL("too many spans", span != NULL);
+		busy += 5;
+	}
+	TEST_ASSERT_EQUAL("wrong nr of spans", (int)nr_spans, 2 * 10);
+
+	for (i = 0, t = 0; i < nr_spans; i++) {
+		t += spans[i].busy;
+		TEST_ASSERT_VAL("span wider than its bin",
+				spans[i].end - spans[i].start <= RESOLUTION);
+		TEST_ASSERT_VAL("busy more than the span",
+				spans[i].busy <= spans[i].end - spans[i].start);
+	}
+	TEST_ASSERT_VAL("busy time lost", t == busy);
+
+	/* the first span of CPU 0 has the periods starting at 0, 20, ... 980 */
+	TEST_ASSERT_VAL("wrong span start", spans[0].start == 0);
+	TEST_ASSERT_VAL("wrong span end", spans[0].end == 985);
+	TEST_ASSERT_VAL("wrong span busy", spans[0].busy == 50 * 5);
+
+	/* a period ending on a bin boundary is in the next bin */
+	nr_spans = 0;
+	memset(&bin, 0, sizeof(bin));
+	put_period(&bin, 0, 900, 999, RESOLUTION);
+	span = put_period(&bin, 0, 999, 1000, RESOLUTION);
+	TEST_ASSERT_VAL("merged across bins", nr_spans == 2 && span == &spans[1]);
+
+	/* a long period from an earlier bin extends the span backwards */
+	span = put_period(&bin, 0, 100, 1500, RESOLUTION);
+	TEST_ASSERT_VAL("not merged", nr_spans == 2 && span == &spans[1]);
+	TEST_ASSERT_VAL("span not extended",
+			span->start == 100 && span->end == 1500 && span->busy == 1401);
+
+	return TEST_OK;
+}
@@ -0,0 +1,146 @@
+#include <linux/compiler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <traceevent/event-parse.h>
+#include "tests.h"
+#include "util.h"
+#include "debug.h"
+#include "trace-filter-synth.h"
+
+/*
+ * The filters are compiled into a program for a small stack machine, check
+ * that it matches the same records as the interpreted filter tree.
+ */
+#define NR_RECORDS		4096
+#define SCHED_SWITCH_ID		TRACE_FILTER_SYNTH_SCHED_SWITCH_ID
+#define SYS_ENTER_ID		TRACE_FILTER_SYNTH_SYS_ENTER_ID
+
+static const struct {
+	const char	*str;
+	int		event_id;
+	bool		compiled;
+} filters[] = {
+	/* the 'perf bench trace filter' ones */
+	{ "sched/sched_switch: prev_pid != 0 && next_pid != 0 && "
+	  "(prev_prio < 120 || next_prio < 120 || prev_state & 2) && "
+	  "prev_comm != \"swapper/0\"", SCHED_SWITCH_ID, true },
+	{ "raw_syscalls/sys_enter: id == 0 || id == 1 || id == 3 || "
+	  "id == 232 || (id >= 257 && id <= 262)", SYS_ENTER_ID, true },
+	/* AND binds tighter than OR */
+	{ "sched/sched_switch: prev_pid < 1000 || next_pid < 1000 && "
+	  "prev_prio > 110 || next_prio == 120", SCHED_SWITCH_ID, true },
+	{ "sched/sched_switch: !(prev_pid > 2000) && !(next_prio < 110 || "
+	  "prev_state == 0)", SCHED_SWITCH_ID, true },
+	/* strings and regexes */
+	{ "sched/sched_switch: prev_comm == \"task-5\" || next_comm != \"task-8\"",
+	  SCHED_SWITCH_ID, true },
+	{ "sched/sched_switch: prev_comm =~ \"^task-1\" && next_comm !~ \"7$\"",
+	  SCHED_SWITCH_ID, true },
+	/* arithmetic, tested for non zero, and signed fields */
+	{ "sched/sched_switch: prev_state & 1 || prev_pid % 7 && "
+	  "next_pid >> 11", SCHED_SWITCH_ID, true },
+	{ "sched/sched_switch: prev_prio - 120 && !(next_prio - 130) || "
+	  "prev_pid * next_pid", SCHED_SWITCH_ID, true },
+	{ "sched/sched_switch: prev_pid ^ next_pid && prev_pid | 1",
+	  SCHED_SWITCH_ID, true },
+	{ "raw_syscalls/sys_enter: id < 0 || common_pid > 2048 && id > 100",
+	  SYS_ENTER_ID, true },
+	/* fields missing from the format, CPU and COMM */
+	{ "sched/sched_switch: nonexistent == 1 || prev_pid < 100",
+	  SCHED_SWITCH_ID, true },
+	{ "raw_syscalls/sys_enter: COMM == \"task-5\" || CPU < 8",
+	  SYS_ENTER_ID, true },
+	/* the numeric value of COMM is left to the interpreter */
+	{ "raw_syscalls/sys_enter: COMM > 0 && id == 1",
+	  SYS_ENTER_ID, false },
+};
+
+static int test_filter(struct pevent *pevent, unsigned int idx,
+		       struct pevent_record **records,
+		       enum pevent_errno *results)
+{
+	struct event_filter *filter = pevent_filter_alloc(pevent);
+	enum pevent_errno compiled, tree;
+	unsigned int i, nr_matched = 0;
+	int ret = TEST_FAIL;
+
+	if (filter == NULL)
+		return TEST_FAIL;
+
+	if (pevent_filter_add_filter_str(filter, filters[idx].str) < 0) {
+		pr_debug("failed to add filter '%s'\n", filters[idx].str);
+		goto out;
+	}
+
+	if (pevent_filter_compiled(filter, filters[idx].event_id) !=
+	    filters[idx].compiled) {
+		pr_debug("filter '%s' is %scompiled\n", filters[idx].str,
+			 filters[idx].compiled ? "not " : "");
+		goto out;
+	}
+
+	if (pevent_filter_match_batch(filter, records, NR_RECORDS, results)) {
+		pr_debug("filter '%s' failed in a batch\n", filters[idx].str);
+		goto out;
+	}
+
+	for (i = 0; i < NR_RECORDS; i++) {
+		compiled = pevent_filter_match(filter, records[i]);
+		tree = pevent_filter_match_tree(filter, records[i]);
+
+		if (compiled != tree || results[i] != tree) {
+			pr_debug("filter '%s', record %u: compiled %d, batch %d, tree %d\n",
+				 filters[idx].str, i, compiled, results[i], tree);
+			goto out;
+		}
+		nr_matched += tree == PEVENT_ERRNO__FILTER_MATCH;
+	}
+
+	pr_debug("filter '%s': %u matches\n", filters[idx].str, nr_matched);
+	ret = TEST_OK;
+out:
+	pevent_filter_free(filter);
+	return ret;
+}
+
+int test__trace_filter(int subtest __maybe_unused)
+{
+	struct pevent_record *records = NULL, **record_ptrs = NULL;
+	enum pevent_errno *results = NULL;
+	struct pevent *pevent;
+	int ret = TEST_FAIL;
+	unsigned int i;
+
+	pevent = trace_filter_synth__pevent();
+	if (pevent == NULL)
+		return TEST_FAIL;
+
+	for (i = 0; i < 16; i++) {
+		char comm[16];
+
+		snprintf(comm, sizeof(comm), "task-%u", i);
+		pevent_register_comm(pevent, comm, i);
+	}
+
+	records = trace_filter_synth__records(NR_RECORDS);
+	record_ptrs = calloc(NR_RECORDS, sizeof(*record_ptrs));
+	results = calloc(NR_RECORDS, sizeof(*results));
+	if (!records || !record_ptrs || !results)
+		goto out;
+
+	for (i = 0; i < NR_RECORDS; i++)
+		record_ptrs[i] = &records[i];
+
+	for (i = 0; i < ARRAY_SIZE(filters); i++) {
+		if (test_filter(pevent, i, record_ptrs, results) != TEST_OK)
+			goto out;
+	}
+
+	ret = TEST_OK;
+out:
+	free(results);
+	free(record_ptrs);
+	free(records);
+	pevent_free(pevent);
+	return ret;
+}
@@ -33,6 +33,136 @@ static bool hist_browser__has_filter(struct hist_browser *hb)
 	return hists__has_filter(hb->hists) || hb->min_pcnt || symbol_conf.has_filter;
 }
 
+/*
+ * Row index: the non-filtered entries in output order, with a Fenwick tree
+ * over the number of rows each one takes on screen, i.e. its own line plus
+ * its expanded callchain.  Seeking to a row, counting the rows and folding
+ * an entry are then O(log n) instead of walking all the entries, and
+ * refreshing the screen only touches the visible ones.
+ *
+ * It is rebuilt in O(n) after filtering or resorting the entries, and is
+ * not used with --hierarchy, where the rows of an entry also depend on the
+ * folding of its parents.
+ */
+static u64 hist_entry__index_rows(struct hist_entry *he)
+{
+	return 1 + (he->unfolded ? he->nr_rows : 0);
+}
+
+static void row_index__add(struct hist_browser *hb, u32 idx, s64 delta)
+{
+	u32 i;
+
+	for (i = idx + 1; i <= hb->nr_row_entries; i += i & -i)
+		hb->row_tree[i] += delta;
+	hb->nr_index_rows += delta;
+}
+
+/* Number of rows before the entry at idx */
+static u64 row_index__prefix(struct hist_browser *hb, u32 idx)
+{
+	u64 rows = 0;
+	u32 i;
+
+	for (i = idx; i > 0; i -= i & -i)
+		rows += hb->row_tree[i];
+	return rows;
+}
+
+/* Index of the entry showing row, *offset being the row in that entry */
+static u32 row_index__find(struct hist_browser *hb, u64 row, u16 *offset)
+{
+	u32 pos = 0, step = 1;
+
+	while (step * 2 <= hb->nr_row_entries)
+		step *= 2;
+
+	for (; step; step /= 2) {
+		if (pos + step <= hb->nr_row_entries &&
+		    hb->row_tree[pos + step] <= row) {
+			pos += step;
+			row -= hb->row_tree[pos];
+		}
+	}
+
+	*offset = row;
+	return pos;
+}
+
+static bool row_index__has_entry(struct hist_browser *hb, struct hist_entry *he)
+{
+	return he->row_idx < hb->nr_row_entries &&
+	       hb->row_entries[he->row_idx] == he;
+}
+
+static int hist_browser__build_row_index(struct hist_browser *hb)
+{
+	struct rb_node *nd;
+	u32 nr = 0, i;
+
+	hb->row_index_valid = false;
+
+	for (nd = rb_first(&hb->hists->entries);
+	     (nd = hists__filter_entries(nd, hb->min_pcnt)) != NULL;
+	     nd = rb_hierarchy_next(nd))
+		nr++;
+
+	if (nr > hb->row_entries_size) {
+		struct hist_entry **entries;
+		u64 *tree;
+
+		entries = realloc(hb->row_entries, nr * sizeof(*entries));
+		if (entries == NULL)
+			return -ENOMEM;
+		hb->row_entries = entries;
+
+		tree = realloc(hb->row_tree, (nr + 1) * sizeof(*tree));
+		if (tree == NULL)
+			return -ENOMEM;
+		hb->row_tree = tree;
+
+		hb->row_entries_size = nr;
+	}
+
+	hb->nr_row_entries = nr;
+	hb->nr_index_rows = 0;
+
+	nr = 0;
+	for (nd = rb_first(&hb->hists->entries);
+	     (nd = hists__filter_entries(nd, hb->min_pcnt)) != NULL;
+	     nd = rb_hierarchy_next(nd)) {
+		struct hist_entry *he = rb_entry(nd, struct hist_entry, rb_node);
+
+		he->row_idx = nr;
+		hb->row_entries[nr++] = he;
+		hb->row_tree[nr] = hist_entry__index_rows(he);
+		hb->nr_index_rows += hb->row_tree[nr];
+	}
+
+	/* Push each node to its parent, in order, to build the tree in O(n) */
+	for (i = 1; i <= nr; i++) {
+		u32 parent = i + (i & -i);
+
+		if (parent <= nr)
+			hb->row_tree[parent] += hb->row_tree[i];
+	}
+
+	hb->row_index_valid = true;
+	return 0;
+}
+
+/* Falls back to walking the entries if the index can't be allocated */
+static bool hist_browser__has_row_index(struct hist_browser *hb)
+{
+	if (symbol_conf.report_hierarchy)
+		return false;
+
+	if (!hb->row_index_valid)
+		hist_browser__build_row_index(hb);
+
+	return hb->row_index_valid;
+}
+
 static int hist_browser__get_folding(struct hist_browser *browser)
 {
 	struct rb_node *nd;
@@ -55,6 +185,11 @@ static u32 hist_browser__nr_entries(struct hist_browser *hb)
 {
 	u32 nr_entries;
 
+	if (hist_browser__has_row_index(hb)) {
+		hb->nr_callchain_rows = hb->nr_index_rows - hb->nr_row_entries;
+		return hb->nr_index_rows;
+	}
+
 	if (symbol_conf.report_hierarchy)
 		nr_entries = hb->nr_hierarchy_entries;
 	else if (hist_browser__has_filter(hb))
@@ -362,10 +497,13 @@ static bool hist_browser__toggle_fold(struct hist_browser *browser)
 	struct map_symbol *ms = browser->selection;
 	struct callchain_list *cl = container_of(ms, struct callchain_list, ms);
 	bool has_children;
+	u64 index_rows;
 
 	if (!he || !ms)
 		return false;
 
+	index_rows = hist_entry__index_rows(he);
+
 	if (ms == &he->ms)
 		has_children = hist_entry__toggle_fold(he);
 	else
@@ -416,6 +554,14 @@ static bool hist_browser__toggle_fold(struct hist_browser *browser)
 		else
 			browser->nr_hierarchy_entries += he->nr_rows;
 
+		if (browser->row_index_valid) {
+			if (row_index__has_entry(browser, he))
+				row_index__add(browser, he->row_idx,
+					       hist_entry__index_rows(he) - index_rows);
+			else
+				browser->row_index_valid = false;
+		}
+
 		return true;
 	}
 
@@ -551,6 +697,7 @@ static void hist_browser__set_folding(struct hist_browser *browser, bool unfold)
 {
 	browser->nr_hierarchy_entries = 0;
 	browser->nr_callchain_rows = 0;
+	browser->row_index_valid = false;
 	__hist_browser__set_folding(browser, unfold);
 
 	browser->b.nr_entries = hist_browser__nr_entries(browser);
@@ -595,6 +742,9 @@ int hist_browser__run(struct hist_browser *browser, const char *help)
 			u64 nr_entries;
 			hbt->timer(hbt->arg);
 
+			/* the entries may have been resorted or deleted */
+			browser->row_index_valid = false;
+
 			if (hist_browser__has_filter(browser))
 				hist_browser__update_nr_entries(browser);
 
@@ -1666,6 +1816,25 @@ static unsigned int hist_browser__refresh(struct ui_browser *browser)
 	hb->he_selection = NULL;
 	hb->selection = NULL;
 
+	if (hist_browser__has_row_index(hb)) {
+		struct hist_entry *h;
+		u32 idx = 0;
+
+		if (browser->top) {
+			h = rb_entry(browser->top, struct hist_entry, rb_node);
+			if (row_index__has_entry(hb, h))
+				idx = h->row_idx;
+		}
+
+		for (; idx < hb->nr_row_entries; idx++) {
+			row += hist_browser__show_entry(hb, hb->row_entries[idx], row);
+			if (row == browser->rows)
+				break;
+		}
+
+		return row + header_offset;
+	}
+
 	for (nd = browser->top; nd; nd = rb_hierarchy_next(nd)) {
 		struct hist_entry *h = rb_entry(nd, struct hist_entry, rb_node);
 		float percent;
@@ -1740,6 +1909,46 @@ static struct rb_node *hists__filter_prev_entries(struct rb_node *nd,
 	return NULL;
 }
 
+static void hist_browser__index_seek(struct hist_browser *hb,
+				     off_t offset, int whence)
+{
+	struct ui_browser *browser = &hb->b;
+	struct hist_entry *h = rb_entry(browser->top, struct hist_entry, rb_node);
+	s64 row;
+	u32 idx;
+	u16 off;
+
+	switch (whence) {
+	case SEEK_SET:
+		row = 0;
+		break;
+	case SEEK_CUR:
+		row = 0;
+		if (row_index__has_entry(hb, h))
+			row = row_index__prefix(hb, h->row_idx) + h->row_offset;
+		break;
+	case SEEK_END:
+		row = hb->nr_index_rows - 1;
+		break;
+	default:
+		return;
+	}
+
+	row += offset;
+	if (row < 0)
+		row = 0;
+	if (row >= (s64)hb->nr_index_rows)
+		row = hb->nr_index_rows - 1;
+
+	/* only the first visible entry has a row_offset */
+	h->row_offset = 0;
+
+	idx = row_index__find(hb, row, &off);
+	h = hb->row_entries[idx];
+	h->row_offset = off;
+	browser->top = &h->rb_node;
+}
+
 static void ui_browser__hists_seek(struct ui_browser *browser,
 				   off_t offset, int whence)
 {
@@ -1755,6 +1964,12 @@ static void ui_browser__hists_seek(struct ui_browser *browser,
 
 	ui_browser__hists_init_top(browser);
 
+	if (hist_browser__has_row_index(hb)) {
+		if (hb->nr_index_rows)
+			hist_browser__index_seek(hb, offset, whence);
+		return;
+	}
+
 	switch (whence) {
 	case SEEK_SET:
 		nd = hists__filter_entries(rb_first(browser->entries),
@@ -2087,6 +2302,8 @@ perf_evsel_browser__new(struct perf_evsel *evsel,
 
 void hist_browser__delete(struct hist_browser *browser)
 {
+	free(browser->row_entries);
+	free(browser->row_tree);
 	free(browser);
 }
 
@@ -2603,6 +2820,8 @@ static void hist_browser__update_nr_entries(struct hist_browser *hb)
 	u64 nr_entries = 0;
 	struct rb_node *nd = rb_first(&hb->hists->entries);
 
+	hb->row_index_valid = false;
+
 	if (hb->min_pcnt == 0 && !symbol_conf.report_hierarchy) {
 		hb->nr_non_filtered_entries = hb->hists->nr_non_filtered_entries;
 		return;
@@ -2626,6 +2845,7 @@ static void hist_browser__update_percent_limit(struct hist_browser *hb,
 	u64 min_callchain_hits = total * (percent / 100);
 
 	hb->min_pcnt = callchain_param.min_percent = percent;
+	hb->row_index_valid = false;
 
 	while ((nd = hists__filter_entries(nd, hb->min_pcnt)) != NULL) {
 		he = rb_entry(nd, struct hist_entry, rb_node);
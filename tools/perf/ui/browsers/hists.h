@@ -19,6 +19,17 @@ struct hist_browser {
 	u64		     nr_hierarchy_entries;
 	u64		     nr_callchain_rows;
 
+	/*
+	 * Row index of the non-filtered entries, rebuilt after filtering
+	 * or resorting, see hist_browser__build_row_index().
+	 */
+	struct hist_entry   **row_entries;
+	u64		    *row_tree;
+	u32		     nr_row_entries;
+	u32		     row_entries_size;
+	u64		     nr_index_rows;
+	bool		     row_index_valid;
+
 	/* Get title string. */
 	int                  (*title)(struct hist_browser *browser,
 			     char *bf, size_t size);
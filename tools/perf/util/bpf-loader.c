@@ -1589,6 +1589,87 @@ int bpf__setup_stdout(struct perf_evlist *evlist __maybe_unused)
 	return 0;
 }
 
+/*
+ * Compile a program embedded in perf, through a temporary file as clang
+ * reads the source from a file, and add its events to list, numbered
+ * after the ones of evlist.  'what' names the program in the messages.
+ */
+struct bpf_object *bpf__load_source(const char *what, const char *source,
+				    struct perf_evlist *evlist,
+				    struct list_head *list)
+{
+	char path[] = "/tmp/perf-bpf-XXXXXX.c";
+	struct parse_events_evlist data;
+	struct parse_events_error error;
+	struct perf_evsel *evsel, *tmp;
+	struct bpf_object *obj;
+	char errbuf[BUFSIZ];
+	int fd, err;
+
+	fd = mkstemps(path, 2);
+	if (fd < 0) {
+		err = -errno;
+		pr_err("Failed to create the %s BPF source: %s\n", what,
+		       str_error_r(errno, errbuf, sizeof(errbuf)));
+		return ERR_PTR(err);
+	}
+
+	err = writen(fd, (void *)source, strlen(source));
+	close(fd);
+	if (err < 0) {
+		unlink(path);
+		return ERR_PTR(err);
+	}
+
+	obj = bpf__prepare_load(path, true);
+	if (IS_ERR(obj)) {
+		bpf__strerror_prepare_load(path, true, PTR_ERR(obj),
+					   errbuf, sizeof(errbuf));
+		pr_err("Failed to load the %s BPF program: %s\n", what, errbuf);
+		unlink(path);
+		return obj;
+	}
+	unlink(path);
+
+	bzero(&error, sizeof(error));
+	bzero(&data, sizeof(data));
+	data.error = &error;
+	data.idx = evlist->nr_entries;
+	INIT_LIST_HEAD(list);
+
+	err = parse_events_load_bpf_obj(&data, list, obj, NULL);
+	if (err || list_empty(list)) {
+		pr_err("Failed to add the %s BPF events: %s\n", what,
+		       error.str ?: "no events");
+		free(error.str);
+		free(error.help);
+		list_for_each_entry_safe(evsel, tmp, list, node) {
+			list_del_init(&evsel->node);
+			perf_evsel__delete(evsel);
+		}
+		bpf_object__close(obj);
+		return ERR_PTR(err ?: -EINVAL);
+	}
+
+	return obj;
+}
+
+struct bpf_map *bpf__find_map(struct bpf_object *obj, const char *name)
+{
+	struct bpf_map *map;
+
+	if (obj == NULL)
+		return ERR_PTR(-EINVAL);
+
+	map = bpf_object__find_map_by_name(obj, name);
+	if (IS_ERR(map) || map == NULL) {
+		pr_debug("bpf: map '%s' not found\n", name);
+		return ERR_PTR(-ENOENT);
+	}
+
+	return map;
+}
+
 #define ERRNO_OFFSET(e)		((e) - __BPF_LOADER_ERRNO__START)
 #define ERRCODE_OFFSET(c)	ERRNO_OFFSET(BPF_LOADER_ERRNO__##c)
 #define NR_ERRNO	(__BPF_LOADER_ERRNO__END - __BPF_LOADER_ERRNO__START)
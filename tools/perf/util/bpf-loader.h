@@ -84,6 +84,11 @@ int bpf__setup_stdout(struct perf_evlist *evlist);
 int bpf__strerror_setup_stdout(struct perf_evlist *evlist, int err,
 			       char *buf, size_t size);
 
+struct bpf_object *bpf__load_source(const char *what, const char *source,
+				    struct perf_evlist *evlist,
+				    struct list_head *list);
+struct bpf_map *bpf__find_map(struct bpf_object *obj, const char *name);
+
 #else
 static inline struct bpf_object *
 bpf__prepare_load(const char *filename __maybe_unused,
@@ -135,6 +140,23 @@ bpf__setup_stdout(struct perf_evlist *evlist __maybe_unused)
 	return 0;
 }
 
+static inline struct bpf_object *
+bpf__load_source(const char *what __maybe_unused,
+		 const char *source __maybe_unused,
+		 struct perf_evlist *evlist __maybe_unused,
+		 struct list_head *list __maybe_unused)
+{
+	pr_debug("ERROR: eBPF object loading is disabled during compiling.\n");
+	return ERR_PTR(-ENOTSUP);
+}
+
+static inline struct bpf_map *
+bpf__find_map(struct bpf_object *obj __maybe_unused,
+	      const char *name __maybe_unused)
+{
+	return ERR_PTR(-ENOTSUP);
+}
+
 static inline int
 __bpf_strerror(char *buf, size_t size)
 {
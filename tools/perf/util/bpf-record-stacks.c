@@ -0,0 +1,287 @@
+/*
+ * In-kernel callchain aggregation for 'perf record --bpf-stacks', see
+ * util/bpf-script-record-stacks.c for the BPF side.
+ */
+#include <linux/err.h>
+#include <linux/bitmap.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bpf-record-stacks.h"
+#include "bpf-loader.h"
+#include "evlist.h"
+#include "machine.h"
+#include "symbol.h"
+#include "util.h"
+#include "debug.h"
+
+/*
+ * Offset of the first argument register in the kernel's struct pt_regs,
+ * where the tick handler gets whether the tick hit user mode.
+ */
+#if defined(__x86_64__)
+# define TICK_ARG1_OFFSET	(14 * 8)	/* di */
+#elif defined(__aarch64__)
+# define TICK_ARG1_OFFSET	0		/* regs[0] */
+#else
+# define TICK_ARG1_OFFSET	-1
+#endif
+
+static struct bpf_object *stacks_obj;
+
+static struct bpf_map *stacks_map(const char *name)
+{
+	return bpf__find_map(stacks_obj, name);
+}
+
+static int stacks_map_fd(const char *name)
+{
+	struct bpf_map *map = stacks_map(name);
+
+	return IS_ERR(map) ? PTR_ERR(map) : bpf_map__fd(map);
+}
+
+/*
+ * Compile the embedded program through the usual llvm/bpf-loader path and
+ * add its tick kprobe and sched:sched_process_fork events to evlist, the
+ * samples are written to the tick one, returned in *stacks_evsel.
+ */
+int bpf_record_stacks__add_events(struct perf_evlist *evlist,
+				  struct perf_evsel **stacks_evsel)
+{
+	struct perf_evsel *evsel;
+	struct bpf_object *obj;
+	LIST_HEAD(list);
+	char *source;
+
+	if (asprintf(&source, "#define TICK_ARG1_OFFSET %d\n%s",
+		     TICK_ARG1_OFFSET, bpf_record_stacks__prog) < 0)
+		return -ENOMEM;
+
+	obj = bpf__load_source("record stacks", source, evlist, &list);
+	free(source);
+	if (IS_ERR(obj))
+		return PTR_ERR(obj);
+
+	*stacks_evsel = NULL;
+	list_for_each_entry(evsel, &list, node) {
+		if (strstr(perf_evsel__name(evsel), ":bpf_stacks"))
+			*stacks_evsel = evsel;
+	}
+
+	perf_evlist__splice_list_tail(evlist, &list);
+	stacks_obj = obj;
+	return 0;
+}
+
+int bpf_record_stacks__filter_pid(pid_t pid, bool include)
+{
+	int fd = stacks_map_fd("bpf_stacks_pids");
+	u32 key = pid, value = include;
+
+	if (fd < 0)
+		return fd;
+
+	return bpf_map_update_elem(fd, &key, &value, BPF_ANY) ? -errno : 0;
+}
+
+int bpf_record_stacks__filter_only(bool only, bool by_tid)
+{
+	int fd = stacks_map_fd("bpf_stacks_config");
+	u32 key = 1, value = by_tid;
+
+	if (fd < 0)
+		return fd;
+
+	if (bpf_map_update_elem(fd, &key, &value, BPF_ANY))
+		return -errno;
+
+	key = 0;
+	value = only;
+	return bpf_map_update_elem(fd, &key, &value, BPF_ANY) ? -errno : 0;
+}
+
+/*
+ * The timer interrupt path, from the tick handling to the interrupt entry,
+ * on x86 and arm64, with and without high resolution timers.
+ */
+static const char * const tick_functions[] = {
+	"update_process_times",
+	"tick_sched_handle",
+	"tick_sched_timer",
+	"tick_periodic",
+	"tick_handle_periodic",
+	"__hrtimer_run_queues",
+	"hrtimer_interrupt",
+	"local_apic_timer_interrupt",
+	"smp_apic_timer_interrupt",
+	"smp_trace_apic_timer_interrupt",
+	"apic_timer_interrupt",
+	"trace_apic_timer_interrupt",
+	"arch_timer_handler_phys",
+	"arch_timer_handler_virt",
+	"handle_percpu_devid_irq",
+	"generic_handle_irq",
+	"__handle_domain_irq",
+	"gic_handle_irq",
+	"el1_irq",
+};
+
+static bool tick_function(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(tick_functions); i++) {
+		if (!strcmp(name, tick_functions[i]))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * The program runs in the tick, its kernel stacks start with the timer
+ * interrupt path, minus the probed function that it skips.  Drop the rest
+ * of that path, so that the leaf frame is the interrupted code.  Returns
+ * false when that can't be checked, i.e. no frame is left or the leaf
+ * frame doesn't resolve to a kernel function.
+ */
+bool bpf_record_stacks__skip_tick(struct bpf_stacks_entry *entry,
+				  struct machine *machine)
+{
+	struct symbol *sym = NULL;
+	u32 i;
+
+	for (i = 0; i < entry->nr_kstack; i++) {
+		sym = machine__find_kernel_function(machine, entry->kstack[i],
+						    NULL, NULL);
+		if (sym == NULL || !tick_function(sym->name))
+			break;
+	}
+
+	if (i) {
+		entry->nr_kstack -= i;
+		memmove(entry->kstack, entry->kstack + i,
+			entry->nr_kstack * sizeof(u64));
+	}
+
+	return entry->nr_kstack && sym != NULL;
+}
+
+/* The stack trace map zero fills the entries after the last frame */
+static u32 stacks__read(int fd, s32 id, u64 *ips)
+{
+	u32 nr;
+
+	if (id < 0 || bpf_map_lookup_elem(fd, &id, ips))
+		return 0;
+
+	for (nr = 0; nr < PERF_MAX_STACK_DEPTH && ips[nr]; nr++)
+		;
+	return nr;
+}
+
+static void stacks__mark(unsigned long *ids, u32 nr_ids, s32 id)
+{
+	if (id >= 0 && (u32)id < nr_ids)
+		set_bit(id, ids);
+}
+
+/*
+ * Delete the stack traces of the walked counts, but the ones that the
+ * counts added since then still use.  A stack coming back later is stored
+ * again, with the same id.
+ */
+static void stacks__clear(int counts_fd, int traces_fd, unsigned long *ids,
+			  u32 nr_ids)
+{
+	struct bpf_stacks_key key, next;
+	u32 id;
+
+	memset(&key, 0xff, sizeof(key));
+	while (bpf_map_get_next_key(counts_fd, &key, &next) == 0) {
+		key = next;
+		if (key.kstack >= 0 && (u32)key.kstack < nr_ids)
+			clear_bit(key.kstack, ids);
+		if (key.ustack >= 0 && (u32)key.ustack < nr_ids)
+			clear_bit(key.ustack, ids);
+	}
+
+	for_each_set_bit(id, ids, nr_ids)
+		bpf_map_delete_elem(traces_fd, &id);
+}
+
+/*
+ * Walk the per (pid, tid, stacks) counts.  The cost is proportional to the
+ * number of distinct stacks, not to the number of ticks.  With clear, the
+ * counts and their stack traces are removed once walked, so that the next
+ * walk only has the counts since this one, and the stack map doesn't fill
+ * up with the stacks of the past periods.
+ */
+int bpf_record_stacks__for_each(bpf_stacks_cb_t cb, void *arg, bool clear)
+{
+	struct bpf_map *traces = stacks_map("bpf_stacks_traces");
+	int counts_fd = stacks_map_fd("bpf_stacks_counts");
+	struct bpf_stacks_key key, next;
+	struct bpf_stacks_entry *entry;
+	unsigned long *ids = NULL;
+	bool walked = false;
+	int traces_fd, err = 0;
+	u32 nr_ids = 0;
+
+	if (counts_fd < 0)
+		return counts_fd;
+	if (IS_ERR(traces))
+		return PTR_ERR(traces);
+	traces_fd = bpf_map__fd(traces);
+
+	entry = malloc(sizeof(*entry));
+	if (entry == NULL)
+		return -ENOMEM;
+
+	if (clear) {
+		nr_ids = bpf_map__def(traces)->max_entries;
+		ids = bitmap_alloc(nr_ids);
+		if (ids == NULL) {
+			free(entry);
+			return -ENOMEM;
+		}
+	}
+
+	/* a key that is not in the map starts the iteration */
+	memset(&key, 0xff, sizeof(key));
+
+	while (!err && bpf_map_get_next_key(counts_fd, &key, &next) == 0) {
+		if (clear && walked)
+			bpf_map_delete_elem(counts_fd, &key);
+		key = next;
+		walked = false;
+
+		if (bpf_map_lookup_elem(counts_fd, &key, &entry->count))
+			continue;
+
+		entry->key = key;
+		entry->nr_kstack = stacks__read(traces_fd, key.kstack, entry->kstack);
+		entry->nr_ustack = stacks__read(traces_fd, key.ustack, entry->ustack);
+
+		err = cb(entry, arg);
+		walked = true;
+		if (clear) {
+			stacks__mark(ids, nr_ids, key.kstack);
+			stacks__mark(ids, nr_ids, key.ustack);
+		}
+	}
+
+	if (clear && walked)
+		bpf_map_delete_elem(counts_fd, &key);
+
+	if (clear)
+		stacks__clear(counts_fd, traces_fd, ids, nr_ids);
+
+	free(ids);
+	free(entry);
+	return err;
+}
@@ -0,0 +1,86 @@
+#ifndef __PERF_BPF_RECORD_STACKS_H
+#define __PERF_BPF_RECORD_STACKS_H
+
+#include <linux/compiler.h>
+#include <linux/types.h>
+#include <linux/perf_event.h>
+#include <sys/types.h>
+#include <stdbool.h>
+#include <errno.h>
+#include "debug.h"
+
+/*
+ * Map layout of util/bpf-script-record-stacks.c, keep it in sync.
+ * A negative stack id means there was no stack, or it was lost.
+ */
+struct bpf_stacks_key {
+	u32	pid;
+	u32	tid;
+	s32	kstack;
+	s32	ustack;
+};
+
+struct bpf_stacks_entry {
+	struct bpf_stacks_key	key;
+	u64			count;
+	u32			nr_kstack;
+	u32			nr_ustack;
+	u64			kstack[PERF_MAX_STACK_DEPTH];
+	u64			ustack[PERF_MAX_STACK_DEPTH];
+};
+
+typedef int (*bpf_stacks_cb_t)(struct bpf_stacks_entry *entry, void *arg);
+
+struct perf_evlist;
+struct perf_evsel;
+struct machine;
+
+#ifdef HAVE_LIBBPF_SUPPORT
+extern const char bpf_record_stacks__prog[];
+
+int bpf_record_stacks__add_events(struct perf_evlist *evlist,
+				  struct perf_evsel **stacks_evsel);
+int bpf_record_stacks__filter_pid(pid_t pid, bool include);
+int bpf_record_stacks__filter_only(bool only, bool by_tid);
+int bpf_record_stacks__for_each(bpf_stacks_cb_t cb, void *arg, bool clear);
+bool bpf_record_stacks__skip_tick(struct bpf_stacks_entry *entry,
+				  struct machine *machine);
+#else
+static inline int
+bpf_record_stacks__add_events(struct perf_evlist *evlist __maybe_unused,
+			      struct perf_evsel **stacks_evsel __maybe_unused)
+{
+	pr_err("ERROR: eBPF object loading is disabled during compiling.\n");
+	return -ENOTSUP;
+}
+
+static inline int
+bpf_record_stacks__filter_pid(pid_t pid __maybe_unused,
+			      bool include __maybe_unused)
+{
+	return -ENOTSUP;
+}
+
+static inline int
+bpf_record_stacks__filter_only(bool only __maybe_unused,
+			       bool by_tid __maybe_unused)
+{
+	return -ENOTSUP;
+}
+
+static inline int
+bpf_record_stacks__for_each(bpf_stacks_cb_t cb __maybe_unused,
+			    void *arg __maybe_unused,
+			    bool clear __maybe_unused)
+{
+	return -ENOTSUP;
+}
+
+static inline bool
+bpf_record_stacks__skip_tick(struct bpf_stacks_entry *entry __maybe_unused,
+			     struct machine *machine __maybe_unused)
+{
+	return true;
+}
+#endif
+#endif /* __PERF_BPF_RECORD_STACKS_H */
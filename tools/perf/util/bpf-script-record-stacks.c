@@ -0,0 +1,201 @@
+/*
+ * bpf-script-record-stacks.c
+ *
+ * In-kernel callchain aggregation for 'perf record --bpf-stacks'.
+ *
+ * A kprobe on the scheduler tick counts the (pid, tid, kernel stack,
+ * user stack) of the interrupted task in a hash map, the stacks being
+ * stored once in a stack trace map.  The program returns 0, so no sample
+ * ever reaches the ring buffer, perf record writes the map contents to
+ * perf.data as samples weighted by their count.
+ *
+ * The map layouts must match struct bpf_stacks_key in
+ * util/bpf-record-stacks.h.
+ */
+#ifndef LINUX_VERSION_CODE
+# error Need LINUX_VERSION_CODE
+# error Example: for 4.2 kernel, put 'clang-opt="-DLINUX_VERSION_CODE=0x40200" into llvm section of ~/.perfconfig'
+#endif
+
+/*
+ * Offset of the first argument register in the struct pt_regs of the
+ * kprobe, to tell the ticks in user mode, or -1 to always walk both
+ * stacks.
+ */
+#ifndef TICK_ARG1_OFFSET
+# define TICK_ARG1_OFFSET -1
+#endif
+
+/* The first kernel frame is the probed function */
+#define TICK_STACK_SKIP 1
+
+#define BPF_ANY 0
+#define BPF_NOEXIST 1
+#define BPF_MAP_TYPE_HASH 1
+#define BPF_MAP_TYPE_ARRAY 2
+#define BPF_MAP_TYPE_STACK_TRACE 7
+#define BPF_FUNC_map_lookup_elem 1
+#define BPF_FUNC_map_update_elem 2
+#define BPF_FUNC_get_current_pid_tgid 14
+#define BPF_FUNC_get_stackid 27
+#define BPF_F_SKIP_FIELD_MASK 0xffULL
+#define BPF_F_USER_STACK (1ULL << 8)
+#define BPF_F_REUSE_STACKID (1ULL << 10)
+#define PERF_MAX_STACK_DEPTH 127
+
+typedef int s32;
+typedef unsigned int u32;
+typedef unsigned long long u64;
+
+static void *(*bpf_map_lookup_elem)(void *map, void *key) =
+	(void *) BPF_FUNC_map_lookup_elem;
+static int (*bpf_map_update_elem)(void *map, void *key, void *value, u64 flags) =
+	(void *) BPF_FUNC_map_update_elem;
+static u64 (*bpf_get_current_pid_tgid)(void) =
+	(void *) BPF_FUNC_get_current_pid_tgid;
+static int (*bpf_get_stackid)(void *ctx, void *map, u64 flags) =
+	(void *) BPF_FUNC_get_stackid;
+
+struct bpf_map_def {
+	unsigned int type;
+	unsigned int key_size;
+	unsigned int value_size;
+	unsigned int max_entries;
+};
+
+struct bpf_stacks_key {
+	u32 pid;
+	u32 tid;
+	s32 kstack;
+	s32 ustack;
+};
+
+struct sched_process_fork_args {
+	u64 common;
+	char parent_comm[16];
+	u32 parent_pid;
+	char child_comm[16];
+	u32 child_pid;
+};
+
+#define SEC(NAME) __attribute__((section(NAME), used))
+
+/*
+ * [0]: when set, only the ids marked 1 in bpf_stacks_pids are counted
+ * [1]: when set, the ids are tids, otherwise tgids
+ */
+struct bpf_map_def SEC("maps") bpf_stacks_config = {
+	.type = BPF_MAP_TYPE_ARRAY,
+	.key_size = sizeof(u32),
+	.value_size = sizeof(u32),
+	.max_entries = 2,
+};
+
+/* id -> 1 to include, 0 to exclude (perf itself) */
+struct bpf_map_def SEC("maps") bpf_stacks_pids = {
+	.type = BPF_MAP_TYPE_HASH,
+	.key_size = sizeof(u32),
+	.value_size = sizeof(u32),
+	.max_entries = 16384,
+};
+
+struct bpf_map_def SEC("maps") bpf_stacks_counts = {
+	.type = BPF_MAP_TYPE_HASH,
+	.key_size = sizeof(struct bpf_stacks_key),
+	.value_size = sizeof(u64),
+	.max_entries = 65536,
+};
+
+/*
+ * A stack colliding with another one in this map replaces it, perf record
+ * deletes the stacks of the counts it has written.
+ */
+struct bpf_map_def SEC("maps") bpf_stacks_traces = {
+	.type = BPF_MAP_TYPE_STACK_TRACE,
+	.key_size = sizeof(u32),
+	.value_size = PERF_MAX_STACK_DEPTH * sizeof(u64),
+	.max_entries = 16384,
+};
+
+static inline u32 filter_id(u64 pid_tgid)
+{
+	u32 key = 1, *by_tid;
+
+	by_tid = bpf_map_lookup_elem(&bpf_stacks_config, &key);
+	if (by_tid && *by_tid)
+		return pid_tgid;
+	return pid_tgid >> 32;
+}
+
+static inline int pid_filtered(u64 pid_tgid)
+{
+	u32 key = 0, id = filter_id(pid_tgid), *only, *mode;
+
+	mode = bpf_map_lookup_elem(&bpf_stacks_pids, &id);
+	if (mode)
+		return !*mode;
+
+	only = bpf_map_lookup_elem(&bpf_stacks_config, &key);
+	return only && *only;
+}
+
+SEC("bpf_stacks=update_process_times")
+int bpf_stacks(void *ctx)
+{
+	u64 pid_tgid = bpf_get_current_pid_tgid();
+	struct bpf_stacks_key key;
+	u64 one = 1, *count;
+	int user_tick = 0;
+
+	if (pid_filtered(pid_tgid))
+		return 0;
+
+#if TICK_ARG1_OFFSET >= 0
+	user_tick = *(unsigned long *)((char *)ctx + TICK_ARG1_OFFSET);
+#endif
+
+	key.pid = pid_tgid >> 32;
+	key.tid = pid_tgid;
+	/*
+	 * In kernel mode, the stack starts with the tick handling, skip the
+	 * probed function here, perf record drops the rest of the interrupt
+	 * path, which depends on the kernel.
+	 */
+	key.kstack = user_tick ? -1 :
+		     bpf_get_stackid(ctx, &bpf_stacks_traces,
+				     (TICK_STACK_SKIP & BPF_F_SKIP_FIELD_MASK) |
+				     BPF_F_REUSE_STACKID);
+	key.ustack = bpf_get_stackid(ctx, &bpf_stacks_traces,
+				     BPF_F_USER_STACK | BPF_F_REUSE_STACKID);
+
+	/* The idle tasks of all the CPUs share tid 0 */
+	count = bpf_map_lookup_elem(&bpf_stacks_counts, &key);
+	if (count) {
+		__sync_fetch_and_add(count, 1);
+	} else if (bpf_map_update_elem(&bpf_stacks_counts, &key, &one, BPF_NOEXIST)) {
+		count = bpf_map_lookup_elem(&bpf_stacks_counts, &key);
+		if (count)
+			__sync_fetch_and_add(count, 1);
+	}
+	return 0;
+}
+
+/*
+ * Count the children of the included tasks too, like the inherited
+ * events do.  This runs in the parent, the child id is a tgid for a new
+ * process and a tid for a new thread, which only matters with tid ids.
+ */
+SEC("sched:sched_process_fork")
+int sched_process_fork(struct sched_process_fork_args *args)
+{
+	u32 id = filter_id(bpf_get_current_pid_tgid());
+	u32 child = args->child_pid, one = 1, *mode;
+
+	mode = bpf_map_lookup_elem(&bpf_stacks_pids, &id);
+	if (mode && *mode)
+		bpf_map_update_elem(&bpf_stacks_pids, &child, &one, BPF_NOEXIST);
+	return 0;
+}
+
+char _license[] SEC("license") = "GPL";
+int _version SEC("version") = LINUX_VERSION_CODE;
@@ -0,0 +1,263 @@
+/*
+ * bpf-script-trace-summary.c
+ *
+ * In-kernel syscall aggregation for 'perf trace --summary --bpf-summary'.
+ *
+ * Counts, total/min/max latency and a log2 latency histogram are kept per
+ * (tid, syscall) in hash maps, user space only reads the maps.  Both
+ * programs return 0, so no sample ever reaches the ring buffer.
+ *
+ * The map layouts must match struct syscall_summary_* in
+ * util/bpf-trace-summary.h.
+ */
+#ifndef LINUX_VERSION_CODE
+# error Need LINUX_VERSION_CODE
+# error Example: for 4.2 kernel, put 'clang-opt="-DLINUX_VERSION_CODE=0x40200" into llvm section of ~/.perfconfig'
+#endif
+#define BPF_ANY 0
+#define BPF_NOEXIST 1
+#define BPF_MAP_TYPE_HASH 1
+#define BPF_MAP_TYPE_ARRAY 2
+#define BPF_FUNC_map_lookup_elem 1
+#define BPF_FUNC_map_update_elem 2
+#define BPF_FUNC_map_delete_elem 3
+#define BPF_FUNC_ktime_get_ns 5
+#define BPF_FUNC_get_current_pid_tgid 14
+
+typedef unsigned int u32;
+typedef unsigned long long u64;
+
+static void *(*bpf_map_lookup_elem)(void *map, void *key) =
+	(void *) BPF_FUNC_map_lookup_elem;
+static int (*bpf_map_update_elem)(void *map, void *key, void *value, u64 flags) =
+	(void *) BPF_FUNC_map_update_elem;
+static int (*bpf_map_delete_elem)(void *map, void *key) =
+	(void *) BPF_FUNC_map_delete_elem;
+static u64 (*bpf_ktime_get_ns)(void) =
+	(void *) BPF_FUNC_ktime_get_ns;
+static u64 (*bpf_get_current_pid_tgid)(void) =
+	(void *) BPF_FUNC_get_current_pid_tgid;
+
+struct bpf_map_def {
+	unsigned int type;
+	unsigned int key_size;
+	unsigned int value_size;
+	unsigned int max_entries;
+};
+
+struct syscall_summary_key {
+	u32 tid;
+	u32 id;
+};
+
+struct syscall_summary_stats {
+	u64 count;
+	u64 total;
+	u64 min;
+	u64 max;
+};
+
+struct syscall_summary_hist_key {
+	u32 tid;
+	u32 id;
+	u32 slot;
+	u32 pad;
+};
+
+struct syscall_summary_entry {
+	u64 time;
+	u64 id;
+};
+
+struct syscall_enter_args {
+	u64 common;
+	long id;
+	unsigned long args[6];
+};
+
+struct syscall_exit_args {
+	u64 common;
+	long id;
+	long ret;
+};
+
+struct sched_process_fork_args {
+	u64 common;
+	char parent_comm[16];
+	u32 parent_pid;
+	char child_comm[16];
+	u32 child_pid;
+};
+
+#define SEC(NAME) __attribute__((section(NAME), used))
+
+/*
+ * [0]: when set, only the ids marked 1 in syscall_summary_pids are counted
+ * [1]: when set, the ids are tids, otherwise tgids
+ */
+struct bpf_map_def SEC("maps") syscall_summary_config = {
+	.type = BPF_MAP_TYPE_ARRAY,
+	.key_size = sizeof(u32),
+	.value_size = sizeof(u32),
+	.max_entries = 2,
+};
+
+/* id -> 1 to include, 0 to exclude (perf itself) */
+struct bpf_map_def SEC("maps") syscall_summary_pids = {
+	.type = BPF_MAP_TYPE_HASH,
+	.key_size = sizeof(u32),
+	.value_size = sizeof(u32),
+	.max_entries = 16384,
+};
+
+struct bpf_map_def SEC("maps") syscall_summary_entries = {
+	.type = BPF_MAP_TYPE_HASH,
+	.key_size = sizeof(u32),
+	.value_size = sizeof(struct syscall_summary_entry),
+	.max_entries = 16384,
+};
+
+struct bpf_map_def SEC("maps") syscall_summary_stats = {
+	.type = BPF_MAP_TYPE_HASH,
+	.key_size = sizeof(struct syscall_summary_key),
+	.value_size = sizeof(struct syscall_summary_stats),
+	.max_entries = 65536,
+};
+
+struct bpf_map_def SEC("maps") syscall_summary_hist = {
+	.type = BPF_MAP_TYPE_HASH,
+	.key_size = sizeof(struct syscall_summary_hist_key),
+	.value_size = sizeof(u64),
+	.max_entries = 262144,
+};
+
+static inline u32 filter_id(u64 pid_tgid)
+{
+	u32 key = 1, *by_tid;
+
+	by_tid = bpf_map_lookup_elem(&syscall_summary_config, &key);
+	if (by_tid && *by_tid)
+		return pid_tgid;
+	return pid_tgid >> 32;
+}
+
+static inline int pid_filtered(u64 pid_tgid)
+{
+	u32 key = 0, id = filter_id(pid_tgid), *only, *mode;
+
+	mode = bpf_map_lookup_elem(&syscall_summary_pids, &id);
+	if (mode)
+		return !*mode;
+
+	only = bpf_map_lookup_elem(&syscall_summary_config, &key);
+	return only && *only;
+}
+
+/* floor(log2(v)), unrolled as older verifiers reject loops */
+static inline u32 log2_slot(u64 v)
+{
+	u32 slot = 0;
+
+	if (v >= (1ULL << 32)) { v >>= 32; slot += 32; }
+	if (v >= (1ULL << 16)) { v >>= 16; slot += 16; }
+	if (v >= (1ULL << 8))  { v >>= 8;  slot += 8; }
+	if (v >= (1ULL << 4))  { v >>= 4;  slot += 4; }
+	if (v >= (1ULL << 2))  { v >>= 2;  slot += 2; }
+	if (v >= (1ULL << 1))  {           slot += 1; }
+
+	return slot;
+}
+
+SEC("raw_syscalls:sys_enter")
+int sys_enter(struct syscall_enter_args *args)
+{
+	u64 pid_tgid = bpf_get_current_pid_tgid();
+	u32 tid = pid_tgid;
+	struct syscall_summary_entry entry;
+
+	if (pid_filtered(pid_tgid))
+		return 0;
+
+	entry.time = bpf_ktime_get_ns();
+	entry.id   = args->id;
+	bpf_map_update_elem(&syscall_summary_entries, &tid, &entry, BPF_ANY);
+	return 0;
+}
+
+/*
+ * Count the children of the included tasks too, like the inherited
+ * events do.  This runs in the parent, the child id is a tgid for a new
+ * process and a tid for a new thread, which only matters with tid ids.
+ */
+SEC("sched:sched_process_fork")
+int sched_process_fork(struct sched_process_fork_args *args)
+{
+	u32 id = filter_id(bpf_get_current_pid_tgid());
+	u32 child = args->child_pid, one = 1, *mode;
+
+	mode = bpf_map_lookup_elem(&syscall_summary_pids, &id);
+	if (mode && *mode)
+		bpf_map_update_elem(&syscall_summary_pids, &child, &one, BPF_NOEXIST);
+	return 0;
+}
+
+SEC("raw_syscalls:sys_exit")
+int sys_exit(struct syscall_exit_args *args)
+{
+	u32 tid = bpf_get_current_pid_tgid();
+	struct syscall_summary_entry *entry;
+	struct syscall_summary_stats *stats;
+	struct syscall_summary_key key;
+	struct syscall_summary_hist_key hkey;
+	u64 delta, *count;
+
+	entry = bpf_map_lookup_elem(&syscall_summary_entries, &tid);
+	if (!entry)
+		return 0;
+
+	delta = bpf_ktime_get_ns() - entry->time;
+	key.tid = tid;
+	key.id  = entry->id;
+	bpf_map_delete_elem(&syscall_summary_entries, &tid);
+
+	/*
+	 * Entries are per thread, so only the CPU the thread runs on
+	 * updates them and no atomics are needed.
+	 */
+	stats = bpf_map_lookup_elem(&syscall_summary_stats, &key);
+	if (stats) {
+		stats->count++;
+		stats->total += delta;
+		if (delta < stats->min)
+			stats->min = delta;
+		if (delta > stats->max)
+			stats->max = delta;
+	} else {
+		struct syscall_summary_stats init = {
+			.count = 1,
+			.total = delta,
+			.min   = delta,
+			.max   = delta,
+		};
+
+		bpf_map_update_elem(&syscall_summary_stats, &key, &init, BPF_NOEXIST);
+	}
+
+	hkey.tid  = key.tid;
+	hkey.id   = key.id;
+	hkey.slot = log2_slot(delta);
+	hkey.pad  = 0;
+
+	count = bpf_map_lookup_elem(&syscall_summary_hist, &hkey);
+	if (count) {
+		(*count)++;
+	} else {
+		u64 one = 1;
+
+		bpf_map_update_elem(&syscall_summary_hist, &hkey, &one, BPF_NOEXIST);
+	}
+	return 0;
+}
+
+char _license[] SEC("license") = "GPL";
+int _version SEC("version") = LINUX_VERSION_CODE;
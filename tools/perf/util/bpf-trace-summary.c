@@ -0,0 +1,122 @@
+/*
+ * In-kernel syscall summary for 'perf trace', see
+ * util/bpf-script-trace-summary.c for the BPF side.
+ */
+#include <linux/err.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bpf-trace-summary.h"
+#include "bpf-loader.h"
+#include "evlist.h"
+#include "util.h"
+#include "debug.h"
+
+static struct bpf_object *summary_obj;
+
+static int summary_map_fd(const char *name)
+{
+	struct bpf_map *map = bpf__find_map(summary_obj, name);
+
+	return IS_ERR(map) ? PTR_ERR(map) : bpf_map__fd(map);
+}
+
+/*
+ * Compile the embedded program through the usual llvm/bpf-loader path and
+ * add its raw_syscalls:sys_{enter,exit} and sched:sched_process_fork events
+ * to evlist.
+ */
+int bpf_trace_summary__add_events(struct perf_evlist *evlist)
+{
+	struct bpf_object *obj;
+	LIST_HEAD(list);
+
+	obj = bpf__load_source("trace summary", bpf_trace_summary__prog,
+			       evlist, &list);
+	if (IS_ERR(obj))
+		return PTR_ERR(obj);
+
+	perf_evlist__splice_list_tail(evlist, &list);
+	summary_obj = obj;
+	return 0;
+}
+
+int bpf_trace_summary__filter_pid(pid_t pid, bool include)
+{
+	int fd = summary_map_fd("syscall_summary_pids");
+	u32 key = pid, value = include;
+
+	if (fd < 0)
+		return fd;
+
+	return bpf_map_update_elem(fd, &key, &value, BPF_ANY) ? -errno : 0;
+}
+
+int bpf_trace_summary__filter_only(bool only, bool by_tid)
+{
+	int fd = summary_map_fd("syscall_summary_config");
+	u32 key = 1, value = by_tid;
+
+	if (fd < 0)
+		return fd;
+
+	if (bpf_map_update_elem(fd, &key, &value, BPF_ANY))
+		return -errno;
+
+	key = 0;
+	value = only;
+	return bpf_map_update_elem(fd, &key, &value, BPF_ANY) ? -errno : 0;
+}
+
+static void summary__read_hist(int fd, struct syscall_summary *summary)
+{
+	struct syscall_summary_hist_key key = {
+		.tid = summary->key.tid,
+		.id  = summary->key.id,
+	};
+
+	for (key.slot = 0; key.slot < SYSCALL_SUMMARY_HIST_SLOTS; key.slot++) {
+		if (bpf_map_lookup_elem(fd, &key, &summary->hist[key.slot]))
+			summary->hist[key.slot] = 0;
+	}
+}
+
+/*
+ * Walk the per (tid, syscall) entries.  The cost is proportional to the
+ * number of distinct entries, not to the number of syscalls made.
+ */
+int bpf_trace_summary__for_each(syscall_summary_cb_t cb, void *arg)
+{
+	int stats_fd = summary_map_fd("syscall_summary_stats");
+	int hist_fd = summary_map_fd("syscall_summary_hist");
+	struct syscall_summary_key key, next;
+	struct syscall_summary summary;
+	int err;
+
+	if (stats_fd < 0)
+		return stats_fd;
+	if (hist_fd < 0)
+		return hist_fd;
+
+	/* a key that is not in the map starts the iteration */
+	memset(&key, 0xff, sizeof(key));
+
+	while (bpf_map_get_next_key(stats_fd, &key, &next) == 0) {
+		key = next;
+
+		if (bpf_map_lookup_elem(stats_fd, &key, &summary.stats))
+			continue;
+
+		summary.key = key;
+		summary__read_hist(hist_fd, &summary);
+
+		err = cb(&summary, arg);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
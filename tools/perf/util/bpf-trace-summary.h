@@ -0,0 +1,82 @@
+#ifndef __PERF_BPF_TRACE_SUMMARY_H
+#define __PERF_BPF_TRACE_SUMMARY_H
+
+#include <linux/compiler.h>
+#include <linux/types.h>
+#include <sys/types.h>
+#include <stdbool.h>
+#include <errno.h>
+#include "debug.h"
+
+/*
+ * Map layouts of util/bpf-script-trace-summary.c, keep them in sync.
+ */
+struct syscall_summary_key {
+	u32	tid;
+	u32	id;
+};
+
+struct syscall_summary_stats {
+	u64	count;
+	u64	total;
+	u64	min;
+	u64	max;
+};
+
+struct syscall_summary_hist_key {
+	u32	tid;
+	u32	id;
+	u32	slot;
+	u32	pad;
+};
+
+/* slot N counts latencies in [2^N, 2^(N+1)) nsecs */
+#define SYSCALL_SUMMARY_HIST_SLOTS	64
+
+struct syscall_summary {
+	struct syscall_summary_key	key;
+	struct syscall_summary_stats	stats;
+	u64				hist[SYSCALL_SUMMARY_HIST_SLOTS];
+};
+
+typedef int (*syscall_summary_cb_t)(struct syscall_summary *summary, void *arg);
+
+struct perf_evlist;
+
+#ifdef HAVE_LIBBPF_SUPPORT
+extern const char bpf_trace_summary__prog[];
+
+int bpf_trace_summary__add_events(struct perf_evlist *evlist);
+int bpf_trace_summary__filter_pid(pid_t pid, bool include);
+int bpf_trace_summary__filter_only(bool only, bool by_tid);
+int bpf_trace_summary__for_each(syscall_summary_cb_t cb, void *arg);
+#else
+static inline int
+bpf_trace_summary__add_events(struct perf_evlist *evlist __maybe_unused)
+{
+	pr_err("ERROR: eBPF object loading is disabled during compiling.\n");
+	return -ENOTSUP;
+}
+
+static inline int
+bpf_trace_summary__filter_pid(pid_t pid __maybe_unused,
+			      bool include __maybe_unused)
+{
+	return -ENOTSUP;
+}
+
+static inline int
+bpf_trace_summary__filter_only(bool only __maybe_unused,
+			       bool by_tid __maybe_unused)
+{
+	return -ENOTSUP;
+}
+
+static inline int
+bpf_trace_summary__for_each(syscall_summary_cb_t cb __maybe_unused,
+			    void *arg __maybe_unused)
+{
+	return -ENOTSUP;
+}
+#endif
+#endif /* __PERF_BPF_TRACE_SUMMARY_H */
@@ -22,28 +22,37 @@
 
 static bool no_buildid_cache;
 
+int build_id__mark_dso_hit_ip(struct machine *machine, pid_t pid, pid_t tid,
+			      u8 cpumode, u64 ip)
+{
+	struct addr_location al;
+	struct thread *thread = machine__findnew_thread(machine, pid, tid);
+
+	if (thread == NULL)
+		return -1;
+
+	thread__find_addr_map(thread, cpumode, MAP__FUNCTION, ip, &al);
+
+	if (al.map != NULL)
+		al.map->dso->hit = 1;
+
+	thread__put(thread);
+	return 0;
+}
+
 int build_id__mark_dso_hit(struct perf_tool *tool __maybe_unused,
 			   union perf_event *event,
 			   struct perf_sample *sample,
 			   struct perf_evsel *evsel __maybe_unused,
 			   struct machine *machine)
 {
-	struct addr_location al;
-	struct thread *thread = machine__findnew_thread(machine, sample->pid,
-							sample->tid);
-
-	if (thread == NULL) {
+	if (build_id__mark_dso_hit_ip(machine, sample->pid, sample->tid,
+				      sample->cpumode, sample->ip)) {
 		pr_err("problem processing %d event, skipping it.\n",
 			event->header.type);
 		return -1;
 	}
 
-	thread__find_addr_map(thread, sample->cpumode, MAP__FUNCTION, sample->ip, &al);
-
-	if (al.map != NULL)
-		al.map->dso->hit = 1;
-
-	thread__put(thread);
 	return 0;
 }
 
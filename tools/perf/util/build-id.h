@@ -23,6 +23,9 @@ bool dso__build_id_is_kmod(const struct dso *dso, char *bf, size_t size);
 int build_id__mark_dso_hit(struct perf_tool *tool, union perf_event *event,
 			   struct perf_sample *sample, struct perf_evsel *evsel,
 			   struct machine *machine);
+/* Marks the DSO mapped at ip in the thread pid/tid as hit */
+int build_id__mark_dso_hit_ip(struct machine *machine, pid_t pid, pid_t tid,
+			      u8 cpumode, u64 ip);
 
 int dsos__hit_all(struct perf_session *session);
 
@@ -2,6 +2,7 @@
 #include "util.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
 #include <linux/atomic.h>
 
 struct comm_str {
@@ -12,6 +13,8 @@ struct comm_str {
 
 /* Should perhaps be moved to struct machine */
 static struct rb_root comm_str_root;
+/* sessions may be processed in parallel, e.g. by perf diff */
+static pthread_mutex_t comm_str_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static struct comm_str *comm_str__get(struct comm_str *cs)
 {
@@ -22,11 +25,19 @@ static struct comm_str *comm_str__get(struct comm_str *cs)
 
 static void comm_str__put(struct comm_str *cs)
 {
-	if (cs && atomic_dec_and_test(&cs->refcnt)) {
+	if (!cs)
+		return;
+
+	/* no comm_str__findnew() may get it between the test and the erase */
+	pthread_mutex_lock(&comm_str_lock);
+	if (atomic_dec_and_test(&cs->refcnt)) {
 		rb_erase(&cs->rb_node, &comm_str_root);
+		pthread_mutex_unlock(&comm_str_lock);
 		zfree(&cs->str);
 		free(cs);
+		return;
 	}
+	pthread_mutex_unlock(&comm_str_lock);
 }
 
 static struct comm_str *comm_str__alloc(const char *str)
@@ -48,7 +59,7 @@ static struct comm_str *comm_str__alloc(const char *str)
 	return cs;
 }
 
-static struct comm_str *comm_str__findnew(const char *str, struct rb_root *root)
+static struct comm_str *__comm_str__findnew(const char *str, struct rb_root *root)
 {
 	struct rb_node **p = &root->rb_node;
 	struct rb_node *parent = NULL;
@@ -79,6 +90,18 @@ static struct comm_str *comm_str__findnew(const char *str, struct rb_root *root)
 	return new;
 }
 
+/* Returns a reference to the comm_str of str */
+static struct comm_str *comm_str__findnew(const char *str, struct rb_root *root)
+{
+	struct comm_str *cs;
+
+	pthread_mutex_lock(&comm_str_lock);
+	cs = comm_str__get(__comm_str__findnew(str, root));
+	pthread_mutex_unlock(&comm_str_lock);
+
+	return cs;
+}
+
 struct comm *comm__new(const char *str, u64 timestamp, bool exec)
 {
 	struct comm *comm = zalloc(sizeof(*comm));
@@ -95,8 +118,6 @@ struct comm *comm__new(const char *str, u64 timestamp, bool exec)
 		return NULL;
 	}
 
-	comm_str__get(comm->comm_str);
-
 	return comm;
 }
 
@@ -108,7 +129,6 @@ int comm__override(struct comm *comm, const char *str, u64 timestamp, bool exec)
 	if (!new)
 		return -ENOMEM;
 
-	comm_str__get(new);
 	comm_str__put(old);
 	comm->comm_str = new;
 	comm->start = timestamp;
@@ -0,0 +1,542 @@
+/*
+ * Columnar sample file writing support, see data-convert-col.h for the
+ * file layout.
+ *
+ * Released under the GPL v2. (and only v2, not any later version)
+ */
+
+#include <linux/compiler.h>
+#include <endian.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "data-convert-col.h"
+#include "session.h"
+#include "util.h"
+#include "debug.h"
+#include "tool.h"
+#include "evsel.h"
+#include "machine.h"
+#include "thread.h"
+#include "map.h"
+#include "symbol.h"
+
+static const struct {
+	const char		*name;
+	enum col_type		type;
+	enum col_encoding	encoding;
+} col_columns[COL__MAX] = {
+	[COL__TIME]	= { "time",	COL_TYPE__U64, COL_ENC__DELTA, },
+	[COL__CPU]	= { "cpu",	COL_TYPE__U32, COL_ENC__PLAIN, },
+	[COL__PID]	= { "pid",	COL_TYPE__S32, COL_ENC__PLAIN, },
+	[COL__TID]	= { "tid",	COL_TYPE__S32, COL_ENC__PLAIN, },
+	[COL__IP]	= { "ip",	COL_TYPE__U64, COL_ENC__PLAIN, },
+	[COL__ADDR]	= { "addr",	COL_TYPE__U64, COL_ENC__PLAIN, },
+	[COL__PERIOD]	= { "period",	COL_TYPE__U64, COL_ENC__PLAIN, },
+	[COL__EVENT]	= { "event",	COL_TYPE__STR, COL_ENC__DICT, },
+	[COL__COMM]	= { "comm",	COL_TYPE__STR, COL_ENC__DICT, },
+	[COL__DSO]	= { "dso",	COL_TYPE__STR, COL_ENC__DICT, },
+	[COL__SYMBOL]	= { "symbol",	COL_TYPE__STR, COL_ENC__DICT, },
+};
+
+struct col_buf {
+	u8		*data;
+	size_t		size;
+	size_t		alloc;
+};
+
+/*
+ * String -> index map of a COL_ENC__DICT column, open addressing over
+ * index + 1, so that a zeroed slot is empty.
+ */
+struct col_dict {
+	char		**strs;
+	u32		nr;
+	u32		alloc;
+	u32		*slots;
+	u32		nr_slots;
+};
+
+struct col_chunk {
+	u64		offset;
+	u64		nr_rows;
+	u64		min_time;
+	u64		max_time;
+	u64		size[COL__MAX];
+};
+
+struct col_writer {
+	FILE		 *fp;
+	u64		 offset;
+	unsigned int	 chunk_rows;
+	u64		 nr_rows;
+	u64		 prev_time;
+	u64		 min_time;
+	u64		 max_time;
+	struct col_buf	 cols[COL__MAX];
+	struct col_dict	 dicts[COL__MAX];
+	struct col_chunk *chunks;
+	u64		 nr_chunks;
+	u64		 alloc_chunks;
+};
+
+static int col_buf__put(struct col_buf *b, const void *data, size_t len)
+{
+	if (b->size + len > b->alloc) {
+		size_t alloc = b->alloc ? b->alloc * 2 : 4096;
+		u8 *p;
+
+		while (alloc < b->size + len)
+			alloc *= 2;
+
+		p = realloc(b->data, alloc);
+		if (p == NULL)
+			return -ENOMEM;
+
+		b->data  = p;
+		b->alloc = alloc;
+	}
+
+	memcpy(b->data + b->size, data, len);
+	b->size += len;
+	return 0;
+}
+
+static int col_buf__put_u64(struct col_buf *b, u64 val)
+{
+	val = htole64(val);
+	return col_buf__put(b, &val, sizeof(val));
+}
+
+static int col_buf__put_u32(struct col_buf *b, u32 val)
+{
+	val = htole32(val);
+	return col_buf__put(b, &val, sizeof(val));
+}
+
+static int col_buf__put_delta(struct col_buf *b, s64 delta)
+{
+	u64 val = ((u64)delta << 1) ^ (u64)(delta >> 63);
+	u8 bytes[10];
+	size_t len = 0;
+
+	do {
+		bytes[len] = val & 0x7f;
+		val >>= 7;
+		if (val)
+			bytes[len] |= 0x80;
+		len++;
+	} while (val);
+
+	return col_buf__put(b, bytes, len);
+}
+
+static u32 col_dict__hash(const char *s)
+{
+	u32 hash = 2166136261u;		/* FNV-1a */
+
+	while (*s) {
+		hash ^= (u8)*s++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static int col_dict__rehash(struct col_dict *d)
+{
+	u32 nr_slots = d->nr_slots ? d->nr_slots * 2 : 1024;
+	u32 *slots = calloc(nr_slots, sizeof(*slots));
+	u32 i, slot;
+
+	if (slots == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < d->nr; i++) {
+		slot = col_dict__hash(d->strs[i]) & (nr_slots - 1);
+		while (slots[slot])
+			slot = (slot + 1) & (nr_slots - 1);
+		slots[slot] = i + 1;
+	}
+
+	free(d->slots);
+	d->slots    = slots;
+	d->nr_slots = nr_slots;
+	return 0;
+}
+
+static int col_dict__findnew(struct col_dict *d, const char *s, u32 *idx)
+{
+	u32 slot;
+
+	if (s == NULL)
+		s = "";
+
+	if (d->nr >= d->nr_slots / 2 && col_dict__rehash(d))
+		return -ENOMEM;
+
+	slot = col_dict__hash(s) & (d->nr_slots - 1);
+	while (d->slots[slot]) {
+		if (!strcmp(d->strs[d->slots[slot] - 1], s)) {
+			*idx = d->slots[slot] - 1;
+			return 0;
+		}
+		slot = (slot + 1) & (d->nr_slots - 1);
+	}
+
+	if (d->nr == d->alloc) {
+		u32 alloc = d->alloc ? d->alloc * 2 : 256;
+		char **strs = realloc(d->strs, alloc * sizeof(*strs));
+
+		if (strs == NULL)
+			return -ENOMEM;
+
+		d->strs  = strs;
+		d->alloc = alloc;
+	}
+
+	d->strs[d->nr] = strdup(s);
+	if (d->strs[d->nr] == NULL)
+		return -ENOMEM;
+
+	d->slots[slot] = d->nr + 1;
+	*idx = d->nr++;
+	return 0;
+}
+
+static void col_dict__exit(struct col_dict *d)
+{
+	u32 i;
+
+	for (i = 0; i < d->nr; i++)
+		free(d->strs[i]);
+	zfree(&d->strs);
+	zfree(&d->slots);
+}
+
+static int col_writer__write(struct col_writer *w, const void *data, size_t len)
+{
+	if (len && fwrite(data, len, 1, w->fp) != 1) {
+		pr_err("Failed to write the columnar file: %s\n", strerror(errno));
+		return -1;
+	}
+
+	w->offset += len;
+	return 0;
+}
+
+static int col_writer__write_u64(struct col_writer *w, u64 val)
+{
+	val = htole64(val);
+	return col_writer__write(w, &val, sizeof(val));
+}
+
+static int col_writer__write_u32(struct col_writer *w, u32 val)
+{
+	val = htole32(val);
+	return col_writer__write(w, &val, sizeof(val));
+}
+
+static int col_writer__flush_chunk(struct col_writer *w)
+{
+	struct col_chunk *chunk;
+	int i;
+
+	if (!w->nr_rows)
+		return 0;
+
+	if (w->nr_chunks == w->alloc_chunks) {
+		u64 alloc = w->alloc_chunks ? w->alloc_chunks * 2 : 64;
+
+		chunk = realloc(w->chunks, alloc * sizeof(*chunk));
+		if (chunk == NULL)
+			return -ENOMEM;
+
+		w->chunks       = chunk;
+		w->alloc_chunks = alloc;
+	}
+
+	chunk = &w->chunks[w->nr_chunks++];
+	chunk->offset   = w->offset;
+	chunk->nr_rows  = w->nr_rows;
+	chunk->min_time = w->min_time;
+	chunk->max_time = w->max_time;
+
+	for (i = 0; i < COL__MAX; i++) {
+		struct col_buf *b = &w->cols[i];
+
+		if (col_writer__write(w, b->data, b->size))
+			return -1;
+
+		chunk->size[i] = b->size;
+		b->size = 0;
+	}
+
+	w->nr_rows   = 0;
+	w->prev_time = 0;
+	return 0;
+}
+
+static int col_writer__write_footer(struct col_writer *w)
+{
+	u64 footer = w->offset, i;
+	int c, err = 0;
+
+	err |= col_writer__write_u32(w, COL_FILE_VERSION);
+	err |= col_writer__write_u32(w, COL__MAX);
+
+	for (c = 0; c < COL__MAX && !err; c++) {
+		const char *name = col_columns[c].name;
+		struct col_dict *d = &w->dicts[c];
+		u8 type = col_columns[c].type, encoding = col_columns[c].encoding;
+		u16 len = htole16(strlen(name));
+
+		err |= col_writer__write(w, &type, sizeof(type));
+		err |= col_writer__write(w, &encoding, sizeof(encoding));
+		err |= col_writer__write(w, &len, sizeof(len));
+		err |= col_writer__write(w, name, strlen(name));
+
+		if (encoding != COL_ENC__DICT)
+			continue;
+
+		err |= col_writer__write_u32(w, d->nr);
+		for (i = 0; i < d->nr && !err; i++) {
+			err |= col_writer__write_u32(w, strlen(d->strs[i]));
+			err |= col_writer__write(w, d->strs[i], strlen(d->strs[i]));
+		}
+	}
+
+	err |= col_writer__write_u64(w, w->nr_chunks);
+	for (i = 0; i < w->nr_chunks && !err; i++) {
+		struct col_chunk *chunk = &w->chunks[i];
+
+		err |= col_writer__write_u64(w, chunk->offset);
+		err |= col_writer__write_u64(w, chunk->nr_rows);
+		err |= col_writer__write_u64(w, chunk->min_time);
+		err |= col_writer__write_u64(w, chunk->max_time);
+		for (c = 0; c < COL__MAX; c++)
+			err |= col_writer__write_u64(w, chunk->size[c]);
+	}
+
+	err |= col_writer__write_u64(w, footer);
+	err |= col_writer__write(w, COL_FILE_MAGIC, sizeof(COL_FILE_MAGIC));
+	return err ? -1 : 0;
+}
+
+static void col_writer__delete(struct col_writer *w)
+{
+	int i;
+
+	for (i = 0; i < COL__MAX; i++) {
+		free(w->cols[i].data);
+		col_dict__exit(&w->dicts[i]);
+	}
+	free(w->chunks);
+	free(w);
+}
+
+struct col_writer *col_writer__new(const char *path, unsigned int chunk_rows)
+{
+	struct col_writer *w = zalloc(sizeof(*w));
+	u32 idx;
+	int i;
+
+	if (w == NULL)
+		return NULL;
+
+	w->chunk_rows = chunk_rows ?: COL_CHUNK_ROWS;
+
+	/* the empty string is always entry 0 */
+	for (i = 0; i < COL__MAX; i++) {
+		if (col_columns[i].encoding == COL_ENC__DICT &&
+		    col_dict__findnew(&w->dicts[i], "", &idx))
+			goto out_delete;
+	}
+
+	w->fp = fopen(path, "w");
+	if (w->fp == NULL) {
+		pr_err("Failed to create '%s': %s\n", path, strerror(errno));
+		goto out_delete;
+	}
+
+	if (col_writer__write(w, COL_FILE_MAGIC, sizeof(COL_FILE_MAGIC)))
+		goto out_close;
+
+	return w;
+
+out_close:
+	fclose(w->fp);
+out_delete:
+	col_writer__delete(w);
+	return NULL;
+}
+
+static int col_writer__add_str(struct col_writer *w, int col, const char *s)
+{
+	u32 idx;
+
+	if (col_dict__findnew(&w->dicts[col], s, &idx))
+		return -ENOMEM;
+
+	return col_buf__put_u32(&w->cols[col], idx);
+}
+
+int col_writer__add(struct col_writer *w, struct col_sample *sample)
+{
+	struct col_buf *cols = w->cols;
+	int err = 0;
+
+	if (!w->nr_rows || sample->time < w->min_time)
+		w->min_time = sample->time;
+	if (!w->nr_rows || sample->time > w->max_time)
+		w->max_time = sample->time;
+
+	err |= col_buf__put_delta(&cols[COL__TIME], sample->time - w->prev_time);
+	err |= col_buf__put_u32(&cols[COL__CPU], sample->cpu);
+	err |= col_buf__put_u32(&cols[COL__PID], sample->pid);
+	err |= col_buf__put_u32(&cols[COL__TID], sample->tid);
+	err |= col_buf__put_u64(&cols[COL__IP], sample->ip);
+	err |= col_buf__put_u64(&cols[COL__ADDR], sample->addr);
+	err |= col_buf__put_u64(&cols[COL__PERIOD], sample->period);
+	err |= col_writer__add_str(w, COL__EVENT, sample->event);
+	err |= col_writer__add_str(w, COL__COMM, sample->comm);
+	err |= col_writer__add_str(w, COL__DSO, sample->dso);
+	err |= col_writer__add_str(w, COL__SYMBOL, sample->symbol);
+	if (err) {
+		pr_err("Not enough memory for the columnar chunk\n");
+		return -ENOMEM;
+	}
+
+	w->prev_time = sample->time;
+
+	if (++w->nr_rows == w->chunk_rows)
+		return col_writer__flush_chunk(w);
+	return 0;
+}
+
+int col_writer__close(struct col_writer *w)
+{
+	int err;
+
+	err = col_writer__flush_chunk(w);
+	if (!err)
+		err = col_writer__write_footer(w);
+
+	if (fclose(w->fp) && !err) {
+		pr_err("Failed to write the columnar file: %s\n", strerror(errno));
+		err = -1;
+	}
+
+	col_writer__delete(w);
+	return err;
+}
+
+struct col_convert {
+	struct perf_tool	tool;
+	struct col_writer	*writer;
+	u64			events_size;
+	u64			events_count;
+};
+
+static int process_sample_event(struct perf_tool *tool,
+				union perf_event *event,
+				struct perf_sample *sample,
+				struct perf_evsel *evsel,
+				struct machine *machine)
+{
+	struct col_convert *c = container_of(tool, struct col_convert, tool);
+	struct addr_location al;
+	struct col_sample cs = {
+		.time	= sample->time,
+		.ip	= sample->ip,
+		.addr	= sample->addr,
+		.period	= sample->period,
+		.cpu	= sample->cpu,
+		.pid	= sample->pid,
+		.tid	= sample->tid,
+		.event	= perf_evsel__name(evsel),
+	};
+	int err;
+
+	if (machine__resolve(machine, &al, sample) < 0) {
+		pr_err("problem processing %d event, skipping it.\n",
+		       event->header.type);
+		return -1;
+	}
+
+	cs.comm = thread__comm_str(al.thread);
+	if (al.map)
+		cs.dso = al.map->dso->long_name;
+	if (al.sym)
+		cs.symbol = al.sym->name;
+
+	err = col_writer__add(c->writer, &cs);
+	addr_location__put(&al);
+
+	c->events_count++;
+	c->events_size += event->header.size;
+	return err;
+}
+
+int col_convert__perf2col(const char *input, const char *path,
+			  struct perf_data_convert_opts *opts)
+{
+	struct perf_session *session;
+	struct perf_data_file file = {
+		.path = input,
+		.mode = PERF_DATA_MODE_READ,
+		.force = opts->force,
+	};
+	struct col_convert c = {
+		.tool = {
+			.sample          = process_sample_event,
+			.mmap            = perf_event__process_mmap,
+			.mmap2           = perf_event__process_mmap2,
+			.comm            = perf_event__process_comm,
+			.exit            = perf_event__process_exit,
+			.fork            = perf_event__process_fork,
+			.lost            = perf_event__process_lost,
+			.build_id        = perf_event__process_build_id,
+			.ordered_events  = true,
+			.ordering_requires_timestamps = true,
+		},
+	};
+	int err = -1;
+
+	if (opts->all)
+		pr_warning("--all is only supported with --to-ctf, converting samples only.\n");
+
+	session = perf_session__new(&file, 0, &c.tool);
+	if (!session)
+		return -1;
+
+	if (symbol__init(&session->header.env) < 0)
+		goto out_delete;
+
+	c.writer = col_writer__new(path, COL_CHUNK_ROWS);
+	if (!c.writer)
+		goto out_delete;
+
+	err = perf_session__process_events(session);
+	if (err)
+		pr_err("Error during conversion.\n");
+
+	if (col_writer__close(c.writer))
+		err = -1;
+
+	if (!err) {
+		fprintf(stderr,
+			"[ perf data convert: Converted '%s' into columnar data '%s' ]\n",
+			file.path, path);
+
+		fprintf(stderr,
+			"[ perf data convert: Converted and wrote %.3f MB (%" PRIu64 " samples) ]\n",
+			(double) c.events_size / 1024.0 / 1024.0,
+			c.events_count);
+	}
+
+out_delete:
+	perf_session__delete(session);
+	return err;
+}
@@ -0,0 +1,94 @@
+#ifndef __DATA_CONVERT_COL_H
+#define __DATA_CONVERT_COL_H
+#include <linux/types.h>
+#include "data-convert.h"
+
+/*
+ * Columnar sample files, for analytics tools that want to scan a few
+ * columns of a large capture without replaying it through perf.
+ *
+ * All integers are little endian.  The file is:
+ *
+ *	"PERFCOL\0"
+ *	chunk[nr_chunks]
+ *	footer
+ *	u64 footer offset
+ *	"PERFCOL\0"
+ *
+ * A chunk holds up to chunk_rows samples, stored column after column in
+ * the order of the footer's column table.  Each column is encoded as:
+ *
+ *	COL_ENC__PLAIN:	fixed width values, see enum col_type
+ *	COL_ENC__DELTA:	ULEB128 of the zigzag encoded difference to the
+ *			previous row of the chunk, starting from 0
+ *	COL_ENC__DICT:	u32 index into the column's dictionary, entry 0 is
+ *			the empty string, used when the value is unknown
+ *
+ * The footer is:
+ *
+ *	u32 version, u32 nr_columns
+ *	per column: u8 type, u8 encoding, u16 name length, name,
+ *		    and for COL_ENC__DICT columns u32 nr_strings followed
+ *		    by nr_strings times u32 length, bytes
+ *	u64 nr_chunks
+ *	per chunk: u64 offset, u64 nr_rows, u64 min time, u64 max time,
+ *		   u64 size of each column
+ */
+
+#define COL_FILE_MAGIC		"PERFCOL"	/* and its terminating NUL */
+#define COL_FILE_VERSION	1
+#define COL_CHUNK_ROWS		65536
+
+enum col_type {
+	COL_TYPE__U64 = 1,
+	COL_TYPE__U32,
+	COL_TYPE__S32,
+	COL_TYPE__STR,
+};
+
+enum col_encoding {
+	COL_ENC__PLAIN,
+	COL_ENC__DELTA,
+	COL_ENC__DICT,
+};
+
+enum col_column {
+	COL__TIME,
+	COL__CPU,
+	COL__PID,
+	COL__TID,
+	COL__IP,
+	COL__ADDR,
+	COL__PERIOD,
+	COL__EVENT,
+	COL__COMM,
+	COL__DSO,
+	COL__SYMBOL,
+	COL__MAX,
+};
+
+struct col_sample {
+	u64		time;
+	u64		ip;
+	u64		addr;
+	u64		period;
+	u32		cpu;
+	s32		pid;
+	s32		tid;
+	const char	*event;
+	const char	*comm;
+	const char	*dso;
+	const char	*symbol;
+};
+
+struct col_writer;
+
+struct col_writer *col_writer__new(const char *path, unsigned int chunk_rows);
+int col_writer__add(struct col_writer *w, struct col_sample *sample);
+/* Writes the last chunk and the footer, and frees w */
+int col_writer__close(struct col_writer *w);
+
+int col_convert__perf2col(const char *input_name, const char *to_col,
+			  struct perf_data_convert_opts *opts);
+
+#endif /* __DATA_CONVERT_COL_H */
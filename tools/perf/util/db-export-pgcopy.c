@@ -0,0 +1,479 @@
+/*
+ * db-export-pgcopy.c: Write db_export tables as PostgreSQL binary COPY files
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "evsel.h"
+#include "machine.h"
+#include "thread.h"
+#include "comm.h"
+#include "symbol.h"
+#include "event.h"
+#include "util.h"
+#include "debug.h"
+#include "build-id.h"
+#include "thread-stack.h"
+#include "call-path.h"
+#include "db-export.h"
+#include "db-export-pgcopy.h"
+
+/*
+ * The files have the layout of the tables created by
+ * scripts/python/export-to-postgresql.py, keep them in sync.
+ */
+enum pgcopy_table {
+	PGCOPY_EVSEL,
+	PGCOPY_MACHINE,
+	PGCOPY_THREAD,
+	PGCOPY_COMM,
+	PGCOPY_COMM_THREAD,
+	PGCOPY_DSO,
+	PGCOPY_SYMBOL,
+	PGCOPY_BRANCH_TYPE,
+	PGCOPY_SAMPLE,
+	PGCOPY_CALL_PATH,
+	PGCOPY_CALL,
+	PGCOPY_MAX,
+};
+
+static const char * const pgcopy_file_names[PGCOPY_MAX] = {
+	[PGCOPY_EVSEL]		= "evsel_table.bin",
+	[PGCOPY_MACHINE]	= "machine_table.bin",
+	[PGCOPY_THREAD]		= "thread_table.bin",
+	[PGCOPY_COMM]		= "comm_table.bin",
+	[PGCOPY_COMM_THREAD]	= "comm_thread_table.bin",
+	[PGCOPY_DSO]		= "dso_table.bin",
+	[PGCOPY_SYMBOL]		= "symbol_table.bin",
+	[PGCOPY_BRANCH_TYPE]	= "branch_type_table.bin",
+	[PGCOPY_SAMPLE]		= "sample_table.bin",
+	[PGCOPY_CALL_PATH]	= "call_path_table.bin",
+	[PGCOPY_CALL]		= "call_table.bin",
+};
+
+#define PGCOPY_BUF_SIZE		(1024 * 1024)
+
+struct db_export_pgcopy {
+	FILE	*files[PGCOPY_MAX];
+	bool	branches;
+};
+
+static const char pgcopy_header[19] = "PGCOPY\n\377\r\n\0\0\0\0\0\0\0\0\0";
+static const char pgcopy_trailer[2] = "\377\377";
+
+/*
+ * A row is built in a buffer that is written out when full, when a string
+ * column is added, or at the end of the row.  All values are big endian,
+ * each column is preceded by its length.
+ */
+struct pgcopy_row {
+	FILE	*fp;
+	u8	*pos;
+	u8	buf[256];
+};
+
+static u8 *pgcopy__put(u8 *p, u64 val, int size)
+{
+	while (size--)
+		*p++ = val >> (size * 8);
+	return p;
+}
+
+static void pgcopy_row__flush(struct pgcopy_row *row)
+{
+	fwrite(row->buf, row->pos - row->buf, 1, row->fp);
+	row->pos = row->buf;
+}
+
+static void pgcopy_row__init(struct pgcopy_row *row, FILE *fp, u16 nr_columns)
+{
+	row->fp  = fp;
+	row->pos = pgcopy__put(row->buf, nr_columns, sizeof(u16));
+}
+
+static void pgcopy_row__num(struct pgcopy_row *row, u64 val, int size)
+{
+	if (row->pos + sizeof(u32) + size > row->buf + sizeof(row->buf))
+		pgcopy_row__flush(row);
+
+	row->pos = pgcopy__put(row->pos, size, sizeof(u32));
+	row->pos = pgcopy__put(row->pos, val, size);
+}
+
+static void pgcopy_row__u64(struct pgcopy_row *row, u64 val)
+{
+	pgcopy_row__num(row, val, sizeof(u64));
+}
+
+static void pgcopy_row__s32(struct pgcopy_row *row, s32 val)
+{
+	pgcopy_row__num(row, (u32)val, sizeof(u32));
+}
+
+static void pgcopy_row__str(struct pgcopy_row *row, const char *str)
+{
+	size_t len = strlen(str);
+
+	if (row->pos + sizeof(u32) > row->buf + sizeof(row->buf))
+		pgcopy_row__flush(row);
+
+	row->pos = pgcopy__put(row->pos, len, sizeof(u32));
+	pgcopy_row__flush(row);
+	fwrite(str, len, 1, row->fp);
+}
+
+static int pgcopy_row__end(struct pgcopy_row *row)
+{
+	pgcopy_row__flush(row);
+	return ferror(row->fp) ? -EIO : 0;
+}
+
+static FILE *pgcopy__file(struct db_export *dbe, enum pgcopy_table table)
+{
+	return dbe->pgcopy->files[table];
+}
+
+static int pgcopy__write_evsel(struct db_export *dbe, u64 db_id,
+			       const char *name)
+{
+	struct pgcopy_row row;
+
+	pgcopy_row__init(&row, pgcopy__file(dbe, PGCOPY_EVSEL), 2);
+	pgcopy_row__u64(&row, db_id);
+	pgcopy_row__str(&row, name);
+	return pgcopy_row__end(&row);
+}
+
+static int pgcopy__write_machine(struct db_export *dbe, u64 db_id, s32 pid,
+				 const char *root_dir)
+{
+	struct pgcopy_row row;
+
+	pgcopy_row__init(&row, pgcopy__file(dbe, PGCOPY_MACHINE), 3);
+	pgcopy_row__u64(&row, db_id);
+	pgcopy_row__s32(&row, pid);
+	pgcopy_row__str(&row, root_dir);
+	return pgcopy_row__end(&row);
+}
+
+static int pgcopy__write_thread(struct db_export *dbe, u64 db_id,
+				u64 machine_db_id, u64 main_thread_db_id,
+				s32 pid, s32 tid)
+{
+	struct pgcopy_row row;
+
+	pgcopy_row__init(&row, pgcopy__file(dbe, PGCOPY_THREAD), 5);
+	pgcopy_row__u64(&row, db_id);
+	pgcopy_row__u64(&row, machine_db_id);
+	pgcopy_row__u64(&row, main_thread_db_id);
+	pgcopy_row__s32(&row, pid);
+	pgcopy_row__s32(&row, tid);
+	return pgcopy_row__end(&row);
+}
+
+static int pgcopy__write_comm(struct db_export *dbe, u64 db_id,
+			      const char *str)
+{
+	struct pgcopy_row row;
+
+	pgcopy_row__init(&row, pgcopy__file(dbe, PGCOPY_COMM), 2);
+	pgcopy_row__u64(&row, db_id);
+	pgcopy_row__str(&row, str);
+	return pgcopy_row__end(&row);
+}
+
+static int pgcopy__write_dso(struct db_export *dbe, u64 db_id,
+			     u64 machine_db_id, const char *short_name,
+			     const char *long_name, const char *build_id)
+{
+	struct pgcopy_row row;
+
+	pgcopy_row__init(&row, pgcopy__file(dbe, PGCOPY_DSO), 5);
+	pgcopy_row__u64(&row, db_id);
+	pgcopy_row__u64(&row, machine_db_id);
+	pgcopy_row__str(&row, short_name);
+	pgcopy_row__str(&row, long_name);
+	pgcopy_row__str(&row, build_id);
+	return pgcopy_row__end(&row);
+}
+
+static int pgcopy__write_symbol(struct db_export *dbe, u64 db_id,
+				u64 dso_db_id, u64 start, u64 end,
+				s32 binding, const char *name)
+{
+	struct pgcopy_row row;
+
+	pgcopy_row__init(&row, pgcopy__file(dbe, PGCOPY_SYMBOL), 6);
+	pgcopy_row__u64(&row, db_id);
+	pgcopy_row__u64(&row, dso_db_id);
+	pgcopy_row__u64(&row, start);
+	pgcopy_row__u64(&row, end);
+	pgcopy_row__s32(&row, binding);
+	pgcopy_row__str(&row, name);
+	return pgcopy_row__end(&row);
+}
+
+static int pgcopy__write_call_path(struct db_export *dbe, u64 db_id,
+				   u64 parent_db_id, u64 sym_db_id, u64 ip)
+{
+	struct pgcopy_row row;
+
+	pgcopy_row__init(&row, pgcopy__file(dbe, PGCOPY_CALL_PATH), 4);
+	pgcopy_row__u64(&row, db_id);
+	pgcopy_row__u64(&row, parent_db_id);
+	pgcopy_row__u64(&row, sym_db_id);
+	pgcopy_row__u64(&row, ip);
+	return pgcopy_row__end(&row);
+}
+
+static int pgcopy_export_evsel(struct db_export *dbe, struct perf_evsel *evsel)
+{
+	return pgcopy__write_evsel(dbe, evsel->db_id, perf_evsel__name(evsel));
+}
+
+static int pgcopy_export_machine(struct db_export *dbe,
+				 struct machine *machine)
+{
+	return pgcopy__write_machine(dbe, machine->db_id, machine->pid,
+				     machine->root_dir ?: "");
+}
+
+static int pgcopy_export_thread(struct db_export *dbe, struct thread *thread,
+				u64 main_thread_db_id, struct machine *machine)
+{
+	return pgcopy__write_thread(dbe, thread->db_id, machine->db_id,
+				    main_thread_db_id, thread->pid_,
+				    thread->tid);
+}
+
+static int pgcopy_export_comm(struct db_export *dbe, struct comm *comm)
+{
+	return pgcopy__write_comm(dbe, comm->db_id, comm__str(comm));
+}
+
+static int pgcopy_export_comm_thread(struct db_export *dbe, u64 db_id,
+				     struct comm *comm, struct thread *thread)
+{
+	struct pgcopy_row row;
+
+	pgcopy_row__init(&row, pgcopy__file(dbe, PGCOPY_COMM_THREAD), 3);
+	pgcopy_row__u64(&row, db_id);
+	pgcopy_row__u64(&row, comm->db_id);
+	pgcopy_row__u64(&row, thread->db_id);
+	return pgcopy_row__end(&row);
+}
+
+static int pgcopy_export_dso(struct db_export *dbe, struct dso *dso,
+			     struct machine *machine)
+{
+	char sbuild_id[SBUILD_ID_SIZE];
+
+	build_id__sprintf(dso->build_id, sizeof(dso->build_id), sbuild_id);
+
+	return pgcopy__write_dso(dbe, dso->db_id, machine->db_id,
+				 dso->short_name, dso->long_name, sbuild_id);
+}
+
+static int pgcopy_export_symbol(struct db_export *dbe, struct symbol *sym,
+				struct dso *dso)
+{
+	u64 *sym_db_id = symbol__priv(sym);
+
+	return pgcopy__write_symbol(dbe, *sym_db_id, dso->db_id, sym->start,
+				    sym->end, sym->binding, sym->name);
+}
+
+static int pgcopy_export_branch_type(struct db_export *dbe, u32 branch_type,
+				     const char *name)
+{
+	struct pgcopy_row row;
+
+	pgcopy_row__init(&row, pgcopy__file(dbe, PGCOPY_BRANCH_TYPE), 2);
+	pgcopy_row__s32(&row, branch_type);
+	pgcopy_row__str(&row, name);
+	return pgcopy_row__end(&row);
+}
+
+/* es == NULL writes the id 0 row */
+static int pgcopy__write_sample(struct db_export *dbe, struct export_sample *es)
+{
+	static struct perf_sample zero_sample;
+	struct perf_sample *sample = es ? es->sample : &zero_sample;
+	bool branches = dbe->pgcopy->branches;
+	struct pgcopy_row row;
+
+	pgcopy_row__init(&row, pgcopy__file(dbe, PGCOPY_SAMPLE),
+			 branches ? 18 : 22);
+	pgcopy_row__u64(&row, es ? es->db_id : 0);
+	pgcopy_row__u64(&row, es ? es->evsel->db_id : 0);
+	pgcopy_row__u64(&row, es ? es->al->machine->db_id : 0);
+	pgcopy_row__u64(&row, es ? es->al->thread->db_id : 0);
+	pgcopy_row__u64(&row, es ? es->comm_db_id : 0);
+	pgcopy_row__u64(&row, es ? es->dso_db_id : 0);
+	pgcopy_row__u64(&row, es ? es->sym_db_id : 0);
+	pgcopy_row__u64(&row, es ? es->offset : 0);
+	pgcopy_row__u64(&row, sample->ip);
+	pgcopy_row__u64(&row, sample->time);
+	pgcopy_row__s32(&row, sample->cpu);
+	pgcopy_row__u64(&row, es ? es->addr_dso_db_id : 0);
+	pgcopy_row__u64(&row, es ? es->addr_sym_db_id : 0);
+	pgcopy_row__u64(&row, es ? es->addr_offset : 0);
+	pgcopy_row__u64(&row, sample->addr);
+	if (!branches) {
+		pgcopy_row__u64(&row, sample->period);
+		pgcopy_row__u64(&row, sample->weight);
+		pgcopy_row__u64(&row, sample->transaction);
+		pgcopy_row__u64(&row, sample->data_src);
+	}
+	pgcopy_row__s32(&row, sample->flags & PERF_BRANCH_MASK);
+	pgcopy_row__num(&row, !!(sample->flags & PERF_IP_FLAG_IN_TX), 1);
+	pgcopy_row__u64(&row, es ? es->call_path_id : 0);
+	return pgcopy_row__end(&row);
+}
+
+static int pgcopy_export_sample(struct db_export *dbe, struct export_sample *es)
+{
+	return pgcopy__write_sample(dbe, es);
+}
+
+static int pgcopy_export_call_path(struct db_export *dbe, struct call_path *cp)
+{
+	u64 parent_db_id = cp->parent ? cp->parent->db_id : 0;
+	u64 sym_db_id = cp->sym ? *(u64 *)symbol__priv(cp->sym) : 0;
+
+	return pgcopy__write_call_path(dbe, cp->db_id, parent_db_id, sym_db_id,
+				       cp->ip);
+}
+
+static int pgcopy_export_call_return(struct db_export *dbe,
+				     struct call_return *cr)
+{
+	struct pgcopy_row row;
+
+	pgcopy_row__init(&row, pgcopy__file(dbe, PGCOPY_CALL), 11);
+	pgcopy_row__u64(&row, cr->db_id);
+	pgcopy_row__u64(&row, cr->thread->db_id);
+	pgcopy_row__u64(&row, cr->comm ? cr->comm->db_id : 0);
+	pgcopy_row__u64(&row, cr->cp->db_id);
+	pgcopy_row__u64(&row, cr->call_time);
+	pgcopy_row__u64(&row, cr->return_time);
+	pgcopy_row__u64(&row, cr->branch_count);
+	pgcopy_row__u64(&row, cr->call_ref);
+	pgcopy_row__u64(&row, cr->return_ref);
+	pgcopy_row__u64(&row, cr->cp->parent->db_id);
+	pgcopy_row__s32(&row, cr->flags);
+	return pgcopy_row__end(&row);
+}
+
+/* id == 0 means unknown, it is easier to have rows for them than NULLs */
+static int pgcopy__write_unknown(struct db_export *dbe)
+{
+	int err;
+
+	err = pgcopy__write_evsel(dbe, 0, "unknown") ?:
+	      pgcopy__write_machine(dbe, 0, 0, "unknown") ?:
+	      pgcopy__write_thread(dbe, 0, 0, 0, -1, -1) ?:
+	      pgcopy__write_comm(dbe, 0, "unknown") ?:
+	      pgcopy__write_dso(dbe, 0, 0, "unknown", "unknown", "") ?:
+	      pgcopy__write_symbol(dbe, 0, 0, 0, 0, 0, "unknown") ?:
+	      pgcopy__write_sample(dbe, NULL);
+	if (err || !dbe->pgcopy->files[PGCOPY_CALL_PATH])
+		return err;
+
+	return pgcopy__write_call_path(dbe, 0, 0, 0, 0);
+}
+
+int db_export_pgcopy__open(struct db_export *dbe, const char *dir,
+			   bool branches)
+{
+	struct db_export_pgcopy *pgcopy;
+	char path[PATH_MAX];
+	int i, err;
+
+	pgcopy = zalloc(sizeof(*pgcopy));
+	if (!pgcopy)
+		return -ENOMEM;
+
+	pgcopy->branches = branches;
+	dbe->pgcopy = pgcopy;
+
+	for (i = 0; i < PGCOPY_MAX; i++) {
+		FILE *fp;
+
+		if ((i == PGCOPY_CALL_PATH && !dbe->cpr) ||
+		    (i == PGCOPY_CALL && !dbe->crp))
+			continue;
+
+		scnprintf(path, sizeof(path), "%s/%s", dir, pgcopy_file_names[i]);
+		fp = fopen(path, "w");
+		if (!fp) {
+			err = -errno;
+			pr_err("Failed to create %s: %s\n", path, strerror(errno));
+			goto out_close;
+		}
+
+		setvbuf(fp, NULL, _IOFBF, PGCOPY_BUF_SIZE);
+		fwrite(pgcopy_header, sizeof(pgcopy_header), 1, fp);
+		pgcopy->files[i] = fp;
+	}
+
+	err = pgcopy__write_unknown(dbe);
+	if (err)
+		goto out_close;
+
+	dbe->export_evsel	 = pgcopy_export_evsel;
+	dbe->export_machine	 = pgcopy_export_machine;
+	dbe->export_thread	 = pgcopy_export_thread;
+	dbe->export_comm	 = pgcopy_export_comm;
+	dbe->export_comm_thread	 = pgcopy_export_comm_thread;
+	dbe->export_dso		 = pgcopy_export_dso;
+	dbe->export_symbol	 = pgcopy_export_symbol;
+	dbe->export_branch_type	 = pgcopy_export_branch_type;
+	dbe->export_sample	 = pgcopy_export_sample;
+	if (dbe->cpr)
+		dbe->export_call_path = pgcopy_export_call_path;
+	if (dbe->crp)
+		dbe->export_call_return = pgcopy_export_call_return;
+	return 0;
+
+out_close:
+	db_export_pgcopy__close(dbe);
+	return err;
+}
+
+int db_export_pgcopy__close(struct db_export *dbe)
+{
+	struct db_export_pgcopy *pgcopy = dbe->pgcopy;
+	int i, err = 0;
+
+	if (!pgcopy)
+		return 0;
+
+	for (i = 0; i < PGCOPY_MAX; i++) {
+		FILE *fp = pgcopy->files[i];
+
+		if (!fp)
+			continue;
+
+		fwrite(pgcopy_trailer, sizeof(pgcopy_trailer), 1, fp);
+		if (ferror(fp) || fclose(fp)) {
+			pr_err("Failed to write %s\n", pgcopy_file_names[i]);
+			err = -EIO;
+		}
+	}
+
+	zfree(&dbe->pgcopy);
+	return err;
+}
@@ -0,0 +1,35 @@
+/*
+ * db-export-pgcopy.h: Write db_export tables as PostgreSQL binary COPY files
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ */
+
+#ifndef __PERF_DB_EXPORT_PGCOPY_H
+#define __PERF_DB_EXPORT_PGCOPY_H
+
+#include <stdbool.h>
+
+struct db_export;
+
+/*
+ * Open <dir>/<table>_table.bin for each table of export-to-postgresql.py
+ * and set the dbe export callbacks to write the rows there, so that no row
+ * goes through the scripting engine.  Must be called after dbe->crp and
+ * dbe->cpr are set up, call_path_table.bin and call_table.bin are only
+ * written when they are.  With branches, samples have the columns of the
+ * 'branches' layout.
+ */
+int db_export_pgcopy__open(struct db_export *dbe, const char *dir,
+			   bool branches);
+/* Write the file trailers and close the files */
+int db_export_pgcopy__close(struct db_export *dbe);
+
+#endif
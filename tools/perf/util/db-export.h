@@ -30,6 +30,7 @@ struct call_return_processor;
 struct call_path_root;
 struct call_path;
 struct call_return;
+struct db_export_pgcopy;
 
 struct export_sample {
 	union perf_event	*event;
@@ -67,6 +68,7 @@ struct db_export {
 				  struct call_return *cr);
 	struct call_return_processor *crp;
 	struct call_path_root *cpr;
+	struct db_export_pgcopy *pgcopy;
 	u64 evsel_last_db_id;
 	u64 machine_last_db_id;
 	u64 thread_last_db_id;
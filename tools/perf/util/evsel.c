@@ -15,6 +15,8 @@
 #include <linux/perf_event.h>
 #include <linux/err.h>
 #include <sys/resource.h>
+#include <pthread.h>
+#include <asm/barrier.h>
 #include "asm/bug.h"
 #include "callchain.h"
 #include "cgroup.h"
@@ -1141,6 +1143,18 @@ void perf_evsel__close_fd(struct perf_evsel *evsel, int ncpus, int nthreads)
 		}
 }
 
+static void perf_evsel__free_tp_fields(struct perf_evsel *evsel)
+{
+	struct perf_tp_field *field, *next;
+
+	for (field = evsel->tp_fields; field; field = next) {
+		next = field->next;
+		free(field->name);
+		free(field);
+	}
+	evsel->tp_fields = NULL;
+}
+
 void perf_evsel__exit(struct perf_evsel *evsel)
 {
 	assert(list_empty(&evsel->node));
@@ -1148,6 +1162,7 @@ void perf_evsel__exit(struct perf_evsel *evsel)
 	perf_evsel__free_fd(evsel);
 	perf_evsel__free_id(evsel);
 	perf_evsel__free_config_terms(evsel);
+	perf_evsel__free_tp_fields(evsel);
 	close_cgroup(evsel->cgrp);
 	cpu_map__put(evsel->cpus);
 	cpu_map__put(evsel->own_cpus);
@@ -2344,6 +2359,79 @@ u64 perf_evsel__intval(struct perf_evsel *evsel, struct perf_sample *sample,
 	return field ? format_field__intval(field, sample, evsel->needs_swap) : 0;
 }
 
+/* Reads as 0/NULL, for the fields missing from the format */
+static struct perf_tp_field perf_tp_field__missing;
+static pthread_mutex_t tp_fields_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct perf_tp_field *__perf_evsel__tp_field(struct perf_evsel *evsel,
+					     const char *name)
+{
+	struct format_field *format_field;
+	struct perf_tp_field *field;
+
+	/* not cached until the format is known */
+	if (evsel->tp_format == NULL)
+		return &perf_tp_field__missing;
+
+	pthread_mutex_lock(&tp_fields_lock);
+
+	/* it may have been added since the lockless lookup */
+	for (field = evsel->tp_fields; field; field = field->next) {
+		if (!strcmp(field->name, name))
+			goto out_unlock;
+	}
+
+	field = zalloc(sizeof(*field));
+	if (field)
+		field->name = strdup(name);
+	if (field == NULL || field->name == NULL) {
+		pr_err("Not enough memory to cache the tracepoint field %s\n", name);
+		free(field);
+		field = &perf_tp_field__missing;
+		goto out_unlock;
+	}
+
+	field->needs_swap = evsel->needs_swap;
+
+	format_field = perf_evsel__field(evsel, name);
+	if (format_field) {
+		field->offset	  = format_field->offset;
+		field->size	  = format_field->size;
+		field->is_dynamic = !!(format_field->flags & FIELD_IS_DYNAMIC);
+	}
+
+	field->next = evsel->tp_fields;
+	/* publish it only once it is resolved */
+	wmb();
+	WRITE_ONCE(evsel->tp_fields, field);
+out_unlock:
+	pthread_mutex_unlock(&tp_fields_lock);
+	return field;
+}
+
+u64 perf_tp_field__intval(struct perf_tp_field *field,
+			  struct perf_sample *sample)
+{
+	void *ptr = sample->raw_data + field->offset;
+	u64 value;
+
+	switch (field->size) {
+	case 1:
+		return *(u8 *)ptr;
+	case 2:
+		value = *(u16 *)ptr;
+		return field->needs_swap ? bswap_16(value) : value;
+	case 4:
+		value = *(u32 *)ptr;
+		return field->needs_swap ? bswap_32(value) : value;
+	case 8:
+		memcpy(&value, ptr, sizeof(u64));
+		return field->needs_swap ? bswap_64(value) : value;
+	default:
+		return 0;
+	}
+}
+
 bool perf_evsel__fallback(struct perf_evsel *evsel, int err,
 			  char *msg, size_t msgsize)
 {
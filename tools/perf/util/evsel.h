@@ -4,6 +4,7 @@
 #include <linux/list.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
 #include <linux/perf_event.h>
 #include <linux/types.h>
 #include "xyarray.h"
@@ -96,6 +97,7 @@ struct perf_evsel {
 	double			scale;
 	const char		*unit;
 	struct event_format	*tp_format;
+	struct perf_tp_field	*tp_fields;
 	off_t			id_offset;
 	void			*priv;
 	u64			db_id;
@@ -268,6 +270,82 @@ u64 format_field__intval(struct format_field *field, struct perf_sample *sample,
 
 struct format_field *perf_evsel__field(struct perf_evsel *evsel, const char *name);
 
+/*
+ * A tracepoint field resolved once, so that reading it from a sample is
+ * just a load at a known offset instead of a pevent_find_field() strcmp
+ * walk over the event format.  size == 0 means the event has no such
+ * field.
+ */
+struct perf_tp_field {
+	struct perf_tp_field	*next;
+	char			*name;
+	int			offset;
+	int			size;
+	bool			needs_swap;
+	bool			is_dynamic;
+};
+
+struct perf_tp_field *__perf_evsel__tp_field(struct perf_evsel *evsel,
+					     const char *name);
+u64 perf_tp_field__intval(struct perf_tp_field *field,
+			  struct perf_sample *sample);
+
+/*
+ * The fields are cached in the evsel, the list only has the fields used so
+ * far, so this is a short walk.  The lookup is lockless, new fields are
+ * only ever added at the head of the list, once resolved.
+ */
+static inline struct perf_tp_field *
+perf_evsel__tp_field(struct perf_evsel *evsel, const char *name)
+{
+	struct perf_tp_field *field;
+
+	for (field = READ_ONCE(evsel->tp_fields); field; field = field->next) {
+		if (!strcmp(field->name, name))
+			return field;
+	}
+
+	return __perf_evsel__tp_field(evsel, name);
+}
+
+static inline void *perf_tp_field__rawptr(struct perf_tp_field *field,
+					  struct perf_sample *sample)
+{
+	int offset = field->offset;
+
+	if (field->size == 0)
+		return NULL;
+
+	if (field->is_dynamic) {
+		offset = *(int *)(sample->raw_data + offset);
+		offset &= 0xffff;
+	}
+
+	return sample->raw_data + offset;
+}
+
+/* Cached variants of perf_evsel__intval() & co for hot paths */
+static inline u64 perf_evsel__tp_intval(struct perf_evsel *evsel,
+					struct perf_sample *sample,
+					const char *name)
+{
+	return perf_tp_field__intval(perf_evsel__tp_field(evsel, name), sample);
+}
+
+static inline void *perf_evsel__tp_rawptr(struct perf_evsel *evsel,
+					  struct perf_sample *sample,
+					  const char *name)
+{
+	return perf_tp_field__rawptr(perf_evsel__tp_field(evsel, name), sample);
+}
+
+static inline char *perf_evsel__tp_strval(struct perf_evsel *evsel,
+					  struct perf_sample *sample,
+					  const char *name)
+{
+	return perf_evsel__tp_rawptr(evsel, sample, name);
+}
+
 #define perf_evsel__match(evsel, t, c)		\
 	(evsel->attr.type == PERF_TYPE_##t &&	\
 	 evsel->attr.config == PERF_COUNT_##c)
@@ -0,0 +1,587 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "folded-stacks.h"
+#include "callchain.h"
+#include "event.h"
+#include "machine.h"
+#include "map.h"
+#include "symbol.h"
+#include "thread.h"
+#include "util.h"
+#include <linux/hash.h>
+
+struct fs_key {
+	const void	*key;
+	u32		id;
+};
+
+struct fs_stack {
+	u64		count;
+	size_t		offset;		/* of the frames in fs->frames */
+	u32		nr;
+	u32		hash;
+};
+
+struct folded_stacks {
+	/* frame names, and the slots (id + 1) of their hash table */
+	char		**names;
+	u32		nr_names;
+	u32		alloc_names;
+	u32		*name_slots;
+	u32		nr_name_slots;
+
+	/* pointer -> frame id cache */
+	struct fs_key	*keys;
+	u32		nr_keys;
+	u32		nr_key_slots;
+
+	/* unique stacks, and the slots (index + 1) of their hash table */
+	struct fs_stack	*stacks;
+	u32		nr_stacks;
+	u32		alloc_stacks;
+	u32		*stack_slots;
+	u32		nr_stack_slots;
+
+	u32		*frames;
+	size_t		nr_frames;
+	size_t		alloc_frames;
+
+	/* frames of the sample being added */
+	u32		*buf;
+	unsigned int	buf_size;
+
+	u64		total;
+};
+
+static const char unknown_frame[] = "[unknown]";
+
+static u32 fs__hash_str(const char *s)
+{
+	u32 hash = 2166136261u;		/* FNV-1a */
+
+	while (*s) {
+		hash ^= (u8)*s++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static u32 fs__hash_frames(const u32 *frames, unsigned int nr)
+{
+	u32 hash = 2166136261u;
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		hash ^= frames[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static int fs__grow(void **array, size_t *alloc, size_t nr, size_t size)
+{
+	size_t new_alloc = *alloc ? *alloc : 64;
+	void *p;
+
+	if (nr <= *alloc)
+		return 0;
+
+	while (new_alloc < nr)
+		new_alloc *= 2;
+
+	p = realloc(*array, new_alloc * size);
+	if (p == NULL)
+		return -ENOMEM;
+
+	*array = p;
+	*alloc = new_alloc;
+	return 0;
+}
+
+static int fs__grow32(void **array, u32 *alloc, u32 nr, size_t size)
+{
+	size_t alloc_sz = *alloc;
+	int err;
+
+	err = fs__grow(array, &alloc_sz, nr, size);
+	*alloc = alloc_sz;
+	return err;
+}
+
+struct folded_stacks *folded_stacks__new(void)
+{
+	return zalloc(sizeof(struct folded_stacks));
+}
+
+void folded_stacks__delete(struct folded_stacks *fs)
+{
+	u32 i;
+
+	if (fs == NULL)
+		return;
+
+	for (i = 0; i < fs->nr_names; i++)
+		free(fs->names[i]);
+	free(fs->names);
+	free(fs->name_slots);
+	free(fs->keys);
+	free(fs->stacks);
+	free(fs->stack_slots);
+	free(fs->frames);
+	free(fs->buf);
+	free(fs);
+}
+
+static int fs__rehash_names(struct folded_stacks *fs)
+{
+	u32 nr_slots = fs->nr_name_slots ? fs->nr_name_slots * 2 : 1024;
+	u32 *slots = calloc(nr_slots, sizeof(*slots));
+	u32 i, slot;
+
+	if (slots == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < fs->nr_names; i++) {
+		slot = fs__hash_str(fs->names[i]) & (nr_slots - 1);
+		while (slots[slot])
+			slot = (slot + 1) & (nr_slots - 1);
+		slots[slot] = i + 1;
+	}
+
+	free(fs->name_slots);
+	fs->name_slots = slots;
+	fs->nr_name_slots = nr_slots;
+	return 0;
+}
+
+static int fs__findnew_name(struct folded_stacks *fs, const char *name)
+{
+	u32 slot;
+
+	if (fs->nr_names >= fs->nr_name_slots / 2 && fs__rehash_names(fs))
+		return -ENOMEM;
+
+	slot = fs__hash_str(name) & (fs->nr_name_slots - 1);
+	while (fs->name_slots[slot]) {
+		u32 id = fs->name_slots[slot] - 1;
+
+		if (!strcmp(fs->names[id], name))
+			return id;
+		slot = (slot + 1) & (fs->nr_name_slots - 1);
+	}
+
+	if (fs__grow32((void **)&fs->names, &fs->alloc_names,
+		       fs->nr_names + 1, sizeof(*fs->names)))
+		return -ENOMEM;
+
+	fs->names[fs->nr_names] = strdup(name);
+	if (fs->names[fs->nr_names] == NULL)
+		return -ENOMEM;
+
+	fs->name_slots[slot] = fs->nr_names + 1;
+	return fs->nr_names++;
+}
+
+static int fs__rehash_keys(struct folded_stacks *fs)
+{
+	u32 nr_slots = fs->nr_key_slots ? fs->nr_key_slots * 2 : 1024;
+	unsigned int bits = __builtin_ctz(nr_slots);
+	struct fs_key *keys = calloc(nr_slots, sizeof(*keys));
+	u32 i, slot;
+
+	if (keys == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < fs->nr_key_slots; i++) {
+		if (fs->keys[i].key == NULL)
+			continue;
+
+		slot = hash_ptr((void *)fs->keys[i].key, bits);
+		while (keys[slot].key)
+			slot = (slot + 1) & (nr_slots - 1);
+		keys[slot] = fs->keys[i];
+	}
+
+	free(fs->keys);
+	fs->keys = keys;
+	fs->nr_key_slots = nr_slots;
+	return 0;
+}
+
+int folded_stacks__frame(struct folded_stacks *fs, const void *key,
+			 const char *name)
+{
+	u32 slot;
+	int id;
+
+	if (key == NULL)
+		return fs__findnew_name(fs, name);
+
+	if (fs->nr_keys >= fs->nr_key_slots / 2 && fs__rehash_keys(fs))
+		return -ENOMEM;
+
+	slot = hash_ptr((void *)key, __builtin_ctz(fs->nr_key_slots));
+	while (fs->keys[slot].key) {
+		if (fs->keys[slot].key == key)
+			return fs->keys[slot].id;
+		slot = (slot + 1) & (fs->nr_key_slots - 1);
+	}
+
+	id = fs__findnew_name(fs, name);
+	if (id < 0)
+		return id;
+
+	fs->keys[slot].key = key;
+	fs->keys[slot].id = id;
+	fs->nr_keys++;
+	return id;
+}
+
+static int fs__rehash_stacks(struct folded_stacks *fs)
+{
+	u32 nr_slots = fs->nr_stack_slots ? fs->nr_stack_slots * 2 : 1024;
+	u32 *slots = calloc(nr_slots, sizeof(*slots));
+	u32 i, slot;
+
+	if (slots == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < fs->nr_stacks; i++) {
+		slot = fs->stacks[i].hash & (nr_slots - 1);
+		while (slots[slot])
+			slot = (slot + 1) & (nr_slots - 1);
+		slots[slot] = i + 1;
+	}
+
+	free(fs->stack_slots);
+	fs->stack_slots = slots;
+	fs->nr_stack_slots = nr_slots;
+	return 0;
+}
+
+int folded_stacks__add(struct folded_stacks *fs, const u32 *frames,
+		       unsigned int nr, u64 count)
+{
+	u32 hash = fs__hash_frames(frames, nr), slot;
+	struct fs_stack *stack;
+
+	if (fs->nr_stacks >= fs->nr_stack_slots / 2 && fs__rehash_stacks(fs))
+		return -ENOMEM;
+
+	slot = hash & (fs->nr_stack_slots - 1);
+	while (fs->stack_slots[slot]) {
+		stack = &fs->stacks[fs->stack_slots[slot] - 1];
+
+		if (stack->hash == hash && stack->nr == nr &&
+		    !memcmp(fs->frames + stack->offset, frames,
+			    nr * sizeof(*frames))) {
+			stack->count += count;
+			fs->total += count;
+			return 0;
+		}
+		slot = (slot + 1) & (fs->nr_stack_slots - 1);
+	}
+
+	if (fs__grow32((void **)&fs->stacks, &fs->alloc_stacks,
+		       fs->nr_stacks + 1, sizeof(*fs->stacks)) ||
+	    fs__grow((void **)&fs->frames, &fs->alloc_frames,
+		     fs->nr_frames + nr, sizeof(*fs->frames)))
+		return -ENOMEM;
+
+	stack = &fs->stacks[fs->nr_stacks];
+	stack->count = count;
+	stack->offset = fs->nr_frames;
+	stack->nr = nr;
+	stack->hash = hash;
+
+	memcpy(fs->frames + fs->nr_frames, frames, nr * sizeof(*frames));
+	fs->nr_frames += nr;
+	fs->stack_slots[slot] = ++fs->nr_stacks;
+	fs->total += count;
+	return 0;
+}
+
+static int fs__frame_sym(struct folded_stacks *fs, struct symbol *sym)
+{
+	if (sym == NULL)
+		return folded_stacks__frame(fs, unknown_frame, unknown_frame);
+
+	return folded_stacks__frame(fs, sym, sym->name);
+}
+
+int folded_stacks__add_sample(struct folded_stacks *fs,
+			      struct perf_evsel *evsel,
+			      struct perf_sample *sample,
+			      struct addr_location *al,
+			      unsigned int max_stack)
+{
+	struct callchain_cursor_node *node;
+	const char *comm = thread__comm_str(al->thread);
+	unsigned int i, nr = 0;
+	int id;
+
+	/* the comm, and at least the sample ip */
+	if (fs->buf_size < max_stack + 2) {
+		u32 *buf = realloc(fs->buf, (max_stack + 2) * sizeof(*buf));
+
+		if (buf == NULL)
+			return -ENOMEM;
+		fs->buf = buf;
+		fs->buf_size = max_stack + 2;
+	}
+
+	/*
+	 * Not keyed by the comm string pointer: the comm_str is freed once
+	 * unused, and another comm may be allocated at the same address.
+	 */
+	id = folded_stacks__frame(fs, NULL, comm ?: unknown_frame);
+	if (id < 0)
+		return id;
+	fs->buf[nr++] = id;
+
+	if (symbol_conf.use_callchain && sample->callchain &&
+	    thread__resolve_callchain(al->thread, &callchain_cursor, evsel,
+				      sample, NULL, NULL, max_stack) == 0) {
+		callchain_cursor_commit(&callchain_cursor);
+
+		while ((node = callchain_cursor_current(&callchain_cursor)) &&
+		       nr < fs->buf_size) {
+			id = fs__frame_sym(fs, node->sym);
+			if (id < 0)
+				return id;
+			fs->buf[nr++] = id;
+			callchain_cursor_advance(&callchain_cursor);
+		}
+	}
+
+	if (nr == 1) {
+		id = fs__frame_sym(fs, al->sym);
+		if (id < 0)
+			return id;
+		fs->buf[nr++] = id;
+	}
+
+	/* callchains are leaf first, folded stacks outermost first */
+	for (i = 1; i < (nr + 1) / 2; i++) {
+		u32 tmp = fs->buf[i];
+
+		fs->buf[i] = fs->buf[nr - i];
+		fs->buf[nr - i] = tmp;
+	}
+
+	return folded_stacks__add(fs, fs->buf, nr, 1);
+}
+
+int folded_stacks__fprintf(struct folded_stacks *fs, FILE *fp)
+{
+	u32 i, j;
+
+	for (i = 0; i < fs->nr_stacks; i++) {
+		struct fs_stack *stack = &fs->stacks[i];
+		u32 *frames = fs->frames + stack->offset;
+
+		for (j = 0; j < stack->nr; j++) {
+			if (j)
+				fputc(';', fp);
+			fputs(fs->names[frames[j]], fp);
+		}
+		fprintf(fp, " %" PRIu64 "\n", stack->count);
+	}
+
+	return ferror(fp) ? -EIO : 0;
+}
+
+/* flame graph layout, as in Brendan Gregg's flamegraph.pl */
+#define SVG_WIDTH		1200
+#define SVG_FRAME_HEIGHT	16
+#define SVG_FONT_SIZE		12
+#define SVG_FONT_WIDTH		0.59
+#define SVG_XPAD		10
+#define SVG_YPAD_TOP		(SVG_FONT_SIZE * 3)
+#define SVG_YPAD_BOTTOM		(SVG_FONT_SIZE * 2 + 10)
+#define SVG_MIN_WIDTH		0.1
+
+struct fs_svg {
+	struct folded_stacks	*fs;
+	FILE			*fp;
+	double			scale;
+	unsigned int		height;
+};
+
+static void fs_svg__puts(FILE *fp, const char *s, size_t len)
+{
+	for (; *s && len; s++, len--) {
+		switch (*s) {
+		case '&':
+			fputs("&amp;", fp);
+			break;
+		case '<':
+			fputs("&lt;", fp);
+			break;
+		case '>':
+			fputs("&gt;", fp);
+			break;
+		case '"':
+			fputs("&quot;", fp);
+			break;
+		default:
+			fputc(*s, fp);
+		}
+	}
+}
+
+static void fs_svg__frame(struct fs_svg *svg, const char *name,
+			  unsigned int depth, u64 start, u64 end)
+{
+	double x = SVG_XPAD + start * svg->scale;
+	double width = (end - start) * svg->scale;
+	unsigned int y = svg->height - SVG_YPAD_BOTTOM -
+			 (depth + 1) * SVG_FRAME_HEIGHT;
+	size_t len = strlen(name), chars;
+	u32 hash = fs__hash_str(name);
+	FILE *fp = svg->fp;
+
+	if (width < SVG_MIN_WIDTH)
+		return;
+
+	fputs("<g><title>", fp);
+	fs_svg__puts(fp, name, len);
+	fprintf(fp, " (%" PRIu64 " samples, %.2f%%)</title>",
+		end - start, 100.0 * (end - start) / svg->fs->total);
+
+	/* "hot" palette, the same color for the same function */
+	fprintf(fp, "<rect x=\"%.1f\" y=\"%u\" width=\"%.1f\" height=\"%d\" "
+		"fill=\"rgb(%u,%u,%u)\" rx=\"2\" ry=\"2\"/>",
+		x, y, width, SVG_FRAME_HEIGHT - 1,
+		205 + (hash & 0xff) * 50 / 255,
+		((hash >> 8) & 0xff) * 230 / 255,
+		((hash >> 16) & 0xff) * 55 / 255);
+
+	chars = width / (SVG_FONT_SIZE * SVG_FONT_WIDTH);
+	if (chars >= 3) {
+		fprintf(fp, "<text x=\"%.1f\" y=\"%.1f\">", x + 3,
+			y + SVG_FRAME_HEIGHT - 5.5);
+		if (len <= chars) {
+			fs_svg__puts(fp, name, len);
+		} else {
+			fs_svg__puts(fp, name, chars - 2);
+			fputs("..", fp);
+		}
+		fputs("</text>", fp);
+	}
+	fputs("</g>\n", fp);
+}
+
+static struct folded_stacks *sort_fs;
+
+static int fs_stack__cmp(const void *a, const void *b)
+{
+	const struct fs_stack *l = &sort_fs->stacks[*(const u32 *)a];
+	const struct fs_stack *r = &sort_fs->stacks[*(const u32 *)b];
+	const u32 *lf = sort_fs->frames + l->offset;
+	const u32 *rf = sort_fs->frames + r->offset;
+	u32 i;
+	int cmp;
+
+	for (i = 0; i < l->nr && i < r->nr; i++) {
+		if (lf[i] == rf[i])
+			continue;
+		cmp = strcmp(sort_fs->names[lf[i]], sort_fs->names[rf[i]]);
+		if (cmp)
+			return cmp;
+	}
+
+	return (int)l->nr - (int)r->nr;
+}
+
+int folded_stacks__fprintf_svg(struct folded_stacks *fs, FILE *fp,
+			       const char *title)
+{
+	struct fs_svg svg = { .fs = fs, .fp = fp, };
+	struct {
+		u32	id;
+		u64	start;
+	} *open = NULL;
+	unsigned int depth = 0, max_depth = 0, common, d;
+	u32 *order, i, *frames;
+	u64 x = 0;
+
+	order = malloc((fs->nr_stacks + 1) * sizeof(*order));
+	if (order == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < fs->nr_stacks; i++) {
+		order[i] = i;
+		if (fs->stacks[i].nr > max_depth)
+			max_depth = fs->stacks[i].nr;
+	}
+
+	open = calloc(max_depth + 1, sizeof(*open));
+	if (open == NULL) {
+		free(order);
+		return -ENOMEM;
+	}
+
+	/* sorted by name, the stacks sharing callers are next to each other */
+	sort_fs = fs;
+	qsort(order, fs->nr_stacks, sizeof(*order), fs_stack__cmp);
+
+	svg.height = SVG_YPAD_TOP + SVG_YPAD_BOTTOM +
+		     (max_depth + 1) * SVG_FRAME_HEIGHT;
+	svg.scale = fs->total ?
+		    (double)(SVG_WIDTH - 2 * SVG_XPAD) / fs->total : 0;
+
+	fprintf(fp, "<?xml version=\"1.0\" standalone=\"no\"?>\n"
+		"<svg version=\"1.1\" width=\"%d\" height=\"%u\" "
+		"viewBox=\"0 0 %d %u\" xmlns=\"http://www.w3.org/2000/svg\">\n"
+		"<style type=\"text/css\">\n"
+		"text { font-family: Verdana, sans-serif; font-size: %dpx; fill: rgb(0,0,0); }\n"
+		"rect:hover { stroke: rgb(0,0,0); stroke-width: 0.5; }\n"
+		"</style>\n"
+		"<rect x=\"0\" y=\"0\" width=\"100%%\" height=\"100%%\" fill=\"rgb(248,248,248)\"/>\n"
+		"<text x=\"%d\" y=\"%d\" text-anchor=\"middle\" style=\"font-size: %dpx\">",
+		SVG_WIDTH, svg.height, SVG_WIDTH, svg.height, SVG_FONT_SIZE,
+		SVG_WIDTH / 2, SVG_FONT_SIZE * 2, SVG_FONT_SIZE + 5);
+	fs_svg__puts(fp, title, strlen(title));
+	fputs("</text>\n", fp);
+
+	/*
+	 * Merge the frames shared with the previous stack, draw the ones
+	 * that are not when leaving them.  Depth 0 is the whole profile.
+	 */
+	for (i = 0; i < fs->nr_stacks; i++) {
+		struct fs_stack *stack = &fs->stacks[order[i]];
+
+		frames = fs->frames + stack->offset;
+		for (common = 0; common < depth && common < stack->nr; common++) {
+			if (open[common].id != frames[common])
+				break;
+		}
+
+		for (d = depth; d > common; d--)
+			fs_svg__frame(&svg, fs->names[open[d - 1].id], d,
+				      open[d - 1].start, x);
+
+		for (d = common; d < stack->nr; d++) {
+			open[d].id = frames[d];
+			open[d].start = x;
+		}
+
+		depth = stack->nr;
+		x += stack->count;
+	}
+
+	for (d = depth; d > 0; d--)
+		fs_svg__frame(&svg, fs->names[open[d - 1].id], d,
+			      open[d - 1].start, x);
+	fs_svg__frame(&svg, "all", 0, 0, x);
+
+	fputs("</svg>\n", fp);
+
+	free(open);
+	free(order);
+	return ferror(fp) ? -EIO : 0;
+}
@@ -0,0 +1,46 @@
+#ifndef __PERF_FOLDED_STACKS_H
+#define __PERF_FOLDED_STACKS_H
+
+#include <linux/types.h>
+#include <stdio.h>
+
+/*
+ * Aggregation of callchains into unique stacks, written as the folded
+ * stacks of the flame graph tools:
+ *
+ *	comm;outermost_function;...;leaf_function count
+ *
+ * or directly as a flame graph SVG.  Frame names are interned, so the
+ * memory used depends on the number of unique stacks, not of samples.
+ */
+
+struct folded_stacks;
+struct perf_evsel;
+struct perf_sample;
+struct addr_location;
+
+struct folded_stacks *folded_stacks__new(void);
+void folded_stacks__delete(struct folded_stacks *fs);
+
+/*
+ * Returns the id of the frame called name, key being any pointer that
+ * identifies the name (e.g. a struct symbol) to skip the string lookup
+ * the next times, or NULL.  Returns -ENOMEM on failure.
+ */
+int folded_stacks__frame(struct folded_stacks *fs, const void *key,
+			 const char *name);
+/* frames[] are frame ids, outermost first */
+int folded_stacks__add(struct folded_stacks *fs, const u32 *frames,
+		       unsigned int nr, u64 count);
+/* Adds the comm and callchain of a sample, or its ip without callchain */
+int folded_stacks__add_sample(struct folded_stacks *fs,
+			      struct perf_evsel *evsel,
+			      struct perf_sample *sample,
+			      struct addr_location *al,
+			      unsigned int max_stack);
+
+int folded_stacks__fprintf(struct folded_stacks *fs, FILE *fp);
+int folded_stacks__fprintf_svg(struct folded_stacks *fs, FILE *fp,
+			       const char *title);
+
+#endif /* __PERF_FOLDED_STACKS_H */
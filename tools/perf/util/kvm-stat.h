@@ -15,6 +15,8 @@ struct event_key {
 	struct exit_reasons_table *exit_reasons;
 };
 
+struct log_hist;
+
 struct kvm_event_stats {
 	u64 time;
 	struct stats stats;
@@ -31,6 +33,10 @@ struct kvm_event {
 	#define DEFAULT_VCPU_NUM 8
 	int max_vcpu;
 	struct kvm_event_stats *vcpu;
+
+	/* index in perf_kvm_stat->events and in the per vcpu tables */
+	int idx;
+	struct log_hist *hist;
 };
 
 typedef int (*key_cmp_fun)(struct kvm_event*, struct kvm_event*, int);
@@ -86,6 +92,9 @@ struct perf_kvm_stat {
 	struct kvm_events_ops *events_ops;
 	key_cmp_fun compare;
 	struct list_head kvm_events_cache[EVENTS_CACHE_SIZE];
+	struct kvm_event **events;
+	int nr_events;
+	struct list_head vcpu_records;
 
 	u64 total_time;
 	u64 total_count;
@@ -0,0 +1,50 @@
+#include "log-hist.h"
+
+/* Largest value that lands in 'bucket' */
+u64 log_hist__bucket_max(unsigned int bucket)
+{
+	unsigned int shift;
+	u64 sub;
+
+	if (bucket < LOG_HIST_SUB_BUCKETS)
+		return bucket;
+
+	shift = (bucket >> LOG_HIST_SUB_BITS) - 1;
+	sub = LOG_HIST_SUB_BUCKETS + (bucket & (LOG_HIST_SUB_BUCKETS - 1));
+
+	return ((sub + 1) << shift) - 1;
+}
+
+void log_hist__merge(struct log_hist *dst, struct log_hist *src)
+{
+	int i;
+
+	for (i = 0; i < LOG_HIST_NR_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->count += src->count;
+}
+
+/*
+ * Upper bound of the bucket holding the value at 'pct' (0-100) percent,
+ * callers may want to clamp it with the real maximum.
+ */
+u64 log_hist__percentile(struct log_hist *hist, double pct)
+{
+	u64 rank, seen = 0;
+	int i;
+
+	if (!hist->count)
+		return 0;
+
+	rank = hist->count * pct / 100;
+	if (rank >= hist->count)
+		rank = hist->count - 1;
+
+	for (i = 0; i < LOG_HIST_NR_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if (seen > rank)
+			return log_hist__bucket_max(i);
+	}
+
+	return log_hist__bucket_max(LOG_HIST_NR_BUCKETS - 1);
+}
@@ -0,0 +1,45 @@
+#ifndef __PERF_LOG_HIST_H
+#define __PERF_LOG_HIST_H
+
+#include <linux/types.h>
+#include <linux/bitops.h>
+
+/*
+ * Log-linear histogram of u64 values (e.g. latencies in nsecs): values
+ * below 2^LOG_HIST_SUB_BITS get a bucket each, above that every power of
+ * two range is split into 2^LOG_HIST_SUB_BITS linear buckets, so the
+ * relative error of a percentile is bounded by 1/2^LOG_HIST_SUB_BITS
+ * while the memory used is fixed, whatever the number of values.
+ */
+#define LOG_HIST_SUB_BITS	3
+#define LOG_HIST_SUB_BUCKETS	(1 << LOG_HIST_SUB_BITS)
+#define LOG_HIST_NR_BUCKETS	((64 - LOG_HIST_SUB_BITS + 1) * LOG_HIST_SUB_BUCKETS)
+
+struct log_hist {
+	u64	count;
+	u64	buckets[LOG_HIST_NR_BUCKETS];
+};
+
+static inline unsigned int log_hist__bucket(u64 val)
+{
+	unsigned int shift;
+
+	if (val < LOG_HIST_SUB_BUCKETS)
+		return val;
+
+	shift = fls64(val) - 1 - LOG_HIST_SUB_BITS;
+	return ((shift + 1) << LOG_HIST_SUB_BITS) +
+	       ((val >> shift) & (LOG_HIST_SUB_BUCKETS - 1));
+}
+
+static inline void log_hist__add(struct log_hist *hist, u64 val)
+{
+	hist->buckets[log_hist__bucket(val)]++;
+	hist->count++;
+}
+
+u64 log_hist__bucket_max(unsigned int bucket);
+void log_hist__merge(struct log_hist *dst, struct log_hist *src);
+u64 log_hist__percentile(struct log_hist *hist, double pct);
+
+#endif /* __PERF_LOG_HIST_H */
@@ -0,0 +1,198 @@
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <linux/bitmap.h>
+#include <linux/hash.h>
+#include "mem-cachelines.h"
+#include "intlist.h"
+#include "symbol.h"
+#include "debug.h"
+#include "util.h"
+#include "map.h"
+
+#define MEM_CACHELINE_BITS	10
+
+static int mem_cl_users__init(struct mem_cl_users *users,
+			      struct mem_cachelines *cls)
+{
+	users->cpus = bitmap_alloc(cls->nr_cpus);
+	users->nodes = bitmap_alloc(cls->nr_nodes);
+	users->tids = intlist__new(NULL);
+
+	if (!users->cpus || !users->nodes || !users->tids)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void mem_cl_users__exit(struct mem_cl_users *users)
+{
+	free(users->cpus);
+	free(users->nodes);
+	intlist__delete(users->tids);
+}
+
+int mem_cl_users__add(struct mem_cl_users *users, struct mem_cachelines *cls,
+		      u32 cpu, u32 tid)
+{
+	if (cpu < (u32)cls->nr_cpus) {
+		set_bit(cpu, users->cpus);
+		set_bit(cls->cpu2node[cpu], users->nodes);
+	}
+
+	return intlist__findnew(users->tids, tid) ? 0 : -ENOMEM;
+}
+
+static void mem_cacheline__delete(struct mem_cacheline *cl)
+{
+	struct mem_cl_entry *entry;
+
+	while ((entry = cl->entries) != NULL) {
+		cl->entries = entry->next;
+		mem_cl_users__exit(&entry->users);
+		map__put(entry->map);
+		free(entry);
+	}
+
+	mem_cl_users__exit(&cl->users);
+	free(cl);
+}
+
+static int mem_cachelines__resize(struct mem_cachelines *cls)
+{
+	unsigned int i, bits = cls->bits ? cls->bits + 1 : MEM_CACHELINE_BITS;
+	struct hlist_head *lines;
+	struct mem_cacheline *cl;
+	struct hlist_node *n;
+
+	lines = calloc(1UL << bits, sizeof(*lines));
+	if (!lines)
+		return -ENOMEM;
+
+	for (i = 0; cls->lines && i < (1U << cls->bits); i++) {
+		hlist_for_each_entry_safe(cl, n, &cls->lines[i], node) {
+			hlist_del(&cl->node);
+			hlist_add_head(&cl->node,
+				       &lines[hash_64(cl->addr, bits)]);
+		}
+	}
+
+	free(cls->lines);
+	cls->lines = lines;
+	cls->bits = bits;
+	return 0;
+}
+
+int mem_cachelines__init(struct mem_cachelines *cls, int size,
+			 int nr_cpus, int nr_nodes)
+{
+	memset(cls, 0, sizeof(*cls));
+
+	if (size <= 0 || (size & (size - 1))) {
+		pr_debug("unknown cacheline size, using %d bytes\n",
+			 MEM_CACHELINE_DEFAULT_SIZE);
+		size = MEM_CACHELINE_DEFAULT_SIZE;
+	}
+
+	cls->size = size;
+	cls->nr_cpus = nr_cpus;
+	cls->nr_nodes = nr_nodes;
+	cls->cpu2node = calloc(nr_cpus, sizeof(int));
+	if (!cls->cpu2node)
+		return -ENOMEM;
+
+	if (mem_cachelines__resize(cls)) {
+		zfree(&cls->cpu2node);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+void mem_cachelines__exit(struct mem_cachelines *cls)
+{
+	struct mem_cacheline *cl;
+	struct hlist_node *n;
+	unsigned int i;
+
+	for (i = 0; cls->lines && i < (1U << cls->bits); i++) {
+		hlist_for_each_entry_safe(cl, n, &cls->lines[i], node) {
+			hlist_del(&cl->node);
+			mem_cacheline__delete(cl);
+		}
+	}
+
+	zfree(&cls->lines);
+	zfree(&cls->cpu2node);
+	cls->nr = 0;
+}
+
+struct mem_cacheline *mem_cachelines__findnew(struct mem_cachelines *cls,
+					      u64 addr)
+{
+	struct mem_cacheline *cl;
+	struct hlist_head *head;
+
+	addr &= ~((u64)cls->size - 1);
+
+	head = &cls->lines[hash_64(addr, cls->bits)];
+	hlist_for_each_entry(cl, head, node) {
+		if (cl->addr == addr)
+			return cl;
+	}
+
+	/* keep the chains short, whatever the number of cachelines */
+	if (cls->nr >= (1U << cls->bits)) {
+		if (mem_cachelines__resize(cls))
+			return NULL;
+		head = &cls->lines[hash_64(addr, cls->bits)];
+	}
+
+	cl = zalloc(sizeof(*cl));
+	if (!cl)
+		return NULL;
+
+	cl->addr = addr;
+	if (mem_cl_users__init(&cl->users, cls)) {
+		mem_cacheline__delete(cl);
+		return NULL;
+	}
+
+	hlist_add_head(&cl->node, head);
+	cls->nr++;
+	return cl;
+}
+
+struct mem_cl_entry *mem_cacheline__findnew_entry(struct mem_cacheline *cl,
+						  struct mem_cachelines *cls,
+						  u64 addr,
+						  struct addr_location *al)
+{
+	u32 offset = addr & (cls->size - 1);
+	struct mem_cl_entry *entry;
+
+	for (entry = cl->entries; entry; entry = entry->next) {
+		if (entry->offset == offset && entry->ip == al->addr &&
+		    entry->map == al->map)
+			return entry;
+	}
+
+	entry = zalloc(sizeof(*entry));
+	if (!entry)
+		return NULL;
+
+	if (mem_cl_users__init(&entry->users, cls)) {
+		mem_cl_users__exit(&entry->users);
+		free(entry);
+		return NULL;
+	}
+
+	entry->offset = offset;
+	entry->ip = al->addr;
+	entry->map = map__get(al->map);
+	entry->sym = al->sym;
+	entry->next = cl->entries;
+	cl->entries = entry;
+	cl->nr_entries++;
+	return entry;
+}
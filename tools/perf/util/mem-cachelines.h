@@ -0,0 +1,70 @@
+#ifndef __PERF_MEM_CACHELINES_H
+#define __PERF_MEM_CACHELINES_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include "mem-events.h"
+
+struct addr_location;
+struct intlist;
+
+/* Used when the cacheline size of the machine is unknown */
+#define MEM_CACHELINE_DEFAULT_SIZE	64
+
+/* The CPUs, NUMA nodes and threads that accessed a cacheline or offset */
+struct mem_cl_users {
+	unsigned long		*cpus;
+	unsigned long		*nodes;
+	struct intlist		*tids;
+};
+
+/* The accesses to a cacheline from a given instruction and offset */
+struct mem_cl_entry {
+	struct mem_cl_entry	*next;
+	u64			ip;
+	u32			offset;
+	struct map		*map;
+	struct symbol		*sym;
+	struct c2c_stats	stats;
+	struct mem_cl_users	users;
+};
+
+struct mem_cacheline {
+	struct hlist_node	node;
+	u64			addr;
+	struct c2c_stats	stats;
+	struct mem_cl_users	users;
+	struct mem_cl_entry	*entries;
+	unsigned int		nr_entries;
+};
+
+/*
+ * The cachelines, in a hash table that doubles when it gets as many lines
+ * as buckets, so the chains stay short on large sample sets.
+ */
+struct mem_cachelines {
+	struct hlist_head	*lines;
+	unsigned int		bits;
+	unsigned int		nr;
+	unsigned int		size;
+	int			nr_cpus;
+	int			nr_nodes;
+	int			*cpu2node;
+};
+
+/* A size that isn't a power of two falls back to the default one */
+int mem_cachelines__init(struct mem_cachelines *cls, int size,
+			 int nr_cpus, int nr_nodes);
+/* Deletes all the cachelines and their entries */
+void mem_cachelines__exit(struct mem_cachelines *cls);
+
+struct mem_cacheline *mem_cachelines__findnew(struct mem_cachelines *cls,
+					      u64 addr);
+struct mem_cl_entry *mem_cacheline__findnew_entry(struct mem_cacheline *cl,
+						  struct mem_cachelines *cls,
+						  u64 addr,
+						  struct addr_location *al);
+int mem_cl_users__add(struct mem_cl_users *users, struct mem_cachelines *cls,
+		      u32 cpu, u32 tid);
+
+#endif /* __PERF_MEM_CACHELINES_H */
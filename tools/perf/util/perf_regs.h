@@ -15,6 +15,18 @@ struct sample_reg {
 
 extern const struct sample_reg sample_reg_masks[];
 
+enum {
+	SDT_ARG_VALID = 0,
+	SDT_ARG_SKIP,
+};
+
+/*
+ * Converts the operand of an SDT argument (e.g. "-4(%rbp)") to the
+ * uprobe fetch argument syntax, returning SDT_ARG_SKIP for the operands
+ * uprobes can't fetch.
+ */
+int arch_sdt_arg_parse_op(char *old_op, char **new_op);
+
 #ifdef HAVE_PERF_REGS_SUPPORT
 #include <perf_regs.h>
 
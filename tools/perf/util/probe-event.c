@@ -493,42 +493,65 @@ static struct debuginfo *open_debuginfo(const char *module, bool silent)
 	return ret;
 }
 
-/* For caching the last debuginfo */
-static struct debuginfo *debuginfo_cache;
-static char *debuginfo_cache_path;
+/*
+ * For caching the last debuginfos, so that the DWARF of a binary is read
+ * once when adding many probes to a few binaries.  The binaries without
+ * debuginfo are cached too, as NULL.
+ */
+#define DEBUGINFO_CACHE_SIZE	8
+
+static struct debuginfo_cache_entry {
+	char			*path;
+	struct debuginfo	*dinfo;
+} debuginfo_cache[DEBUGINFO_CACHE_SIZE];
+static int debuginfo_cache_next;
 
 static struct debuginfo *debuginfo_cache__open(const char *module, bool silent)
 {
+	struct debuginfo_cache_entry *entry;
 	const char *path = module;
+	int i;
 
 	/* If the module is NULL, it should be the kernel. */
 	if (!module)
 		path = "kernel";
 
-	if (debuginfo_cache_path && !strcmp(debuginfo_cache_path, path))
-		goto out;
+	for (i = 0; i < DEBUGINFO_CACHE_SIZE; i++) {
+		entry = &debuginfo_cache[i];
+		if (!entry->path || strcmp(entry->path, path))
+			continue;
+		if (!entry->dinfo && !silent)
+			pr_warning("The %s file has no debug information.\n",
+				   path);
+		return entry->dinfo;
+	}
 
-	/* Copy module path */
-	free(debuginfo_cache_path);
-	debuginfo_cache_path = strdup(path);
-	if (!debuginfo_cache_path) {
-		debuginfo__delete(debuginfo_cache);
-		debuginfo_cache = NULL;
-		goto out;
+	/* Replace the oldest one */
+	entry = &debuginfo_cache[debuginfo_cache_next];
+	debuginfo_cache_next = (debuginfo_cache_next + 1) % DEBUGINFO_CACHE_SIZE;
+	debuginfo__delete(entry->dinfo);
+	free(entry->path);
+
+	entry->dinfo = open_debuginfo(module, silent);
+	entry->path = strdup(path);
+	if (!entry->path) {
+		debuginfo__delete(entry->dinfo);
+		entry->dinfo = NULL;
 	}
 
-	debuginfo_cache = open_debuginfo(module, silent);
-	if (!debuginfo_cache)
-		zfree(&debuginfo_cache_path);
-out:
-	return debuginfo_cache;
+	return entry->dinfo;
 }
 
 static void debuginfo_cache__exit(void)
 {
-	debuginfo__delete(debuginfo_cache);
-	debuginfo_cache = NULL;
-	zfree(&debuginfo_cache_path);
+	int i;
+
+	for (i = 0; i < DEBUGINFO_CACHE_SIZE; i++) {
+		debuginfo__delete(debuginfo_cache[i].dinfo);
+		debuginfo_cache[i].dinfo = NULL;
+		zfree(&debuginfo_cache[i].path);
+	}
+	debuginfo_cache_next = 0;
 }
 
 
@@ -742,7 +765,7 @@ static int try_to_find_probe_trace_events(struct perf_probe_event *pev,
 	struct debuginfo *dinfo;
 	int ntevs, ret = 0;
 
-	dinfo = open_debuginfo(pev->target, !need_dwarf);
+	dinfo = debuginfo_cache__open(pev->target, !need_dwarf);
 	if (!dinfo) {
 		if (need_dwarf)
 			return -ENOENT;
@@ -767,8 +790,6 @@ static int try_to_find_probe_trace_events(struct perf_probe_event *pev,
 		}
 	}
 
-	debuginfo__delete(dinfo);
-
 	if (ntevs > 0) {	/* Succeeded to find trace events */
 		pr_debug("Found %d probe_trace_events.\n", ntevs);
 		ret = post_process_probe_trace_events(pev, *tevs, ntevs,
@@ -2619,43 +2640,137 @@ static int __open_probe_file_and_namelist(bool uprobe,
 	return fd;
 }
 
-static int __add_probe_trace_events(struct perf_probe_event *pev,
+/*
+ * The events of all the perf_probe_events are added through the same
+ * probe events files and name lists, their commands written in batches,
+ * and the probe caches are committed once per target.
+ */
+struct probe_batch {
+	int			fd[2];
+	struct strlist		*namelist[2];
+	struct strbuf		buf[2];
+	struct probe_trace_event *last[2];
+	struct probe_batch_cache {
+		char			*target;
+		struct probe_cache	*cache;
+	}			*caches;
+	int			nr_caches;
+};
+
+static void probe_batch__init(struct probe_batch *batch)
+{
+	int up;
+
+	memset(batch, 0, sizeof(*batch));
+	for (up = 0; up < 2; up++) {
+		batch->fd[up] = -1;
+		strbuf_init(&batch->buf[up], 0);
+	}
+}
+
+static struct probe_cache *probe_batch__cache(struct probe_batch *batch,
+					      const char *target)
+{
+	struct probe_batch_cache *bc;
+	int i;
+
+	for (i = 0; i < batch->nr_caches; i++) {
+		bc = &batch->caches[i];
+		if ((!bc->target && !target) ||
+		    (bc->target && target && !strcmp(bc->target, target)))
+			return bc->cache;
+	}
+
+	bc = realloc(batch->caches, (i + 1) * sizeof(*bc));
+	if (!bc)
+		return NULL;
+	batch->caches = bc;
+	bc += i;
+
+	bc->target = target ? strdup(target) : NULL;
+	bc->cache = probe_cache__new(target);
+	batch->nr_caches++;
+	return bc->cache;
+}
+
+static int probe_batch__flush(struct probe_batch *batch)
+{
+	int up, ret = 0;
+
+	for (up = 0; up < 2 && !ret; up++) {
+		if (batch->fd[up] < 0)
+			continue;
+		ret = probe_file__flush_events(batch->fd[up], &batch->buf[up]);
+		if (ret == -EINVAL && up && batch->last[up])
+			warn_uprobe_event_compat(batch->last[up]);
+	}
+	return ret;
+}
+
+static void probe_batch__exit(struct probe_batch *batch, bool commit)
+{
+	int i, up;
+
+	for (i = 0; i < batch->nr_caches; i++) {
+		struct probe_batch_cache *bc = &batch->caches[i];
+
+		if (commit && bc->cache && probe_cache__commit(bc->cache) < 0)
+			pr_warning("Failed to add event to probe cache\n");
+		probe_cache__delete(bc->cache);
+		free(bc->target);
+	}
+	free(batch->caches);
+
+	for (up = 0; up < 2; up++) {
+		strbuf_release(&batch->buf[up]);
+		strlist__delete(batch->namelist[up]);
+		if (batch->fd[up] >= 0)
+			close(batch->fd[up]);
+	}
+}
+
+static int __add_probe_trace_events(struct probe_batch *batch,
+				     struct perf_probe_event *pev,
 				     struct probe_trace_event *tevs,
 				     int ntevs, bool allow_suffix)
 {
-	int i, fd[2] = {-1, -1}, up, ret;
+	int i, up, ret;
 	struct probe_trace_event *tev = NULL;
 	struct probe_cache *cache = NULL;
-	struct strlist *namelist[2] = {NULL, NULL};
 
 	up = pev->uprobes ? 1 : 0;
-	fd[up] = __open_probe_file_and_namelist(up, &namelist[up]);
-	if (fd[up] < 0)
-		return fd[up];
+	if (batch->fd[up] == -1) {
+		batch->fd[up] = __open_probe_file_and_namelist(up,
+						&batch->namelist[up]);
+		if (batch->fd[up] < 0)
+			return batch->fd[up];
+	}
 
 	ret = 0;
 	for (i = 0; i < ntevs; i++) {
 		tev = &tevs[i];
 		up = tev->uprobes ? 1 : 0;
-		if (fd[up] == -1) {	/* Open the kprobe/uprobe_events */
-			fd[up] = __open_probe_file_and_namelist(up,
-								&namelist[up]);
-			if (fd[up] < 0)
-				goto close_out;
+		if (batch->fd[up] == -1) {	/* Open the kprobe/uprobe_events */
+			batch->fd[up] = __open_probe_file_and_namelist(up,
+							&batch->namelist[up]);
+			if (batch->fd[up] < 0)
+				return batch->fd[up];
 		}
 		/* Skip if the symbol is out of .text or blacklisted */
 		if (!tev->point.symbol && !pev->uprobes)
 			continue;
 
 		/* Set new name for tev (and update namelist) */
-		ret = probe_trace_event__set_name(tev, pev, namelist[up],
+		ret = probe_trace_event__set_name(tev, pev, batch->namelist[up],
 						  allow_suffix);
 		if (ret < 0)
 			break;
 
-		ret = probe_file__add_event(fd[up], tev);
+		ret = probe_file__add_event_batch(batch->fd[up],
+						  &batch->buf[up], tev);
 		if (ret < 0)
 			break;
+		batch->last[up] = tev;
 
 		/*
 		 * Probes after the first probe which comes from same
@@ -2668,20 +2783,11 @@ static int __add_probe_trace_events(struct perf_probe_event *pev,
 	if (ret == -EINVAL && pev->uprobes)
 		warn_uprobe_event_compat(tev);
 	if (ret == 0 && probe_conf.cache) {
-		cache = probe_cache__new(pev->target);
-		if (!cache ||
-		    probe_cache__add_entry(cache, pev, tevs, ntevs) < 0 ||
-		    probe_cache__commit(cache) < 0)
+		cache = probe_batch__cache(batch, pev->target);
+		if (!cache || probe_cache__add_entry(cache, pev, tevs, ntevs) < 0)
 			pr_warning("Failed to add event to probe cache\n");
-		probe_cache__delete(cache);
 	}
 
-close_out:
-	for (up = 0; up < 2; up++) {
-		strlist__delete(namelist[up]);
-		if (fd[up] >= 0)
-			close(fd[up]);
-	}
 	return ret;
 }
 
@@ -3188,7 +3294,7 @@ static int convert_to_probe_trace_events(struct perf_probe_event *pev,
 
 int convert_perf_probe_events(struct perf_probe_event *pevs, int npevs)
 {
-	int i, ret;
+	int i, ret = 0;
 
 	/* Loop 1: convert all events */
 	for (i = 0; i < npevs; i++) {
@@ -3198,27 +3304,40 @@ int convert_perf_probe_events(struct perf_probe_event *pevs, int npevs)
 		/* Convert with or without debuginfo */
 		ret  = convert_to_probe_trace_events(&pevs[i], &pevs[i].tevs);
 		if (ret < 0)
-			return ret;
+			break;
 		pevs[i].ntevs = ret;
 	}
 	/* This just release blacklist only if allocated */
 	kprobe_blacklist__release();
+	/* The debuginfos were shared by the events of the same binary */
+	debuginfo_cache__exit();
 
-	return 0;
+	return ret < 0 ? ret : 0;
 }
 
 int apply_perf_probe_events(struct perf_probe_event *pevs, int npevs)
 {
+	struct probe_batch batch;
 	int i, ret = 0;
 
+	probe_batch__init(&batch);
+
 	/* Loop 2: add all events */
 	for (i = 0; i < npevs; i++) {
-		ret = __add_probe_trace_events(&pevs[i], pevs[i].tevs,
+		ret = __add_probe_trace_events(&batch, &pevs[i], pevs[i].tevs,
 					       pevs[i].ntevs,
 					       probe_conf.force_add);
 		if (ret < 0)
 			break;
 	}
+
+	/* Write the events batched so far, even on error, as before */
+	i = probe_batch__flush(&batch);
+	if (!ret)
+		ret = i;
+
+	/* The cached events of a failed batch may not have been added */
+	probe_batch__exit(&batch, i == 0);
 	return ret;
 }
 
@@ -27,6 +27,8 @@
 #include "probe-event.h"
 #include "probe-file.h"
 #include "session.h"
+#include "perf_regs.h"
+#include "strbuf.h"
 
 #define MAX_CMDLEN 256
 
@@ -249,6 +251,58 @@ int probe_file__add_event(int fd, struct probe_trace_event *tev)
 	return ret;
 }
 
+/* The kernel parses the probe events files in chunks of this size */
+#define PROBE_EVENTS_BUFSIZE	4096
+
+/*
+ * Adds the command of tev to the commands batched in buf, writing them
+ * first if buf would get bigger than what the kernel parses at once.
+ */
+int probe_file__add_event_batch(int fd, struct strbuf *buf,
+				struct probe_trace_event *tev)
+{
+	char *cmd = synthesize_probe_trace_command(tev);
+	int ret = 0;
+
+	if (!cmd) {
+		pr_debug("Failed to synthesize probe trace event.\n");
+		return -EINVAL;
+	}
+
+	pr_debug("Writing event: %s\n", cmd);
+	if (buf->len && buf->len + strlen(cmd) + 1 > PROBE_EVENTS_BUFSIZE)
+		ret = probe_file__flush_events(fd, buf);
+	if (!ret)
+		ret = strbuf_addf(buf, "%s\n", cmd);
+	free(cmd);
+
+	return ret;
+}
+
+/*
+ * Writes the batched commands at once.  The kernel stops at the first one
+ * it fails to add, the previous ones stay.
+ */
+int probe_file__flush_events(int fd, struct strbuf *buf)
+{
+	char sbuf[STRERR_BUFSIZE];
+	int ret = 0;
+
+	if (!buf->len)
+		return 0;
+
+	if (!probe_event_dry_run &&
+	    write(fd, buf->buf, buf->len) < (ssize_t)buf->len) {
+		ret = -errno;
+		pr_warning("Failed to write events: %s\n",
+			   str_error_r(errno, sbuf, sizeof(sbuf)));
+		pr_debug("The events were:\n%s", buf->buf);
+	}
+	strbuf_setlen(buf, 0);
+
+	return ret;
+}
+
 static int __del_trace_probe_event(int fd, struct str_node *ent)
 {
 	char *p;
@@ -688,9 +742,89 @@ static unsigned long long sdt_note__get_addr(struct sdt_note *note)
 		 : (unsigned long long)note->addr.a64[0];
 }
 
+/*
+ * Converts the "size@operand" SDT argument to "argN=operand:type", the
+ * size being negative for signed values.  Returns 0 if it was skipped.
+ */
+static int synthesize_sdt_probe_arg(struct strbuf *buf, int i, const char *arg)
+{
+	char *op, *new_op = NULL, *at = strchr(arg, '@');
+	const char *type = NULL;
+	int ret, size;
+
+	if (at) {
+		size = atoi(arg);
+		switch (abs(size)) {
+		case 1: type = size < 0 ? "s8" : "u8"; break;
+		case 2: type = size < 0 ? "s16" : "u16"; break;
+		case 4: type = size < 0 ? "s32" : "u32"; break;
+		case 8: type = size < 0 ? "s64" : "u64"; break;
+		default: break;
+		}
+		arg = at + 1;
+	}
+
+	op = strdup(arg);
+	if (!op)
+		return -ENOMEM;
+
+	ret = arch_sdt_arg_parse_op(op, &new_op);
+	free(op);
+	if (ret < 0)
+		return ret;
+	if (ret == SDT_ARG_SKIP) {
+		pr_debug4("Skipping SDT argument %d: %s\n", i, arg);
+		return 0;
+	}
+
+	ret = strbuf_addf(buf, " arg%d=%s", i, new_op);
+	if (!ret && type)
+		ret = strbuf_addf(buf, ":%s", type);
+	free(new_op);
+	return ret < 0 ? ret : 1;
+}
+
+static char *synthesize_sdt_probe_command(struct sdt_note *note,
+					  const char *pathname,
+					  const char *sdtgrp)
+{
+	struct strbuf buf;
+	char *args, *arg, *tmp;
+	int i = 1;
+
+	if (strbuf_init(&buf, 32) < 0)
+		return NULL;
+
+	if (strbuf_addf(&buf, "p:%s/%s %s:0x%llx", sdtgrp, note->name,
+			pathname, sdt_note__get_addr(note)) < 0)
+		goto error;
+
+	if (!note->args)
+		goto out;
+
+	args = strdup(note->args);
+	if (!args)
+		goto error;
+
+	for (arg = strtok_r(args, " ", &tmp); arg;
+	     arg = strtok_r(NULL, " ", &tmp), i++) {
+		if (synthesize_sdt_probe_arg(&buf, i, arg) < 0) {
+			free(args);
+			goto error;
+		}
+	}
+	free(args);
+out:
+	return strbuf_detach(&buf, NULL);
+
+error:
+	strbuf_release(&buf);
+	return NULL;
+}
+
 int probe_cache__scan_sdt(struct probe_cache *pcache, const char *pathname)
 {
-	struct probe_cache_entry *entry = NULL;
+	struct probe_cache_entry *entry = NULL, *tmp;
 	struct list_head sdtlist;
 	struct sdt_note *note;
 	char *buf;
@@ -703,6 +837,16 @@ int probe_cache__scan_sdt(struct probe_cache *pcache, const char *pathname)
 		pr_debug("Failed to get sdt note: %d\n", ret);
 		return ret;
 	}
+
+	/* Rescanning replaces the SDT events, e.g. cached without arguments */
+	list_for_each_entry_safe(entry, tmp, &pcache->entries, node) {
+		if (entry->sdt) {
+			list_del_init(&entry->node);
+			probe_cache_entry__delete(entry);
+		}
+	}
+	entry = NULL;
+
 	list_for_each_entry(note, &sdtlist, note_list) {
 		ret = snprintf(sdtgrp, 64, "sdt_%s", note->provider);
 		if (ret < 0)
@@ -724,11 +868,11 @@ int probe_cache__scan_sdt(struct probe_cache *pcache, const char *pathname)
 			entry->pev.group = strdup(sdtgrp);
 			list_add_tail(&entry->node, &pcache->entries);
 		}
-		ret = asprintf(&buf, "p:%s/%s %s:0x%llx",
-				sdtgrp, note->name, pathname,
-				sdt_note__get_addr(note));
-		if (ret < 0)
+		buf = synthesize_sdt_probe_command(note, pathname, sdtgrp);
+		if (!buf) {
+			ret = -ENOMEM;
 			break;
+		}
 		strlist__add(entry->tevlist, buf);
 		free(buf);
 		entry = NULL;
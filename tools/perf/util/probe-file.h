@@ -5,6 +5,8 @@
 #include "strfilter.h"
 #include "probe-event.h"
 
+struct strbuf;
+
 /* Cache of probe definitions */
 struct probe_cache_entry {
 	struct list_head	node;
@@ -31,6 +33,9 @@ int probe_file__open_both(int *kfd, int *ufd, int flag);
 struct strlist *probe_file__get_namelist(int fd);
 struct strlist *probe_file__get_rawlist(int fd);
 int probe_file__add_event(int fd, struct probe_trace_event *tev);
+int probe_file__add_event_batch(int fd, struct strbuf *buf,
+				struct probe_trace_event *tev);
+int probe_file__flush_events(int fd, struct strbuf *buf);
 int probe_file__del_events(int fd, struct strfilter *filter);
 int probe_file__get_events(int fd, struct strfilter *filter,
 				  struct strlist *plist);
@@ -145,10 +145,193 @@ void debuginfo__delete(struct debuginfo *dbg)
 	if (dbg) {
 		if (dbg->dwfl)
 			dwfl_end(dbg->dwfl);
+		free(dbg->func_names);
+		free(dbg->funcs);
 		free(dbg);
 	}
 }
 
+/*
+ * Function index: looking functions up by name used to walk the DIEs of
+ * all the CUs for each query, which takes seconds on big binaries.  The
+ * function definitions are indexed at the first lookup instead, so the
+ * following ones only cost a binary search.
+ */
+struct debuginfo_func {
+	const char	*name;		/* Points to the DWARF string data */
+	Dwarf_Off	cu_off;
+	Dwarf_Off	die_off;
+};
+
+struct func_index_param {
+	struct debuginfo	*dbg;
+	Dwarf_Off		cu_off;
+	size_t			alloc;
+	int			err;
+};
+
+static int func_index_cb(Dwarf_Die *sp_die, void *data)
+{
+	struct func_index_param *param = data;
+	struct debuginfo *dbg = param->dbg;
+	struct debuginfo_func *func;
+	const char *name;
+
+	if (!die_is_func_def(sp_die))
+		return DWARF_CB_OK;
+
+	name = dwarf_diename(sp_die);
+	if (!name)
+		return DWARF_CB_OK;
+
+	if (dbg->nr_funcs == param->alloc) {
+		size_t alloc = param->alloc ? param->alloc * 2 : 1024;
+
+		func = realloc(dbg->funcs, alloc * sizeof(*func));
+		if (!func) {
+			param->err = -ENOMEM;
+			return DWARF_CB_ABORT;
+		}
+		dbg->funcs = func;
+		param->alloc = alloc;
+	}
+
+	func = &dbg->funcs[dbg->nr_funcs++];
+	func->name = name;
+	func->cu_off = param->cu_off;
+	func->die_off = dwarf_dieoffset(sp_die);
+
+	return DWARF_CB_OK;
+}
+
+static int func_name_cmp(const void *a, const void *b)
+{
+	const struct debuginfo_func *fa = *(const struct debuginfo_func **)a;
+	const struct debuginfo_func *fb = *(const struct debuginfo_func **)b;
+	int ret = strcmp(fa->name, fb->name);
+
+	/* Keep the functions of the same name in DIE order */
+	if (ret)
+		return ret;
+	return fa->die_off < fb->die_off ? -1 : fa->die_off > fb->die_off;
+}
+
+static int debuginfo__index_funcs(struct debuginfo *dbg)
+{
+	struct func_index_param param = { .dbg = dbg, };
+	Dwarf_Off off = 0, noff;
+	Dwarf_Die cu_die;
+	size_t cuhl, i;
+
+	if (dbg->func_names)
+		return 0;
+
+	/* Loop on CUs (Compilation Unit) */
+	while (!param.err &&
+	       !dwarf_nextcu(dbg->dbg, off, &noff, &cuhl, NULL, NULL, NULL)) {
+		param.cu_off = off + cuhl;
+		if (dwarf_offdie(dbg->dbg, param.cu_off, &cu_die))
+			dwarf_getfuncs(&cu_die, func_index_cb, &param, 0);
+		off = noff;
+	}
+
+	if (!param.err) {
+		dbg->func_names = malloc((dbg->nr_funcs ?: 1) *
+					 sizeof(*dbg->func_names));
+		if (!dbg->func_names)
+			param.err = -ENOMEM;
+	}
+	if (param.err) {
+		zfree(&dbg->funcs);
+		dbg->nr_funcs = 0;
+		return param.err;
+	}
+
+	for (i = 0; i < dbg->nr_funcs; i++)
+		dbg->func_names[i] = &dbg->funcs[i];
+	qsort(dbg->func_names, dbg->nr_funcs, sizeof(*dbg->func_names),
+	      func_name_cmp);
+
+	pr_debug("Indexed %zu functions\n", dbg->nr_funcs);
+	return 0;
+}
+
+/* Iterates the function definitions matching a name or a glob */
+struct func_iter {
+	struct debuginfo	*dbg;
+	const char		*name;
+	bool			glob;
+	size_t			pos;
+	size_t			end;
+};
+
+static int func_iter__init(struct func_iter *iter, struct debuginfo *dbg,
+			   const char *name)
+{
+	size_t lo = 0, hi;
+	int ret;
+
+	ret = debuginfo__index_funcs(dbg);
+	if (ret < 0)
+		return ret;
+
+	iter->dbg = dbg;
+	iter->name = name;
+	iter->glob = strisglob(name);
+	iter->pos = 0;
+	iter->end = dbg->nr_funcs;
+	if (iter->glob)
+		return 0;
+
+	/* The lower bound of name, then the end of its range */
+	hi = dbg->nr_funcs;
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+
+		if (strcmp(dbg->func_names[mid]->name, name) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	iter->pos = lo;
+
+	hi = dbg->nr_funcs;
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+
+		if (strcmp(dbg->func_names[mid]->name, name) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	iter->end = lo;
+
+	return 0;
+}
+
+/* Returns 1 with the CU and function DIEs of the next match, 0 at the end */
+static int func_iter__next(struct func_iter *iter, Dwarf_Die *cu_die,
+			   Dwarf_Die *sp_die)
+{
+	struct debuginfo *dbg = iter->dbg;
+	struct debuginfo_func *func;
+
+	while (iter->pos < iter->end) {
+		if (iter->glob) {
+			func = &dbg->funcs[iter->pos++];
+			if (!strglobmatch(func->name, iter->name))
+				continue;
+		} else
+			func = dbg->func_names[iter->pos++];
+
+		if (dwarf_offdie(dbg->dbg, func->cu_off, cu_die) &&
+		    dwarf_offdie(dbg->dbg, func->die_off, sp_die))
+			return 1;
+	}
+
+	return 0;
+}
+
 /*
  * Probe finder related functions
  */
@@ -985,11 +1168,31 @@ static int probe_point_search_cb(Dwarf_Die *sp_die, void *data)
 	return DWARF_CB_ABORT; /* Exit; no same symbol in this CU. */
 }
 
-static int find_probe_point_by_func(struct probe_finder *pf)
+static int find_probe_point_by_func(struct debuginfo *dbg,
+				    struct probe_finder *pf)
 {
 	struct dwarf_callback_param _param = {.data = (void *)pf,
 					      .retval = 0};
-	dwarf_getfuncs(&pf->cu_die, probe_point_search_cb, &_param, 0);
+	Dwarf_Off done_cu = 0;
+	struct func_iter iter;
+	Dwarf_Die sp_die;
+	int ret;
+
+	ret = func_iter__init(&iter, dbg, pf->pev->point.function);
+	if (ret < 0)
+		return ret;
+
+	while (func_iter__next(&iter, &pf->cu_die, &sp_die)) {
+		/* There is no other candidate in this CU */
+		if (dwarf_dieoffset(&pf->cu_die) == done_cu)
+			continue;
+
+		if (probe_point_search_cb(&sp_die, &_param) == DWARF_CB_ABORT)
+			done_cu = dwarf_dieoffset(&pf->cu_die);
+		if (_param.retval < 0)
+			break;
+	}
+
 	return _param.retval;
 }
 
@@ -1061,6 +1264,11 @@ static int debuginfo__find_probe_location(struct debuginfo *dbg,
 		}
 	}
 
+	if (pp->function) {
+		ret = find_probe_point_by_func(dbg, pf);
+		goto found;
+	}
+
 	/* Loop on CUs (Compilation Unit) */
 	while (!dwarf_nextcu(dbg->dbg, off, &noff, &cuhl, NULL, NULL, NULL)) {
 		/* Get the DIE(Debugging Information Entry) of this CU */
@@ -1075,9 +1283,7 @@ static int debuginfo__find_probe_location(struct debuginfo *dbg,
 			pf->fname = NULL;
 
 		if (!pp->file || pf->fname) {
-			if (pp->function)
-				ret = find_probe_point_by_func(pf);
-			else if (pp->lazy_line)
+			if (pp->lazy_line)
 				ret = find_probe_point_lazy(&pf->cu_die, pf);
 			else {
 				pf->lno = pp->line;
@@ -1691,10 +1897,29 @@ static int line_range_search_cb(Dwarf_Die *sp_die, void *data)
 	return DWARF_CB_OK;
 }
 
-static int find_line_range_by_func(struct line_finder *lf)
+static int find_line_range_by_func(struct debuginfo *dbg,
+				   struct line_finder *lf)
 {
 	struct dwarf_callback_param param = {.data = (void *)lf, .retval = 0};
-	dwarf_getfuncs(&lf->cu_die, line_range_search_cb, &param, 0);
+	Dwarf_Off done_cu = 0;
+	struct func_iter iter;
+	Dwarf_Die sp_die;
+	int ret;
+
+	ret = func_iter__init(&iter, dbg, lf->lr->function);
+	if (ret < 0)
+		return ret;
+
+	while (!lf->found && func_iter__next(&iter, &lf->cu_die, &sp_die)) {
+		if (dwarf_dieoffset(&lf->cu_die) == done_cu)
+			continue;
+
+		if (line_range_search_cb(&sp_die, &param) == DWARF_CB_ABORT)
+			done_cu = dwarf_dieoffset(&lf->cu_die);
+		if (param.retval < 0)
+			break;
+	}
+
 	return param.retval;
 }
 
@@ -1722,6 +1947,9 @@ int debuginfo__find_line_range(struct debuginfo *dbg, struct line_range *lr)
 			if (lf.found)
 				goto found;
 		}
+
+		ret = find_line_range_by_func(dbg, &lf);
+		goto found;
 	}
 
 	/* Loop on CUs (Compilation Unit) */
@@ -1742,13 +1970,9 @@ int debuginfo__find_line_range(struct debuginfo *dbg, struct line_range *lr)
 			lf.fname = 0;
 
 		if (!lr->file || lf.fname) {
-			if (lr->function)
-				ret = find_line_range_by_func(&lf);
-			else {
-				lf.lno_s = lr->start;
-				lf.lno_e = lr->end;
-				ret = find_line_range_by_line(NULL, &lf);
-			}
+			lf.lno_s = lr->start;
+			lf.lno_e = lr->end;
+			ret = find_line_range_by_line(NULL, &lf);
 		}
 		off = noff;
 	}
@@ -31,6 +31,11 @@ struct debuginfo {
 	Dwfl_Module	*mod;
 	Dwfl		*dwfl;
 	Dwarf_Addr	bias;
+
+	/* Function definitions, built at the first lookup by name */
+	struct debuginfo_func	*funcs;		/* In DIE order */
+	struct debuginfo_func	**func_names;	/* Sorted by name */
+	size_t			nr_funcs;
 };
 
 /* This also tries to open distro debuginfo */
@@ -0,0 +1,62 @@
+#include "sched-timehist.h"
+
+u64 timehist_thread__sched_out(struct timehist_thread *tr, u64 timestamp,
+			       bool preempted)
+{
+	u64 dt_run = 0;
+
+	if (tr->last_in) {
+		dt_run = timestamp - tr->last_in;
+		tr->nr_slices++;
+		tr->run_time += dt_run;
+	}
+
+	tr->last_in = 0;
+	tr->last_out = timestamp;
+	tr->ready_to_run = 0;
+
+	/* preempted, so it is runnable right away */
+	if (preempted) {
+		tr->ready_to_run = timestamp;
+		tr->nr_preempted++;
+	}
+
+	return dt_run;
+}
+
+void timehist_thread__sched_in(struct timehist_thread *tr, u64 timestamp)
+{
+	tr->dt_wait = 0;
+	tr->dt_delay = 0;
+
+	/*
+	 * The wait ends when the thread becomes runnable, the delay then
+	 * lasts until it runs.  Without a wakeup, all of it is waiting.
+	 */
+	if (tr->ready_to_run) {
+		if (tr->last_out && tr->ready_to_run > tr->last_out)
+			tr->dt_wait = tr->ready_to_run - tr->last_out;
+
+		tr->dt_delay = timestamp - tr->ready_to_run;
+		tr->delay_time += tr->dt_delay;
+		log_hist__add(&tr->delay_hist, tr->dt_delay);
+
+		if (tr->dt_delay > tr->max_delay) {
+			tr->max_delay = tr->dt_delay;
+			tr->max_delay_at = timestamp;
+		}
+	} else if (tr->last_out) {
+		tr->dt_wait = timestamp - tr->last_out;
+	}
+
+	tr->wait_time += tr->dt_wait;
+	tr->ready_to_run = 0;
+	tr->last_in = timestamp;
+}
+
+void timehist_thread__wakeup(struct timehist_thread *tr, u64 timestamp)
+{
+	/* only the first wakeup of a sleeping task starts its delay */
+	if (!tr->last_in && !tr->ready_to_run)
+		tr->ready_to_run = timestamp;
+}
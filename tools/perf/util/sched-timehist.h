@@ -0,0 +1,41 @@
+#ifndef __PERF_SCHED_TIMEHIST_H
+#define __PERF_SCHED_TIMEHIST_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <stdbool.h>
+#include "log-hist.h"
+
+struct thread;
+
+/*
+ * Scheduling state and totals of a thread for 'perf sched timehist'.
+ * Each slice is split into the time waiting for an event (wait), then
+ * waiting for a CPU once runnable (delay), then running (run).
+ */
+struct timehist_thread {
+	struct list_head list;
+	struct thread	*thread;
+	u64		last_in;	/* 0: not running, or not seen yet */
+	u64		last_out;
+	u64		ready_to_run;	/* woken up or preempted at */
+	u64		dt_wait;	/* of the current slice */
+	u64		dt_delay;
+	u64		nr_slices;
+	u64		nr_preempted;
+	u64		nr_migrations;
+	u64		run_time;
+	u64		wait_time;
+	u64		delay_time;
+	u64		max_delay;
+	u64		max_delay_at;
+	struct log_hist	delay_hist;
+};
+
+/* Returns the run time of the slice, 0 if its start wasn't seen */
+u64 timehist_thread__sched_out(struct timehist_thread *tr, u64 timestamp,
+			       bool preempted);
+void timehist_thread__sched_in(struct timehist_thread *tr, u64 timestamp);
+void timehist_thread__wakeup(struct timehist_thread *tr, u64 timestamp);
+
+#endif /* __PERF_SCHED_TIMEHIST_H */
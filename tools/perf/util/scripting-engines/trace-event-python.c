@@ -38,6 +38,7 @@
 #include "../comm.h"
 #include "../machine.h"
 #include "../db-export.h"
+#include "../db-export-pgcopy.h"
 #include "../thread-stack.h"
 #include "../trace-event.h"
 #include "../machine.h"
@@ -386,6 +387,382 @@ exit:
 	return pylist;
 }
 
+/*
+ * Batch mode: if the script sets perf_script_batch_size and defines a
+ * <system>__<event>__batch(event_name, nr, columns, types) handler, the
+ * events of that tracepoint are accumulated into one column per field and
+ * the handler is called once every perf_script_batch_size events, instead
+ * of building a tuple and calling a handler per event.
+ *
+ * Numeric and fixed size fields are passed as memoryviews of packed native
+ * values, with their struct module format in types, __data_loc fields and
+ * common_comm are passed as lists of strings.
+ */
+enum batch_column_kind {
+	BATCH_COL_CPU,
+	BATCH_COL_TIME,
+	BATCH_COL_COMM,
+	BATCH_COL_NUMERIC,
+	BATCH_COL_FIXED,
+	BATCH_COL_DYNAMIC,
+};
+
+struct batch_column {
+	enum batch_column_kind	kind;
+	const char		*name;
+	struct format_field	*field;
+	unsigned int		width;
+	char			*data;
+	PyObject		*list;
+	PyObject		*last_comm;
+};
+
+struct event_batch {
+	PyObject		*handler;
+	PyObject		*event_name;
+	PyObject		*types;
+	char			handler_name[256];
+	unsigned int		nr;
+	unsigned int		nr_columns;
+	struct batch_column	columns[];
+};
+
+static unsigned int batch_size;
+static struct event_batch **event_batches;
+static DECLARE_BITMAP(events_batch_checked, TRACE_EVENT_TYPE_MAX);
+
+static const char *batch_column_format(struct batch_column *col, char *buf,
+				       size_t size)
+{
+	static const char formats[2][9] = {
+		{ [1] = 'B', [2] = 'H', [4] = 'I', [8] = 'Q', },
+		{ [1] = 'b', [2] = 'h', [4] = 'i', [8] = 'q', },
+	};
+	bool is_signed;
+
+	switch (col->kind) {
+	case BATCH_COL_CPU:
+		return "I";
+	case BATCH_COL_TIME:
+		return "Q";
+	case BATCH_COL_NUMERIC:
+		is_signed = col->field->flags & FIELD_IS_SIGNED;
+		scnprintf(buf, size, "%c", formats[is_signed][col->width]);
+		return buf;
+	case BATCH_COL_FIXED:
+		scnprintf(buf, size, "%us", col->width);
+		return buf;
+	case BATCH_COL_COMM:
+	case BATCH_COL_DYNAMIC:
+	default:
+		return NULL;
+	}
+}
+
+static void batch_column__init(struct batch_column *col,
+			       struct format_field *field)
+{
+	col->field = field;
+	col->name  = field->name;
+	col->width = field->size;
+
+	if (field->flags & FIELD_IS_DYNAMIC)
+		col->kind = BATCH_COL_DYNAMIC;
+	else if ((field->flags & FIELD_IS_ARRAY) ||
+		 (field->size != 1 && field->size != 2 &&
+		  field->size != 4 && field->size != 8))
+		col->kind = BATCH_COL_FIXED;
+	else
+		col->kind = BATCH_COL_NUMERIC;
+}
+
+static struct event_batch *event_batch__new(struct event_format *event,
+					    const char *handler_name)
+{
+	struct event_batch *batch;
+	struct format_field *field;
+	struct batch_column *col;
+	PyObject *handler;
+	char name[256], fmt[16];
+	unsigned int i, n = 4;
+
+	scnprintf(name, sizeof(name), "%s__batch", handler_name);
+	handler = get_handler(name);
+	if (!handler)
+		return NULL;
+
+	for (field = event->format.fields; field; field = field->next)
+		n++;
+
+	batch = zalloc(sizeof(*batch) + n * sizeof(*col));
+	if (!batch)
+		Py_FatalError("couldn't allocate event batch");
+
+	strcpy(batch->handler_name, name);
+	batch->handler = handler;
+	batch->event_name = PyString_FromString(handler_name);
+	batch->types = PyDict_New();
+	if (!batch->event_name || !batch->types)
+		Py_FatalError("couldn't create Python event batch");
+
+	col = batch->columns;
+	col->kind = BATCH_COL_CPU;
+	col->name = "common_cpu";
+	(col++)->width = sizeof(u32);
+	col->kind = BATCH_COL_TIME;
+	col->name = "common_time";
+	(col++)->width = sizeof(u64);
+	col->kind = BATCH_COL_COMM;
+	(col++)->name = "common_comm";
+
+	field = pevent_find_common_field(event, "common_pid");
+	if (!field)
+		Py_FatalError("no common_pid field");
+	batch_column__init(col++, field);
+
+	for (field = event->format.fields; field; field = field->next)
+		batch_column__init(col++, field);
+
+	batch->nr_columns = n;
+
+	for (i = 0; i < n; i++) {
+		const char *format;
+
+		col = &batch->columns[i];
+		if (col->kind == BATCH_COL_COMM || col->kind == BATCH_COL_DYNAMIC) {
+			col->list = PyList_New(0);
+			if (!col->list)
+				Py_FatalError("couldn't create Python list");
+			continue;
+		}
+
+		col->data = malloc(batch_size * col->width);
+		if (!col->data)
+			Py_FatalError("couldn't allocate event batch column");
+
+		format = batch_column_format(col, fmt, sizeof(fmt));
+		pydict_set_item_string_decref(batch->types, col->name,
+					      PyString_FromString(format));
+	}
+
+	return batch;
+}
+
+static void event_batch__delete(struct event_batch *batch)
+{
+	unsigned int i;
+
+	for (i = 0; i < batch->nr_columns; i++) {
+		free(batch->columns[i].data);
+		Py_XDECREF(batch->columns[i].list);
+		Py_XDECREF(batch->columns[i].last_comm);
+	}
+	Py_DECREF(batch->event_name);
+	Py_DECREF(batch->types);
+	free(batch);
+}
+
+static void batch_column__add_numeric(struct batch_column *col, void *dst,
+				      struct event_format *event, void *data)
+{
+	unsigned long long val = read_size(event, data + col->field->offset,
+					   col->width);
+
+	switch (col->width) {
+	case 1:
+		*(u8 *)dst = val;
+		break;
+	case 2:
+		*(u16 *)dst = val;
+		break;
+	case 4:
+		*(u32 *)dst = val;
+		break;
+	case 8:
+	default:
+		*(u64 *)dst = val;
+		break;
+	}
+}
+
+static PyObject *batch_column__dynamic(struct batch_column *col,
+				       struct event_format *event, void *data)
+{
+	unsigned long long val = pevent_read_number(event->pevent,
+						    data + col->field->offset,
+						    col->field->size);
+	unsigned int offset = val & 0xffff, len = val >> 16;
+
+	if (col->field->flags & FIELD_IS_STRING &&
+	    is_printable_array(data + offset, len))
+		return PyString_FromString((char *)data + offset);
+
+	return PyString_FromStringAndSize((char *)data + offset, len);
+}
+
+static void batch_column__append(struct batch_column *col, PyObject *obj)
+{
+	if (!obj || PyList_Append(col->list, obj))
+		Py_FatalError("couldn't append to Python list");
+	Py_DECREF(obj);
+}
+
+static void event_batch__add(struct event_batch *batch,
+			     struct event_format *event,
+			     struct perf_sample *sample, const char *comm)
+{
+	void *data = sample->raw_data;
+	unsigned int i;
+
+	for (i = 0; i < batch->nr_columns; i++) {
+		struct batch_column *col = &batch->columns[i];
+		void *dst = col->data ? col->data + batch->nr * col->width : NULL;
+
+		switch (col->kind) {
+		case BATCH_COL_CPU:
+			*(u32 *)dst = sample->cpu;
+			break;
+		case BATCH_COL_TIME:
+			*(u64 *)dst = sample->time;
+			break;
+		case BATCH_COL_NUMERIC:
+			batch_column__add_numeric(col, dst, event, data);
+			break;
+		case BATCH_COL_FIXED:
+			memcpy(dst, data + col->field->offset, col->width);
+			break;
+		case BATCH_COL_COMM:
+			/* consecutive events mostly come from the same thread */
+			if (!col->last_comm ||
+			    strcmp(comm, PyString_AS_STRING(col->last_comm))) {
+				Py_XDECREF(col->last_comm);
+				col->last_comm = PyString_InternFromString(comm);
+			}
+			Py_XINCREF(col->last_comm);
+			batch_column__append(col, col->last_comm);
+			break;
+		case BATCH_COL_DYNAMIC:
+		default:
+			batch_column__append(col, batch_column__dynamic(col, event, data));
+			break;
+		}
+	}
+
+	batch->nr++;
+}
+
+static void event_batch__flush(struct event_batch *batch)
+{
+	PyObject *columns, *t, *obj;
+	unsigned int i;
+
+	if (!batch->nr)
+		return;
+
+	columns = PyDict_New();
+	if (!columns)
+		Py_FatalError("couldn't create Python dictionary");
+
+	for (i = 0; i < batch->nr_columns; i++) {
+		struct batch_column *col = &batch->columns[i];
+
+		if (col->list) {
+			obj = col->list;
+			col->list = PyList_New(0);
+			if (!col->list)
+				Py_FatalError("couldn't create Python list");
+		} else {
+			PyObject *str;
+
+			str = PyString_FromStringAndSize(col->data,
+							 batch->nr * col->width);
+			if (!str)
+				Py_FatalError("couldn't create Python string");
+			obj = PyMemoryView_FromObject(str);
+			Py_DECREF(str);
+			if (!obj)
+				Py_FatalError("couldn't create Python memoryview");
+		}
+		pydict_set_item_string_decref(columns, col->name, obj);
+	}
+
+	t = PyTuple_New(4);
+	if (!t)
+		Py_FatalError("couldn't create Python tuple");
+
+	Py_INCREF(batch->event_name);
+	Py_INCREF(batch->types);
+	PyTuple_SetItem(t, 0, batch->event_name);
+	PyTuple_SetItem(t, 1, PyInt_FromLong(batch->nr));
+	PyTuple_SetItem(t, 2, columns);
+	PyTuple_SetItem(t, 3, batch->types);
+
+	batch->nr = 0;
+	call_object(batch->handler, t, batch->handler_name);
+
+	Py_DECREF(t);
+}
+
+static struct event_batch *get_event_batch(struct event_format *event,
+					   const char *handler_name)
+{
+	if (!test_and_set_bit(event->id, events_batch_checked))
+		event_batches[event->id] = event_batch__new(event, handler_name);
+
+	return event_batches[event->id];
+}
+
+static void flush_event_batches(void)
+{
+	unsigned int id;
+
+	if (!event_batches)
+		return;
+
+	for_each_set_bit(id, events_batch_checked, TRACE_EVENT_TYPE_MAX) {
+		if (event_batches[id])
+			event_batch__flush(event_batches[id]);
+	}
+}
+
+static void set_batch_mode(void)
+{
+	const char *perf_script_batch_size = "perf_script_batch_size";
+	PyObject *size;
+	long val;
+
+	size = PyDict_GetItemString(main_dict, perf_script_batch_size);
+	if (!size)
+		return;
+
+	val = PyInt_AsLong(size);
+	if (val == -1 && PyErr_Occurred())
+		handler_call_die(perf_script_batch_size);
+	if (val <= 0)
+		return;
+
+	event_batches = calloc(TRACE_EVENT_TYPE_MAX, sizeof(*event_batches));
+	if (!event_batches)
+		Py_FatalError("couldn't allocate event batches");
+
+	batch_size = val;
+}
+
+static void free_event_batches(void)
+{
+	unsigned int id;
+
+	if (!event_batches)
+		return;
+
+	for_each_set_bit(id, events_batch_checked, TRACE_EVENT_TYPE_MAX) {
+		if (event_batches[id])
+			event_batch__delete(event_batches[id]);
+	}
+	zfree(&event_batches);
+	batch_size = 0;
+}
+
 static void python_process_tracepoint(struct perf_sample *sample,
 				      struct perf_evsel *evsel,
 				      struct addr_location *al)
@@ -403,23 +780,34 @@ static void python_process_tracepoint(struct perf_sample *sample,
 	unsigned long long nsecs = sample->time;
 	const char *comm = thread__comm_str(al->thread);
 
-	t = PyTuple_New(MAX_FIELDS);
-	if (!t)
-		Py_FatalError("couldn't create Python tuple");
-
 	if (!event) {
 		snprintf(handler_name, sizeof(handler_name),
 			 "ug! no event found for type %" PRIu64, (u64)evsel->attr.config);
 		Py_FatalError(handler_name);
 	}
 
-	pid = raw_field_value(event, "common_pid", data);
-
 	sprintf(handler_name, "%s__%s", event->system, event->name);
 
 	if (!test_and_set_bit(event->id, events_defined))
 		define_event_symbols(event, handler_name, event->print_fmt.args);
 
+	if (batch_size) {
+		struct event_batch *batch = get_event_batch(event, handler_name);
+
+		if (batch) {
+			event_batch__add(batch, event, sample, comm);
+			if (batch->nr == batch_size)
+				event_batch__flush(batch);
+			return;
+		}
+	}
+
+	t = PyTuple_New(MAX_FIELDS);
+	if (!t)
+		Py_FatalError("couldn't create Python tuple");
+
+	pid = raw_field_value(event, "common_pid", data);
+
 	handler = get_handler(handler_name);
 	if (!handler) {
 		dict = PyDict_New();
@@ -1015,7 +1403,11 @@ static void set_table_handlers(struct tables *tables)
 	const char *perf_db_export_mode = "perf_db_export_mode";
 	const char *perf_db_export_calls = "perf_db_export_calls";
 	const char *perf_db_export_callchains = "perf_db_export_callchains";
+	const char *perf_db_export_pgcopy = "perf_db_export_pgcopy";
+	const char *perf_db_export_pgcopy_branches = "perf_db_export_pgcopy_branches";
 	PyObject *db_export_mode, *db_export_calls, *db_export_callchains;
+	PyObject *db_export_pgcopy, *db_export_pgcopy_branches;
+	bool pgcopy_branches = false;
 	bool export_calls = false;
 	bool export_callchains = false;
 	int ret;
@@ -1085,6 +1477,28 @@ static void set_table_handlers(struct tables *tables)
 	 */
 	symbol_conf.priv_size = sizeof(u64);
 
+	/*
+	 * Write the tables as PostgreSQL binary COPY files from C, instead of
+	 * calling the *_table() handlers for every row.
+	 */
+	db_export_pgcopy = PyDict_GetItemString(main_dict, perf_db_export_pgcopy);
+	if (db_export_pgcopy && PyString_Check(db_export_pgcopy)) {
+		db_export_pgcopy_branches = PyDict_GetItemString(main_dict,
+						perf_db_export_pgcopy_branches);
+		if (db_export_pgcopy_branches) {
+			ret = PyObject_IsTrue(db_export_pgcopy_branches);
+			if (ret == -1)
+				handler_call_die(perf_db_export_pgcopy_branches);
+			pgcopy_branches = !!ret;
+		}
+
+		if (db_export_pgcopy__open(&tables->dbe,
+					   PyString_AsString(db_export_pgcopy),
+					   pgcopy_branches))
+			Py_FatalError("failed to create the export files");
+		return;
+	}
+
 	SET_TABLE_HANDLER(evsel);
 	SET_TABLE_HANDLER(machine);
 	SET_TABLE_HANDLER(thread);
@@ -1141,6 +1555,7 @@ static int python_start_script(const char *script, int argc, const char **argv)
 	}
 
 	set_table_handlers(tables);
+	set_batch_mode();
 
 	if (tables->db_export_mode) {
 		err = db_export__branch_types(&tables->dbe);
@@ -1161,8 +1576,16 @@ error:
 static int python_flush_script(void)
 {
 	struct tables *tables = &tables_global;
+	int err;
+
+	flush_event_batches();
+
+	err = db_export__flush(&tables->dbe);
+	if (err)
+		return err;
 
-	return db_export__flush(&tables->dbe);
+	/* the script's trace_end() loads the files */
+	return db_export_pgcopy__close(&tables->dbe);
 }
 
 /*
@@ -1172,8 +1595,11 @@ static int python_stop_script(void)
 {
 	struct tables *tables = &tables_global;
 
+	flush_event_batches();
 	try_call_object("trace_end", NULL);
 
+	free_event_batches();
+	db_export_pgcopy__close(&tables->dbe);
 	db_export__exit(&tables->dbe);
 
 	Py_XDECREF(main_dict);
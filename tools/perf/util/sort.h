@@ -77,6 +77,7 @@ struct hist_entry_ops {
  *
  * @row_offset - offset from the first callchain expanded to appear on screen
  * @nr_rows - rows expanded in callchain, recalculated on folding/unfolding
+ * @row_idx - position in the row index of the hists browser
  */
 struct hist_entry {
 	struct rb_node		rb_node_in;
@@ -113,6 +114,7 @@ struct hist_entry {
 		struct /* for TUI */ {
 			u16	row_offset;
 			u16	nr_rows;
+			u32	row_idx;
 			bool	init_have_children;
 			bool	unfolded;
 			bool	has_children;
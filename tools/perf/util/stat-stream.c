@@ -0,0 +1,244 @@
+#include <linux/compiler.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <asm/barrier.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "stat-stream.h"
+#include "evlist.h"
+#include "evsel.h"
+#include "counts.h"
+#include "util.h"
+#include "debug.h"
+
+#define STAT_STREAM_BUF_SIZE	(64 * 1024)
+
+struct stat_stream {
+	int				fd;
+	bool				close_fd;
+	u64				time;
+	/* buffered writer, pipes and plain files */
+	char				*buf;
+	size_t				buf_pos;
+	/* ring file */
+	void				*base;
+	size_t				mmap_len;
+	struct stat_stream_header	*header;
+	struct stat_stream_record	*ring;
+	u64				head;
+};
+
+static int stat_stream__flush(struct stat_stream *stream)
+{
+	if (stream->buf_pos == 0)
+		return 0;
+
+	if (writen(stream->fd, stream->buf, stream->buf_pos) < 0) {
+		pr_err("failed to write stat stream: %s\n", strerror(errno));
+		return -1;
+	}
+
+	stream->buf_pos = 0;
+	return 0;
+}
+
+static int stat_stream__append(struct stat_stream *stream,
+			       const void *data, size_t size)
+{
+	if (stream->buf_pos + size > STAT_STREAM_BUF_SIZE &&
+	    stat_stream__flush(stream))
+		return -1;
+
+	memcpy(stream->buf + stream->buf_pos, data, size);
+	stream->buf_pos += size;
+	return 0;
+}
+
+static void stat_stream__init_header(struct stat_stream_header *header,
+				     struct perf_evlist *evlist,
+				     unsigned int ring_size)
+{
+	header->magic	    = STAT_STREAM_MAGIC;
+	header->version	    = STAT_STREAM_VERSION;
+	header->record_size = sizeof(struct stat_stream_record);
+	header->nr_evsels   = evlist->nr_entries;
+	header->name_size   = STAT_STREAM_NAME_SIZE;
+	header->data_offset = sizeof(*header) +
+			      evlist->nr_entries * STAT_STREAM_NAME_SIZE;
+	header->ring_size   = ring_size;
+	header->head	    = 0;
+}
+
+static void evsel__stream_name(struct perf_evsel *evsel, char *name)
+{
+	memset(name, 0, STAT_STREAM_NAME_SIZE);
+	strncpy(name, perf_evsel__name(evsel), STAT_STREAM_NAME_SIZE - 1);
+}
+
+static int stat_stream__open_pipe(struct stat_stream *stream, const char *path,
+				  struct perf_evlist *evlist)
+{
+	struct stat_stream_header header;
+	struct perf_evsel *evsel;
+	char name[STAT_STREAM_NAME_SIZE];
+
+	if (!strcmp(path, "-")) {
+		stream->fd = STDOUT_FILENO;
+	} else {
+		stream->fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+		if (stream->fd < 0) {
+			pr_err("failed to open stat stream %s: %s\n",
+			       path, strerror(errno));
+			return -1;
+		}
+		stream->close_fd = true;
+	}
+
+	stream->buf = malloc(STAT_STREAM_BUF_SIZE);
+	if (stream->buf == NULL)
+		return -ENOMEM;
+
+	stat_stream__init_header(&header, evlist, 0);
+	if (stat_stream__append(stream, &header, sizeof(header)))
+		return -1;
+
+	evlist__for_each_entry(evlist, evsel) {
+		evsel__stream_name(evsel, name);
+		if (stat_stream__append(stream, name, sizeof(name)))
+			return -1;
+	}
+
+	return stat_stream__flush(stream);
+}
+
+static int stat_stream__open_ring(struct stat_stream *stream, const char *path,
+				  unsigned int ring_size,
+				  struct perf_evlist *evlist)
+{
+	struct stat_stream_header header;
+	struct perf_evsel *evsel;
+	char *names;
+
+	stat_stream__init_header(&header, evlist, ring_size);
+	stream->mmap_len = header.data_offset +
+			   (size_t)ring_size * sizeof(struct stat_stream_record);
+
+	stream->fd = open(path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+	if (stream->fd < 0) {
+		pr_err("failed to open stat stream %s: %s\n",
+		       path, strerror(errno));
+		return -1;
+	}
+	stream->close_fd = true;
+
+	if (ftruncate(stream->fd, stream->mmap_len) < 0) {
+		pr_err("failed to size stat stream %s: %s\n",
+		       path, strerror(errno));
+		return -1;
+	}
+
+	stream->base = mmap(NULL, stream->mmap_len, PROT_READ|PROT_WRITE,
+			    MAP_SHARED, stream->fd, 0);
+	if (stream->base == MAP_FAILED) {
+		stream->base = NULL;
+		pr_err("failed to mmap stat stream %s: %s\n",
+		       path, strerror(errno));
+		return -1;
+	}
+
+	names = stream->base + sizeof(header);
+	evlist__for_each_entry(evlist, evsel) {
+		evsel__stream_name(evsel, names);
+		names += STAT_STREAM_NAME_SIZE;
+	}
+
+	stream->ring = stream->base + header.data_offset;
+	stream->header = stream->base;
+	/* publish the magic last so consumers never see a partial header */
+	header.magic = 0;
+	*stream->header = header;
+	wmb();
+	stream->header->magic = STAT_STREAM_MAGIC;
+	return 0;
+}
+
+struct stat_stream *stat_stream__new(const char *path, unsigned int ring_size,
+				     struct perf_evlist *evlist)
+{
+	struct stat_stream *stream = zalloc(sizeof(*stream));
+	int err;
+
+	if (stream == NULL)
+		return NULL;
+
+	stream->fd = -1;
+
+	if (ring_size)
+		err = stat_stream__open_ring(stream, path, ring_size, evlist);
+	else
+		err = stat_stream__open_pipe(stream, path, evlist);
+
+	if (err) {
+		stat_stream__delete(stream);
+		return NULL;
+	}
+
+	return stream;
+}
+
+void stat_stream__delete(struct stat_stream *stream)
+{
+	if (stream == NULL)
+		return;
+
+	if (stream->buf)
+		stat_stream__flush(stream);
+	if (stream->base)
+		munmap(stream->base, stream->mmap_len);
+	if (stream->close_fd)
+		close(stream->fd);
+	free(stream->buf);
+	free(stream);
+}
+
+void stat_stream__begin(struct stat_stream *stream, u64 time)
+{
+	stream->time = time;
+}
+
+int stat_stream__write(struct stat_stream *stream, int evsel, int cpu,
+		       int thread, struct perf_counts_values *count)
+{
+	struct stat_stream_record rec = {
+		.time	= stream->time,
+		.evsel	= evsel,
+		.cpu	= cpu,
+		.thread	= thread,
+		.val	= count->val,
+		.ena	= count->ena,
+		.run	= count->run,
+	};
+
+	if (stream->ring) {
+		stream->ring[stream->head++ % stream->header->ring_size] = rec;
+		return 0;
+	}
+
+	return stat_stream__append(stream, &rec, sizeof(rec));
+}
+
+int stat_stream__end(struct stat_stream *stream)
+{
+	if (stream->ring) {
+		/* make the records visible before the new head */
+		wmb();
+		stream->header->head = stream->head;
+		return 0;
+	}
+
+	return stat_stream__flush(stream);
+}
@@ -0,0 +1,67 @@
+#ifndef __PERF_STAT_STREAM_H
+#define __PERF_STAT_STREAM_H
+
+#include <linux/types.h>
+#include <stdbool.h>
+
+/*
+ * Fixed schema, machine readable output for 'perf stat --stream'.
+ *
+ * The stream starts with a struct stat_stream_header followed by
+ * nr_evsels names of STAT_STREAM_NAME_SIZE bytes each (NUL padded),
+ * the record with evsel == N describes the Nth name.  After that come
+ * struct stat_stream_record entries, one per counter per cpu/thread per
+ * read, carrying the raw (unscaled, cumulative) counter values.
+ *
+ * For pipes and regular files records are appended through a buffered
+ * writer and flushed once per interval.
+ *
+ * For ring files (--stream-ring) the file is mmaped and the record area
+ * at data_offset holds ring_size slots.  Record N lives in slot
+ * N % ring_size and 'head' counts the records written so far; it is
+ * updated once per interval after a write barrier.  A consumer reads
+ * head, issues a read barrier, copies the records it has not seen yet
+ * (at most ring_size of them) and re-reads head to detect records that
+ * were overwritten during the copy.
+ */
+
+#define STAT_STREAM_MAGIC	0x4d41455254535450ULL	/* "PTSTREAM" */
+#define STAT_STREAM_VERSION	1
+#define STAT_STREAM_NAME_SIZE	64
+
+struct stat_stream_header {
+	u64	magic;
+	u32	version;
+	u32	record_size;
+	u32	nr_evsels;
+	u32	name_size;
+	u64	data_offset;
+	u64	ring_size;
+	u64	head;
+};
+
+struct stat_stream_record {
+	u64	time;		/* nsecs since the counters were enabled */
+	u32	evsel;		/* index into the name table */
+	s32	cpu;		/* -1 if not per cpu */
+	s32	thread;		/* tid, -1 if not per thread */
+	u32	reserved;
+	u64	val;
+	u64	ena;
+	u64	run;
+};
+
+struct perf_evlist;
+struct perf_counts_values;
+struct stat_stream;
+
+struct stat_stream *stat_stream__new(const char *path, unsigned int ring_size,
+				     struct perf_evlist *evlist);
+void stat_stream__delete(struct stat_stream *stream);
+
+void stat_stream__begin(struct stat_stream *stream, u64 time);
+int stat_stream__write(struct stat_stream *stream, int evsel, int cpu,
+		       int thread, struct perf_counts_values *count);
+int stat_stream__end(struct stat_stream *stream);
+
+#endif /* __PERF_STAT_STREAM_H */
@@ -20,6 +20,29 @@ void update_stats(struct stats *stats, u64 val)
 		stats->min = val;
 }
 
+/*
+ * Combine the stats of two disjoint sets of values, see "Parallel
+ * algorithm" in the page referenced below.
+ */
+void merge_stats(struct stats *stats, struct stats *other)
+{
+	double n = stats->n + other->n;
+	double delta = other->mean - stats->mean;
+
+	if (!other->n)
+		return;
+
+	stats->M2 += other->M2 + delta * delta * stats->n * other->n / n;
+	stats->mean += delta * other->n / n;
+	stats->n = n;
+
+	if (other->max > stats->max)
+		stats->max = other->max;
+
+	if (other->min < stats->min)
+		stats->min = other->min;
+}
+
 double avg_stats(struct stats *stats)
 {
 	return stats->mean;
@@ -47,6 +47,7 @@ struct perf_stat_config {
 };
 
 void update_stats(struct stats *stats, u64 val);
+void merge_stats(struct stats *stats, struct stats *other);
 double avg_stats(struct stats *stats);
 double stddev_stats(struct stats *stats);
 double rel_stddev_stats(double stddev, double avg);
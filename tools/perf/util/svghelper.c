@@ -218,21 +218,37 @@ void svg_box(int Yslot, u64 start, u64 end, const char *type)
 }
 
 static char *time_to_string(u64 duration);
-void svg_blocked(int Yslot, int cpu, u64 start, u64 end, const char *backtrace)
+
+/*
+ * Samples merged by 'perf timechart --resolution' span more time than
+ * they were busy, draw them translucent in proportion.
+ */
+static const char *busy_opacity(u64 start, u64 end, u64 busy)
+{
+	static char opacity[32];
+
+	if (busy >= end - start)
+		return "";
+
+	sprintf(opacity, " opacity=\"%.2f\"", 0.2 + 0.8 * busy / (end - start));
+	return opacity;
+}
+
+void svg_blocked(int Yslot, int cpu, u64 start, u64 end, u64 busy, const char *backtrace)
 {
 	if (!svgfile)
 		return;
 
-	fprintf(svgfile, "<g>\n");
+	fprintf(svgfile, "<g%s>\n", busy_opacity(start, end, busy));
 	fprintf(svgfile, "<title>#%d blocked %s</title>\n", cpu,
-		time_to_string(end - start));
+		time_to_string(busy));
 	if (backtrace)
 		fprintf(svgfile, "<desc>Blocked on:\n%s</desc>\n", backtrace);
 	svg_box(Yslot, start, end, "blocked");
 	fprintf(svgfile, "</g>\n");
 }
 
-void svg_running(int Yslot, int cpu, u64 start, u64 end, const char *backtrace)
+void svg_running(int Yslot, int cpu, u64 start, u64 end, u64 busy, const char *backtrace)
 {
 	double text_size;
 	const char *type;
@@ -240,14 +256,14 @@ void svg_running(int Yslot, int cpu, u64 start, u64 end, const char *backtrace)
 	if (!svgfile)
 		return;
 
-	if (svg_highlight && end - start > svg_highlight)
+	if (svg_highlight && busy > svg_highlight)
 		type = "sample_hi";
 	else
 		type = "sample";
-	fprintf(svgfile, "<g>\n");
+	fprintf(svgfile, "<g%s>\n", busy_opacity(start, end, busy));
 
 	fprintf(svgfile, "<title>#%d running %s</title>\n",
-		cpu, time_to_string(end - start));
+		cpu, time_to_string(busy));
 	if (backtrace)
 		fprintf(svgfile, "<desc>Switched because:\n%s</desc>\n", backtrace);
 	fprintf(svgfile, "<rect x=\"%.8f\" width=\"%.8f\" y=\"%.1f\" height=\"%.1f\" class=\"%s\"/>\n",
@@ -286,7 +302,7 @@ static char *time_to_string(u64 duration)
 	return text;
 }
 
-void svg_waiting(int Yslot, int cpu, u64 start, u64 end, const char *backtrace)
+void svg_waiting(int Yslot, int cpu, u64 start, u64 end, u64 busy, const char *backtrace)
 {
 	char *text;
 	const char *style;
@@ -297,10 +313,10 @@ void svg_waiting(int Yslot, int cpu, u64 start, u64 end, const char *backtrace)
 
 	style = "waiting";
 
-	if (end-start > 10 * 1000000) /* 10 msec */
+	if (busy > 10 * 1000000) /* 10 msec */
 		style = "WAITING";
 
-	text = time_to_string(end-start);
+	text = time_to_string(busy);
 
 	font_size = 1.0 * (time2pixels(end)-time2pixels(start));
 
@@ -309,8 +325,9 @@ void svg_waiting(int Yslot, int cpu, u64 start, u64 end, const char *backtrace)
 
 	font_size = round_text_size(font_size);
 
-	fprintf(svgfile, "<g transform=\"translate(%.8f,%.8f)\">\n", time2pixels(start), Yslot * SLOT_MULT);
-	fprintf(svgfile, "<title>#%d waiting %s</title>\n", cpu, time_to_string(end - start));
+	fprintf(svgfile, "<g%s transform=\"translate(%.8f,%.8f)\">\n",
+		busy_opacity(start, end, busy), time2pixels(start), Yslot * SLOT_MULT);
+	fprintf(svgfile, "<title>#%d waiting %s</title>\n", cpu, text);
 	if (backtrace)
 		fprintf(svgfile, "<desc>Waiting on:\n%s</desc>\n", backtrace);
 	fprintf(svgfile, "<rect x=\"0\" width=\"%.8f\" y=\"0\" height=\"%.1f\" class=\"%s\"/>\n",
@@ -380,7 +397,8 @@ void svg_cpu_box(int cpu, u64 __max_freq, u64 __turbo_freq)
 	fprintf(svgfile, "</g>\n");
 }
 
-void svg_process(int cpu, u64 start, u64 end, int pid, const char *name, const char *backtrace)
+void svg_process(int cpu, u64 start, u64 end, u64 busy, int pid, const char *name,
+		 const char *backtrace)
 {
 	double width;
 	const char *type;
@@ -388,15 +406,16 @@ void svg_process(int cpu, u64 start, u64 end, int pid, const char *name, const c
 	if (!svgfile)
 		return;
 
-	if (svg_highlight && end - start >= svg_highlight)
+	if (svg_highlight && busy >= svg_highlight)
 		type = "sample_hi";
 	else if (svg_highlight_name && strstr(name, svg_highlight_name))
 		type = "sample_hi";
 	else
 		type = "sample";
 
-	fprintf(svgfile, "<g transform=\"translate(%.8f,%.8f)\">\n", time2pixels(start), cpu2y(cpu));
-	fprintf(svgfile, "<title>%d %s running %s</title>\n", pid, name, time_to_string(end - start));
+	fprintf(svgfile, "<g%s transform=\"translate(%.8f,%.8f)\">\n",
+		busy_opacity(start, end, busy), time2pixels(start), cpu2y(cpu));
+	fprintf(svgfile, "<title>%d %s running %s</title>\n", pid, name, time_to_string(busy));
 	if (backtrace)
 		fprintf(svgfile, "<desc>Switched because:\n%s</desc>\n", backtrace);
 	fprintf(svgfile, "<rect x=\"0\" width=\"%.8f\" y=\"0\" height=\"%.1f\" class=\"%s\"/>\n",
@@ -414,7 +433,7 @@ void svg_process(int cpu, u64 start, u64 end, int pid, const char *name, const c
 	fprintf(svgfile, "</g>\n");
 }
 
-void svg_cstate(int cpu, u64 start, u64 end, int type)
+void svg_cstate(int cpu, u64 start, u64 end, u64 busy, int type)
 {
 	double width;
 	char style[128];
@@ -423,7 +442,7 @@ void svg_cstate(int cpu, u64 start, u64 end, int type)
 		return;
 
 
-	fprintf(svgfile, "<g>\n");
+	fprintf(svgfile, "<g%s>\n", busy_opacity(start, end, busy));
 
 	if (type > 6)
 		type = 6;
@@ -8,14 +8,15 @@ void svg_ubox(int Yslot, u64 start, u64 end, double height, const char *type, in
 void svg_lbox(int Yslot, u64 start, u64 end, double height, const char *type, int fd, int err, int merges);
 void svg_fbox(int Yslot, u64 start, u64 end, double height, const char *type, int fd, int err, int merges);
 void svg_box(int Yslot, u64 start, u64 end, const char *type);
-void svg_blocked(int Yslot, int cpu, u64 start, u64 end, const char *backtrace);
-void svg_running(int Yslot, int cpu, u64 start, u64 end, const char *backtrace);
-void svg_waiting(int Yslot, int cpu, u64 start, u64 end, const char *backtrace);
+void svg_blocked(int Yslot, int cpu, u64 start, u64 end, u64 busy, const char *backtrace);
+void svg_running(int Yslot, int cpu, u64 start, u64 end, u64 busy, const char *backtrace);
+void svg_waiting(int Yslot, int cpu, u64 start, u64 end, u64 busy, const char *backtrace);
 void svg_cpu_box(int cpu, u64 max_frequency, u64 turbo_frequency);
 
 
-void svg_process(int cpu, u64 start, u64 end, int pid, const char *name, const char *backtrace);
-void svg_cstate(int cpu, u64 start, u64 end, int type);
+void svg_process(int cpu, u64 start, u64 end, u64 busy, int pid, const char *name,
+		 const char *backtrace);
+void svg_cstate(int cpu, u64 start, u64 end, u64 busy, int type);
 void svg_pstate(int cpu, u64 start, u64 end, u64 freq);
 
 
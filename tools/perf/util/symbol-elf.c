@@ -1814,7 +1814,7 @@ void kcore_extract__delete(struct kcore_extract *kce)
 static int populate_sdt_note(Elf **elf, const char *data, size_t len,
 			     struct list_head *sdt_notes)
 {
-	const char *provider, *name;
+	const char *provider, *name, *args;
 	struct sdt_note *tmp = NULL;
 	GElf_Ehdr ehdr;
 	GElf_Addr base_off = 0;
@@ -1873,6 +1873,16 @@ static int populate_sdt_note(Elf **elf, const char *data, size_t len,
 		goto out_free_prov;
 	}
 
+	/* "size@operand" separated by spaces, e.g. "-4@%edi 8@-16(%rbp)" */
+	args = memchr(name, '\0', data + len - name);
+	if (args && ++args < data + len && *args) {
+		tmp->args = strndup(args, data + len - args);
+		if (!tmp->args) {
+			ret = -ENOMEM;
+			goto out_free_name;
+		}
+	}
+
 	if (gelf_getclass(*elf) == ELFCLASS32) {
 		memcpy(&tmp->addr, &buf, 3 * sizeof(Elf32_Addr));
 		tmp->bit32 = true;
@@ -1910,6 +1920,7 @@ static int populate_sdt_note(Elf **elf, const char *data, size_t len,
 	return 0;
 
 out_free_name:
+	free(tmp->args);
 	free(tmp->name);
 out_free_prov:
 	free(tmp->provider);
@@ -2028,6 +2039,7 @@ int cleanup_sdt_note_list(struct list_head *sdt_notes)
 
 	list_for_each_entry_safe(pos, tmp, sdt_notes, note_list) {
 		list_del(&pos->note_list);
+		free(pos->args);
 		free(pos->name);
 		free(pos->provider);
 		free(pos);
@@ -0,0 +1,44 @@
+#include <stddef.h>
+#include "time-bins.h"
+
+/* forget the entries of a previous bin, nothing can merge into them anymore */
+static void time_bin__move(struct time_bin *bin, u64 idx)
+{
+	if (bin->idx != idx) {
+		bin->idx = idx;
+		bin->entries = NULL;
+	}
+}
+
+struct time_bin_entry *time_bin__find(struct time_bin *bin, int key, u64 end,
+				      u64 resolution)
+{
+	struct time_bin_entry *entry;
+
+	if (!resolution)
+		return NULL;
+
+	time_bin__move(bin, end / resolution);
+
+	/* as many entries as keys seen in this bin, usually a handful */
+	for (entry = bin->entries; entry; entry = entry->next) {
+		if (entry->key == key)
+			return entry;
+	}
+
+	return NULL;
+}
+
+void time_bin__add(struct time_bin *bin, struct time_bin_entry *entry,
+		   int key, u64 end, u64 resolution)
+{
+	entry->key = key;
+	entry->next = NULL;
+
+	if (!resolution)
+		return;
+
+	time_bin__move(bin, end / resolution);
+	entry->next = bin->entries;
+	bin->entries = entry;
+}
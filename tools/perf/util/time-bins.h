@@ -0,0 +1,34 @@
+#ifndef __PERF_TIME_BINS_H
+#define __PERF_TIME_BINS_H
+
+#include <linux/types.h>
+
+/*
+ * Level of detail for long traces, as in 'perf timechart --resolution':
+ * time is cut in bins of 'resolution' ns and the periods of a same key
+ * ending in the same bin are merged into one element.  So there is at
+ * most one element per key and bin, however many events there are.
+ *
+ * The owner of the periods, a task, a CPU, has a time_bin with the
+ * elements ending in the current bin, the elements embed a time_bin_entry.
+ */
+struct time_bin_entry {
+	struct time_bin_entry	*next;
+	int			key;
+};
+
+struct time_bin {
+	struct time_bin_entry	*entries;
+	u64			idx;
+};
+
+/*
+ * Returns the entry of 'key' that a period ending at 'end' is to be merged
+ * into, or NULL if it needs a new one, to be passed to time_bin__add().
+ */
+struct time_bin_entry *time_bin__find(struct time_bin *bin, int key, u64 end,
+				      u64 resolution);
+void time_bin__add(struct time_bin *bin, struct time_bin_entry *entry,
+		   int key, u64 end, u64 resolution);
+
+#endif /* __PERF_TIME_BINS_H */
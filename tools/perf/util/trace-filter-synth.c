@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <traceevent/event-parse.h>
+
+#include "trace-filter-synth.h"
+#include "debug.h"
+
+#define RECORD_SIZE		64
+
+static const char sched_switch_format[] =
+"name: sched_switch\n"
+"ID: 316\n"
+"format:\n"
+"\tfield:unsigned short common_type;\toffset:0;\tsize:2;\tsigned:0;\n"
+"\tfield:unsigned char common_flags;\toffset:2;\tsize:1;\tsigned:0;\n"
+"\tfield:unsigned char common_preempt_count;\toffset:3;\tsize:1;\tsigned:0;\n"
+"\tfield:int common_pid;\toffset:4;\tsize:4;\tsigned:1;\n"
+"\n"
+"\tfield:char prev_comm[16];\toffset:8;\tsize:16;\tsigned:1;\n"
+"\tfield:pid_t prev_pid;\toffset:24;\tsize:4;\tsigned:1;\n"
+"\tfield:int prev_prio;\toffset:28;\tsize:4;\tsigned:1;\n"
+"\tfield:long prev_state;\toffset:32;\tsize:8;\tsigned:1;\n"
+"\tfield:char next_comm[16];\toffset:40;\tsize:16;\tsigned:1;\n"
+"\tfield:pid_t next_pid;\toffset:56;\tsize:4;\tsigned:1;\n"
+"\tfield:int next_prio;\toffset:60;\tsize:4;\tsigned:1;\n"
+"\n"
+"print fmt: \"prev_comm=%s prev_pid=%d prev_prio=%d prev_state=%lx ==> "
+"next_comm=%s next_pid=%d next_prio=%d\", REC->prev_comm, REC->prev_pid, "
+"REC->prev_prio, REC->prev_state, REC->next_comm, REC->next_pid, "
+"REC->next_prio\n";
+
+static const char sys_enter_format[] =
+"name: sys_enter\n"
+"ID: 21\n"
+"format:\n"
+"\tfield:unsigned short common_type;\toffset:0;\tsize:2;\tsigned:0;\n"
+"\tfield:unsigned char common_flags;\toffset:2;\tsize:1;\tsigned:0;\n"
+"\tfield:unsigned char common_preempt_count;\toffset:3;\tsize:1;\tsigned:0;\n"
+"\tfield:int common_pid;\toffset:4;\tsize:4;\tsigned:1;\n"
+"\n"
+"\tfield:long id;\toffset:8;\tsize:8;\tsigned:1;\n"
+"\tfield:unsigned long args[6];\toffset:16;\tsize:48;\tsigned:0;\n"
+"\n"
+"print fmt: \"NR %ld (%lx, %lx, %lx, %lx, %lx, %lx)\", REC->id, "
+"REC->args[0], REC->args[1], REC->args[2], REC->args[3], REC->args[4], "
+"REC->args[5]\n";
+
+struct pevent *trace_filter_synth__pevent(void)
+{
+	struct pevent *pevent = pevent_alloc();
+
+	if (pevent == NULL)
+		return NULL;
+
+	pevent_set_long_size(pevent, sizeof(long));
+	pevent_set_host_bigendian(pevent, traceevent_host_bigendian());
+	pevent_set_file_bigendian(pevent, traceevent_host_bigendian());
+
+	if (pevent_parse_event(pevent, sched_switch_format,
+			       strlen(sched_switch_format), "sched") ||
+	    pevent_parse_event(pevent, sys_enter_format,
+			       strlen(sys_enter_format), "raw_syscalls")) {
+		pr_err("Failed to parse the synthesized event formats\n");
+		pevent_free(pevent);
+		return NULL;
+	}
+
+	return pevent;
+}
+
+static void synthesize_record(struct pevent_record *record, unsigned int i)
+{
+	char *data = record->data;
+	int pid = rand() % 4096;
+
+	memset(data, 0, RECORD_SIZE);
+	*(int *)(data + 4) = pid;
+	record->size = RECORD_SIZE;
+	record->cpu = i % 64;
+
+	/* three syscalls for every context switch, some unknown (< 0) */
+	if (i % 4) {
+		*(unsigned short *)data = TRACE_FILTER_SYNTH_SYS_ENTER_ID;
+		*(long *)(data + 8) = rand() % 330 - 10;
+		return;
+	}
+
+	*(unsigned short *)data = TRACE_FILTER_SYNTH_SCHED_SWITCH_ID;
+	snprintf(data + 8, 16, pid % 16 ? "task-%d" : "swapper/0", pid % 64);
+	*(int *)(data + 24) = pid % 16 ? pid : 0;
+	*(int *)(data + 28) = 100 + rand() % 40;
+	*(long *)(data + 32) = rand() % 4;
+	snprintf(data + 40, 16, "task-%d", i % 64);
+	*(int *)(data + 56) = rand() % 4096;
+	*(int *)(data + 60) = 100 + rand() % 40;
+}
+
+struct pevent_record *trace_filter_synth__records(unsigned int nr)
+{
+	struct pevent_record *records;
+	char *data;
+	unsigned int i;
+
+	/* the records, followed by their data */
+	records = calloc(nr, sizeof(*records) + RECORD_SIZE);
+	if (records == NULL)
+		return NULL;
+
+	data = (char *)(records + nr);
+
+	srand(0);
+	for (i = 0; i < nr; i++) {
+		records[i].data = data + i * RECORD_SIZE;
+		synthesize_record(&records[i], i);
+	}
+
+	return records;
+}
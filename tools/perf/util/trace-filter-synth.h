@@ -0,0 +1,20 @@
+#ifndef __PERF_TRACE_FILTER_SYNTH_H
+#define __PERF_TRACE_FILTER_SYNTH_H
+
+/*
+ * Synthesized sched_switch and raw_syscalls:sys_enter records, for the
+ * 'perf bench trace filter' benchmark and the trace filter tests.
+ */
+
+#define TRACE_FILTER_SYNTH_SCHED_SWITCH_ID	316
+#define TRACE_FILTER_SYNTH_SYS_ENTER_ID		21
+
+struct pevent;
+struct pevent_record;
+
+/* a pevent with the two event formats parsed */
+struct pevent *trace_filter_synth__pevent(void);
+/* the same nr records on every call, free() them */
+struct pevent_record *trace_filter_synth__records(unsigned int nr);
+
+#endif /* __PERF_TRACE_FILTER_SYNTH_H */
@@ -2,6 +2,7 @@
 #include "util.h"
 #include "debug.h"
 #include <api/fs/fs.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/utsname.h>
 #ifdef HAVE_BACKTRACE_SUPPORT
@@ -19,6 +20,10 @@
 #include "callchain.h"
 #include "strlist.h"
 
+#ifndef FICLONE
+#define FICLONE		_IOW(0x94, 9, int)
+#endif
+
 #define CALLCHAIN_PARAM_DEFAULT			\
 	.mode		= CHAIN_GRAPH_ABS,	\
 	.min_percent	= 0.5,			\
@@ -250,7 +255,11 @@ int copyfile_mode(const char *from, const char *to, mode_t mode)
 	if (fromfd < 0)
 		goto out_close_to;
 
-	err = copyfile_offset(fromfd, 0, tofd, 0, st.st_size);
+	/* share the extents when the filesystem can, e.g. btrfs or xfs */
+	if (!ioctl(tofd, FICLONE, fromfd))
+		err = 0;
+	else
+		err = copyfile_offset(fromfd, 0, tofd, 0, st.st_size);
 
 	close(fromfd);
 out_close_to: